@@ -13,6 +13,9 @@
 #include "tcgs_interface.h"
 #include "tcgs_stream.h"
 #include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_interface_encode.h"
+#include "tcgs_credential.h"
       
 /*****************************************************************************
  * \brief Initializes TCG Storage Host
@@ -59,6 +62,8 @@ void TCGS_ResetHost(void)
  * that was previously initialized with TCGS_HostInit. Make sure to call it
  * when work with TCG Storage host is complete.
  *
+ * \par Cached credentials are zeroized.
+ *
  * \par TCGS_HostInit shall be called before.
  *
  * \return None
@@ -67,7 +72,7 @@ void TCGS_ResetHost(void)
  *****************************************************************************/
 void TCGS_DestroyHost(void)
 {
-    return;
+    TCGS_ClearCredentials();
 }
 
 uint8 TCGS_Buffer_Level0Discovery[TCGS_BLOCK_SIZE];
@@ -98,3 +103,43 @@ TCGS_Error_t TCGS_Level0Discovery(void)
     }
     return ERROR_SUCCESS;
 }
+
+static TCGS_Error_t TCGS_Device_ReadLevel0Discovery(TCGS_Device_t *device, void *buffer, bool quiet)
+{
+	TCGS_CommandBlock_t commandBlock;
+	TCGS_InterfaceError_t errorInterface;
+	TCGS_Level0Discovery_Header_t *header;
+	TCGS_Level0Discovery_FeatureOpal1_t *opal1;
+	TCGS_Level0Discovery_FeatureOpal2_t *opal2;
+
+	memset(buffer, 0, TCGS_BLOCK_SIZE);
+	TCGS_PrepareInterfaceCommand(LEVEL0_DISCOVERY, NULL, &commandBlock, NULL);
+	if (TCGS_Device_SendCommand(device, &commandBlock, NULL, &errorInterface, buffer) != ERROR_SUCCESS ||
+		errorInterface != INTERFACE_ERROR_GOOD)
+	{
+		return ERROR_INTERFACE;
+	}
+	header = quiet ? TCGS_DecodeLevel0DiscoveryQuiet(buffer) : TCGS_DecodeLevel0Discovery(buffer);
+
+	opal2 = TCGS_GetLevel0DiscoveryFeatureOpal2Header(header);
+	opal1 = TCGS_GetLevel0DiscoveryFeatureOpal1Header(header);
+	if (opal2 != NULL)
+	{
+		device->comId = opal2->baseComID;
+	}
+	else if (opal1 != NULL)
+	{
+		device->comId = opal1->baseComID;
+	}
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Device_Level0Discovery(TCGS_Device_t *device, void *buffer)
+{
+	return TCGS_Device_ReadLevel0Discovery(device, buffer, FALSE);
+}
+
+TCGS_Error_t TCGS_Device_Level0DiscoveryQuiet(TCGS_Device_t *device, void *buffer)
+{
+	return TCGS_Device_ReadLevel0Discovery(device, buffer, TRUE);
+}
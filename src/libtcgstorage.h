@@ -12,6 +12,7 @@
 
 #include "tcgs_types.h"
 #include "tcgs_stream.h"
+#include "tcgs_interface.h"
 
 /*****************************************************************************
  * \brief Initializes TCG Storage Host
@@ -52,6 +53,8 @@ void TCGS_ResetHost(void);
  * that was previously initialized with TCGS_HostInit. Make sure to call it
  * when work with TCG Storage host is complete.
  *
+ * \par Cached credentials are zeroized.
+ *
  * \par TCGS_HostInit shall be called before.
  *
  * \return None
@@ -74,4 +77,33 @@ void TCGS_DestroyHost(void);
  *****************************************************************************/
 TCGS_Error_t TCGS_Level0Discovery(void);
 
+/*****************************************************************************
+ * \brief Read and decode Level 0 Discovery data of device
+ *
+ * \par Base ComID of Opal SSC feature is stored to comId of the device.
+ *
+ * @param[in]  device   device
+ * @param[out] buffer   buffer of TCGS_BLOCK_SIZE bytes for decoded data
+ *
+ * \return ERROR_SUCCESS if data is read, ERROR_INTERFACE otherwise
+ *
+ * \see TCGS_Level0Discovery
+ *****************************************************************************/
+TCGS_Error_t TCGS_Device_Level0Discovery(TCGS_Device_t *device, void *buffer);
+
+/*****************************************************************************
+ * \brief Read and decode Level 0 Discovery data of device without printing it
+ *
+ * \par Same as TCGS_Device_Level0Discovery, decoded data is not printed when
+ * TCGS_VERBOSE is set. Used by periodic and bulk callers.
+ *
+ * @param[in]  device   device
+ * @param[out] buffer   buffer of TCGS_BLOCK_SIZE bytes for decoded data
+ *
+ * \return ERROR_SUCCESS if data is read, ERROR_INTERFACE otherwise
+ *
+ * \see TCGS_Device_Level0Discovery, TCGS_DecodeLevel0DiscoveryQuiet
+ *****************************************************************************/
+TCGS_Error_t TCGS_Device_Level0DiscoveryQuiet(TCGS_Device_t *device, void *buffer);
+
 #endif //_LIBTCGSTORAGE_H
@@ -0,0 +1,479 @@
+/////////////////////////////////////////////////////////////////////////////
+/// libtcgstorage.hpp
+///
+/// Header-only C++17 front end of TCG Storage Host
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _LIBTCGSTORAGE_HPP
+#define _LIBTCGSTORAGE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+extern "C" {
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+#include "tcgs_transaction.h"
+}
+
+namespace tcgs
+{
+
+/*****************************************************************************
+ * \brief View of contiguous elements owned by someone else
+ *
+ * \par Subset of std::span of C++20 with the same names, so it can be
+ * replaced by std::span when the library moves to C++20.
+ *****************************************************************************/
+template <typename T>
+class Span
+{
+public:
+	constexpr Span() : pointer(nullptr), count(0) {}
+	constexpr Span(T *data, std::size_t size) : pointer(data), count(size) {}
+	template <std::size_t N>
+	constexpr Span(T (&array)[N]) : pointer(array), count(N) {}
+
+	constexpr T *data() const { return pointer; }
+	constexpr std::size_t size() const { return count; }
+	constexpr bool empty() const { return count == 0; }
+	constexpr T *begin() const { return pointer; }
+	constexpr T *end() const { return pointer + count; }
+	constexpr T &operator[](std::size_t i) const { return pointer[i]; }
+	constexpr Span subspan(std::size_t offset, std::size_t length) const { return Span(pointer + offset, length); }
+
+private:
+	T           *pointer;
+	std::size_t  count;
+};
+
+using Bytes = Span<const uint8>;
+
+//UIDs as integers, so they can be arguments of templates, see tcgs_uid.h
+namespace uid
+{
+	constexpr uint64 ThisSP              = 0x0000000000000001ULL;
+	constexpr uint64 Method_Get          = 0x0000000600000016ULL;
+	constexpr uint64 Method_Set          = 0x0000000600000017ULL;
+	constexpr uint64 AdminSP             = 0x0000020500000001ULL;
+	constexpr uint64 LockingSP           = 0x0000020500000002ULL;
+	constexpr uint64 Anybody             = 0x0000000900000001ULL;
+	constexpr uint64 SID                 = 0x0000000900000006ULL;
+	constexpr uint64 Admin1              = 0x0000000900010001ULL;
+	constexpr uint64 User1               = 0x0000000900030001ULL;
+	constexpr uint64 C_PIN_SID           = 0x0000000B00000001ULL;
+	constexpr uint64 C_PIN_MSID          = 0x0000000B00008402ULL;
+	constexpr uint64 C_PIN_Admin1        = 0x0000000B00010001ULL;
+	constexpr uint64 C_PIN_User1         = 0x0000000B00030001ULL;
+	constexpr uint64 Locking_GlobalRange = 0x0000080200000001ULL;
+	constexpr uint64 Locking_Range1      = 0x0000080200030001ULL;
+	constexpr uint64 MBRControl          = 0x0000080300000001ULL;
+}
+
+constexpr TCGS_UID_t ToUID(uint64 uid)
+{
+	return TCGS_UID_t{{static_cast<uint8>(uid >> 56), static_cast<uint8>(uid >> 48),
+			static_cast<uint8>(uid >> 40), static_cast<uint8>(uid >> 32),
+			static_cast<uint8>(uid >> 24), static_cast<uint8>(uid >> 16),
+			static_cast<uint8>(uid >> 8), static_cast<uint8>(uid)}};
+}
+
+namespace detail
+{
+	/*
+	 * Encodes tokens at compile time the same way as TCGS_Builder_Add*,
+	 * tokens that don't fit N bytes are only counted
+	 */
+	template <std::size_t N>
+	struct Encoder
+	{
+		std::array<uint8, N> bytes{};
+		std::size_t          length = 0;
+
+		constexpr void Token(uint8 value)
+		{
+			if (length < N)
+			{
+				bytes[length] = value;
+			}
+			length++;
+		}
+
+		constexpr void UInt(uint64 value)
+		{
+			std::size_t size = sizeof(uint64);
+
+			if (value <= TCGS_TINY_ATOM_MAX)
+			{
+				Token(static_cast<uint8>(value));
+				return;
+			}
+			while (size > 1 && (value >> ((size - 1) * 8)) == 0)
+			{
+				size--;
+			}
+			Token(static_cast<uint8>(TCGS_SHORT_ATOM | size));
+			for (std::size_t i = 0; i < size; i++)
+			{
+				Token(static_cast<uint8>(value >> ((size - 1 - i) * 8)));
+			}
+		}
+
+		constexpr void UID(uint64 uid)
+		{
+			Token(static_cast<uint8>(TCGS_SHORT_ATOM_BYTES | sizeof(uint64)));
+			for (std::size_t i = 0; i < sizeof(uint64); i++)
+			{
+				Token(static_cast<uint8>(uid >> ((sizeof(uint64) - 1 - i) * 8)));
+			}
+		}
+
+		constexpr void NamedUInt(uint64 name, uint64 value)
+		{
+			Token(TOKEN_START_NAME);
+			UInt(name);
+			UInt(value);
+			Token(TOKEN_END_NAME);
+		}
+
+		constexpr void StartCall(uint64 object, uint64 method)
+		{
+			Token(TOKEN_CALL);
+			UID(object);
+			UID(method);
+			Token(TOKEN_START_LIST);
+		}
+
+		constexpr void EndCall()
+		{
+			Token(TOKEN_END_LIST);
+			Token(TOKEN_END_OF_DATA);
+			Token(TOKEN_START_LIST);
+			UInt(METHOD_STATUS_SUCCESS);
+			UInt(0);
+			UInt(0);
+			Token(TOKEN_END_LIST);
+		}
+	};
+
+	//token stream written by static Encode of Tokens, evaluated at compile time
+	template <typename Tokens>
+	struct Encoded
+	{
+		static constexpr std::size_t length = [] {
+			Encoder<0> encoder;
+			Tokens::Encode(encoder);
+			return encoder.length;
+		}();
+
+		static constexpr std::array<uint8, length> bytes = [] {
+			Encoder<length> encoder;
+			Tokens::Encode(encoder);
+			return encoder.bytes;
+		}();
+	};
+
+	//appends encoded tokens as TCGS_Builder_AddEncoded, the copy of constant size is inlined
+	template <typename Tokens>
+	inline void Append(TCGS_Builder_t *builder)
+	{
+		constexpr std::size_t length = Encoded<Tokens>::length;
+
+		if (builder->length + length > builder->size)
+		{
+			builder->overflow = TRUE;
+			return;
+		}
+		std::memcpy(builder->buffer + builder->length, Encoded<Tokens>::bytes.data(), length);
+		builder->length += length;
+	}
+
+	template <uint64 Object, uint32 Column>
+	struct SetPrefix
+	{
+		template <typename E>
+		static constexpr void Encode(E &encoder)
+		{
+			encoder.StartCall(Object, uid::Method_Set);
+			encoder.Token(TOKEN_START_NAME);
+			encoder.UInt(SET_VALUES);
+			encoder.Token(TOKEN_START_LIST);
+			encoder.Token(TOKEN_START_NAME);
+			encoder.UInt(Column);
+		}
+	};
+
+	struct SetSuffix
+	{
+		template <typename E>
+		static constexpr void Encode(E &encoder)
+		{
+			encoder.Token(TOKEN_END_NAME);
+			encoder.Token(TOKEN_END_LIST);
+			encoder.Token(TOKEN_END_NAME);
+			encoder.EndCall();
+		}
+	};
+}
+
+/*****************************************************************************
+ * \brief Get method of columns of object
+ *
+ * \par The whole invocation is encoded at compile time, tokens are the same
+ * as of TCGS_Builder_AddGet.
+ *****************************************************************************/
+template <uint64 Object, uint32 StartColumn, uint32 EndColumn>
+struct Get
+{
+	struct Tokens
+	{
+		template <typename E>
+		static constexpr void Encode(E &encoder)
+		{
+			encoder.StartCall(Object, uid::Method_Get);
+			encoder.Token(TOKEN_START_LIST);
+			encoder.NamedUInt(CELLBLOCK_START_COLUMN, StartColumn);
+			encoder.NamedUInt(CELLBLOCK_END_COLUMN, EndColumn);
+			encoder.Token(TOKEN_END_LIST);
+			encoder.EndCall();
+		}
+	};
+
+	static constexpr Bytes Encoded()
+	{
+		return Bytes(detail::Encoded<Tokens>::bytes.data(), detail::Encoded<Tokens>::length);
+	}
+
+	static void Add(TCGS_Builder_t *builder)
+	{
+		detail::Append<Tokens>(builder);
+	}
+};
+
+/*****************************************************************************
+ * \brief Set method of one column of object
+ *
+ * \par Tokens before and after the value are encoded at compile time, only
+ * the value is encoded at run time.
+ *****************************************************************************/
+template <uint64 Object, uint32 Column>
+struct SetUInt
+{
+	static void Add(TCGS_Builder_t *builder, uint64 value)
+	{
+		detail::Append<detail::SetPrefix<Object, Column>>(builder);
+		TCGS_Builder_AddUInt(builder, value);
+		detail::Append<detail::SetSuffix>(builder);
+	}
+};
+
+template <uint64 Object, uint32 Column>
+struct SetBytes
+{
+	static void Add(TCGS_Builder_t *builder, Bytes value)
+	{
+		detail::Append<detail::SetPrefix<Object, Column>>(builder);
+		TCGS_Builder_AddBytes(builder, value.data(), static_cast<uint32>(value.size()));
+		detail::Append<detail::SetSuffix>(builder);
+	}
+};
+
+/*****************************************************************************
+ * \brief Values returned by method
+ *
+ * \par The view points to the response buffer of the session, it is valid
+ * until the next method of the session. Results of transaction calls point
+ * to the buffer of the call.
+ *****************************************************************************/
+class Results
+{
+public:
+	Results() : parser{nullptr, 0, 0}, status(METHOD_STATUS_FAIL) {}
+
+	TCGS_MethodStatus_t Status() const { return status; }
+	Bytes Tokens() const { return Bytes(parser.data, parser.length); }
+
+	//parser of returned values positioned at the start
+	TCGS_Parser_t Parser() const { return parser; }
+
+	bool Find(uint64 name, uint64 &value) const
+	{
+		TCGS_Token_t token;
+
+		if (!TCGS_Parser_FindNamedValue(&parser, name, &token) || token.type != TOKEN_TYPE_UINT)
+		{
+			return false;
+		}
+		value = token.value;
+		return true;
+	}
+
+	bool Find(uint64 name, Bytes &value) const
+	{
+		TCGS_Token_t token;
+
+		if (!TCGS_Parser_FindNamedValue(&parser, name, &token) || token.type != TOKEN_TYPE_BYTES)
+		{
+			return false;
+		}
+		value = Bytes(token.data, token.length);
+		return true;
+	}
+
+private:
+	friend class Session;
+	friend class Transaction;
+
+	TCGS_Parser_t        parser;
+	TCGS_MethodStatus_t  status;
+};
+
+/*****************************************************************************
+ * \brief Session closed when it goes out of scope
+ *
+ * \par The session is neither copied nor moved: the builder of the C
+ * session points to buffers inside of it.
+ *****************************************************************************/
+class Session
+{
+public:
+	Session() { session.open = FALSE; }
+	~Session()
+	{
+		if (session.open)
+		{
+			TCGS_EndSession(&session);
+		}
+	}
+	Session(const Session &) = delete;
+	Session &operator=(const Session &) = delete;
+
+	/*
+	 * Starts session, see TCGS_StartSession
+	 */
+	TCGS_Error_t Start(TCGS_Device_t *device, const TCGS_UID_t &sp, const TCGS_UID_t *authority = nullptr,
+			Bytes challenge = Bytes(), bool write = false, TCGS_MethodStatus_t *status = nullptr)
+	{
+		return TCGS_StartSession(&session, device, &sp, authority, challenge.data(),
+				static_cast<uint32>(challenge.size()), write, status);
+	}
+
+	TCGS_Error_t End()
+	{
+		return TCGS_EndSession(&session);
+	}
+
+	bool IsOpen() const { return session.open; }
+	TCGS_Session_t *Native() { return &session; }
+
+	/*
+	 * Invokes method with run-time values, results may be nullptr
+	 */
+	template <typename Method, typename... Values>
+	TCGS_Error_t Call(Results *results, Values... values)
+	{
+		TCGS_MethodStatus_t status;
+		TCGS_Error_t error;
+
+		Method::Add(TCGS_Session_StartPacket(&session), values...);
+		error = TCGS_Session_Call(&session, (results != nullptr) ? &results->parser : nullptr, &status);
+		if (results != nullptr)
+		{
+			results->status = status;
+		}
+		return error;
+	}
+
+private:
+	TCGS_Session_t  session;
+};
+
+/*****************************************************************************
+ * \brief Transaction aborted when it goes out of scope without commit
+ *
+ * \par The session shall outlive the transaction.
+ *****************************************************************************/
+class Transaction
+{
+public:
+	Transaction() : active(false) {}
+	~Transaction()
+	{
+		if (active)
+		{
+			TCGS_EndTransaction(&transaction, FALSE);
+		}
+	}
+	Transaction(const Transaction &) = delete;
+	Transaction &operator=(const Transaction &) = delete;
+
+	TCGS_Error_t Start(Session &session)
+	{
+		TCGS_Error_t error = TCGS_StartTransaction(&transaction, session.Native());
+
+		active = (error == ERROR_SUCCESS);
+		return error;
+	}
+
+	/*
+	 * Queues method, invocations without run-time values are queued as
+	 * encoded at compile time
+	 */
+	template <typename Method, typename... Values>
+	TCGS_Error_t Call(TCGS_TransactionCall_t *call, Values... values)
+	{
+		if constexpr (sizeof...(Values) == 0)
+		{
+			return TCGS_Transaction_AddEncoded(&transaction, call, Method::Encoded().data(),
+					static_cast<uint32>(Method::Encoded().size()));
+		}
+		else
+		{
+			uint8 tokens[TCGS_MAX_COMPACKET_SIZE];
+			TCGS_Builder_t builder;
+
+			TCGS_Builder_Init(&builder, tokens, sizeof(tokens));
+			Method::Add(&builder, values...);
+			if (builder.overflow)
+			{
+				return ERROR_BUILDER;
+			}
+			return TCGS_Transaction_AddEncoded(&transaction, call, tokens, builder.length);
+		}
+	}
+
+	TCGS_Error_t Commit()
+	{
+		active = false;
+		return TCGS_EndTransaction(&transaction, TRUE);
+	}
+
+	TCGS_Error_t Abort()
+	{
+		active = false;
+		return TCGS_EndTransaction(&transaction, FALSE);
+	}
+
+	static Results GetResults(TCGS_TransactionCall_t &call)
+	{
+		Results results;
+
+		TCGS_TransactionCall_GetResults(&call, &results.parser);
+		results.status = call.status;
+		return results;
+	}
+
+private:
+	TCGS_Transaction_t  transaction;
+	bool                active;
+};
+
+} //namespace tcgs
+
+#endif //_LIBTCGSTORAGE_HPP
@@ -0,0 +1,327 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_arbiter.c
+///
+/// Arbiter of ComIDs shared by processes through shared memory
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_operation.h"
+#include "tcgs_time.h"
+#include "tcgs_comid.h"
+#include "tcgs_arbiter.h"
+
+#define TCGS_ARBITER_MAGIC   0x41434754  //"TGCA"
+#define TCGS_ARBITER_VERSION 1
+
+enum
+{
+	ARBITER_TABLE_NEW,
+	ARBITER_TABLE_INITIALIZING,
+	ARBITER_TABLE_READY,
+};
+
+/*
+ * Waits for another process to finish writing of shared state
+ */
+static bool TCGS_Arbiter_WaitState(volatile uint32 *state, uint32 value)
+{
+	uint64 deadline = TCGS_GetTime() + TCGS_ARBITER_INIT_TIMEOUT * TCGS_NSEC_PER_MSEC;
+
+	while (*state != value)
+	{
+		if (TCGS_GetTime() > deadline)
+		{
+			return FALSE;
+		}
+		TCGS_Sleep(TCGS_NSEC_PER_MSEC);
+	}
+	__sync_synchronize();
+	return TRUE;
+}
+
+TCGS_Error_t TCGS_Arbiter_Open(TCGS_Arbiter_t *arbiter, const char *path)
+{
+	TCGS_ArbiterTable_t *table;
+	struct stat status;
+	int fd;
+
+	memset(arbiter, 0, sizeof(*arbiter));
+	arbiter->fd = -1;
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0)
+	{
+		return ERROR_PARAMETER;
+	}
+	//new file is zero filled, which is the state of a new table
+	if (fstat(fd, &status) != 0 ||
+		((size_t)status.st_size < sizeof(*table) && ftruncate(fd, sizeof(*table)) != 0))
+	{
+		close(fd);
+		return ERROR_PARAMETER;
+	}
+	table = mmap(NULL, sizeof(*table), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (table == MAP_FAILED)
+	{
+		close(fd);
+		return ERROR_PARAMETER;
+	}
+
+	if (__sync_bool_compare_and_swap(&table->state, ARBITER_TABLE_NEW, ARBITER_TABLE_INITIALIZING))
+	{
+		table->magic = TCGS_ARBITER_MAGIC;
+		table->version = TCGS_ARBITER_VERSION;
+		table->slotCount = TCGS_ARBITER_SLOTS;
+		__sync_synchronize();
+		table->state = ARBITER_TABLE_READY;
+	}
+	else if (!TCGS_Arbiter_WaitState(&table->state, ARBITER_TABLE_READY))
+	{
+		munmap(table, sizeof(*table));
+		close(fd);
+		return ERROR_TIMEOUT;
+	}
+	if (table->magic != TCGS_ARBITER_MAGIC || table->version != TCGS_ARBITER_VERSION ||
+		table->slotCount != TCGS_ARBITER_SLOTS)
+	{
+		munmap(table, sizeof(*table));
+		close(fd);
+		return ERROR_PARAMETER;
+	}
+	arbiter->table = table;
+	arbiter->fd = fd;
+	return ERROR_SUCCESS;
+}
+
+void TCGS_Arbiter_Close(TCGS_Arbiter_t *arbiter)
+{
+	if (arbiter->table != NULL)
+	{
+		munmap(arbiter->table, sizeof(*arbiter->table));
+		arbiter->table = NULL;
+	}
+	if (arbiter->fd >= 0)
+	{
+		close(arbiter->fd);
+		arbiter->fd = -1;
+	}
+}
+
+TCGS_Error_t TCGS_Arbiter_GetDeviceKey(const char *path, uint64 *deviceKey)
+{
+	struct stat status;
+
+	if (stat(path, &status) != 0)
+	{
+		return ERROR_PARAMETER;
+	}
+	if (S_ISBLK(status.st_mode) || S_ISCHR(status.st_mode))
+	{
+		*deviceKey = (uint64)status.st_rdev;
+	}
+	else
+	{
+		*deviceKey = ((uint64)status.st_dev << 32) ^ (uint64)status.st_ino;
+	}
+	return ERROR_SUCCESS;
+}
+
+void TCGS_Arbiter_Attach(TCGS_Arbiter_t *arbiter, TCGS_Device_t *device, uint64 deviceKey)
+{
+	device->arbiter = arbiter;
+	device->arbiterKey = deviceKey;
+	device->arbiterSlot = NULL;
+	device->lockedSlot = NULL;
+	device->leasedSlot = NULL;
+}
+
+static void TCGS_Arbiter_InitSlot(TCGS_ArbiterSlot_t *slot, uint64 deviceKey, uint16 comId)
+{
+	pthread_mutexattr_t attributes;
+
+	slot->deviceKey = deviceKey;
+	slot->comId = comId;
+	slot->owner = 0;
+	slot->acquisitions = 0;
+	slot->contended = 0;
+	slot->recoveries = 0;
+	pthread_mutexattr_init(&attributes);
+	pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+	//the lock of the device is taken again by Stack Reset and within lease
+	pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&slot->lock, &attributes);
+	pthread_mutexattr_destroy(&attributes);
+}
+
+TCGS_ArbiterSlot_t *TCGS_Arbiter_FindSlot(TCGS_Arbiter_t *arbiter, uint64 deviceKey, uint16 comId)
+{
+	TCGS_ArbiterTable_t *table = arbiter->table;
+	TCGS_ArbiterSlot_t *slot;
+	uint64 hash = (deviceKey ^ ((uint64)comId << 48)) * 0x9E3779B97F4A7C15ULL;
+	uint32 first = (uint32)(hash >> 32) % TCGS_ARBITER_SLOTS;
+	uint32 i;
+
+	//open addressing, slots are never removed, so probing stops at the first free one
+	for (i = 0; i < TCGS_ARBITER_SLOTS; i++)
+	{
+		slot = &table->slots[(first + i) % TCGS_ARBITER_SLOTS];
+		if (__sync_bool_compare_and_swap(&slot->state, ARBITER_SLOT_FREE, ARBITER_SLOT_CLAIMED))
+		{
+			TCGS_Arbiter_InitSlot(slot, deviceKey, comId);
+			__sync_synchronize();
+			slot->state = ARBITER_SLOT_READY;
+			return slot;
+		}
+		//slot of a process that died while claiming it stays claimed and is skipped
+		if (!TCGS_Arbiter_WaitState(&slot->state, ARBITER_SLOT_READY))
+		{
+			continue;
+		}
+		if (slot->deviceKey == deviceKey && slot->comId == comId)
+		{
+			return slot;
+		}
+	}
+	return NULL;
+}
+
+TCGS_Error_t TCGS_Arbiter_Acquire(TCGS_ArbiterSlot_t *slot, bool *recovered)
+{
+	struct timespec deadline;
+	uint64 remaining;
+	int result;
+
+	if (recovered != NULL)
+	{
+		*recovered = FALSE;
+	}
+	result = pthread_mutex_trylock(&slot->lock);
+	if (result == EBUSY)
+	{
+		__sync_fetch_and_add(&slot->contended, 1);
+		remaining = TCGS_Operation_Remaining();
+		if (remaining == TCGS_OPERATION_UNLIMITED)
+		{
+			result = pthread_mutex_lock(&slot->lock);
+		}
+		else
+		{
+			//timed lock of mutex is measured with realtime clock
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			remaining += deadline.tv_nsec;
+			deadline.tv_sec += remaining / TCGS_NSEC_PER_SEC;
+			deadline.tv_nsec = remaining % TCGS_NSEC_PER_SEC;
+			result = pthread_mutex_timedlock(&slot->lock, &deadline);
+		}
+	}
+	if (result == EOWNERDEAD)
+	{
+		pthread_mutex_consistent(&slot->lock);
+		__sync_fetch_and_add(&slot->recoveries, 1);
+		if (recovered != NULL)
+		{
+			*recovered = TRUE;
+		}
+		result = 0;
+	}
+	if (result == ETIMEDOUT)
+	{
+		return ERROR_TIMEOUT;
+	}
+	if (result != 0)
+	{
+		return ERROR_INTERFACE;
+	}
+	slot->owner = (uint32)getpid();
+	slot->acquisitions++;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Arbiter_Release(TCGS_ArbiterSlot_t *slot)
+{
+	//the lock is owned by the thread that took it
+	return (pthread_mutex_unlock(&slot->lock) == 0) ? ERROR_SUCCESS : ERROR_PARAMETER;
+}
+
+TCGS_Error_t TCGS_Arbiter_LockDevice(TCGS_Device_t *device, TCGS_ArbiterSlot_t **acquired)
+{
+	TCGS_ArbiterSlot_t *slot = device->arbiterSlot;
+	TCGS_Error_t error;
+	bool recovered;
+
+	if (slot == NULL || slot->comId != device->comId)
+	{
+		slot = TCGS_Arbiter_FindSlot(device->arbiter, device->arbiterKey, device->comId);
+		if (slot == NULL)
+		{
+			return ERROR_PARAMETER;
+		}
+		device->arbiterSlot = slot;
+	}
+	error = TCGS_Arbiter_Acquire(slot, &recovered);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	//holder died within an exchange, its response may be pending on the ComID
+	if (recovered && device->comId != 0)
+	{
+		TCGS_StackReset(device, device->comId);
+	}
+	*acquired = slot;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Arbiter_Lease(TCGS_Device_t *device)
+{
+	TCGS_ArbiterSlot_t *slot;
+	TCGS_Error_t error;
+
+	if (device->arbiter == NULL)
+	{
+		return ERROR_PARAMETER;
+	}
+	error = TCGS_Arbiter_LockDevice(device, &slot);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	//the lock is recursive, only this thread may have leased the device already
+	if (device->leasedSlot != NULL)
+	{
+		TCGS_Arbiter_Release(slot);
+		return ERROR_PARAMETER;
+	}
+	device->leasedSlot = slot;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Arbiter_EndLease(TCGS_Device_t *device)
+{
+	TCGS_ArbiterSlot_t *slot = device->leasedSlot;
+
+	if (slot == NULL)
+	{
+		return ERROR_PARAMETER;
+	}
+	if (TCGS_Arbiter_Release(slot) != ERROR_SUCCESS)
+	{
+		//the lease belongs to another thread
+		return ERROR_PARAMETER;
+	}
+	device->leasedSlot = NULL;
+	return ERROR_SUCCESS;
+}
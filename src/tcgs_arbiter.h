@@ -0,0 +1,185 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_arbiter.h
+///
+/// Arbiter of ComIDs shared by processes through shared memory
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_ARBITER_H
+#define _TCGS_ARBITER_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_interface.h"
+
+typedef enum
+{
+	ARBITER_SLOT_FREE,
+	ARBITER_SLOT_CLAIMED,   //key is being written by the process that took the slot
+	ARBITER_SLOT_READY,
+} TCGS_ArbiterSlotState_t;
+
+/*****************************************************************************
+ * \brief ComID of a device in shared memory
+ *
+ * \par The lock is a process-shared robust recursive mutex: a lock that
+ * isn't contended is taken without system call, and the lock of a process
+ * that died holding it is taken over by the next process.
+ *****************************************************************************/
+typedef struct TCGS_ArbiterSlot
+{
+	volatile uint32   state;          //TCGS_ArbiterSlotState_t
+	uint16            comId;
+	uint64            deviceKey;
+	pthread_mutex_t   lock;
+	volatile uint32   owner;          //process that took the lock last
+	volatile uint64   acquisitions;
+	volatile uint64   contended;      //acquisitions that waited for another holder
+	volatile uint64   recoveries;     //locks taken over from dead processes
+} TCGS_ArbiterSlot_t;
+
+//content of the shared memory
+typedef struct
+{
+	volatile uint32     state;          //0 new, 1 being initialized, 2 ready
+	uint32              magic;
+	uint32              version;
+	uint32              slotCount;
+	TCGS_ArbiterSlot_t  slots[TCGS_ARBITER_SLOTS];
+} TCGS_ArbiterTable_t;
+
+/*****************************************************************************
+ * \brief Arbiter of ComIDs shared by processes
+ *
+ * \par Every process maps the same file, e.g. in /dev/shm or /run, there is
+ * no arbiter daemon. Slots are found and added without locks, exchanges on
+ * ComID of attached device hold the lock of its slot in addition to the
+ * lock of the device.
+ *****************************************************************************/
+typedef struct TCGS_Arbiter
+{
+	TCGS_ArbiterTable_t  *table;
+	int                   fd;
+} TCGS_Arbiter_t;
+
+/*****************************************************************************
+ * \brief Maps file of arbiter, the file is created and initialized if needed
+ *
+ * @param[out] arbiter      arbiter
+ * @param[in]  path         path of the file shared by processes
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if the file is not an arbiter of
+ * this version or can't be mapped, ERROR_TIMEOUT if another process doesn't
+ * finish its initialization
+ *****************************************************************************/
+TCGS_Error_t TCGS_Arbiter_Open(TCGS_Arbiter_t *arbiter, const char *path);
+
+/*****************************************************************************
+ * \brief Unmaps file of arbiter, locks held by the process are released by
+ * the system as by a dead process
+ *****************************************************************************/
+void TCGS_Arbiter_Close(TCGS_Arbiter_t *arbiter);
+
+/*****************************************************************************
+ * \brief Returns key of device node the same for all processes
+ *
+ * @param[in]  path         path of device, e.g. /dev/sda
+ * @param[out] deviceKey    device number of device node, file identity of
+ *                          other files
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if the path doesn't exist
+ *****************************************************************************/
+TCGS_Error_t TCGS_Arbiter_GetDeviceKey(const char *path, uint64 *deviceKey);
+
+/*****************************************************************************
+ * \brief Makes exchanges on ComIDs of device exclusive among processes
+ *
+ * \par Lock of the device takes lock of the slot of the device and its
+ * ComID first. When previous holder of the slot died during an exchange,
+ * Stack Reset of the ComID is done before the lock is returned.
+ *
+ * @param[in]  arbiter      arbiter
+ * @param[in]  device       device
+ * @param[in]  deviceKey    key of the device
+ *
+ * \return None
+ *
+ * \see TCGS_Device_Lock
+ *****************************************************************************/
+void TCGS_Arbiter_Attach(TCGS_Arbiter_t *arbiter, TCGS_Device_t *device, uint64 deviceKey);
+
+/*****************************************************************************
+ * \brief Finds slot of ComID of device, the slot is added if not found
+ *
+ * \return slot, NULL if all slots are taken
+ *****************************************************************************/
+TCGS_ArbiterSlot_t *TCGS_Arbiter_FindSlot(TCGS_Arbiter_t *arbiter, uint64 deviceKey, uint16 comId);
+
+/*****************************************************************************
+ * \brief Takes lock of slot
+ *
+ * \par Lock is recursive, the thread holding it may take it again. Deadline
+ * of current operation limits the wait.
+ *
+ * @param[in]  slot         slot
+ * @param[out] recovered    TRUE if the lock was taken over from a dead
+ *                          process, may be NULL
+ *
+ * \return ERROR_SUCCESS, ERROR_TIMEOUT if the lock is not taken before the
+ * deadline, ERROR_INTERFACE if the lock is not recoverable
+ *****************************************************************************/
+TCGS_Error_t TCGS_Arbiter_Acquire(TCGS_ArbiterSlot_t *slot, bool *recovered);
+
+/*****************************************************************************
+ * \brief Releases lock of slot
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if the calling thread doesn't hold
+ * the lock
+ *****************************************************************************/
+TCGS_Error_t TCGS_Arbiter_Release(TCGS_ArbiterSlot_t *slot);
+
+/*****************************************************************************
+ * \brief Takes lock of the slot of attached device and its current ComID
+ *
+ * \par Called by TCGS_Device_Lock. Stack Reset of the ComID is done if the
+ * lock was taken over from a dead process. The caller releases the returned
+ * slot, which stays the same if ComID of the device changes meanwhile.
+ *
+ * @param[in]  device       attached device
+ * @param[out] acquired     slot whose lock is taken
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if there is no free slot, errors of
+ * TCGS_Arbiter_Acquire
+ *****************************************************************************/
+TCGS_Error_t TCGS_Arbiter_LockDevice(TCGS_Device_t *device, TCGS_ArbiterSlot_t **acquired);
+
+/*****************************************************************************
+ * \brief Leases ComID of attached device to the thread
+ *
+ * \par Exchanges of other processes and threads on the ComID wait until the
+ * lease ends, so sessions started within the lease are not interleaved with
+ * sessions of others. The lease is held by the thread and ended by the same
+ * thread, leases of a device don't nest. The slot leased is released even if
+ * ComID of the device changes within the lease.
+ *
+ * @param[in]  device       attached device with comId set
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if the device is not attached or
+ * is leased already, errors of TCGS_Arbiter_LockDevice
+ *
+ * \see TCGS_Arbiter_EndLease
+ *****************************************************************************/
+TCGS_Error_t TCGS_Arbiter_Lease(TCGS_Device_t *device);
+
+/*****************************************************************************
+ * \brief Ends lease of the device taken by the calling thread
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if the device is not leased or the
+ * lease belongs to another thread
+ *****************************************************************************/
+TCGS_Error_t TCGS_Arbiter_EndLease(TCGS_Device_t *device);
+
+#endif //_TCGS_ARBITER_H
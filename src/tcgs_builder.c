@@ -6,13 +6,27 @@
 /// (c) Artem Zankovich
 //////////////////////////////////////////////////////////////////////////////
 
+#include <string.h>
+
+#include "tcgs_config.h"
 #include "tcgs_builder.h"
 #include "tcgs_interface.h"
+#include "tcgs_interface_encode.h"
+#include "tcgs_uid.h"
 
 /*****************************************************************************
  * \brief Encodes both parts of interface commands: (1) a command block and
  * (2) a data payload
  *
+ * \par For PACKET and PACKET_RESPONSE commands data is a ComPacket generated
+ * with TCGS_Builder_t. ComID and transfer length of the command block are
+ * taken from the ComPacket header. PACKET payload is copied to payload buffer
+ * unless payload is NULL or the same buffer as data.
+ *
+ * \par For COMID_REQUEST and COMID_RESPONSE commands data is a ComID
+ * management request, its ComID is used for the command block. The request
+ * is copied to the block of payload.
+ *
  * @param[in]  command      Code of command to encode
  * @param[in]  data         Data of the command to encode. NULL if command has no data
  * @param[out] commandBlock buffer for generated command block part of interface command
@@ -25,6 +39,8 @@
 TCGS_Error_t TCGS_PrepareInterfaceCommand(TCGS_InterfaceCommand_t command, uint8 *data,
    TCGS_CommandBlock_t *commandBlock, void *payload)
 {
+	#define comPacket ((TCGS_ComPacketHeader_t*)data)
+
 	switch (command)
 	{
 	case LEVEL0_DISCOVERY:
@@ -37,9 +53,279 @@ TCGS_Error_t TCGS_PrepareInterfaceCommand(TCGS_InterfaceCommand_t command, uint8
 		commandBlock->command    = IF_SEND;
 		commandBlock->protocolId = 0x01;
 		commandBlock->length     = 0x00;	//length is to be updated when payload is generated
-		commandBlock->comId      = 0x01;    //TODO: get ComId from data (or parameter?)
+		commandBlock->comId      = 0x01;
+		if (data != NULL)
+		{
+			commandBlock->comId  = _getBE16(comPacket->comId);
+			commandBlock->length = (sizeof(TCGS_ComPacketHeader_t) + _getBE32(comPacket->length)
+					+ TCGS_BLOCK_SIZE - 1) / TCGS_BLOCK_SIZE;
+			if (payload != NULL && payload != data)
+			{
+				memcpy(payload, data, TCGS_GetTransferLength(commandBlock));
+			}
+		}
+		break;
+	case PACKET_RESPONSE:
+		if (data == NULL)
+		{
+			return ERROR_BUILDER;
+		}
+		commandBlock->command    = IF_RECV;
+		commandBlock->protocolId = 0x01;
+		commandBlock->length     = TCGS_MAX_COMPACKET_SIZE / TCGS_BLOCK_SIZE;
+		commandBlock->comId      = _getBE16(comPacket->comId);
+		break;
+	case COMID_REQUEST:
+	case COMID_RESPONSE:
+		if (data == NULL)
+		{
+			return ERROR_BUILDER;
+		}
+		commandBlock->command    = (command == COMID_REQUEST) ? IF_SEND : IF_RECV;
+		commandBlock->protocolId = 0x02;
+		commandBlock->length     = 0x01;
+		commandBlock->comId      = _getBE16(((TCGS_ComIDRequest_t*)data)->comId);
+		if (command == COMID_REQUEST && payload != NULL)
+		{
+			memset(payload, 0, TCGS_BLOCK_SIZE);
+			memcpy(payload, data, sizeof(TCGS_ComIDRequest_t));
+		}
 		break;
 	} //switch (command) 
 	
 	return ERROR_SUCCESS;
+	#undef comPacket
+}
+
+static void TCGS_Builder_Write(TCGS_Builder_t *builder, const void *data, uint32 length)
+{
+	if (builder->length + length > builder->size)
+	{
+		builder->overflow = TRUE;
+		return;
+	}
+	memcpy(builder->buffer + builder->length, data, length);
+	builder->length += length;
+}
+
+static void TCGS_Builder_WriteByte(TCGS_Builder_t *builder, uint8 value)
+{
+	TCGS_Builder_Write(builder, &value, 1);
+}
+
+void TCGS_Builder_Init(TCGS_Builder_t *builder, void *buffer, uint32 size)
+{
+	builder->buffer   = (uint8*)buffer;
+	builder->size     = size;
+	builder->length   = 0;
+	builder->overflow = FALSE;
+}
+
+void TCGS_Builder_StartComPacket(TCGS_Builder_t *builder, uint16 comId,
+		uint32 tperSessionNumber, uint32 hostSessionNumber)
+{
+	TCGS_ComPacketHeader_t *comPacket = (TCGS_ComPacketHeader_t*)builder->buffer;
+	TCGS_PacketHeader_t *packet = (TCGS_PacketHeader_t*)(comPacket + 1);
+
+	builder->length = 0;
+	builder->overflow = FALSE;
+	if (builder->size < TCGS_PACKET_HEADERS_LENGTH)
+	{
+		builder->overflow = TRUE;
+		return;
+	}
+	memset(builder->buffer, 0, TCGS_PACKET_HEADERS_LENGTH);
+	_putBE16(comPacket->comId, comId);
+	_putBE32(packet->tperSessionNumber, tperSessionNumber);
+	_putBE32(packet->hostSessionNumber, hostSessionNumber);
+	builder->length = TCGS_PACKET_HEADERS_LENGTH;
+}
+
+uint32 TCGS_Builder_GetDataLength(TCGS_Builder_t *builder)
+{
+	return builder->length - TCGS_PACKET_HEADERS_LENGTH;
+}
+
+TCGS_Error_t TCGS_Builder_EndComPacket(TCGS_Builder_t *builder)
+{
+	TCGS_ComPacketHeader_t *comPacket = (TCGS_ComPacketHeader_t*)builder->buffer;
+	TCGS_PacketHeader_t *packet = (TCGS_PacketHeader_t*)(comPacket + 1);
+	TCGS_SubPacketHeader_t *subPacket = (TCGS_SubPacketHeader_t*)(packet + 1);
+	uint32 dataLength, paddedLength, totalLength;
+
+	if (builder->overflow || builder->length < TCGS_PACKET_HEADERS_LENGTH)
+	{
+		return ERROR_BUILDER;
+	}
+	dataLength = TCGS_Builder_GetDataLength(builder);
+	paddedLength = (dataLength + 3) & ~3;
+	totalLength = (TCGS_PACKET_HEADERS_LENGTH + paddedLength + TCGS_BLOCK_SIZE - 1) & ~(TCGS_BLOCK_SIZE - 1);
+	if (totalLength > builder->size)
+	{
+		builder->overflow = TRUE;
+		return ERROR_BUILDER;
+	}
+	memset(builder->buffer + builder->length, 0, totalLength - builder->length);
+
+	_putBE32(subPacket->length, dataLength);
+	_putBE32(packet->length, sizeof(TCGS_SubPacketHeader_t) + paddedLength);
+	_putBE32(comPacket->length, sizeof(TCGS_PacketHeader_t) + sizeof(TCGS_SubPacketHeader_t) + paddedLength);
+
+	return ERROR_SUCCESS;
+}
+
+void TCGS_Builder_AddToken(TCGS_Builder_t *builder, TCGS_ControlToken_t token)
+{
+	TCGS_Builder_WriteByte(builder, (uint8)token);
+}
+
+void TCGS_Builder_AddUInt(TCGS_Builder_t *builder, uint64 value)
+{
+	uint8 atom[1 + sizeof(uint64)];
+	uint32 length = sizeof(uint64);
+	uint32 i;
+
+	if (value <= TCGS_TINY_ATOM_MAX)
+	{
+		TCGS_Builder_WriteByte(builder, (uint8)value);
+		return;
+	}
+	//short atom with minimal number of bytes
+	while (length > 1 && (value >> ((length - 1) * 8)) == 0)
+	{
+		length--;
+	}
+	atom[0] = TCGS_SHORT_ATOM | (uint8)length;
+	for (i = 0; i < length; i++)
+	{
+		atom[1 + i] = (uint8)(value >> ((length - 1 - i) * 8));
+	}
+	TCGS_Builder_Write(builder, atom, 1 + length);
+}
+
+void TCGS_Builder_AddBytes(TCGS_Builder_t *builder, const void *data, uint32 length)
+{
+	uint8 header[4];
+
+	if (length <= TCGS_SHORT_ATOM_MAX)
+	{
+		header[0] = TCGS_SHORT_ATOM_BYTES | (uint8)length;
+		TCGS_Builder_Write(builder, header, 1);
+	}
+	else if (length <= TCGS_MEDIUM_ATOM_MAX)
+	{
+		header[0] = TCGS_MEDIUM_ATOM_BYTES | (uint8)(length >> 8);
+		header[1] = (uint8)length;
+		TCGS_Builder_Write(builder, header, 2);
+	}
+	else
+	{
+		header[0] = TCGS_LONG_ATOM_BYTES;
+		header[1] = (uint8)(length >> 16);
+		header[2] = (uint8)(length >> 8);
+		header[3] = (uint8)length;
+		TCGS_Builder_Write(builder, header, 4);
+	}
+	TCGS_Builder_Write(builder, data, length);
+}
+
+void TCGS_Builder_AddUID(TCGS_Builder_t *builder, const TCGS_UID_t *uid)
+{
+	TCGS_Builder_AddBytes(builder, uid->bytes, sizeof(uid->bytes));
+}
+
+void TCGS_Builder_AddEncoded(TCGS_Builder_t *builder, const void *tokens, uint32 length)
+{
+	TCGS_Builder_Write(builder, tokens, length);
+}
+
+void TCGS_Builder_AddNamedUInt(TCGS_Builder_t *builder, uint32 name, uint64 value)
+{
+	TCGS_Builder_AddToken(builder, TOKEN_START_NAME);
+	TCGS_Builder_AddUInt(builder, name);
+	TCGS_Builder_AddUInt(builder, value);
+	TCGS_Builder_AddToken(builder, TOKEN_END_NAME);
+}
+
+void TCGS_Builder_AddNamedBytes(TCGS_Builder_t *builder, uint32 name, const void *data, uint32 length)
+{
+	TCGS_Builder_AddToken(builder, TOKEN_START_NAME);
+	TCGS_Builder_AddUInt(builder, name);
+	TCGS_Builder_AddBytes(builder, data, length);
+	TCGS_Builder_AddToken(builder, TOKEN_END_NAME);
+}
+
+void TCGS_Builder_AddNamedUID(TCGS_Builder_t *builder, uint32 name, const TCGS_UID_t *uid)
+{
+	TCGS_Builder_AddNamedBytes(builder, name, uid->bytes, sizeof(uid->bytes));
+}
+
+void TCGS_Builder_StartCall(TCGS_Builder_t *builder, const TCGS_UID_t *invokingId,
+		const TCGS_UID_t *methodId)
+{
+	TCGS_Builder_AddToken(builder, TOKEN_CALL);
+	TCGS_Builder_AddUID(builder, invokingId);
+	TCGS_Builder_AddUID(builder, methodId);
+	TCGS_Builder_AddToken(builder, TOKEN_START_LIST);
+}
+
+void TCGS_Builder_AddStatus(TCGS_Builder_t *builder, TCGS_MethodStatus_t status)
+{
+	TCGS_Builder_AddToken(builder, TOKEN_END_OF_DATA);
+	TCGS_Builder_AddToken(builder, TOKEN_START_LIST);
+	TCGS_Builder_AddUInt(builder, status);
+	TCGS_Builder_AddUInt(builder, 0);
+	TCGS_Builder_AddUInt(builder, 0);
+	TCGS_Builder_AddToken(builder, TOKEN_END_LIST);
+}
+
+void TCGS_Builder_EndCall(TCGS_Builder_t *builder)
+{
+	TCGS_Builder_AddToken(builder, TOKEN_END_LIST);
+	TCGS_Builder_AddStatus(builder, METHOD_STATUS_SUCCESS);
+}
+
+void TCGS_Builder_AddGet(TCGS_Builder_t *builder, const TCGS_UID_t *object,
+		uint32 startColumn, uint32 endColumn)
+{
+	TCGS_Builder_StartCall(builder, object, &TCGS_UID_Method_Get);
+	TCGS_Builder_AddToken(builder, TOKEN_START_LIST);
+	TCGS_Builder_AddNamedUInt(builder, CELLBLOCK_START_COLUMN, startColumn);
+	TCGS_Builder_AddNamedUInt(builder, CELLBLOCK_END_COLUMN, endColumn);
+	TCGS_Builder_AddToken(builder, TOKEN_END_LIST);
+	TCGS_Builder_EndCall(builder);
+}
+
+static void TCGS_Builder_StartSet(TCGS_Builder_t *builder, const TCGS_UID_t *object, uint32 column)
+{
+	TCGS_Builder_StartCall(builder, object, &TCGS_UID_Method_Set);
+	TCGS_Builder_AddToken(builder, TOKEN_START_NAME);
+	TCGS_Builder_AddUInt(builder, SET_VALUES);
+	TCGS_Builder_AddToken(builder, TOKEN_START_LIST);
+	TCGS_Builder_AddToken(builder, TOKEN_START_NAME);
+	TCGS_Builder_AddUInt(builder, column);
+}
+
+static void TCGS_Builder_EndSet(TCGS_Builder_t *builder)
+{
+	TCGS_Builder_AddToken(builder, TOKEN_END_NAME);
+	TCGS_Builder_AddToken(builder, TOKEN_END_LIST);
+	TCGS_Builder_AddToken(builder, TOKEN_END_NAME);
+	TCGS_Builder_EndCall(builder);
+}
+
+void TCGS_Builder_AddSetUInt(TCGS_Builder_t *builder, const TCGS_UID_t *object,
+		uint32 column, uint64 value)
+{
+	TCGS_Builder_StartSet(builder, object, column);
+	TCGS_Builder_AddUInt(builder, value);
+	TCGS_Builder_EndSet(builder);
+}
+
+void TCGS_Builder_AddSetBytes(TCGS_Builder_t *builder, const TCGS_UID_t *object,
+		uint32 column, const void *data, uint32 length)
+{
+	TCGS_Builder_StartSet(builder, object, column);
+	TCGS_Builder_AddBytes(builder, data, length);
+	TCGS_Builder_EndSet(builder);
 }
@@ -8,6 +8,8 @@
 #ifndef _TCGS_BUILDER_H
 #define _TCGS_BUILDER_H  
 
+#include <stdbool.h>
+
 #include "tcgs_types.h"
 #include "tcgs_stream.h"
 #include "tcgs_interface.h"
@@ -15,13 +17,25 @@
 typedef enum
 {
 	LEVEL0_DISCOVERY,
-	PACKET
+	PACKET,
+	PACKET_RESPONSE,
+	COMID_REQUEST,      //ComID management request, data is TCGS_ComIDRequest_t
+	COMID_RESPONSE,     //response to ComID management request, data is the request
 } TCGS_InterfaceCommand_t; 
 
 /*****************************************************************************
  * \brief Encodes both parts of interface commands: (1) a command block and
  * (2) a data payload
  *
+ * \par For PACKET and PACKET_RESPONSE commands data is a ComPacket generated
+ * with TCGS_Builder_t. ComID and transfer length of the command block are
+ * taken from the ComPacket header. PACKET payload is copied to payload buffer
+ * unless payload is NULL or the same buffer as data.
+ *
+ * \par For COMID_REQUEST and COMID_RESPONSE commands data is a ComID
+ * management request, its ComID is used for the command block. The request
+ * is copied to the block of payload.
+ *
  * @param[in]  command      Code of command to encode
  * @param[in]  data         Data of the command to encode. NULL if command has no data
  * @param[out] commandBlock buffer for generated command block part of interface command
@@ -34,4 +48,144 @@ typedef enum
 TCGS_Error_t TCGS_PrepareInterfaceCommand(TCGS_InterfaceCommand_t command, uint8 *data,
 		TCGS_CommandBlock_t *commandBlock, void *payload);
 
+/*****************************************************************************
+ * \brief Builder of ComPackets
+ *
+ * The builder writes headers and token stream of one ComPacket with one
+ * Packet and one SubPacket to caller-supplied buffer. Encoding functions
+ * never write beyond the buffer, overflow is reported by
+ * TCGS_Builder_EndComPacket.
+ *****************************************************************************/
+typedef struct
+{
+	uint8  *buffer;     //buffer for ComPacket
+	uint32  size;       //size of the buffer
+	uint32  length;     //number of bytes written to the buffer
+	bool    overflow;   //TRUE if some data didn't fit the buffer
+} TCGS_Builder_t;
+
+/*****************************************************************************
+ * \brief Initializes builder with buffer
+ *
+ * @param[out] builder      builder to initialize
+ * @param[in]  buffer       buffer for ComPacket, its size shall be a multiple
+ *                          of TCGS_BLOCK_SIZE
+ * @param[in]  size         size of the buffer
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Builder_Init(TCGS_Builder_t *builder, void *buffer, uint32 size);
+
+/*****************************************************************************
+ * \brief Starts new ComPacket in the builder buffer
+ *
+ * \par Headers of ComPacket, Packet and SubPacket are reserved and filled
+ * by TCGS_Builder_EndComPacket. Session numbers are 0 for Session Manager
+ * calls.
+ *
+ * @param[in]  builder              builder
+ * @param[in]  comId                ComID
+ * @param[in]  tperSessionNumber    TPer session number
+ * @param[in]  hostSessionNumber    host session number
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Builder_StartComPacket(TCGS_Builder_t *builder, uint16 comId,
+		uint32 tperSessionNumber, uint32 hostSessionNumber);
+
+/*****************************************************************************
+ * \brief Completes ComPacket: fills lengths of headers and pads the data
+ *
+ * \par SubPacket data is padded to 4 bytes and the ComPacket is padded with
+ * zeroes to the block boundary.
+ *
+ * @param[in]  builder      builder
+ *
+ * \return ERROR_SUCCESS if ComPacket fits the buffer, ERROR_BUILDER otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_Builder_EndComPacket(TCGS_Builder_t *builder);
+
+/*****************************************************************************
+ * \brief Return length of token stream written to current SubPacket
+ *
+ * @param[in]  builder      builder
+ *
+ * \return uint32 number of bytes of tokens
+ *****************************************************************************/
+uint32 TCGS_Builder_GetDataLength(TCGS_Builder_t *builder);
+
+/*****************************************************************************
+ * \brief Token encoding functions
+ *
+ * Integers are encoded with the shortest atom, byte sequences with short,
+ * medium or long atom depending on length.
+ *****************************************************************************/
+void TCGS_Builder_AddToken(TCGS_Builder_t *builder, TCGS_ControlToken_t token);
+void TCGS_Builder_AddUInt(TCGS_Builder_t *builder, uint64 value);
+void TCGS_Builder_AddBytes(TCGS_Builder_t *builder, const void *data, uint32 length);
+void TCGS_Builder_AddUID(TCGS_Builder_t *builder, const TCGS_UID_t *uid);
+
+/*****************************************************************************
+ * \brief Adds tokens encoded in advance
+ *
+ * \par Used for method invocations encoded at compile time, see
+ * libtcgstorage.hpp.
+ *
+ * @param[in]  builder      builder
+ * @param[in]  tokens       encoded tokens
+ * @param[in]  length       length of the tokens
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Builder_AddEncoded(TCGS_Builder_t *builder, const void *tokens, uint32 length);
+void TCGS_Builder_AddNamedUInt(TCGS_Builder_t *builder, uint32 name, uint64 value);
+void TCGS_Builder_AddNamedBytes(TCGS_Builder_t *builder, uint32 name, const void *data, uint32 length);
+void TCGS_Builder_AddNamedUID(TCGS_Builder_t *builder, uint32 name, const TCGS_UID_t *uid);
+
+/*****************************************************************************
+ * \brief Starts method invocation: Call token, invoking UID, method UID and
+ * start of parameter list
+ *
+ * @param[in]  builder      builder
+ * @param[in]  invokingId   UID of invoking table, object or Session Manager
+ * @param[in]  methodId     UID of method
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Builder_StartCall(TCGS_Builder_t *builder, const TCGS_UID_t *invokingId,
+		const TCGS_UID_t *methodId);
+
+/*****************************************************************************
+ * \brief Completes method invocation: end of parameter list, End of Data
+ * token and status list
+ *
+ * @param[in]  builder      builder
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Builder_EndCall(TCGS_Builder_t *builder);
+
+/*****************************************************************************
+ * \brief Writes End of Data token and method status list
+ *
+ * @param[in]  builder      builder
+ * @param[in]  status       method status code
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Builder_AddStatus(TCGS_Builder_t *builder, TCGS_MethodStatus_t status);
+
+/*****************************************************************************
+ * \brief Method encoding functions: complete invocations of Get on a cell
+ * block of one row and Set of one column
+ *
+ * \see TCGS_Get, TCGS_SetUInt, TCGS_SetBytes
+ *****************************************************************************/
+void TCGS_Builder_AddGet(TCGS_Builder_t *builder, const TCGS_UID_t *object,
+		uint32 startColumn, uint32 endColumn);
+void TCGS_Builder_AddSetUInt(TCGS_Builder_t *builder, const TCGS_UID_t *object,
+		uint32 column, uint64 value);
+void TCGS_Builder_AddSetBytes(TCGS_Builder_t *builder, const TCGS_UID_t *object,
+		uint32 column, const void *data, uint32 length);
+
 #endif //TCGS_BUILDER_H
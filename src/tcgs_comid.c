@@ -0,0 +1,143 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_comid.c
+///
+/// ComID management: verification of ComID and Stack Reset
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <pthread.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_interface.h"
+#include "tcgs_interface_encode.h"
+#include "tcgs_time.h"
+#include "tcgs_comid.h"
+#include "tcgs_operation.h"
+
+/*
+ * Sends ComID management request and polls TPer for its response. The
+ * device is locked for the exchange, so it doesn't interleave with sessions.
+ */
+static TCGS_Error_t TCGS_ComID_Request(TCGS_Device_t *device, uint16 comId,
+		TCGS_ComIDRequestCode_t code, uint32 *data)
+{
+	uint32 buffer[TCGS_BLOCK_SIZE / sizeof(uint32)];
+	TCGS_ComIDRequest_t request;
+	TCGS_ComIDResponse_t *response = (TCGS_ComIDResponse_t*)buffer;
+	TCGS_CommandBlock_t commandBlock;
+	TCGS_InterfaceError_t interfaceError;
+	TCGS_Error_t status;
+	uint32 attempt;
+
+	memset(&request, 0, sizeof(request));
+	_putBE16(request.comId, comId);
+	_putBE32(request.requestCode, code);
+
+	status = TCGS_Device_Lock(device);
+	if (status != ERROR_SUCCESS)
+	{
+		return status;
+	}
+	TCGS_PrepareInterfaceCommand(COMID_REQUEST, (uint8*)&request, &commandBlock, buffer);
+	status = TCGS_Device_SendCommand(device, &commandBlock, buffer, &interfaceError, NULL);
+	if (status != ERROR_SUCCESS || interfaceError != INTERFACE_ERROR_GOOD)
+	{
+		TCGS_Device_Unlock(device);
+		return TCGS_IsOperationError(status) ? status : ERROR_INTERFACE;
+	}
+	status = ERROR_INTERFACE;
+
+	TCGS_PrepareInterfaceCommand(COMID_RESPONSE, (uint8*)&request, &commandBlock, NULL);
+	for (attempt = 0; attempt < TCGS_SESSION_POLL_LIMIT; attempt++)
+	{
+		memset(buffer, 0, sizeof(buffer));
+		status = TCGS_Device_SendCommand(device, &commandBlock, NULL, &interfaceError, buffer);
+		if (TCGS_IsOperationError(status))
+		{
+			break;
+		}
+		if (status != ERROR_SUCCESS || interfaceError != INTERFACE_ERROR_GOOD ||
+			_getBE16(response->comId) != comId || _getBE32(response->requestCode) != code)
+		{
+			status = ERROR_INTERFACE;
+			break;
+		}
+		if (_getBE16(response->availableDataLength) >= sizeof(response->data))
+		{
+			*data = _getBE32(response->data);
+			break;
+		}
+		//TPer is still processing the request
+		status = TCGS_Operation_Sleep(TCGS_SESSION_POLL_INTERVAL * TCGS_NSEC_PER_USEC);
+		if (status != ERROR_SUCCESS)
+		{
+			break;
+		}
+		status = ERROR_INTERFACE;
+	}
+	TCGS_Device_Unlock(device);
+	return status;
+}
+
+TCGS_Error_t TCGS_VerifyComID(TCGS_Device_t *device, uint16 comId, TCGS_ComIDState_t *state)
+{
+	TCGS_Error_t error;
+	uint32 data;
+
+	error = TCGS_ComID_Request(device, comId, COMID_REQUEST_VERIFY_COMID_VALID, &data);
+	if (error == ERROR_SUCCESS)
+	{
+		*state = (TCGS_ComIDState_t)data;
+	}
+	return error;
+}
+
+TCGS_Error_t TCGS_StackReset(TCGS_Device_t *device, uint16 comId)
+{
+	TCGS_Error_t error;
+	uint32 data;
+
+	error = TCGS_ComID_Request(device, comId, COMID_REQUEST_STACK_RESET, &data);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	//0 is success, 1 is failure of the reset
+	return (data == 0) ? ERROR_SUCCESS : ERROR_INTERFACE;
+}
+
+TCGS_Error_t TCGS_Device_ReclaimComID(TCGS_Device_t *device, TCGS_Level0Discovery_Header_t *header,
+		bool *reset)
+{
+	TCGS_Level0Discovery_FeatureTper_t *tper = TCGS_GetLevel0DiscoveryFeatureTperHeader(header);
+	TCGS_ComIDState_t state;
+	TCGS_Error_t error;
+
+	*reset = FALSE;
+	if (tper == NULL || !tper->comIdManagementSupported)
+	{
+		return ERROR_PARAMETER;
+	}
+	error = TCGS_VerifyComID(device, device->comId, &state);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	switch (state)
+	{
+	case COMID_STATE_ASSOCIATED:
+		error = TCGS_StackReset(device, device->comId);
+		*reset = (error == ERROR_SUCCESS);
+		return error;
+	case COMID_STATE_INVALID:
+		return ERROR_PARAMETER;
+	default:
+		return ERROR_SUCCESS;
+	}
+}
@@ -0,0 +1,62 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_comid.h
+///
+/// ComID management: verification of ComID and Stack Reset
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_COMID_H
+#define _TCGS_COMID_H
+
+#include <stdbool.h>
+
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+
+/*****************************************************************************
+ * \brief Reads state of ComID with VERIFY_COMID_VALID request
+ *
+ * @param[in]  device       device
+ * @param[in]  comId        ComID to verify
+ * @param[out] state        state of ComID
+ *
+ * \return ERROR_SUCCESS if state is read, ERROR_INTERFACE otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_VerifyComID(TCGS_Device_t *device, uint16 comId, TCGS_ComIDState_t *state);
+
+/*****************************************************************************
+ * \brief Resets synchronous protocol stack of ComID with STACK_RESET request
+ *
+ * \par All sessions open on the ComID are aborted, open transactions are
+ * rolled back and pending responses are discarded.
+ *
+ * @param[in]  device       device
+ * @param[in]  comId        ComID to reset
+ *
+ * \return ERROR_SUCCESS if TPer reports success of the reset, ERROR_INTERFACE
+ * otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_StackReset(TCGS_Device_t *device, uint16 comId);
+
+/*****************************************************************************
+ * \brief Reclaims ComID of device from sessions left open by a crashed host
+ *
+ * \par ComID of the device is verified and reset only if sessions are
+ * associated with it, so a clean ComID is not disturbed. The function is
+ * to be called before the first session is started on the device, sessions
+ * open on the ComID by this host are aborted too.
+ *
+ * @param[in]  device       device with comId set
+ * @param[in]  header       decoded Level 0 Discovery response of the device
+ * @param[out] reset        TRUE if Stack Reset was done
+ *
+ * \return ERROR_SUCCESS if ComID is usable, ERROR_PARAMETER if TPer doesn't
+ * support ComID management or ComID is not valid, ERROR_INTERFACE otherwise
+ *
+ * \see TCGS_Device_Level0Discovery
+ *****************************************************************************/
+TCGS_Error_t TCGS_Device_ReclaimComID(TCGS_Device_t *device, TCGS_Level0Discovery_Header_t *header,
+		bool *reset);
+
+#endif //_TCGS_COMID_H
@@ -11,6 +11,135 @@
 
 #include <stdbool.h>
 
+#include "tcgs_types.h"
+
+//build profile for Shadow MBR pre-boot image: buffers are static and sized
+//at build time, verbose output and hash acceleration are stripped,
+//session pool and caches are reduced
+#ifndef TCGS_PROFILE_PREBOOT
+#define TCGS_PROFILE_PREBOOT FALSE
+#endif
+
+#if TCGS_PROFILE_PREBOOT
+#define TCGS_VERBOSE FALSE
+#else
 #define TCGS_VERBOSE TRUE
+#endif
+
+//devices and sessions of pre-boot image are kept in static tables of
+//tcgs_preboot.c, their number is fixed at build time
+#ifndef TCGS_PREBOOT_MAX_DEVICES
+#define TCGS_PREBOOT_MAX_DEVICES 4
+#endif
+#ifndef TCGS_PREBOOT_MAX_SESSIONS
+#define TCGS_PREBOOT_MAX_SESSIONS 4
+#endif
+
+//size of buffers for ComPackets sent and received within session,
+//shall be a multiple of TCGS_BLOCK_SIZE and not exceed MaxComPacketSize of TPer
+#define TCGS_MAX_COMPACKET_SIZE 2048
+
+//maximal length of credential (C_PIN value) accepted by the library
+#define TCGS_MAX_CREDENTIAL_LENGTH 32
+
+//number of IF-RECV attempts to get a response that is not ready yet
+#define TCGS_SESSION_POLL_LIMIT 1000
+
+//delay between IF-RECV attempts in microseconds
+#define TCGS_SESSION_POLL_INTERVAL 100
+
+//longest sleep in microseconds between checks for cancellation of operation
+#define TCGS_OPERATION_SLEEP_SLICE 1000
+
+//time in milliseconds given to close session or reset ComID after
+//interruption of operation by deadline or cancellation
+#define TCGS_OPERATION_CLEANUP_TIMEOUT 2000
+
+//number of sessions kept open by session pool of one device
+#if TCGS_PROFILE_PREBOOT
+#define TCGS_SESSION_POOL_SIZE 1
+#else
+#define TCGS_SESSION_POOL_SIZE 4
+#endif
+
+//default time in milliseconds an idle pooled session is kept open
+#define TCGS_SESSION_POOL_TIMEOUT 30000
+
+//maximal number of methods sent in one ComPacket of transaction,
+//limits size of the response
+#if TCGS_PROFILE_PREBOOT
+#define TCGS_TRANSACTION_MAX_CALLS 8
+#else
+#define TCGS_TRANSACTION_MAX_CALLS 32
+#endif
+
+//number of table rows kept by table cache of a session
+#if TCGS_PROFILE_PREBOOT
+#define TCGS_TABLE_CACHE_ROWS 2
+#else
+#define TCGS_TABLE_CACHE_ROWS 8
+#endif
+
+//number of columns of a row kept by table cache, higher columns are read with TCGS_Get
+#define TCGS_TABLE_CACHE_COLUMNS 16
+
+//longest byte cell kept by table cache
+#define TCGS_TABLE_CACHE_CELL_SIZE 32
+
+//number of locking ranges kept by LBA index, Opal allows Global Range and 8 more
+#if TCGS_PROFILE_PREBOOT
+#define TCGS_LBA_INDEX_RANGES 9
+#else
+#define TCGS_LBA_INDEX_RANGES 16
+#endif
+
+//use SHA extensions and AVX2 for hashing when CPU supports them
+#if TCGS_PROFILE_PREBOOT
+#define TCGS_HASH_ACCELERATION FALSE
+#else
+#define TCGS_HASH_ACCELERATION TRUE
+#endif
+
+//number of derived credentials cached in locked memory,
+//pre-boot image keeps the cache in static memory
+#if TCGS_PROFILE_PREBOOT
+#define TCGS_CREDENTIAL_CACHE_SIZE TCGS_PREBOOT_MAX_DEVICES
+#else
+#define TCGS_CREDENTIAL_CACHE_SIZE 64
+#endif
+
+//layers of interface chain after nested chains are flattened
+#define TCGS_INTERFACE_CHAIN_LAYERS 8
+
+//read-only commands in flight shared by single-flight layer and the
+//largest response shared, longer commands are sent as is
+#define TCGS_SINGLE_FLIGHT_SLOTS        16
+#define TCGS_SINGLE_FLIGHT_MAX_RESPONSE TCGS_BLOCK_SIZE
+
+//objects and arrays nested in formatted output, formatters written by one
+//writev and column of values of text style
+#define TCGS_FORMAT_MAX_DEPTH     8
+#define TCGS_FORMAT_WRITEV_COUNT  64
+#define TCGS_FORMAT_TEXT_COLUMN   24
+
+//ComIDs of all devices shared by processes through one arbiter, and
+//milliseconds to wait for another process to initialize shared state
+#define TCGS_ARBITER_SLOTS        256
+#define TCGS_ARBITER_INIT_TIMEOUT 1000
+
+//locking ranges and users configured by provisioning template
+#define TCGS_PROVISION_MAX_RANGES 9
+#define TCGS_PROVISION_MAX_USERS  8
+
+//bytes of shadow MBR image written by one Set method during provisioning,
+//progress of the upload is checkpointed after every chunk
+#define TCGS_PROVISION_MBR_CHUNK_SIZE 1024
+
+//locking ranges locked by one drive of lockdown, all Set methods of a drive
+//are sent in one ComPacket
+#define TCGS_LOCKDOWN_MAX_RANGES 9
+
+//locking ranges unlocked by one drive on resume
+#define TCGS_RESUME_MAX_RANGES 9
 
 #endif /* TCGS_CONFIG_H_ */
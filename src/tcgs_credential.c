@@ -0,0 +1,251 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_credential.c
+///
+/// Derivation of credentials (C_PIN values) from passphrases
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_interface_encode.h"
+#include "tcgs_hash.h"
+#include "tcgs_credential.h"
+
+//number of cache misses derived by one call of TCGS_Pbkdf2_Batch
+#define TCGS_CREDENTIAL_BATCH_SIZE 16
+
+typedef struct
+{
+	bool   used;
+	uint8  key[TCGS_SHA256_DIGEST_LENGTH];  //digest of derivation parameters
+	uint8  credential[TCGS_MAX_CREDENTIAL_LENGTH];
+} TCGS_CredentialEntry_t;
+
+typedef struct
+{
+	TCGS_CredentialEntry_t entries[TCGS_CREDENTIAL_CACHE_SIZE];
+	uint32                 next;            //entry to be replaced next
+} TCGS_CredentialCache_t;
+
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+static TCGS_CredentialCache_t *cache;
+static bool cacheUnavailable;
+
+#if TCGS_PROFILE_PREBOOT
+//pre-boot image has neither swap nor core dumps
+static TCGS_CredentialCache_t staticCache;
+
+static TCGS_CredentialCache_t *TCGS_Credential_GetCache(void)
+{
+	cache = &staticCache;
+	return cache;
+}
+#else
+/*
+ * Maps the cache into memory excluded from swap and core dumps
+ */
+static TCGS_CredentialCache_t *TCGS_Credential_GetCache(void)
+{
+	void *memory;
+
+	if (cache != NULL || cacheUnavailable)
+	{
+		return cache;
+	}
+	memory = mmap(NULL, sizeof(TCGS_CredentialCache_t), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+	{
+		cacheUnavailable = TRUE;
+		return NULL;
+	}
+	if (mlock(memory, sizeof(TCGS_CredentialCache_t)) != 0)
+	{
+		//credentials are not kept in memory that may be swapped out
+		munmap(memory, sizeof(TCGS_CredentialCache_t));
+		cacheUnavailable = TRUE;
+		return NULL;
+	}
+#ifdef MADV_DONTDUMP
+	madvise(memory, sizeof(TCGS_CredentialCache_t), MADV_DONTDUMP);
+#endif
+	cache = (TCGS_CredentialCache_t*)memory;
+	return cache;
+}
+#endif //TCGS_PROFILE_PREBOOT
+
+/*
+ * Cache key is a digest of all derivation parameters, the passphrase
+ * itself is not stored
+ */
+static void TCGS_Credential_GetKey(TCGS_HashAlgorithm_t algorithm, uint32 iterations,
+		const TCGS_CredentialRequest_t *request, uint32 credentialLength, uint8 *key)
+{
+	TCGS_Hash_t hash;
+	uint8 parameters[16];
+
+	_putBE32(parameters, (uint32)algorithm);
+	_putBE32(parameters + 4, iterations);
+	_putBE32(parameters + 8, credentialLength);
+	_putBE32(parameters + 12, request->saltLength);
+	TCGS_Hash_Init(&hash, HASH_SHA256);
+	TCGS_Hash_Update(&hash, parameters, sizeof(parameters));
+	TCGS_Hash_Update(&hash, request->salt, request->saltLength);
+	TCGS_Hash_Update(&hash, request->passphrase, request->passphraseLength);
+	TCGS_Hash_Final(&hash, key);
+}
+
+static bool TCGS_Credential_Lookup(const uint8 *key, uint8 *credential, uint32 credentialLength)
+{
+	bool found = FALSE;
+	uint32 i;
+
+	pthread_mutex_lock(&cacheLock);
+	if (TCGS_Credential_GetCache() != NULL)
+	{
+		for (i = 0; i < TCGS_CREDENTIAL_CACHE_SIZE && !found; i++)
+		{
+			if (cache->entries[i].used &&
+				memcmp(cache->entries[i].key, key, TCGS_SHA256_DIGEST_LENGTH) == 0)
+			{
+				memcpy(credential, cache->entries[i].credential, credentialLength);
+				found = TRUE;
+			}
+		}
+	}
+	pthread_mutex_unlock(&cacheLock);
+	return found;
+}
+
+static void TCGS_Credential_Store(const uint8 *key, const uint8 *credential, uint32 credentialLength)
+{
+	TCGS_CredentialEntry_t *entry;
+
+	pthread_mutex_lock(&cacheLock);
+	if (TCGS_Credential_GetCache() != NULL)
+	{
+		entry = &cache->entries[cache->next];
+		cache->next = (cache->next + 1) % TCGS_CREDENTIAL_CACHE_SIZE;
+		TCGS_Zeroize(entry, sizeof(*entry));
+		memcpy(entry->key, key, TCGS_SHA256_DIGEST_LENGTH);
+		memcpy(entry->credential, credential, credentialLength);
+		entry->used = TRUE;
+	}
+	pthread_mutex_unlock(&cacheLock);
+}
+
+static TCGS_Error_t TCGS_Credential_Derive(TCGS_HashAlgorithm_t algorithm, uint32 iterations,
+		TCGS_Pbkdf2_Request_t *pending, uint8 (*keys)[TCGS_SHA256_DIGEST_LENGTH], uint32 count)
+{
+	TCGS_Error_t error;
+	uint32 i;
+
+	error = TCGS_Pbkdf2_Batch(algorithm, iterations, pending, count);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	for (i = 0; i < count; i++)
+	{
+		TCGS_Credential_Store(keys[i], pending[i].key, pending[i].keyLength);
+	}
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_DeriveCredentials(TCGS_HashAlgorithm_t algorithm, uint32 iterations,
+		TCGS_CredentialRequest_t *requests, uint32 count, uint32 credentialLength)
+{
+	TCGS_Pbkdf2_Request_t pending[TCGS_CREDENTIAL_BATCH_SIZE];
+	uint8 keys[TCGS_CREDENTIAL_BATCH_SIZE][TCGS_SHA256_DIGEST_LENGTH];
+	TCGS_Error_t error = ERROR_SUCCESS;
+	uint32 i, pendingCount = 0;
+
+	if (iterations == 0 || credentialLength == 0 || credentialLength > TCGS_MAX_CREDENTIAL_LENGTH)
+	{
+		return ERROR_PARAMETER;
+	}
+	for (i = 0; i < count && error == ERROR_SUCCESS; i++)
+	{
+		TCGS_Credential_GetKey(algorithm, iterations, &requests[i], credentialLength, keys[pendingCount]);
+		if (TCGS_Credential_Lookup(keys[pendingCount], requests[i].credential, credentialLength))
+		{
+			continue;
+		}
+		pending[pendingCount].password = requests[i].passphrase;
+		pending[pendingCount].passwordLength = requests[i].passphraseLength;
+		pending[pendingCount].salt = requests[i].salt;
+		pending[pendingCount].saltLength = requests[i].saltLength;
+		pending[pendingCount].key = requests[i].credential;
+		pending[pendingCount].keyLength = credentialLength;
+		if (++pendingCount == TCGS_CREDENTIAL_BATCH_SIZE)
+		{
+			error = TCGS_Credential_Derive(algorithm, iterations, pending, keys, pendingCount);
+			pendingCount = 0;
+		}
+	}
+	if (pendingCount > 0 && error == ERROR_SUCCESS)
+	{
+		error = TCGS_Credential_Derive(algorithm, iterations, pending, keys, pendingCount);
+	}
+	TCGS_Zeroize(keys, sizeof(keys));
+	return error;
+}
+
+TCGS_Error_t TCGS_DeriveCredential(TCGS_HashAlgorithm_t algorithm, uint32 iterations,
+		const void *passphrase, uint32 passphraseLength,
+		const void *salt, uint32 saltLength,
+		uint8 *credential, uint32 credentialLength)
+{
+	TCGS_CredentialRequest_t request;
+	TCGS_Error_t error;
+
+	request.passphrase = passphrase;
+	request.passphraseLength = passphraseLength;
+	request.salt = salt;
+	request.saltLength = saltLength;
+	error = TCGS_DeriveCredentials(algorithm, iterations, &request, 1, credentialLength);
+	if (error == ERROR_SUCCESS)
+	{
+		memcpy(credential, request.credential, credentialLength);
+	}
+	TCGS_Zeroize(request.credential, sizeof(request.credential));
+	return error;
+}
+
+uint32 TCGS_GetCachedCredentialCount(void)
+{
+	uint32 i, count = 0;
+
+	pthread_mutex_lock(&cacheLock);
+	for (i = 0; cache != NULL && i < TCGS_CREDENTIAL_CACHE_SIZE; i++)
+	{
+		if (cache->entries[i].used)
+		{
+			count++;
+		}
+	}
+	pthread_mutex_unlock(&cacheLock);
+	return count;
+}
+
+void TCGS_ClearCredentials(void)
+{
+	pthread_mutex_lock(&cacheLock);
+	if (cache != NULL)
+	{
+		TCGS_Zeroize(cache, sizeof(*cache));
+#if !TCGS_PROFILE_PREBOOT
+		munlock(cache, sizeof(*cache));
+		munmap(cache, sizeof(*cache));
+#endif //!TCGS_PROFILE_PREBOOT
+		cache = NULL;
+	}
+	cacheUnavailable = FALSE;
+	pthread_mutex_unlock(&cacheLock);
+}
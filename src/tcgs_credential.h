@@ -0,0 +1,88 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_credential.h
+///
+/// Derivation of credentials (C_PIN values) from passphrases
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_CREDENTIAL_H
+#define _TCGS_CREDENTIAL_H
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_hash.h"
+
+/*****************************************************************************
+ * \brief Credential derivation request of TCGS_DeriveCredentials
+ *
+ * \par Salt binds credential to the drive, usually it is serial number.
+ *****************************************************************************/
+typedef struct
+{
+	const void *passphrase;
+	uint32      passphraseLength;
+	const void *salt;
+	uint32      saltLength;
+	uint8       credential[TCGS_MAX_CREDENTIAL_LENGTH];   //derived credential
+} TCGS_CredentialRequest_t;
+
+/*****************************************************************************
+ * \brief Derives credential from passphrase with PBKDF2
+ *
+ * \par Derived credentials are cached in memory locked against swapping
+ * for the life of the process, so unlocking the same drive again doesn't
+ * repeat the derivation. The cache is cleared by TCGS_ClearCredentials.
+ * If memory can't be locked credentials are not cached.
+ *
+ * @param[in]  algorithm        hash algorithm of PBKDF2
+ * @param[in]  iterations       iteration count of PBKDF2
+ * @param[in]  passphrase       passphrase
+ * @param[in]  passphraseLength length of passphrase
+ * @param[in]  salt             salt, e.g. serial number of the drive
+ * @param[in]  saltLength       length of salt
+ * @param[out] credential       derived credential
+ * @param[in]  credentialLength length of credential, up to TCGS_MAX_CREDENTIAL_LENGTH
+ *
+ * \return ERROR_SUCCESS if credential is derived, ERROR_PARAMETER otherwise
+ *
+ * \see TCGS_DeriveCredentials
+ *****************************************************************************/
+TCGS_Error_t TCGS_DeriveCredential(TCGS_HashAlgorithm_t algorithm, uint32 iterations,
+		const void *passphrase, uint32 passphraseLength,
+		const void *salt, uint32 saltLength,
+		uint8 *credential, uint32 credentialLength);
+
+/*****************************************************************************
+ * \brief Derives credentials for several drives in one call
+ *
+ * \par Credentials missing in the cache are derived together with
+ * TCGS_Pbkdf2_Batch, which is faster than deriving them one by one.
+ *
+ * @param[in]  algorithm        hash algorithm of PBKDF2
+ * @param[in]  iterations       iteration count of PBKDF2
+ * @param[in,out] requests      requests
+ * @param[in]  count            number of requests
+ * @param[in]  credentialLength length of credentials
+ *
+ * \return ERROR_SUCCESS if credentials are derived, ERROR_PARAMETER otherwise
+ *
+ * \see TCGS_DeriveCredential
+ *****************************************************************************/
+TCGS_Error_t TCGS_DeriveCredentials(TCGS_HashAlgorithm_t algorithm, uint32 iterations,
+		TCGS_CredentialRequest_t *requests, uint32 count, uint32 credentialLength);
+
+/*****************************************************************************
+ * \brief Returns number of credentials in the cache
+ *****************************************************************************/
+uint32 TCGS_GetCachedCredentialCount(void);
+
+/*****************************************************************************
+ * \brief Zeroizes and releases the cache of derived credentials
+ *
+ * \par The function is called by TCGS_DestroyHost.
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_ClearCredentials(void);
+
+#endif //_TCGS_CREDENTIAL_H
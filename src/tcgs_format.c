@@ -0,0 +1,711 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_format.c
+///
+/// Formatter of decoded responses to text or JSON
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_parser.h"
+#include "tcgs_uid_catalog.h"
+#include "tcgs_format.h"
+
+//indentation of members of objects in text style
+#define TCGS_FORMAT_TEXT_INDENT 2
+
+static const char * const commandNames[IF_LAST] =
+{
+	"IF_SEND",
+	"IF_RECV",
+};
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+void TCGS_Formatter_Init(TCGS_Formatter_t *formatter, char *buffer, uint32 capacity,
+		TCGS_FormatStyle_t style)
+{
+	memset(formatter, 0, sizeof(*formatter));
+	formatter->buffer = buffer;
+	formatter->capacity = capacity;
+	formatter->style = style;
+	formatter->sink = -1;
+}
+
+void TCGS_Formatter_SetGrow(TCGS_Formatter_t *formatter, TCGS_FormatGrow_t grow, void *context)
+{
+	formatter->grow = grow;
+	formatter->growContext = context;
+}
+
+void TCGS_Formatter_SetSink(TCGS_Formatter_t *formatter, int sink)
+{
+	formatter->sink = sink;
+}
+
+void TCGS_Formatter_Reset(TCGS_Formatter_t *formatter)
+{
+	formatter->length = 0;
+	formatter->depth = 0;
+	formatter->truncated = FALSE;
+	memset(formatter->count, 0, sizeof(formatter->count));
+	memset(formatter->array, 0, sizeof(formatter->array));
+	memset(formatter->indent, 0, sizeof(formatter->indent));
+}
+
+static bool TCGS_Format_WriteAll(int fd, const char *data, uint32 length)
+{
+	ssize_t written;
+
+	while (length > 0)
+	{
+		written = write(fd, data, length);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return FALSE;
+		}
+		data += written;
+		length -= (uint32)written;
+	}
+	return TRUE;
+}
+
+TCGS_Error_t TCGS_Formatter_Flush(TCGS_Formatter_t *formatter)
+{
+	if (formatter->sink < 0)
+	{
+		return ERROR_PARAMETER;
+	}
+	if (!TCGS_Format_WriteAll(formatter->sink, formatter->buffer, formatter->length))
+	{
+		return ERROR_INTERFACE;
+	}
+	formatter->length = 0;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Formatter_Writev(int fd, TCGS_Formatter_t *formatters, uint32 count)
+{
+	struct iovec vectors[TCGS_FORMAT_WRITEV_COUNT];
+	ssize_t written;
+	uint32 first, vectorCount, i;
+
+	for (first = 0; first < count; first += vectorCount)
+	{
+		vectorCount = count - first;
+		vectorCount = (vectorCount < TCGS_FORMAT_WRITEV_COUNT) ? vectorCount : TCGS_FORMAT_WRITEV_COUNT;
+		for (i = 0; i < vectorCount; i++)
+		{
+			vectors[i].iov_base = formatters[first + i].buffer;
+			vectors[i].iov_len = formatters[first + i].length;
+		}
+		//partial write continues from the first vector not written completely
+		i = 0;
+		while (i < vectorCount)
+		{
+			written = writev(fd, &vectors[i], (int)(vectorCount - i));
+			if (written < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return ERROR_INTERFACE;
+			}
+			while (i < vectorCount && (size_t)written >= vectors[i].iov_len)
+			{
+				written -= vectors[i].iov_len;
+				i++;
+			}
+			if (i < vectorCount)
+			{
+				vectors[i].iov_base = (char*)vectors[i].iov_base + written;
+				vectors[i].iov_len -= written;
+			}
+		}
+		for (i = 0; i < vectorCount; i++)
+		{
+			TCGS_Formatter_Reset(&formatters[first + i]);
+		}
+	}
+	return ERROR_SUCCESS;
+}
+
+/*
+ * Makes room for length bytes: flushes the buffer to the sink, then grows it
+ */
+static bool TCGS_Format_Reserve(TCGS_Formatter_t *formatter, uint32 length)
+{
+	if (formatter->truncated)
+	{
+		return FALSE;
+	}
+	if (formatter->capacity - formatter->length >= length)
+	{
+		return TRUE;
+	}
+	if (formatter->sink >= 0 && TCGS_Formatter_Flush(formatter) == ERROR_SUCCESS &&
+		formatter->capacity >= length)
+	{
+		return TRUE;
+	}
+	if (formatter->grow != NULL &&
+		formatter->grow(formatter, formatter->length + length, formatter->growContext) &&
+		formatter->capacity - formatter->length >= length)
+	{
+		return TRUE;
+	}
+	formatter->truncated = TRUE;
+	return FALSE;
+}
+
+static void TCGS_Format_Append(TCGS_Formatter_t *formatter, const char *data, uint32 length)
+{
+	if (TCGS_Format_Reserve(formatter, length))
+	{
+		memcpy(formatter->buffer + formatter->length, data, length);
+		formatter->length += length;
+	}
+}
+
+static void TCGS_Format_AppendChar(TCGS_Formatter_t *formatter, char c, uint32 count)
+{
+	if (TCGS_Format_Reserve(formatter, count))
+	{
+		memset(formatter->buffer + formatter->length, c, count);
+		formatter->length += count;
+	}
+}
+
+static void TCGS_Format_AppendUInt(TCGS_Formatter_t *formatter, uint64 value)
+{
+	char digits[20];
+	uint32 i = sizeof(digits);
+
+	do
+	{
+		digits[--i] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+	TCGS_Format_Append(formatter, digits + i, sizeof(digits) - i);
+}
+
+//string of JSON style is quoted and escaped
+static void TCGS_Format_AppendString(TCGS_Formatter_t *formatter, const char *value, uint32 length)
+{
+	char escape[6] = {'\\', 'u', '0', '0'};
+	uint32 start, i;
+
+	if (formatter->style != FORMAT_JSON)
+	{
+		TCGS_Format_Append(formatter, value, length);
+		return;
+	}
+	TCGS_Format_AppendChar(formatter, '"', 1);
+	for (start = i = 0; i < length; i++)
+	{
+		if (value[i] != '"' && value[i] != '\\' && (uint8)value[i] >= 0x20)
+		{
+			continue;
+		}
+		TCGS_Format_Append(formatter, value + start, i - start);
+		if ((uint8)value[i] < 0x20)
+		{
+			escape[4] = hexDigits[(uint8)value[i] >> 4];
+			escape[5] = hexDigits[value[i] & 0x0F];
+			TCGS_Format_Append(formatter, escape, sizeof(escape));
+		}
+		else
+		{
+			escape[1] = value[i];
+			TCGS_Format_Append(formatter, escape, 2);
+			escape[1] = 'u';
+		}
+		start = i + 1;
+	}
+	TCGS_Format_Append(formatter, value + start, length - start);
+	TCGS_Format_AppendChar(formatter, '"', 1);
+}
+
+/*
+ * Writes separator and name of the next value at current depth
+ */
+static void TCGS_Format_Name(TCGS_Formatter_t *formatter, const char *name, bool scalar)
+{
+	uint32 depth = formatter->depth;
+	uint32 indent = formatter->indent[depth] * TCGS_FORMAT_TEXT_INDENT;
+	uint32 index = formatter->count[depth]++;
+	uint32 column = 0;
+	uint32 mark;
+
+	if (formatter->style == FORMAT_JSON)
+	{
+		if (index > 0 && depth > 0)
+		{
+			TCGS_Format_AppendChar(formatter, ',', 1);
+		}
+		if (!formatter->array[depth] && name != NULL)
+		{
+			TCGS_Format_AppendString(formatter, name, strlen(name));
+			TCGS_Format_AppendChar(formatter, ':', 1);
+		}
+		return;
+	}
+
+	if (!formatter->array[depth] && name == NULL)
+	{
+		return;
+	}
+	mark = formatter->length;
+	TCGS_Format_AppendChar(formatter, ' ', indent);
+	if (formatter->array[depth])
+	{
+		TCGS_Format_AppendChar(formatter, '[', 1);
+		TCGS_Format_AppendUInt(formatter, index);
+		TCGS_Format_AppendChar(formatter, ']', 1);
+	}
+	else
+	{
+		TCGS_Format_AppendString(formatter, name, strlen(name));
+	}
+	TCGS_Format_AppendChar(formatter, ':', 1);
+	if (!scalar)
+	{
+		TCGS_Format_AppendChar(formatter, '\n', 1);
+		return;
+	}
+	//buffer may have been flushed within the line, then the value isn't aligned
+	if (formatter->length > mark)
+	{
+		column = formatter->length - mark;
+	}
+	TCGS_Format_AppendChar(formatter, ' ',
+			(column < TCGS_FORMAT_TEXT_COLUMN) ? TCGS_FORMAT_TEXT_COLUMN - column : 1);
+}
+
+//ends scalar value, every top level JSON value is a line
+static void TCGS_Format_EndValue(TCGS_Formatter_t *formatter)
+{
+	if (formatter->style == FORMAT_TEXT || formatter->depth == 0)
+	{
+		TCGS_Format_AppendChar(formatter, '\n', 1);
+	}
+}
+
+static void TCGS_Format_Begin(TCGS_Formatter_t *formatter, const char *name, bool array)
+{
+	uint32 depth = formatter->depth;
+	bool named = formatter->array[depth] || name != NULL;
+
+	if (depth == TCGS_FORMAT_MAX_DEPTH)
+	{
+		formatter->truncated = TRUE;
+		return;
+	}
+	TCGS_Format_Name(formatter, name, FALSE);
+	if (formatter->style == FORMAT_JSON)
+	{
+		TCGS_Format_AppendChar(formatter, array ? '[' : '{', 1);
+	}
+	formatter->depth++;
+	formatter->count[depth + 1] = 0;
+	formatter->array[depth + 1] = array;
+	//members are indented under the name of the object in text style
+	formatter->indent[depth + 1] = formatter->indent[depth] + (named ? 1 : 0);
+}
+
+static void TCGS_Format_End(TCGS_Formatter_t *formatter, bool array)
+{
+	if (formatter->depth == 0)
+	{
+		return;
+	}
+	formatter->depth--;
+	if (formatter->style == FORMAT_JSON)
+	{
+		TCGS_Format_AppendChar(formatter, array ? ']' : '}', 1);
+		if (formatter->depth == 0)
+		{
+			TCGS_Format_AppendChar(formatter, '\n', 1);
+		}
+	}
+}
+
+void TCGS_Format_BeginObject(TCGS_Formatter_t *formatter, const char *name)
+{
+	TCGS_Format_Begin(formatter, name, FALSE);
+}
+
+void TCGS_Format_EndObject(TCGS_Formatter_t *formatter)
+{
+	TCGS_Format_End(formatter, FALSE);
+}
+
+void TCGS_Format_BeginArray(TCGS_Formatter_t *formatter, const char *name)
+{
+	TCGS_Format_Begin(formatter, name, TRUE);
+}
+
+void TCGS_Format_EndArray(TCGS_Formatter_t *formatter)
+{
+	TCGS_Format_End(formatter, TRUE);
+}
+
+void TCGS_Format_UInt(TCGS_Formatter_t *formatter, const char *name, uint64 value)
+{
+	TCGS_Format_Name(formatter, name, TRUE);
+	TCGS_Format_AppendUInt(formatter, value);
+	TCGS_Format_EndValue(formatter);
+}
+
+static void TCGS_Format_Int(TCGS_Formatter_t *formatter, const char *name, long long value)
+{
+	TCGS_Format_Name(formatter, name, TRUE);
+	if (value < 0)
+	{
+		TCGS_Format_AppendChar(formatter, '-', 1);
+	}
+	TCGS_Format_AppendUInt(formatter, (value < 0) ? 0 - (uint64)value : (uint64)value);
+	TCGS_Format_EndValue(formatter);
+}
+
+void TCGS_Format_Bool(TCGS_Formatter_t *formatter, const char *name, bool value)
+{
+	TCGS_Format_Name(formatter, name, TRUE);
+	if (value)
+	{
+		TCGS_Format_Append(formatter, "true", sizeof("true") - 1);
+	}
+	else
+	{
+		TCGS_Format_Append(formatter, "false", sizeof("false") - 1);
+	}
+	TCGS_Format_EndValue(formatter);
+}
+
+void TCGS_Format_String(TCGS_Formatter_t *formatter, const char *name, const char *value)
+{
+	TCGS_Format_Name(formatter, name, TRUE);
+	TCGS_Format_AppendString(formatter, value, strlen(value));
+	TCGS_Format_EndValue(formatter);
+}
+
+void TCGS_Format_Hex(TCGS_Formatter_t *formatter, const char *name, const void *data, uint32 length)
+{
+	const uint8 *bytes = data;
+	char pair[2];
+	uint32 i;
+
+	TCGS_Format_Name(formatter, name, TRUE);
+	if (formatter->style == FORMAT_JSON)
+	{
+		TCGS_Format_AppendChar(formatter, '"', 1);
+	}
+	for (i = 0; i < length; i++)
+	{
+		pair[0] = hexDigits[bytes[i] >> 4];
+		pair[1] = hexDigits[bytes[i] & 0x0F];
+		TCGS_Format_Append(formatter, pair, sizeof(pair));
+	}
+	if (formatter->style == FORMAT_JSON)
+	{
+		TCGS_Format_AppendChar(formatter, '"', 1);
+	}
+	TCGS_Format_EndValue(formatter);
+}
+
+const char *TCGS_Format_FeatureName(uint16 featureCode)
+{
+	const TCGS_FeatureCatalogEntry_t *entry = TCGS_FeatureCatalog_FindCode(featureCode);
+
+	return (entry != NULL) ? entry->name : NULL;
+}
+
+void TCGS_Format_Command(TCGS_Formatter_t *formatter, const char *name,
+		const TCGS_CommandBlock_t *commandBlock)
+{
+	TCGS_Format_BeginObject(formatter, name);
+	if (commandBlock->command < IF_LAST)
+	{
+		TCGS_Format_String(formatter, "command", commandNames[commandBlock->command]);
+	}
+	else
+	{
+		TCGS_Format_UInt(formatter, "command", commandBlock->command);
+	}
+	TCGS_Format_UInt(formatter, "protocolId", commandBlock->protocolId);
+	TCGS_Format_UInt(formatter, "length", commandBlock->length);
+	TCGS_Format_UInt(formatter, "comId", commandBlock->comId);
+	TCGS_Format_EndObject(formatter);
+}
+
+static void TCGS_Format_Feature(TCGS_Formatter_t *formatter, TCGS_Level0Discovery_Feature_t *feature)
+{
+	const char *featureName = TCGS_Format_FeatureName(feature->code);
+
+	TCGS_Format_BeginObject(formatter, NULL);
+	TCGS_Format_UInt(formatter, "code", feature->code);
+	if (featureName != NULL)
+	{
+		TCGS_Format_String(formatter, "name", featureName);
+	}
+	TCGS_Format_UInt(formatter, "version", feature->version);
+	TCGS_Format_UInt(formatter, "length", feature->length);
+
+	switch (feature->code)
+	{
+	case FEATURE_TPER:
+		#define featureTPer ((TCGS_Level0Discovery_FeatureTper_t*)(void*)feature)
+		TCGS_Format_Bool(formatter, "syncSupported", featureTPer->syncSupported);
+		TCGS_Format_Bool(formatter, "asyncSupported", featureTPer->asyncSupported);
+		TCGS_Format_Bool(formatter, "ackNakSupported", featureTPer->ackSupported);
+		TCGS_Format_Bool(formatter, "bufferManagementSupported", featureTPer->bufferManagementSupported);
+		TCGS_Format_Bool(formatter, "streamingSupported", featureTPer->streamingSupported);
+		TCGS_Format_Bool(formatter, "comIdManagementSupported", featureTPer->comIdManagementSupported);
+		#undef featureTPer
+		break;
+	case FEATURE_LOCKING:
+		#define featureLocking ((TCGS_Level0Discovery_FeatureLocking_t*)(void*)feature)
+		TCGS_Format_Bool(formatter, "lockingSupported", featureLocking->lockingSupport);
+		TCGS_Format_Bool(formatter, "lockingEnabled", featureLocking->lockingEnabled);
+		TCGS_Format_Bool(formatter, "locked", featureLocking->locked);
+		TCGS_Format_Bool(formatter, "mediaEncryption", featureLocking->mediaEncryption);
+		TCGS_Format_Bool(formatter, "mbrEnabled", featureLocking->MBREnabled);
+		TCGS_Format_Bool(formatter, "mbrDone", featureLocking->MBRDone);
+		#undef featureLocking
+		break;
+	case FEATURE_GEOMETRY:
+		#define featureGeometry ((TCGS_Level0Discovery_FeatureGeometry_t*)(void*)feature)
+		TCGS_Format_UInt(formatter, "logicalBlockSize", featureGeometry->LogicalBlockSize);
+		TCGS_Format_UInt(formatter, "alignmentGranularity", featureGeometry->AlignmentGranularity);
+		TCGS_Format_UInt(formatter, "lowestAlignedLBA", featureGeometry->LowestAlignedLBA);
+		#undef featureGeometry
+		break;
+	case FEATURE_OPAL1:
+		#define featureOpal1 ((TCGS_Level0Discovery_FeatureOpal1_t*)(void*)feature)
+		TCGS_Format_UInt(formatter, "baseComId", featureOpal1->baseComID);
+		TCGS_Format_UInt(formatter, "numberOfComIds", featureOpal1->numberOfComIDs);
+		TCGS_Format_Bool(formatter, "rangeCrossing", featureOpal1->rangeCrossing);
+		#undef featureOpal1
+		break;
+	case FEATURE_OPAL2:
+		#define featureOpal2 ((TCGS_Level0Discovery_FeatureOpal2_t*)(void*)feature)
+		TCGS_Format_UInt(formatter, "baseComId", featureOpal2->baseComID);
+		TCGS_Format_UInt(formatter, "numberOfComIds", featureOpal2->numberOfComIDs);
+		TCGS_Format_Bool(formatter, "rangeCrossing", featureOpal2->rangeCrossing);
+		TCGS_Format_UInt(formatter, "numberOfAdmins", featureOpal2->numberOfAdminsSupported);
+		TCGS_Format_UInt(formatter, "numberOfUsers", featureOpal2->numberOfUsersSupported);
+		TCGS_Format_UInt(formatter, "initialPinSid", featureOpal2->initialPinSidIndicator);
+		TCGS_Format_UInt(formatter, "behaviorPinSidRevert", featureOpal2->behaviorPinSinRevert);
+		#undef featureOpal2
+		break;
+	}
+	TCGS_Format_EndObject(formatter);
+}
+
+void TCGS_Format_Level0Discovery(TCGS_Formatter_t *formatter, const char *name,
+		TCGS_Level0Discovery_Header_t *header)
+{
+	TCGS_Level0Discovery_Feature_t *feature;
+
+	TCGS_Format_BeginObject(formatter, name);
+	TCGS_Format_UInt(formatter, "length", header->length);
+	TCGS_Format_UInt(formatter, "versionMajor", header->versionMajor);
+	TCGS_Format_UInt(formatter, "versionMinor", header->versionMinor);
+	TCGS_Format_BeginArray(formatter, "features");
+	feature = TCGS_GetLevel0DiscoveryFirstFeatureHeader(header);
+	while (feature != NULL)
+	{
+		TCGS_Format_Feature(formatter, feature);
+		feature = TCGS_GetLevel0DiscoveryNextFeatureHeader(header, feature);
+	}
+	TCGS_Format_EndArray(formatter);
+	TCGS_Format_EndObject(formatter);
+}
+
+//name of named value: integer names in decimal, byte names as text if printable
+static const char *TCGS_Format_TokenName(const TCGS_Token_t *token, char *nameBuf)
+{
+	char digits[20];
+	uint64 value = token->value;
+	uint32 i = sizeof(digits), length;
+	bool printable = TRUE;
+
+	if (token->type == TOKEN_TYPE_BYTES)
+	{
+		length = (token->length < TCGS_UID_CATALOG_NAME_LENGTH / 2) ?
+				token->length : TCGS_UID_CATALOG_NAME_LENGTH / 2 - 1;
+		for (i = 0; i < length; i++)
+		{
+			printable = printable && token->data[i] >= 0x20 && token->data[i] < 0x7F;
+		}
+		for (i = 0; i < length; i++)
+		{
+			if (printable)
+			{
+				nameBuf[i] = (char)token->data[i];
+				continue;
+			}
+			nameBuf[i * 2] = hexDigits[token->data[i] >> 4];
+			nameBuf[i * 2 + 1] = hexDigits[token->data[i] & 0x0F];
+		}
+		nameBuf[printable ? length : length * 2] = '\0';
+		return nameBuf;
+	}
+	do
+	{
+		digits[--i] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+	memcpy(nameBuf, digits + i, sizeof(digits) - i);
+	nameBuf[sizeof(digits) - i] = '\0';
+	return nameBuf;
+}
+
+static void TCGS_Format_Atom(TCGS_Formatter_t *formatter, const char *name, const TCGS_Token_t *token)
+{
+	const TCGS_UIDCatalogEntry_t *entry;
+
+	switch (token->type)
+	{
+	case TOKEN_TYPE_UINT:
+		TCGS_Format_UInt(formatter, name, token->value);
+		break;
+	case TOKEN_TYPE_INT:
+		TCGS_Format_Int(formatter, name, (long long)token->value);
+		break;
+	default:
+		entry = (token->length == sizeof(TCGS_UID_t)) ?
+				TCGS_UIDCatalog_FindUID((const TCGS_UID_t*)token->data) : NULL;
+		if (entry != NULL)
+		{
+			TCGS_Format_String(formatter, name, entry->name);
+		}
+		else
+		{
+			TCGS_Format_Hex(formatter, name, token->data, token->length);
+		}
+		break;
+	}
+}
+
+static const struct
+{
+	uint8       control;
+	const char *name;
+} controlNames[] =
+{
+	{TOKEN_CALL,              "CALL"},
+	{TOKEN_END_OF_DATA,       "EOD"},
+	{TOKEN_END_OF_SESSION,    "EOS"},
+	{TOKEN_START_TRANSACTION, "START_TRANSACTION"},
+	{TOKEN_END_TRANSACTION,   "END_TRANSACTION"},
+	{TOKEN_EMPTY,             "EMPTY"},
+};
+
+//control tokens other than lists and names are values named by the token
+static void TCGS_Format_Control(TCGS_Formatter_t *formatter, const char *name, uint8 control)
+{
+	uint32 i;
+
+	for (i = 0; i < sizeof(controlNames) / sizeof(controlNames[0]); i++)
+	{
+		if (controlNames[i].control == control)
+		{
+			TCGS_Format_String(formatter, name, controlNames[i].name);
+			return;
+		}
+	}
+	TCGS_Format_Hex(formatter, name, &control, 1);
+}
+
+void TCGS_Format_Tokens(TCGS_Formatter_t *formatter, const char *name,
+		const TCGS_Parser_t *tokens, TCGS_FormatSecret_t secret, void *context)
+{
+	TCGS_Parser_t parser = *tokens;
+	TCGS_Token_t token;
+	char nameBuf[TCGS_UID_CATALOG_NAME_LENGTH];
+	const char *valueName = NULL;
+	bool named = FALSE;     //the next token is name of named value
+	bool masked;
+	uint32 depth = formatter->depth;
+
+	TCGS_Format_BeginArray(formatter, name);
+	//name of named value is consumed by the value following it
+	while (TCGS_Parser_Next(&parser, &token))
+	{
+		masked = secret != NULL && secret(&token, context);
+		if (named)
+		{
+			named = FALSE;
+			valueName = TCGS_Format_TokenName(&token, nameBuf);
+			continue;
+		}
+		if (token.type != TOKEN_TYPE_CONTROL)
+		{
+			if (masked)
+			{
+				TCGS_Format_String(formatter, valueName, "<secret>");
+			}
+			else
+			{
+				TCGS_Format_Atom(formatter, valueName, &token);
+			}
+			valueName = NULL;
+			continue;
+		}
+		switch (token.control)
+		{
+		case TOKEN_START_LIST:
+			TCGS_Format_BeginArray(formatter, valueName);
+			break;
+		case TOKEN_END_LIST:
+			//unbalanced end doesn't close the array of the tokens
+			if (formatter->depth > depth + 1)
+			{
+				TCGS_Format_EndArray(formatter);
+			}
+			break;
+		case TOKEN_START_NAME:
+			TCGS_Format_BeginObject(formatter, valueName);
+			named = TRUE;
+			break;
+		case TOKEN_END_NAME:
+			if (formatter->depth > depth + 1)
+			{
+				TCGS_Format_EndObject(formatter);
+			}
+			break;
+		default:
+			TCGS_Format_Control(formatter, valueName, token.control);
+			break;
+		}
+		valueName = NULL;
+	}
+	//lists and names left open by the stream are closed
+	while (formatter->depth > depth)
+	{
+		TCGS_Format_End(formatter, formatter->array[formatter->depth]);
+	}
+}
+
+void TCGS_Format_Result(TCGS_Formatter_t *formatter, const char *name,
+		const TCGS_Parser_t *results, TCGS_MethodStatus_t status)
+{
+	TCGS_Format_BeginObject(formatter, name);
+	TCGS_Format_UInt(formatter, "status", status);
+	TCGS_Format_Tokens(formatter, "values", results, NULL, NULL);
+	TCGS_Format_EndObject(formatter);
+}
@@ -0,0 +1,229 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_format.h
+///
+/// Formatter of decoded responses to text or JSON
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_FORMAT_H
+#define _TCGS_FORMAT_H
+
+#include <stdbool.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_parser.h"
+
+typedef enum
+{
+	FORMAT_TEXT,    //"name: value" lines, members of objects are indented
+	FORMAT_JSON,    //JSON line per top level value
+} TCGS_FormatStyle_t;
+
+struct TCGS_Formatter;
+
+/*****************************************************************************
+ * \brief Grows buffer of formatter
+ *
+ * \par Function provided by caller replaces buffer and capacity of the
+ * formatter with larger ones and copies the formatted text, the library
+ * itself never allocates memory.
+ *
+ * @param[in]  formatter    formatter
+ * @param[in]  capacity     capacity needed
+ * @param[in]  context      context passed to TCGS_Formatter_SetGrow
+ *
+ * \return TRUE if the buffer is grown
+ *****************************************************************************/
+typedef bool (*TCGS_FormatGrow_t)(struct TCGS_Formatter *formatter, uint32 capacity, void *context);
+
+/*****************************************************************************
+ * \brief Formatter writing text to caller-supplied buffer
+ *
+ * \par Text that doesn't fit is first flushed to the sink, then the buffer
+ * is grown. When neither helps the rest of the output is dropped and
+ * truncated is set until the formatter is reset.
+ *****************************************************************************/
+typedef struct TCGS_Formatter
+{
+	char                *buffer;
+	uint32               capacity;
+	uint32               length;     //bytes of formatted text in buffer
+	TCGS_FormatStyle_t   style;
+	TCGS_FormatGrow_t    grow;       //NULL if buffer has fixed size
+	void                *growContext;
+	int                  sink;       //file descriptor full buffer is written to, -1 if none
+	uint32               depth;      //objects and arrays open
+	uint32               count[TCGS_FORMAT_MAX_DEPTH + 1];   //values written at depth
+	bool                 array[TCGS_FORMAT_MAX_DEPTH + 1];   //values at depth are elements of array
+	uint8                indent[TCGS_FORMAT_MAX_DEPTH + 1];  //indentation of values at depth in text style
+	bool                 truncated;
+} TCGS_Formatter_t;
+
+/*****************************************************************************
+ * \brief Initializes formatter
+ *
+ * @param[out] formatter    formatter
+ * @param[in]  buffer       buffer of formatted text, not terminated with zero
+ * @param[in]  capacity     size of the buffer
+ * @param[in]  style        text or JSON
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Formatter_Init(TCGS_Formatter_t *formatter, char *buffer, uint32 capacity,
+		TCGS_FormatStyle_t style);
+
+void TCGS_Formatter_SetGrow(TCGS_Formatter_t *formatter, TCGS_FormatGrow_t grow, void *context);
+
+/*****************************************************************************
+ * \brief Sets file descriptor the buffer is written to when it is full
+ *
+ * \see TCGS_Formatter_Flush
+ *****************************************************************************/
+void TCGS_Formatter_SetSink(TCGS_Formatter_t *formatter, int sink);
+
+/*****************************************************************************
+ * \brief Empties buffer and clears nesting and truncation of formatter
+ *****************************************************************************/
+void TCGS_Formatter_Reset(TCGS_Formatter_t *formatter);
+
+/*****************************************************************************
+ * \brief Writes formatted text to the sink and empties the buffer
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if there is no sink,
+ * ERROR_INTERFACE if write fails
+ *****************************************************************************/
+TCGS_Error_t TCGS_Formatter_Flush(TCGS_Formatter_t *formatter);
+
+/*****************************************************************************
+ * \brief Writes text of many formatters with writev and resets them
+ *
+ * \par Text of every formatter is one I/O vector, up to
+ * TCGS_FORMAT_WRITEV_COUNT formatters are written by one system call.
+ *
+ * @param[in]  fd           file descriptor
+ * @param[in]  formatters   formatters
+ * @param[in]  count        number of formatters
+ *
+ * \return ERROR_SUCCESS, ERROR_INTERFACE if write fails
+ *****************************************************************************/
+TCGS_Error_t TCGS_Formatter_Writev(int fd, TCGS_Formatter_t *formatters, uint32 count);
+
+/*****************************************************************************
+ * \brief Opens object or array
+ *
+ * \par Name is ignored for elements of arrays and required for members of
+ * objects. Nesting deeper than TCGS_FORMAT_MAX_DEPTH truncates the output.
+ *
+ * @param[in]  formatter    formatter
+ * @param[in]  name         name of member, NULL for top level value or element
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Format_BeginObject(TCGS_Formatter_t *formatter, const char *name);
+void TCGS_Format_EndObject(TCGS_Formatter_t *formatter);
+void TCGS_Format_BeginArray(TCGS_Formatter_t *formatter, const char *name);
+void TCGS_Format_EndArray(TCGS_Formatter_t *formatter);
+
+void TCGS_Format_UInt(TCGS_Formatter_t *formatter, const char *name, uint64 value);
+void TCGS_Format_Bool(TCGS_Formatter_t *formatter, const char *name, bool value);
+
+/*****************************************************************************
+ * \brief Formats zero terminated string, JSON special characters are escaped
+ *****************************************************************************/
+void TCGS_Format_String(TCGS_Formatter_t *formatter, const char *name, const char *value);
+
+/*****************************************************************************
+ * \brief Formats bytes as string of hex digits
+ *****************************************************************************/
+void TCGS_Format_Hex(TCGS_Formatter_t *formatter, const char *name, const void *data, uint32 length);
+
+/*****************************************************************************
+ * \brief Formats interface command block
+ *
+ * @param[in]  formatter    formatter
+ * @param[in]  name         name of member, NULL for top level value or element
+ * @param[in]  commandBlock command block
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Format_Command(TCGS_Formatter_t *formatter, const char *name,
+		const TCGS_CommandBlock_t *commandBlock);
+
+/*****************************************************************************
+ * \brief Formats Level 0 Discovery as object with array of features
+ *
+ * \par TCGS_DecodeLevel0Discovery shall be called before.
+ *
+ * @param[in]  formatter    formatter
+ * @param[in]  name         name of member, NULL for top level value or element
+ * @param[in]  header       decoded Level 0 Discovery
+ *
+ * \return None
+ *
+ * \see TCGS_DecodeLevel0Discovery
+ *****************************************************************************/
+void TCGS_Format_Level0Discovery(TCGS_Formatter_t *formatter, const char *name,
+		TCGS_Level0Discovery_Header_t *header);
+
+/*****************************************************************************
+ * \brief Tells if byte atom is secret, it is formatted as <secret>
+ *
+ * \par Function provided by caller is called for every token of the stream
+ * in order, control tokens and names of named values included.
+ *
+ * @param[in]  token        token of the stream
+ * @param[in]  context      context passed to TCGS_Format_Tokens
+ *
+ * \return TRUE if value of the token shall not be formatted
+ *****************************************************************************/
+typedef bool (*TCGS_FormatSecret_t)(const TCGS_Token_t *token, void *context);
+
+/*****************************************************************************
+ * \brief Formats token stream as array
+ *
+ * \par Lists are arrays, named values are objects with one member named by
+ * the name of the value. Other control tokens are formatted by names, e.g.
+ * CALL and EOD. Known UIDs are formatted by names of UID catalog, other
+ * byte atoms are hex strings. Lists left open by the stream are closed.
+ *
+ * @param[in]  formatter    formatter
+ * @param[in]  name         name of member, NULL for top level value or element
+ * @param[in]  tokens       parser of the token stream, it is not moved
+ * @param[in]  secret       function masking credentials, NULL if none
+ * @param[in]  context      context of the function
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Format_Tokens(TCGS_Formatter_t *formatter, const char *name,
+		const TCGS_Parser_t *tokens, TCGS_FormatSecret_t secret, void *context);
+
+/*****************************************************************************
+ * \brief Formats result of method invocation
+ *
+ * \par Lists of returned values are arrays, named values are objects with
+ * one member named by the name of the value. Known UIDs are formatted by
+ * names of UID catalog, other byte atoms are hex strings.
+ *
+ * @param[in]  formatter    formatter
+ * @param[in]  name         name of member, NULL for top level value or element
+ * @param[in]  results      parser of returned values, it is not moved
+ * @param[in]  status       method status
+ *
+ * \return None
+ *
+ * \see TCGS_Parser_GetResult
+ *****************************************************************************/
+void TCGS_Format_Result(TCGS_Formatter_t *formatter, const char *name,
+		const TCGS_Parser_t *results, TCGS_MethodStatus_t status);
+
+/*****************************************************************************
+ * \brief Returns name of Level 0 feature
+ *
+ * \return name, NULL if feature is unknown
+ *****************************************************************************/
+const char *TCGS_Format_FeatureName(uint16 featureCode);
+
+#endif //_TCGS_FORMAT_H
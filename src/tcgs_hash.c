@@ -0,0 +1,696 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_hash.c
+///
+/// SHA-1/SHA-256 hashing and PBKDF2 key derivation
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_interface_encode.h"
+#include "tcgs_hash.h"
+
+#if TCGS_HASH_ACCELERATION && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TCGS_HASH_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+//number of PBKDF2 blocks derived at once by TCGS_Pbkdf2_Batch
+#define TCGS_PBKDF2_LANES 8
+
+//minimal number of busy lanes for AVX2 to outrun SHA extensions
+#define TCGS_PBKDF2_AVX2_MIN_LANES 5
+
+#define _rotl32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define _rotr32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+typedef void (*TCGS_Hash_Compress_t)(uint32 *state, const uint8 *block);
+
+static const uint32 sha1Initial[5] =
+{
+	0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0,
+};
+
+static const uint32 sha256Initial[8] =
+{
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+static const uint32 sha256K[64] =
+{
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+static pthread_once_t accelerationOnce = PTHREAD_ONCE_INIT;
+static uint32 accelerationSupported;
+static uint32 accelerationMask = ~0U;
+
+void TCGS_Zeroize(void *data, uint32 length)
+{
+	volatile uint8 *bytes = (volatile uint8*)data;
+
+	while (length-- > 0)
+	{
+		*bytes++ = 0;
+	}
+}
+
+static void TCGS_Sha1_Compress(uint32 *state, const uint8 *block)
+{
+	uint32 w[80], a, b, c, d, e, f, k, temp;
+	int t;
+
+	for (t = 0; t < 16; t++)
+	{
+		w[t] = _getBE32(block + t * 4);
+	}
+	for (t = 16; t < 80; t++)
+	{
+		temp = w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16];
+		w[t] = _rotl32(temp, 1);
+	}
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3]; e = state[4];
+	for (t = 0; t < 80; t++)
+	{
+		if (t < 20)
+		{
+			f = (b & c) | (~b & d);
+			k = 0x5A827999;
+		}
+		else if (t < 40)
+		{
+			f = b ^ c ^ d;
+			k = 0x6ED9EBA1;
+		}
+		else if (t < 60)
+		{
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8F1BBCDC;
+		}
+		else
+		{
+			f = b ^ c ^ d;
+			k = 0xCA62C1D6;
+		}
+		temp = _rotl32(a, 5) + f + e + k + w[t];
+		e = d;
+		d = c;
+		c = _rotl32(b, 30);
+		b = a;
+		a = temp;
+	}
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+}
+
+static void TCGS_Sha256_Compress(uint32 *state, const uint8 *block)
+{
+	uint32 w[64], a, b, c, d, e, f, g, h, s0, s1, t1, t2;
+	int t;
+
+	for (t = 0; t < 16; t++)
+	{
+		w[t] = _getBE32(block + t * 4);
+	}
+	for (t = 16; t < 64; t++)
+	{
+		s0 = _rotr32(w[t - 15], 7) ^ _rotr32(w[t - 15], 18) ^ (w[t - 15] >> 3);
+		s1 = _rotr32(w[t - 2], 17) ^ _rotr32(w[t - 2], 19) ^ (w[t - 2] >> 10);
+		w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+	}
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3];
+	e = state[4]; f = state[5]; g = state[6]; h = state[7];
+	for (t = 0; t < 64; t++)
+	{
+		s1 = _rotr32(e, 6) ^ _rotr32(e, 11) ^ _rotr32(e, 25);
+		t1 = h + s1 + ((e & f) ^ (~e & g)) + sha256K[t] + w[t];
+		s0 = _rotr32(a, 2) ^ _rotr32(a, 13) ^ _rotr32(a, 22);
+		t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+#ifdef TCGS_HASH_X86
+
+/*
+ * SHA-256 compression with SHA extensions. The state is kept in ABEF/CDGH
+ * order required by SHA256RNDS2; each iteration performs four rounds and
+ * extends message schedule for the following ones.
+ */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void TCGS_Sha256_CompressShaNi(uint32 *state, const uint8 *block)
+{
+	const __m128i mask = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+	__m128i state0, state1, abefSave, cdghSave, message, temp;
+	__m128i schedule[4];
+	int i;
+
+	temp   = _mm_loadu_si128((const __m128i*)&state[0]);
+	state1 = _mm_loadu_si128((const __m128i*)&state[4]);
+	temp   = _mm_shuffle_epi32(temp, 0xB1);            //CDAB
+	state1 = _mm_shuffle_epi32(state1, 0x1B);          //EFGH
+	state0 = _mm_alignr_epi8(temp, state1, 8);         //ABEF
+	state1 = _mm_blend_epi16(state1, temp, 0xF0);      //CDGH
+	abefSave = state0;
+	cdghSave = state1;
+
+	for (i = 0; i < 16; i++)
+	{
+		if (i < 4)
+		{
+			schedule[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(block + i * 16)), mask);
+		}
+		message = _mm_add_epi32(schedule[i & 3], _mm_loadu_si128((const __m128i*)&sha256K[i * 4]));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+		if (i >= 3 && i <= 14)
+		{
+			temp = _mm_alignr_epi8(schedule[i & 3], schedule[(i - 1) & 3], 4);
+			schedule[(i + 1) & 3] = _mm_add_epi32(schedule[(i + 1) & 3], temp);
+			schedule[(i + 1) & 3] = _mm_sha256msg2_epu32(schedule[(i + 1) & 3], schedule[i & 3]);
+		}
+		message = _mm_shuffle_epi32(message, 0x0E);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, message);
+		if (i >= 1 && i <= 12)
+		{
+			schedule[(i - 1) & 3] = _mm_sha256msg1_epu32(schedule[(i - 1) & 3], schedule[i & 3]);
+		}
+	}
+
+	state0 = _mm_add_epi32(state0, abefSave);
+	state1 = _mm_add_epi32(state1, cdghSave);
+	temp   = _mm_shuffle_epi32(state0, 0x1B);          //FEBA
+	state1 = _mm_shuffle_epi32(state1, 0xB1);          //DCHG
+	state0 = _mm_blend_epi16(temp, state1, 0xF0);      //DCBA
+	state1 = _mm_alignr_epi8(state1, temp, 8);         //HGFE
+	_mm_storeu_si128((__m128i*)&state[0], state0);
+	_mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+#define _rotr256(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+/*
+ * SHA-256 compression of eight independent blocks, one per 32-bit lane.
+ * Message words are in w, the schedule is extended in place.
+ */
+__attribute__((target("avx2")))
+static void TCGS_Sha256_Compress8(__m256i *state, __m256i *w)
+{
+	__m256i a, b, c, d, e, f, g, h, s0, s1, t1, t2;
+	int t;
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3];
+	e = state[4]; f = state[5]; g = state[6]; h = state[7];
+	for (t = 0; t < 64; t++)
+	{
+		if (t >= 16)
+		{
+			s0 = _mm256_xor_si256(_mm256_xor_si256(_rotr256(w[(t - 15) & 15], 7),
+					_rotr256(w[(t - 15) & 15], 18)), _mm256_srli_epi32(w[(t - 15) & 15], 3));
+			s1 = _mm256_xor_si256(_mm256_xor_si256(_rotr256(w[(t - 2) & 15], 17),
+					_rotr256(w[(t - 2) & 15], 19)), _mm256_srli_epi32(w[(t - 2) & 15], 10));
+			w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0),
+					_mm256_add_epi32(w[(t - 7) & 15], s1));
+		}
+		s1 = _mm256_xor_si256(_mm256_xor_si256(_rotr256(e, 6), _rotr256(e, 11)), _rotr256(e, 25));
+		t1 = _mm256_add_epi32(_mm256_add_epi32(h, s1),
+				_mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g)));
+		t1 = _mm256_add_epi32(_mm256_add_epi32(t1, _mm256_set1_epi32((int)sha256K[t])), w[t & 15]);
+		s0 = _mm256_xor_si256(_mm256_xor_si256(_rotr256(a, 2), _rotr256(a, 13)), _rotr256(a, 22));
+		t2 = _mm256_add_epi32(s0, _mm256_xor_si256(_mm256_xor_si256(_mm256_and_si256(a, b),
+				_mm256_and_si256(a, c)), _mm256_and_si256(b, c)));
+		h = g;
+		g = f;
+		f = e;
+		e = _mm256_add_epi32(d, t1);
+		d = c;
+		c = b;
+		b = a;
+		a = _mm256_add_epi32(t1, t2);
+	}
+	state[0] = _mm256_add_epi32(state[0], a); state[1] = _mm256_add_epi32(state[1], b);
+	state[2] = _mm256_add_epi32(state[2], c); state[3] = _mm256_add_epi32(state[3], d);
+	state[4] = _mm256_add_epi32(state[4], e); state[5] = _mm256_add_epi32(state[5], f);
+	state[6] = _mm256_add_epi32(state[6], g); state[7] = _mm256_add_epi32(state[7], h);
+}
+
+#endif //TCGS_HASH_X86
+
+static void TCGS_Hash_Detect(void)
+{
+#ifdef TCGS_HASH_X86
+	unsigned int eax, ebx, ecx, edx;
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.1") && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) &&
+		(ebx & (1 << 29)) != 0)
+	{
+		accelerationSupported |= HASH_ACCELERATION_SHA_NI;
+	}
+	if (__builtin_cpu_supports("avx2"))
+	{
+		accelerationSupported |= HASH_ACCELERATION_AVX2;
+	}
+#endif
+}
+
+uint32 TCGS_Hash_GetAcceleration(void)
+{
+	pthread_once(&accelerationOnce, TCGS_Hash_Detect);
+	return accelerationSupported & accelerationMask;
+}
+
+void TCGS_Hash_SetAcceleration(uint32 mask)
+{
+	accelerationMask = mask;
+}
+
+static TCGS_Hash_Compress_t TCGS_Hash_GetCompress(TCGS_HashAlgorithm_t algorithm)
+{
+	if (algorithm == HASH_SHA1)
+	{
+		return TCGS_Sha1_Compress;
+	}
+#ifdef TCGS_HASH_X86
+	if (TCGS_Hash_GetAcceleration() & HASH_ACCELERATION_SHA_NI)
+	{
+		return TCGS_Sha256_CompressShaNi;
+	}
+#endif
+	return TCGS_Sha256_Compress;
+}
+
+uint32 TCGS_Hash_GetDigestLength(TCGS_HashAlgorithm_t algorithm)
+{
+	return (algorithm == HASH_SHA1) ? TCGS_SHA1_DIGEST_LENGTH : TCGS_SHA256_DIGEST_LENGTH;
+}
+
+/*
+ * Continues hashing from intermediate state after whole blocks were hashed
+ */
+static void TCGS_Hash_Resume(TCGS_Hash_t *hash, TCGS_HashAlgorithm_t algorithm,
+		const uint32 *state, uint64 length)
+{
+	hash->algorithm = algorithm;
+	memcpy(hash->state, state, sizeof(hash->state));
+	hash->blockLength = 0;
+	hash->length = length;
+}
+
+void TCGS_Hash_Init(TCGS_Hash_t *hash, TCGS_HashAlgorithm_t algorithm)
+{
+	uint32 state[8];
+
+	memset(state, 0, sizeof(state));
+	if (algorithm == HASH_SHA1)
+	{
+		memcpy(state, sha1Initial, sizeof(sha1Initial));
+	}
+	else
+	{
+		memcpy(state, sha256Initial, sizeof(sha256Initial));
+	}
+	TCGS_Hash_Resume(hash, algorithm, state, 0);
+}
+
+void TCGS_Hash_Update(TCGS_Hash_t *hash, const void *data, uint32 length)
+{
+	TCGS_Hash_Compress_t compress = TCGS_Hash_GetCompress(hash->algorithm);
+	const uint8 *bytes = (const uint8*)data;
+	uint32 chunk;
+
+	hash->length += length;
+	if (hash->blockLength > 0)
+	{
+		chunk = TCGS_HASH_BLOCK_LENGTH - hash->blockLength;
+		chunk = (length < chunk) ? length : chunk;
+		memcpy(hash->block + hash->blockLength, bytes, chunk);
+		hash->blockLength += chunk;
+		bytes += chunk;
+		length -= chunk;
+		if (hash->blockLength < TCGS_HASH_BLOCK_LENGTH)
+		{
+			return;
+		}
+		compress(hash->state, hash->block);
+		hash->blockLength = 0;
+	}
+	while (length >= TCGS_HASH_BLOCK_LENGTH)
+	{
+		compress(hash->state, bytes);
+		bytes += TCGS_HASH_BLOCK_LENGTH;
+		length -= TCGS_HASH_BLOCK_LENGTH;
+	}
+	memcpy(hash->block, bytes, length);
+	hash->blockLength = length;
+}
+
+void TCGS_Hash_Final(TCGS_Hash_t *hash, uint8 *digest)
+{
+	TCGS_Hash_Compress_t compress = TCGS_Hash_GetCompress(hash->algorithm);
+	uint64 bits = hash->length * 8;
+	uint32 i;
+
+	hash->block[hash->blockLength++] = 0x80;
+	if (hash->blockLength > TCGS_HASH_BLOCK_LENGTH - 8)
+	{
+		memset(hash->block + hash->blockLength, 0, TCGS_HASH_BLOCK_LENGTH - hash->blockLength);
+		compress(hash->state, hash->block);
+		hash->blockLength = 0;
+	}
+	memset(hash->block + hash->blockLength, 0, TCGS_HASH_BLOCK_LENGTH - 8 - hash->blockLength);
+	_putBE32(hash->block + TCGS_HASH_BLOCK_LENGTH - 8, (uint32)(bits >> 32));
+	_putBE32(hash->block + TCGS_HASH_BLOCK_LENGTH - 4, (uint32)bits);
+	compress(hash->state, hash->block);
+
+	for (i = 0; i < TCGS_Hash_GetDigestLength(hash->algorithm) / 4; i++)
+	{
+		_putBE32(digest + i * 4, hash->state[i]);
+	}
+	TCGS_Zeroize(hash, sizeof(*hash));
+}
+
+void TCGS_Hash(TCGS_HashAlgorithm_t algorithm, const void *data, uint32 length, uint8 *digest)
+{
+	TCGS_Hash_t hash;
+
+	TCGS_Hash_Init(&hash, algorithm);
+	TCGS_Hash_Update(&hash, data, length);
+	TCGS_Hash_Final(&hash, digest);
+}
+
+/*
+ * HMAC of PBKDF2 block: states after hashing key XOR ipad/opad are kept,
+ * so each HMAC of a digest-sized message costs two compressions.
+ */
+typedef struct
+{
+	uint32  inner[8];
+	uint32  outer[8];
+	uint32  u[8];       //U(j) of RFC 2898
+	uint32  t[8];       //XOR of U(1)..U(j)
+} TCGS_Pbkdf2_Lane_t;
+
+static void TCGS_Pbkdf2_InitLane(TCGS_Pbkdf2_Lane_t *lane, TCGS_HashAlgorithm_t algorithm,
+		const TCGS_Pbkdf2_Request_t *request, uint32 blockIndex)
+{
+	TCGS_Hash_Compress_t compress = TCGS_Hash_GetCompress(algorithm);
+	uint32 digestLength = TCGS_Hash_GetDigestLength(algorithm);
+	uint8 pad[TCGS_HASH_BLOCK_LENGTH];
+	uint8 digest[TCGS_HASH_MAX_DIGEST_LENGTH];
+	uint8 index[4];
+	TCGS_Hash_t hash;
+	uint32 i;
+
+	memset(pad, 0, sizeof(pad));
+	if (request->passwordLength > TCGS_HASH_BLOCK_LENGTH)
+	{
+		TCGS_Hash(algorithm, request->password, request->passwordLength, pad);
+	}
+	else
+	{
+		memcpy(pad, request->password, request->passwordLength);
+	}
+
+	TCGS_Hash_Init(&hash, algorithm);
+	memcpy(lane->inner, hash.state, sizeof(lane->inner));
+	memcpy(lane->outer, hash.state, sizeof(lane->outer));
+	for (i = 0; i < TCGS_HASH_BLOCK_LENGTH; i++)
+	{
+		pad[i] ^= 0x36;
+	}
+	compress(lane->inner, pad);
+	for (i = 0; i < TCGS_HASH_BLOCK_LENGTH; i++)
+	{
+		pad[i] ^= 0x36 ^ 0x5C;
+	}
+	compress(lane->outer, pad);
+
+	//U(1) = HMAC(password, salt || INT(i))
+	_putBE32(index, blockIndex);
+	TCGS_Hash_Resume(&hash, algorithm, lane->inner, TCGS_HASH_BLOCK_LENGTH);
+	TCGS_Hash_Update(&hash, request->salt, request->saltLength);
+	TCGS_Hash_Update(&hash, index, sizeof(index));
+	TCGS_Hash_Final(&hash, digest);
+	TCGS_Hash_Resume(&hash, algorithm, lane->outer, TCGS_HASH_BLOCK_LENGTH);
+	TCGS_Hash_Update(&hash, digest, digestLength);
+	TCGS_Hash_Final(&hash, digest);
+
+	memset(lane->u, 0, sizeof(lane->u));
+	for (i = 0; i < digestLength / 4; i++)
+	{
+		lane->u[i] = _getBE32(digest + i * 4);
+	}
+	memcpy(lane->t, lane->u, sizeof(lane->t));
+
+	TCGS_Zeroize(pad, sizeof(pad));
+	TCGS_Zeroize(digest, sizeof(digest));
+}
+
+static void TCGS_Pbkdf2_Iterate(TCGS_Pbkdf2_Lane_t *lane, TCGS_HashAlgorithm_t algorithm,
+		uint32 iterations)
+{
+	TCGS_Hash_Compress_t compress = TCGS_Hash_GetCompress(algorithm);
+	uint32 digestWords = TCGS_Hash_GetDigestLength(algorithm) / 4;
+	uint8 block[TCGS_HASH_BLOCK_LENGTH];
+	uint32 state[8];
+	uint32 i, j;
+
+	//message of both hashes is one digest: padding and length are constant
+	memset(block, 0, sizeof(block));
+	block[digestWords * 4] = 0x80;
+	_putBE32(block + TCGS_HASH_BLOCK_LENGTH - 4, (TCGS_HASH_BLOCK_LENGTH + digestWords * 4) * 8);
+
+	for (i = 1; i < iterations; i++)
+	{
+		for (j = 0; j < digestWords; j++)
+		{
+			_putBE32(block + j * 4, lane->u[j]);
+		}
+		memcpy(state, lane->inner, sizeof(state));
+		compress(state, block);
+		for (j = 0; j < digestWords; j++)
+		{
+			_putBE32(block + j * 4, state[j]);
+		}
+		memcpy(state, lane->outer, sizeof(state));
+		compress(state, block);
+		for (j = 0; j < digestWords; j++)
+		{
+			lane->u[j] = state[j];
+			lane->t[j] ^= state[j];
+		}
+	}
+	TCGS_Zeroize(block, sizeof(block));
+	TCGS_Zeroize(state, sizeof(state));
+}
+
+#ifdef TCGS_HASH_X86
+
+__attribute__((target("avx2")))
+static void TCGS_Pbkdf2_Iterate8(TCGS_Pbkdf2_Lane_t *lanes, uint32 count, uint32 iterations)
+{
+	__m256i inner[8], outer[8], u[8], t[8], state[8], w[16];
+	uint32 words[TCGS_PBKDF2_LANES];
+	uint32 i, j, lane;
+
+	//words of all lanes are transposed: vector j holds word j of every lane
+	for (j = 0; j < 8; j++)
+	{
+		for (lane = 0; lane < TCGS_PBKDF2_LANES; lane++)
+		{
+			words[lane] = lanes[lane < count ? lane : 0].inner[j];
+		}
+		inner[j] = _mm256_loadu_si256((const __m256i*)words);
+		for (lane = 0; lane < TCGS_PBKDF2_LANES; lane++)
+		{
+			words[lane] = lanes[lane < count ? lane : 0].outer[j];
+		}
+		outer[j] = _mm256_loadu_si256((const __m256i*)words);
+		for (lane = 0; lane < TCGS_PBKDF2_LANES; lane++)
+		{
+			words[lane] = lanes[lane < count ? lane : 0].u[j];
+		}
+		u[j] = _mm256_loadu_si256((const __m256i*)words);
+		t[j] = u[j];
+	}
+
+	for (i = 1; i < iterations; i++)
+	{
+		for (j = 0; j < 8; j++)
+		{
+			w[j] = u[j];
+			state[j] = inner[j];
+		}
+		w[8] = _mm256_set1_epi32((int)0x80000000);
+		for (j = 9; j < 15; j++)
+		{
+			w[j] = _mm256_setzero_si256();
+		}
+		w[15] = _mm256_set1_epi32((TCGS_HASH_BLOCK_LENGTH + TCGS_SHA256_DIGEST_LENGTH) * 8);
+		TCGS_Sha256_Compress8(state, w);
+
+		for (j = 0; j < 8; j++)
+		{
+			w[j] = state[j];
+			state[j] = outer[j];
+		}
+		w[8] = _mm256_set1_epi32((int)0x80000000);
+		for (j = 9; j < 15; j++)
+		{
+			w[j] = _mm256_setzero_si256();
+		}
+		w[15] = _mm256_set1_epi32((TCGS_HASH_BLOCK_LENGTH + TCGS_SHA256_DIGEST_LENGTH) * 8);
+		TCGS_Sha256_Compress8(state, w);
+
+		for (j = 0; j < 8; j++)
+		{
+			u[j] = state[j];
+			t[j] = _mm256_xor_si256(t[j], state[j]);
+		}
+	}
+
+	for (j = 0; j < 8; j++)
+	{
+		_mm256_storeu_si256((__m256i*)words, t[j]);
+		for (lane = 0; lane < count; lane++)
+		{
+			lanes[lane].t[j] = words[lane];
+		}
+	}
+	TCGS_Zeroize(words, sizeof(words));
+	TCGS_Zeroize(state, sizeof(state));
+	TCGS_Zeroize(w, sizeof(w));
+	TCGS_Zeroize(inner, sizeof(inner));
+	TCGS_Zeroize(outer, sizeof(outer));
+	TCGS_Zeroize(u, sizeof(u));
+	TCGS_Zeroize(t, sizeof(t));
+}
+
+#endif //TCGS_HASH_X86
+
+typedef struct
+{
+	TCGS_Pbkdf2_Request_t *request;
+	uint32                 blockIndex;
+} TCGS_Pbkdf2_Target_t;
+
+static void TCGS_Pbkdf2_Flush(TCGS_HashAlgorithm_t algorithm, uint32 iterations,
+		TCGS_Pbkdf2_Lane_t *lanes, TCGS_Pbkdf2_Target_t *targets, uint32 count)
+{
+	uint32 digestLength = TCGS_Hash_GetDigestLength(algorithm);
+	uint8 digest[TCGS_HASH_MAX_DIGEST_LENGTH];
+	uint32 lane, j, offset, length;
+
+#ifdef TCGS_HASH_X86
+	//AVX2 costs the same for any number of lanes, SHA extensions win on few of them
+	if (algorithm == HASH_SHA256 && (TCGS_Hash_GetAcceleration() & HASH_ACCELERATION_AVX2) &&
+		count >= ((TCGS_Hash_GetAcceleration() & HASH_ACCELERATION_SHA_NI) ? TCGS_PBKDF2_AVX2_MIN_LANES : 2))
+	{
+		TCGS_Pbkdf2_Iterate8(lanes, count, iterations);
+	}
+	else
+#endif
+	{
+		for (lane = 0; lane < count; lane++)
+		{
+			TCGS_Pbkdf2_Iterate(&lanes[lane], algorithm, iterations);
+		}
+	}
+
+	for (lane = 0; lane < count; lane++)
+	{
+		for (j = 0; j < digestLength / 4; j++)
+		{
+			_putBE32(digest + j * 4, lanes[lane].t[j]);
+		}
+		offset = (targets[lane].blockIndex - 1) * digestLength;
+		length = targets[lane].request->keyLength - offset;
+		memcpy(targets[lane].request->key + offset, digest,
+				(length < digestLength) ? length : digestLength);
+	}
+	TCGS_Zeroize(digest, sizeof(digest));
+	TCGS_Zeroize(lanes, sizeof(TCGS_Pbkdf2_Lane_t) * count);
+}
+
+TCGS_Error_t TCGS_Pbkdf2_Batch(TCGS_HashAlgorithm_t algorithm, uint32 iterations,
+		TCGS_Pbkdf2_Request_t *requests, uint32 count)
+{
+	TCGS_Pbkdf2_Lane_t lanes[TCGS_PBKDF2_LANES];
+	TCGS_Pbkdf2_Target_t targets[TCGS_PBKDF2_LANES];
+	uint32 digestLength = TCGS_Hash_GetDigestLength(algorithm);
+	uint32 i, block, blocks, laneCount = 0;
+
+	if (iterations == 0)
+	{
+		return ERROR_PARAMETER;
+	}
+	for (i = 0; i < count; i++)
+	{
+		if (requests[i].keyLength == 0)
+		{
+			return ERROR_PARAMETER;
+		}
+	}
+
+	//every block of every key is an independent HMAC chain
+	for (i = 0; i < count; i++)
+	{
+		blocks = (requests[i].keyLength + digestLength - 1) / digestLength;
+		for (block = 1; block <= blocks; block++)
+		{
+			TCGS_Pbkdf2_InitLane(&lanes[laneCount], algorithm, &requests[i], block);
+			targets[laneCount].request = &requests[i];
+			targets[laneCount].blockIndex = block;
+			if (++laneCount == TCGS_PBKDF2_LANES)
+			{
+				TCGS_Pbkdf2_Flush(algorithm, iterations, lanes, targets, laneCount);
+				laneCount = 0;
+			}
+		}
+	}
+	if (laneCount > 0)
+	{
+		TCGS_Pbkdf2_Flush(algorithm, iterations, lanes, targets, laneCount);
+	}
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Pbkdf2(TCGS_HashAlgorithm_t algorithm,
+		const void *password, uint32 passwordLength,
+		const void *salt, uint32 saltLength,
+		uint32 iterations, uint8 *key, uint32 keyLength)
+{
+	TCGS_Pbkdf2_Request_t request;
+
+	request.password = password;
+	request.passwordLength = passwordLength;
+	request.salt = salt;
+	request.saltLength = saltLength;
+	request.key = key;
+	request.keyLength = keyLength;
+	return TCGS_Pbkdf2_Batch(algorithm, iterations, &request, 1);
+}
@@ -0,0 +1,142 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_hash.h
+///
+/// SHA-1/SHA-256 hashing and PBKDF2 key derivation
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_HASH_H
+#define _TCGS_HASH_H
+
+#include "tcgs_types.h"
+
+#define TCGS_SHA1_DIGEST_LENGTH     20
+#define TCGS_SHA256_DIGEST_LENGTH   32
+#define TCGS_HASH_MAX_DIGEST_LENGTH 32
+#define TCGS_HASH_BLOCK_LENGTH      64
+
+typedef enum
+{
+	HASH_SHA1,
+	HASH_SHA256,
+} TCGS_HashAlgorithm_t;
+
+//CPU features used for hashing, see TCGS_Hash_GetAcceleration
+#define HASH_ACCELERATION_SHA_NI 0x01   //SHA extensions: single buffer SHA-256
+#define HASH_ACCELERATION_AVX2   0x02   //AVX2: SHA-256 of 8 buffers at once
+
+typedef struct
+{
+	TCGS_HashAlgorithm_t  algorithm;
+	uint32                state[8];
+	uint8                 block[TCGS_HASH_BLOCK_LENGTH];
+	uint32                blockLength;
+	uint64                length;       //total length of hashed data in bytes
+} TCGS_Hash_t;
+
+/*****************************************************************************
+ * \brief PBKDF2 key derivation request of TCGS_Pbkdf2_Batch
+ *****************************************************************************/
+typedef struct
+{
+	const void *password;
+	uint32      passwordLength;
+	const void *salt;
+	uint32      saltLength;
+	uint8      *key;            //buffer for derived key
+	uint32      keyLength;
+} TCGS_Pbkdf2_Request_t;
+
+uint32 TCGS_Hash_GetDigestLength(TCGS_HashAlgorithm_t algorithm);
+
+void TCGS_Hash_Init(TCGS_Hash_t *hash, TCGS_HashAlgorithm_t algorithm);
+void TCGS_Hash_Update(TCGS_Hash_t *hash, const void *data, uint32 length);
+void TCGS_Hash_Final(TCGS_Hash_t *hash, uint8 *digest);
+
+/*****************************************************************************
+ * \brief Calculates digest of data in one call
+ *
+ * @param[in]  algorithm    hash algorithm
+ * @param[in]  data         data to hash
+ * @param[in]  length       length of data
+ * @param[out] digest       buffer of TCGS_Hash_GetDigestLength bytes
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Hash(TCGS_HashAlgorithm_t algorithm, const void *data, uint32 length, uint8 *digest);
+
+/*****************************************************************************
+ * \brief Returns CPU features used for hashing
+ *
+ * \par Features are detected at the first call. Acceleration can be switched
+ * off at build time with TCGS_HASH_ACCELERATION.
+ *
+ * \return uint32 combination of HASH_ACCELERATION_* flags
+ *
+ * \see TCGS_Hash_SetAcceleration
+ *****************************************************************************/
+uint32 TCGS_Hash_GetAcceleration(void);
+
+/*****************************************************************************
+ * \brief Restricts CPU features used for hashing
+ *
+ * \par The function is intended for tests and benchmarks. Features not
+ * supported by CPU are ignored.
+ *
+ * @param[in]  mask         allowed HASH_ACCELERATION_* flags
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Hash_SetAcceleration(uint32 mask);
+
+/*****************************************************************************
+ * \brief Derives key from password with PBKDF2-HMAC (RFC 2898)
+ *
+ * @param[in]  algorithm        hash algorithm of HMAC
+ * @param[in]  password         password
+ * @param[in]  passwordLength   length of password
+ * @param[in]  salt             salt
+ * @param[in]  saltLength       length of salt
+ * @param[in]  iterations       iteration count
+ * @param[out] key              derived key
+ * @param[in]  keyLength        length of key to derive
+ *
+ * \return ERROR_SUCCESS if key is derived, ERROR_PARAMETER if iteration count
+ * or key length is 0
+ *
+ * \see TCGS_Pbkdf2_Batch
+ *****************************************************************************/
+TCGS_Error_t TCGS_Pbkdf2(TCGS_HashAlgorithm_t algorithm,
+		const void *password, uint32 passwordLength,
+		const void *salt, uint32 saltLength,
+		uint32 iterations, uint8 *key, uint32 keyLength);
+
+/*****************************************************************************
+ * \brief Derives several keys with the same algorithm and iteration count
+ *
+ * \par Blocks of all keys are derived in parallel: with AVX2 eight
+ * SHA-256 HMAC chains are computed by one instruction stream.
+ *
+ * @param[in]  algorithm    hash algorithm of HMAC
+ * @param[in]  iterations   iteration count
+ * @param[in,out] requests  requests, keys are written to their buffers
+ * @param[in]  count        number of requests
+ *
+ * \return ERROR_SUCCESS if all keys are derived, ERROR_PARAMETER if
+ * iteration count or length of any key is 0
+ *
+ * \see TCGS_Pbkdf2
+ *****************************************************************************/
+TCGS_Error_t TCGS_Pbkdf2_Batch(TCGS_HashAlgorithm_t algorithm, uint32 iterations,
+		TCGS_Pbkdf2_Request_t *requests, uint32 count);
+
+/*****************************************************************************
+ * \brief Clears memory with secret data
+ *
+ * \par Unlike memset the clearing is not removed by compiler optimization.
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Zeroize(void *data, uint32 length);
+
+#endif //_TCGS_HASH_H
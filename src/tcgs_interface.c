@@ -7,16 +7,14 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include <string.h>
-#if TCGS_VERBOSE
-#include <stdio.h>
-#endif //TCGS_VERBOSE
-
-#include <stdio.h>
 
+#include "tcgs_config.h"
 #include "tcgs_interface.h"
 #include "tcgs_interface_ata.h"
+#include "tcgs_interface_chain.h"
+#include "tcgs_operation.h"
+#include "tcgs_arbiter.h"
 #include "tcgs_types.h"
-#include "tcgs_verbose.h"
 
 static TCGS_Interface_t currentInterface;
 TCGS_InterfaceFunctions_t *TCGS_Interface_Funcs;
@@ -27,6 +25,11 @@ void TCGS_SetInterfaceFunctions(TCGS_InterfaceFunctions_t *functs)
 	currentInterface = INTERFACE_UNKNOWN;
 }
 
+TCGS_InterfaceFunctions_t *TCGS_GetInterfaceFunctions(void)
+{
+	return TCGS_Interface_Funcs;
+}
+
 void TCGS_SetInterface(TCGS_Interface_t interface)
 {
 	switch(interface)
@@ -44,6 +47,125 @@ void TCGS_SetInterface(TCGS_Interface_t interface)
 	currentInterface = interface;
 }
 
+void TCGS_Device_Init(TCGS_Device_t *device, TCGS_InterfaceFunctions_t *funcs, void *context)
+{
+	memset(device, 0, sizeof(*device));
+	device->funcs = funcs;
+	device->context = context;
+	pthread_mutex_init(&device->lock, NULL);
+}
+
+void TCGS_Device_Destroy(TCGS_Device_t *device)
+{
+	pthread_mutex_destroy(&device->lock);
+}
+
+TCGS_Error_t TCGS_Device_Lock(TCGS_Device_t *device)
+{
+	struct TCGS_ArbiterSlot *slot = NULL;
+#if !TCGS_PROFILE_PREBOOT
+	TCGS_Error_t error;
+
+	//pre-boot image is built without arbiter, devices are not shared with other processes
+	if (device->arbiter != NULL)
+	{
+		error = TCGS_Arbiter_LockDevice(device, &slot);
+		if (error != ERROR_SUCCESS)
+		{
+			return error;
+		}
+	}
+#endif //!TCGS_PROFILE_PREBOOT
+	pthread_mutex_lock(&device->lock);
+	//ComID of the device may change before the lock is released
+	device->lockedSlot = slot;
+	return ERROR_SUCCESS;
+}
+
+void TCGS_Device_Unlock(TCGS_Device_t *device)
+{
+#if !TCGS_PROFILE_PREBOOT
+	struct TCGS_ArbiterSlot *slot = device->lockedSlot;
+#endif //!TCGS_PROFILE_PREBOOT
+
+	device->lockedSlot = NULL;
+	pthread_mutex_unlock(&device->lock);
+#if !TCGS_PROFILE_PREBOOT
+	if (slot != NULL)
+	{
+		TCGS_Arbiter_Release(slot);
+	}
+#endif //!TCGS_PROFILE_PREBOOT
+}
+
+//device of the command being sent by the thread
+static __thread TCGS_Device_t *currentDevice;
+
+TCGS_Device_t *TCGS_GetCurrentDevice(void)
+{
+	return currentDevice;
+}
+
+/*****************************************************************************
+ * \brief Map command to interface of the device and send it to TPer. Return response and status.
+ *
+ * @param[in]  device                 device, NULL for current set of interface functions
+ * @param[in]  inputCommandBlock      input command block
+ * @param[in]  inputPayload           input payload. NULL if command has no data
+ * @param[out] tperError              interface command error status
+ * @param[out] outputPayload          output payload
+ *
+ * \return ERROR_SUCCESS if interface command is successfully mapped to transport
+ * of the device, sent to TPer and the last returned response (error status code
+ * and payload). Error code ERROR_INTERFACE is returned otherwise
+ *
+ * \par Commands of functions with chain pass through its layers.
+ *
+ * \par Command is not sent if current operation of the thread is expired or
+ * cancelled, ERROR_TIMEOUT or ERROR_CANCELLED is returned then and if
+ * transport fails after the deadline.
+ *
+ *****************************************************************************/
+TCGS_Error_t TCGS_Device_SendCommand(TCGS_Device_t *device,
+    TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
+    TCGS_InterfaceError_t *tperError, void *outputPayload)
+{
+	TCGS_InterfaceFunctions_t *funcs = TCGS_Interface_Funcs;
+	TCGS_Device_t *previousDevice = currentDevice;
+	TCGS_Error_t error, operationError;
+
+	if (device != NULL && device->funcs != NULL)
+	{
+		funcs = device->funcs;
+	}
+	error = TCGS_Operation_Check();
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	currentDevice = device;
+	if (funcs->chain != NULL)
+	{
+		error = TCGS_InterfaceChain_SendCommand(funcs->chain, inputCommandBlock, inputPayload,
+				tperError, outputPayload);
+	}
+	else
+	{
+		error = (*funcs->send)(inputCommandBlock, inputPayload, tperError, outputPayload);
+	}
+	currentDevice = previousDevice;
+	if (device != NULL)
+	{
+		device->interfaceError = (error == ERROR_SUCCESS) ? *tperError : INTERFACE_ERROR_GOOD;
+	}
+	if (error != ERROR_SUCCESS && (operationError = TCGS_Operation_Check()) != ERROR_SUCCESS)
+	{
+		//transport gave up at the deadline of the operation
+		error = operationError;
+	}
+	return error;
+}
+
 /*****************************************************************************
  * \brief Map command to ATA interface and send it to TPer. Return response and status.
  *
@@ -57,20 +179,11 @@ void TCGS_SetInterface(TCGS_Interface_t interface)
  * ERROR_INTERFACE is returned when
  *
  *****************************************************************************/
-TCGS_InterfaceError_t TCGS_SendCommand(
+TCGS_Error_t TCGS_SendCommand(
     TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
     TCGS_InterfaceError_t *tperError, void *outputPayload)
 {
-	TCGS_InterfaceError_t error;
-#if TCGS_VERBOSE
-	printf(TCGS_VERBOSE_COMMAND_SEPARATOR "\n");
-	TCGS_PrintCommand(inputCommandBlock);
-#endif //TCGS_VERBOSE
-	error = (*TCGS_Interface_Funcs->send)(inputCommandBlock, inputPayload, tperError, outputPayload);
-#if TCGS_VERBOSE
-	printf(TCGS_VERBOSE_COMMAND_SEPARATOR "\n");
-#endif //TCGS_VERBOSE
-	return error;
+	return TCGS_Device_SendCommand(NULL, inputCommandBlock, inputPayload, tperError, outputPayload);
 }
 
 #define MAX_INTERFACE_PARAMETER_LENGTH 32
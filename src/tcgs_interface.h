@@ -8,6 +8,8 @@
 #ifndef _TCGS_INTERFACE_H
 #define _TCGS_INTERFACE_H
 
+#include <pthread.h>
+
 #include "tcgs_types.h"
 
 typedef enum
@@ -38,10 +40,17 @@ typedef struct
 {
 	TCGS_Command_t command;   		//Either IF-SEND or IF-RECV
 	uint8          protocolId;      //Between 0x01 and 0x06
-	uint32         length;          //The amount of data to be transferred, in bytes
+	uint32         length;          //The amount of data to be transferred, in blocks of TCGS_BLOCK_SIZE bytes
 	uint32         comId;           //The ComID to be used, for Protocol IDs 0x01, 0x02, 0x06
 } TCGS_CommandBlock_t;
 
+//size in bytes of the payload described by the command block
+#define TCGS_GetTransferLength(commandBlock) ((commandBlock)->length * TCGS_BLOCK_SIZE)
+
+//payload of the command is ComPacket: protocol 0x01 except Level 0 Discovery on ComID 0x0001
+#define TCGS_IsComPacketCommand(commandBlock) \
+	((commandBlock)->protocolId == 0x01 && (commandBlock)->comId != 0x0001)
+
 /*****************************************************************************
  * \brief Supported transport interfaces
  *
@@ -67,7 +76,7 @@ typedef enum
  *****************************************************************************/
 void TCGS_SetInterface(TCGS_Interface_t interface);
 
-typedef TCGS_InterfaceError_t (*TCGS_SendCommand_t) (
+typedef TCGS_Error_t (*TCGS_SendCommand_t) (
 	    TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
 	    TCGS_InterfaceError_t *interfaceError, void *outputPayload);
 
@@ -82,14 +91,120 @@ typedef TCGS_InterfaceError_t (*TCGS_SendCommand_t) (
  * \see TCGS_SetInterface
  *
  *****************************************************************************/
+struct TCGS_InterfaceChain;
+struct TCGS_Arbiter;
+struct TCGS_ArbiterSlot;
+struct TCGS_Session;
+
 typedef struct
 {
 	//TCGS_InitCommand_t *init
 	TCGS_SendCommand_t send;
+	struct TCGS_InterfaceChain *chain;  //layers the commands pass through, NULL if none
 } TCGS_InterfaceFunctions_t;
 
 void TCGS_SetInterfaceFunctions(TCGS_InterfaceFunctions_t *functs);
 
+/*****************************************************************************
+ * \brief Return current set of interface functions
+ *
+ * Used by transport wrappers that forward commands to the previously
+ * installed interface.
+ *
+ * \return TCGS_InterfaceFunctions_t* current set of interface functions
+ *
+ * \see TCGS_SetInterfaceFunctions
+ *
+ *****************************************************************************/
+TCGS_InterfaceFunctions_t *TCGS_GetInterfaceFunctions(void);
+
+/*****************************************************************************
+ * \brief Storage device with TPer
+ *
+ * The structure binds set of interface functions with transport-specific
+ * context of the device (e.g. file descriptor or instance of virtual TPer).
+ * Interface functions get the device of the command being sent with
+ * TCGS_GetCurrentDevice.
+ *
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_InterfaceFunctions_t *funcs;   //interface functions, NULL to use the current set
+	void                      *context; //transport-specific context of the device
+	uint16                     comId;   //base ComID reported by Level 0 Discovery
+	pthread_mutex_t            lock;    //serializes IF-SEND/IF-RECV exchanges on the ComID
+	TCGS_InterfaceError_t      interfaceError;  //interface status of the last command sent
+	struct TCGS_Arbiter       *arbiter;         //serializes exchanges with other processes, NULL if none
+	uint64                     arbiterKey;      //key of the device in the arbiter
+	struct TCGS_ArbiterSlot   *arbiterSlot;     //slot of the ComID the lock was taken last
+	struct TCGS_ArbiterSlot   *lockedSlot;      //slot held by the lock of the device
+	struct TCGS_ArbiterSlot   *leasedSlot;      //slot held by lease of the device
+	struct TCGS_Session       *pendingSession;  //session whose response to IF-SEND is not read yet
+} TCGS_Device_t;
+
+/*****************************************************************************
+ * \brief Initializes device structure
+ *
+ * @param[out] device       device to initialize
+ * @param[in]  funcs        interface functions, NULL to use the current set
+ * @param[in]  context      transport-specific context of the device
+ *
+ * \return None
+ *
+ * \see TCGS_Device_Destroy
+ *
+ *****************************************************************************/
+void TCGS_Device_Init(TCGS_Device_t *device, TCGS_InterfaceFunctions_t *funcs, void *context);
+
+void TCGS_Device_Destroy(TCGS_Device_t *device);
+
+/*****************************************************************************
+ * \brief Takes lock of exchanges on ComID of device
+ *
+ * \par Lock of the arbiter the device is attached to is taken first, so
+ * exchanges of other processes on the ComID wait too.
+ *
+ * \return ERROR_SUCCESS, errors of TCGS_Arbiter_LockDevice
+ *
+ * \see TCGS_Arbiter_Attach
+ *****************************************************************************/
+TCGS_Error_t TCGS_Device_Lock(TCGS_Device_t *device);
+
+void TCGS_Device_Unlock(TCGS_Device_t *device);
+
+/*****************************************************************************
+ * \brief Map command to interface of the device and send it to TPer. Return response and status.
+ *
+ * @param[in]  device                 device, NULL for current set of interface functions
+ * @param[in]  inputCommandBlock      input command block
+ * @param[in]  inputPayload           input payload. NULL if command has no data
+ * @param[out] tperError              interface command error status
+ * @param[out] outputPayload          output payload
+ *
+ * \return ERROR_SUCCESS if interface command is successfully mapped to transport
+ * of the device, sent to TPer and the last returned response (error status code
+ * and payload). Error code ERROR_INTERFACE is returned otherwise
+ *
+ * \par Commands of functions with chain pass through its layers.
+ *
+ * \see TCGS_SendCommand, TCGS_InterfaceChain_Init
+ *
+ *****************************************************************************/
+TCGS_Error_t TCGS_Device_SendCommand(TCGS_Device_t *device,
+    TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
+    TCGS_InterfaceError_t *interfaceError, void *outputPayload);
+
+/*****************************************************************************
+ * \brief Return device the command is being sent to
+ *
+ * The function is to be called by interface functions to get
+ * transport-specific context of the device.
+ *
+ * \return TCGS_Device_t* device, NULL if command is sent with TCGS_SendCommand
+ *
+ *****************************************************************************/
+TCGS_Device_t *TCGS_GetCurrentDevice(void);
+
 /*****************************************************************************
  * \brief Map command to current interface and send it to TPer. Return response and status.
  *
@@ -103,7 +218,7 @@ void TCGS_SetInterfaceFunctions(TCGS_InterfaceFunctions_t *functs);
  * ERROR_INTERFACE is returned otherwise
  *
  *****************************************************************************/
-TCGS_InterfaceError_t TCGS_SendCommand(
+TCGS_Error_t TCGS_SendCommand(
     TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
     TCGS_InterfaceError_t *interfaceError, void *outputPayload);
 
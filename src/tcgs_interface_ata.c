@@ -23,7 +23,7 @@
  * ERROR_INTERFACE is returned otherwise
  *
  *****************************************************************************/
-TCGS_InterfaceError_t TCGS_ATA_SendCommand(
+TCGS_Error_t TCGS_ATA_SendCommand(
     TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
     TCGS_InterfaceError_t *tperError, void *outputPayload)
 {
@@ -35,4 +35,5 @@ TCGS_InterfaceError_t TCGS_ATA_SendCommand(
 TCGS_InterfaceFunctions_t TCGS_Interface_ATA_Funcs =
 {
 	(TCGS_SendCommand_t)&TCGS_ATA_SendCommand,
+	NULL,
 };
@@ -25,7 +25,7 @@ extern TCGS_InterfaceFunctions_t TCGS_Interface_ATA_Funcs;
  * ERROR_INTERFACE is returned otherwise
  *
  *****************************************************************************/
-TCGS_InterfaceError_t TCGS_ATA_SendCommand(
+TCGS_Error_t TCGS_ATA_SendCommand(
     TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
     TCGS_InterfaceError_t *tperError, void *outputPayload);
 
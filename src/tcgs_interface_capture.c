@@ -0,0 +1,386 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_interface_capture.c
+///
+/// Record/replay interface mapper
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tcgs_types.h"
+#include "tcgs_interface.h"
+#include "tcgs_interface_chain.h"
+#include "tcgs_interface_capture.h"
+#include "tcgs_time.h"
+
+#define _align(x) (((x) + TCGS_CAPTURE_ALIGNMENT - 1) & ~(TCGS_CAPTURE_ALIGNMENT - 1))
+
+/*
+ * Recording
+ */
+static FILE *recordFile;
+static uint64 recordStart;
+static uint32 recordCount;
+static bool recordFailed;           //a record was written short, the file is incomplete
+//records of devices sent concurrently are not interleaved
+static pthread_mutex_t recordLock = PTHREAD_MUTEX_INITIALIZER;
+static TCGS_InterfaceFunctions_t *recordTarget;
+static bool recordInstalled;        //recording functions are installed instead of recordTarget
+
+static void TCGS_Capture_Write(TCGS_CommandBlock_t *inputCommandBlock, void *inputPayload,
+		TCGS_InterfaceError_t *tperError, void *outputPayload, TCGS_Error_t status, uint64 start)
+{
+	static const uint8 padding[TCGS_CAPTURE_ALIGNMENT];
+	TCGS_CaptureRecord_t record;
+	void *payload;
+
+	payload = (inputCommandBlock->command == IF_SEND) ? inputPayload : outputPayload;
+
+	memset(&record, 0, sizeof(record));
+	record.command        = (uint8)inputCommandBlock->command;
+	record.protocolId     = inputCommandBlock->protocolId;
+	record.interfaceError = (uint8)*tperError;
+	record.status         = (uint8)status;
+	record.length         = inputCommandBlock->length;
+	record.comId          = inputCommandBlock->comId;
+	record.payloadLength  = (payload != NULL) ? TCGS_GetTransferLength(inputCommandBlock) : 0;
+	record.timestamp      = start - recordStart;
+	record.duration       = TCGS_GetTime() - start;
+
+	pthread_mutex_lock(&recordLock);
+	if (recordFile == NULL || recordFailed)
+	{
+		pthread_mutex_unlock(&recordLock);
+		return;
+	}
+	if (fwrite(&record, sizeof(record), 1, recordFile) != 1 ||
+		(record.payloadLength > 0 &&
+		 (fwrite(payload, record.payloadLength, 1, recordFile) != 1 ||
+		  fwrite(padding, 1, _align(record.payloadLength) - record.payloadLength, recordFile) !=
+				_align(record.payloadLength) - record.payloadLength)))
+	{
+		//following records would be misaligned, recording stops here
+		recordFailed = TRUE;
+	}
+	else
+	{
+		recordCount++;
+	}
+	pthread_mutex_unlock(&recordLock);
+}
+
+static TCGS_Error_t TCGS_Record_SendCommand(
+    TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
+    TCGS_InterfaceError_t *tperError, void *outputPayload)
+{
+	TCGS_Error_t status;
+	uint64 start;
+
+	start = TCGS_GetTime();
+	status = (*recordTarget->send)(inputCommandBlock, inputPayload, tperError, outputPayload);
+	TCGS_Capture_Write(inputCommandBlock, inputPayload, tperError, outputPayload, status, start);
+	return status;
+}
+
+static TCGS_LayerVerdict_t TCGS_Record_After(void *context, TCGS_LayerCommand_t *command)
+{
+	TCGS_Capture_Write(command->commandBlock, command->inputPayload, command->interfaceError,
+			command->outputPayload, command->status, command->start);
+	return LAYER_CONTINUE;
+}
+
+TCGS_InterfaceFunctions_t TCGS_Interface_Record_Funcs =
+{
+	(TCGS_SendCommand_t)&TCGS_Record_SendCommand,
+	NULL,
+};
+
+static TCGS_Error_t TCGS_Capture_OpenRecord(const char *path)
+{
+	TCGS_CaptureHeader_t header;
+
+	if (recordFile != NULL)
+	{
+		return ERROR_INTERFACE;
+	}
+	recordFile = fopen(path, "wb");
+	if (recordFile == NULL)
+	{
+		return ERROR_INTERFACE;
+	}
+
+	//header is rewritten with actual number of records when recording is stopped
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TCGS_CAPTURE_MAGIC, sizeof(TCGS_CAPTURE_MAGIC));
+	header.version = TCGS_CAPTURE_VERSION;
+	if (fwrite(&header, sizeof(header), 1, recordFile) != 1)
+	{
+		fclose(recordFile);
+		recordFile = NULL;
+		return ERROR_INTERFACE;
+	}
+
+	recordCount = 0;
+	recordFailed = FALSE;
+	recordStart = TCGS_GetTime();
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Capture_StartRecord(const char *path)
+{
+	if (TCGS_GetInterfaceFunctions() == NULL || TCGS_Capture_OpenRecord(path) != ERROR_SUCCESS)
+	{
+		return ERROR_INTERFACE;
+	}
+	recordTarget = TCGS_GetInterfaceFunctions();
+	recordInstalled = TRUE;
+	TCGS_SetInterfaceFunctions(&TCGS_Interface_Record_Funcs);
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Capture_StartRecordLayer(const char *path, TCGS_InterfaceLayer_t *layer)
+{
+	if (TCGS_Capture_OpenRecord(path) != ERROR_SUCCESS)
+	{
+		return ERROR_INTERFACE;
+	}
+	memset(layer, 0, sizeof(*layer));
+	layer->after = TCGS_Record_After;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Capture_StopRecord(void)
+{
+	TCGS_CaptureHeader_t header;
+	TCGS_Error_t error = ERROR_SUCCESS;
+
+	pthread_mutex_lock(&recordLock);
+	if (recordFile == NULL)
+	{
+		pthread_mutex_unlock(&recordLock);
+		return ERROR_SUCCESS;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TCGS_CAPTURE_MAGIC, sizeof(TCGS_CAPTURE_MAGIC));
+	header.version     = TCGS_CAPTURE_VERSION;
+	header.recordCount = recordCount;
+	//records buffered by stdio may fail to be written only now
+	if (fflush(recordFile) != 0 || fseek(recordFile, 0, SEEK_SET) != 0 ||
+		fwrite(&header, sizeof(header), 1, recordFile) != 1)
+	{
+		recordFailed = TRUE;
+	}
+	if (fclose(recordFile) != 0 || recordFailed)
+	{
+		error = ERROR_INTERFACE;
+	}
+	recordFile = NULL;
+	pthread_mutex_unlock(&recordLock);
+
+	if (recordInstalled)
+	{
+		TCGS_SetInterfaceFunctions(recordTarget);
+		recordInstalled = FALSE;
+	}
+	recordTarget = NULL;
+	return error;
+}
+
+/*
+ * Replaying
+ */
+static uint8 *replayData;
+static size_t replaySize;
+static size_t replayOffset;
+static uint32 replayCount;
+static TCGS_CaptureReplayMode_t replayMode;
+static TCGS_InterfaceFunctions_t *replayPrevious;
+static bool replayInstalled;        //replaying functions are installed instead of replayPrevious
+
+static TCGS_Error_t TCGS_Replay_SendCommand(
+    TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
+    TCGS_InterfaceError_t *tperError, void *outputPayload)
+{
+	TCGS_CaptureRecord_t *record;
+
+	if (replayData == NULL || replayOffset + sizeof(TCGS_CaptureRecord_t) > replaySize)
+	{
+		*tperError = INTERFACE_ERROR_SYNCHRONOUS_PROTOCOL_VIOLATION;
+		return ERROR_INTERFACE;
+	}
+	record = (TCGS_CaptureRecord_t*)(replayData + replayOffset);
+
+	//the host side conversation must be the same as recorded one
+	if (record->command    != (uint8)inputCommandBlock->command ||
+		record->protocolId != inputCommandBlock->protocolId ||
+		record->length     != inputCommandBlock->length ||
+		record->comId      != inputCommandBlock->comId)
+	{
+		*tperError = INTERFACE_ERROR_SYNCHRONOUS_PROTOCOL_VIOLATION;
+		return ERROR_INTERFACE;
+	}
+
+	if (record->command == IF_RECV && outputPayload != NULL)
+	{
+		memcpy(outputPayload, record + 1, record->payloadLength);
+	}
+	if (replayMode == CAPTURE_REPLAY_RECORDED_SPEED)
+	{
+		TCGS_Sleep(record->duration);
+	}
+	replayOffset += sizeof(TCGS_CaptureRecord_t) + _align(record->payloadLength);
+
+	*tperError = (TCGS_InterfaceError_t)record->interfaceError;
+	return (TCGS_Error_t)record->status;
+}
+
+TCGS_InterfaceFunctions_t TCGS_Interface_Replay_Funcs =
+{
+	(TCGS_SendCommand_t)&TCGS_Replay_SendCommand,
+	NULL,
+};
+
+//replay layer completes every command with the recorded response
+static TCGS_LayerVerdict_t TCGS_Replay_Before(void *context, TCGS_LayerCommand_t *command)
+{
+	command->status = TCGS_Replay_SendCommand(command->commandBlock, command->inputPayload,
+			command->interfaceError, command->outputPayload);
+	return LAYER_COMPLETE;
+}
+
+/*
+ * Walk through all records once so that replaying doesn't need to check
+ * payload bounds
+ */
+static bool TCGS_Capture_ValidateReplay(void)
+{
+	TCGS_CaptureHeader_t *header = (TCGS_CaptureHeader_t*)replayData;
+	TCGS_CaptureRecord_t *record;
+	size_t offset = sizeof(TCGS_CaptureHeader_t);
+	uint32 i;
+
+	if (replaySize < sizeof(TCGS_CaptureHeader_t) ||
+		memcmp(header->magic, TCGS_CAPTURE_MAGIC, sizeof(TCGS_CAPTURE_MAGIC)) != 0 ||
+		header->version != TCGS_CAPTURE_VERSION)
+	{
+		return FALSE;
+	}
+	for (i = 0; i < header->recordCount; i++)
+	{
+		if (offset + sizeof(TCGS_CaptureRecord_t) > replaySize)
+		{
+			return FALSE;
+		}
+		record = (TCGS_CaptureRecord_t*)(replayData + offset);
+		offset += sizeof(TCGS_CaptureRecord_t) + _align(record->payloadLength);
+		if (offset > replaySize)
+		{
+			return FALSE;
+		}
+	}
+	replayCount = header->recordCount;
+	return TRUE;
+}
+
+static TCGS_Error_t TCGS_Capture_MapReplay(const char *path, TCGS_CaptureReplayMode_t mode)
+{
+	struct stat fileStat;
+	void *data;
+	int fd;
+
+	if (replayData != NULL)
+	{
+		return ERROR_INTERFACE;
+	}
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return ERROR_INTERFACE;
+	}
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(fd);
+		return ERROR_INTERFACE;
+	}
+	data = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		return ERROR_INTERFACE;
+	}
+
+	replayData = (uint8*)data;
+	replaySize = fileStat.st_size;
+	if (!TCGS_Capture_ValidateReplay())
+	{
+		munmap(replayData, replaySize);
+		replayData = NULL;
+		replaySize = 0;
+		return ERROR_INTERFACE;
+	}
+	replayMode = mode;
+	replayOffset = sizeof(TCGS_CaptureHeader_t);
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Capture_OpenReplay(const char *path, TCGS_CaptureReplayMode_t mode)
+{
+	if (TCGS_Capture_MapReplay(path, mode) != ERROR_SUCCESS)
+	{
+		return ERROR_INTERFACE;
+	}
+	replayPrevious = TCGS_GetInterfaceFunctions();
+	replayInstalled = TRUE;
+	TCGS_SetInterfaceFunctions(&TCGS_Interface_Replay_Funcs);
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Capture_OpenReplayLayer(const char *path, TCGS_CaptureReplayMode_t mode,
+		TCGS_InterfaceLayer_t *layer)
+{
+	if (TCGS_Capture_MapReplay(path, mode) != ERROR_SUCCESS)
+	{
+		return ERROR_INTERFACE;
+	}
+	memset(layer, 0, sizeof(*layer));
+	layer->before = TCGS_Replay_Before;
+	return ERROR_SUCCESS;
+}
+
+void TCGS_Capture_RewindReplay(void)
+{
+	replayOffset = sizeof(TCGS_CaptureHeader_t);
+}
+
+uint32 TCGS_Capture_GetReplayRecordCount(void)
+{
+	return (replayData != NULL) ? replayCount : 0;
+}
+
+void TCGS_Capture_CloseReplay(void)
+{
+	if (replayData == NULL)
+	{
+		return;
+	}
+	munmap(replayData, replaySize);
+	replayData = NULL;
+	replaySize = 0;
+	replayCount = 0;
+
+	if (replayInstalled)
+	{
+		TCGS_SetInterfaceFunctions(replayPrevious);
+		replayInstalled = FALSE;
+	}
+	replayPrevious = NULL;
+}
@@ -0,0 +1,164 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_interface_capture.h
+///
+/// Record/replay interface mapper
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_INTERFACE_CAPTURE_H
+#define _TCGS_INTERFACE_CAPTURE_H
+
+#include "tcgs_types.h"
+#include "tcgs_interface.h"
+#include "tcgs_interface_chain.h"
+
+#define TCGS_CAPTURE_MAGIC   "TCGSCAP"
+#define TCGS_CAPTURE_VERSION 1
+
+//records and their payloads are aligned in the capture file to this value
+#define TCGS_CAPTURE_ALIGNMENT 8
+
+/*****************************************************************************
+ * \brief Header of capture file
+ *
+ * The capture file consists of the header followed by recordCount records.
+ * All fields are stored in host byte order, the file is intended to be
+ * mapped into memory and used on the host that recorded it.
+ *****************************************************************************/
+typedef struct
+{
+	uint8  magic[8];           //TCGS_CAPTURE_MAGIC
+	uint32 version;            //TCGS_CAPTURE_VERSION
+	uint32 recordCount;        //number of records in the file
+} TCGS_CaptureHeader_t;
+
+/*****************************************************************************
+ * \brief One interface command passed through TCGS_SendCommand
+ *
+ * The record is followed by payloadLength bytes of payload padded up to
+ * TCGS_CAPTURE_ALIGNMENT. The payload is the input payload for IF-SEND and
+ * the output payload for IF-RECV.
+ *****************************************************************************/
+typedef struct
+{
+	uint8  command;            //TCGS_Command_t
+	uint8  protocolId;
+	uint8  interfaceError;     //TCGS_InterfaceError_t returned by TPer
+	uint8  status;             //status returned by the interface function
+	uint32 length;             //length field of the command block
+	uint32 comId;
+	uint32 payloadLength;      //in bytes
+	uint64 timestamp;          //ns since the start of the capture
+	uint64 duration;           //ns spent in the interface function
+} TCGS_CaptureRecord_t;
+
+typedef enum
+{
+	CAPTURE_REPLAY_RECORDED_SPEED,  //each response is delayed for recorded duration
+	CAPTURE_REPLAY_MAXIMUM_SPEED,   //responses are returned immediately
+} TCGS_CaptureReplayMode_t;
+
+extern TCGS_InterfaceFunctions_t TCGS_Interface_Record_Funcs;
+extern TCGS_InterfaceFunctions_t TCGS_Interface_Replay_Funcs;
+
+/*****************************************************************************
+ * \brief Start recording of interface commands to capture file
+ *
+ * \par The function installs recording interface functions that forward
+ * every command to the interface functions which were current at the moment
+ * of the call and append command, payload, status and timing to the file.
+ *
+ * @param[in]  path         path of the capture file, truncated if exists
+ *
+ * \return ERROR_SUCCESS if the file is created, ERROR_INTERFACE otherwise
+ *
+ * \see TCGS_Capture_StopRecord
+ *****************************************************************************/
+TCGS_Error_t TCGS_Capture_StartRecord(const char *path);
+
+/*****************************************************************************
+ * \brief Start recording of interface commands passing through layer
+ *
+ * \par Interface functions are not changed, the layer is to be stacked in a
+ * chain. Commands are recorded as the layer sees them: with responses of
+ * the inner layers and the backend.
+ *
+ * @param[in]  path         path of the capture file, truncated if exists
+ * @param[out] layer        recording layer
+ *
+ * \return ERROR_SUCCESS if the file is created, ERROR_INTERFACE otherwise
+ *
+ * \see TCGS_Capture_StopRecord, TCGS_InterfaceChain_Init
+ *****************************************************************************/
+TCGS_Error_t TCGS_Capture_StartRecordLayer(const char *path, TCGS_InterfaceLayer_t *layer);
+
+/*****************************************************************************
+ * \brief Stop recording, finalize capture file and restore interface
+ * functions that were current before TCGS_Capture_StartRecord
+ *
+ * \par Records of commands sent concurrently are written whole, one at a
+ * time. Recording stops at the first record that can't be written.
+ *
+ * \return ERROR_SUCCESS if all records are written, ERROR_INTERFACE if a
+ * write failed and the file holds only the records before it
+ *
+ * \see TCGS_Capture_StartRecord
+ *****************************************************************************/
+TCGS_Error_t TCGS_Capture_StopRecord(void);
+
+/*****************************************************************************
+ * \brief Open capture file and install replaying interface functions
+ *
+ * \par Replaying interface functions serve recorded responses in order of
+ * recording. A command which doesn't match the next record is failed with
+ * INTERFACE_ERROR_SYNCHRONOUS_PROTOCOL_VIOLATION.
+ *
+ * @param[in]  path         path of the capture file
+ * @param[in]  mode         replay speed
+ *
+ * \return ERROR_SUCCESS if the file is mapped, ERROR_INTERFACE otherwise
+ *
+ * \see TCGS_Capture_RewindReplay, TCGS_Capture_CloseReplay
+ *****************************************************************************/
+TCGS_Error_t TCGS_Capture_OpenReplay(const char *path, TCGS_CaptureReplayMode_t mode);
+
+/*****************************************************************************
+ * \brief Open capture file for replaying layer
+ *
+ * \par The layer completes every command with the recorded response, so
+ * inner layers and the backend are not called.
+ *
+ * @param[in]  path         path of the capture file
+ * @param[in]  mode         replay speed
+ * @param[out] layer        replaying layer
+ *
+ * \return ERROR_SUCCESS if the file is mapped, ERROR_INTERFACE otherwise
+ *
+ * \see TCGS_Capture_OpenReplay
+ *****************************************************************************/
+TCGS_Error_t TCGS_Capture_OpenReplayLayer(const char *path, TCGS_CaptureReplayMode_t mode,
+		TCGS_InterfaceLayer_t *layer);
+
+/*****************************************************************************
+ * \brief Restart replay from the first record of the capture file
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Capture_RewindReplay(void);
+
+/*****************************************************************************
+ * \brief Return number of records in opened capture file
+ *
+ * \return uint32 number of records, 0 if no capture file is opened
+ *****************************************************************************/
+uint32 TCGS_Capture_GetReplayRecordCount(void);
+
+/*****************************************************************************
+ * \brief Unmap capture file and restore interface functions that were
+ * current before TCGS_Capture_OpenReplay
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Capture_CloseReplay(void);
+
+#endif //_TCGS_INTERFACE_CAPTURE_H
@@ -0,0 +1,455 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_interface_chain.c
+///
+/// Chain of layers around interface functions
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#if TCGS_VERBOSE
+#include <stdio.h>
+#endif //TCGS_VERBOSE
+
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_interface_chain.h"
+#include "tcgs_operation.h"
+#include "tcgs_time.h"
+#include "tcgs_verbose.h"
+
+static TCGS_Error_t TCGS_InterfaceChain_AddLayer(TCGS_InterfaceChain_t *chain, const TCGS_InterfaceLayer_t *layer)
+{
+	if (layer->before == NULL && layer->after == NULL)
+	{
+		return ERROR_SUCCESS;
+	}
+	if (chain->layerCount == TCGS_INTERFACE_CHAIN_LAYERS)
+	{
+		return ERROR_PARAMETER;
+	}
+	chain->layers[chain->layerCount++] = *layer;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_InterfaceChain_Init(TCGS_InterfaceChain_t *chain, TCGS_InterfaceFunctions_t *backend,
+		const TCGS_InterfaceLayer_t *layers, uint32 count)
+{
+	uint32 i;
+
+	memset(chain, 0, sizeof(*chain));
+	chain->backend = backend->send;
+	for (i = 0; i < count; i++)
+	{
+		if (TCGS_InterfaceChain_AddLayer(chain, &layers[i]) != ERROR_SUCCESS)
+		{
+			return ERROR_PARAMETER;
+		}
+	}
+	//layers of backend chain are inner to the new ones
+	if (backend->chain != NULL)
+	{
+		for (i = 0; i < backend->chain->layerCount; i++)
+		{
+			if (TCGS_InterfaceChain_AddLayer(chain, &backend->chain->layers[i]) != ERROR_SUCCESS)
+			{
+				return ERROR_PARAMETER;
+			}
+		}
+		chain->backend = backend->chain->backend;
+	}
+	chain->funcs.send = chain->backend;
+	chain->funcs.chain = (chain->layerCount > 0) ? chain : NULL;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_InterfaceChain_SendCommand(TCGS_InterfaceChain_t *chain,
+    TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
+    TCGS_InterfaceError_t *interfaceError, void *outputPayload)
+{
+	TCGS_InterfaceLayer_t *layers = chain->layers;
+	TCGS_LayerCommand_t command;
+	uint32 first = 0, i;
+	bool retry;
+
+	command.commandBlock = inputCommandBlock;
+	command.inputPayload = inputPayload;
+	command.interfaceError = interfaceError;
+	command.outputPayload = outputPayload;
+	command.status = ERROR_INTERFACE;
+	command.attempt = 0;
+	command.start = TCGS_GetTime();
+
+	do
+	{
+		for (i = first; i < chain->layerCount; i++)
+		{
+			if (layers[i].before != NULL && layers[i].before(layers[i].context, &command) == LAYER_COMPLETE)
+			{
+				break;
+			}
+		}
+		if (i == chain->layerCount)
+		{
+			command.status = chain->backend(inputCommandBlock, inputPayload, interfaceError, outputPayload);
+		}
+		retry = FALSE;
+		while (i > 0 && !retry)
+		{
+			i--;
+			retry = (layers[i].after != NULL && layers[i].after(layers[i].context, &command) == LAYER_RETRY);
+		}
+		//the retrying layer sends the command to its inner layers
+		first = i + 1;
+		command.attempt++;
+	} while (retry);
+
+	return command.status;
+}
+
+/*
+ * Tracing
+ */
+#if TCGS_VERBOSE
+static TCGS_LayerVerdict_t TCGS_Layer_TraceBefore(void *context, TCGS_LayerCommand_t *command)
+{
+	printf(TCGS_VERBOSE_COMMAND_SEPARATOR "\n");
+	TCGS_PrintCommand(command->commandBlock);
+	if (TCGS_IsComPacketCommand(command->commandBlock) && command->commandBlock->command == IF_SEND &&
+		command->inputPayload != NULL)
+	{
+		TCGS_PrintComPacket(command->inputPayload, TCGS_GetTransferLength(command->commandBlock));
+	}
+	return LAYER_CONTINUE;
+}
+
+static TCGS_LayerVerdict_t TCGS_Layer_TraceAfter(void *context, TCGS_LayerCommand_t *command)
+{
+	if (TCGS_IsComPacketCommand(command->commandBlock) && command->commandBlock->command == IF_RECV &&
+		command->outputPayload != NULL && command->status == ERROR_SUCCESS)
+	{
+		TCGS_PrintComPacket(command->outputPayload, TCGS_GetTransferLength(command->commandBlock));
+	}
+	printf(TCGS_VERBOSE_COMMAND_SEPARATOR "\n");
+	return LAYER_CONTINUE;
+}
+#endif //TCGS_VERBOSE
+
+void TCGS_Layer_Trace(TCGS_InterfaceLayer_t *layer)
+{
+	memset(layer, 0, sizeof(*layer));
+#if TCGS_VERBOSE
+	layer->before = TCGS_Layer_TraceBefore;
+	layer->after = TCGS_Layer_TraceAfter;
+#endif //TCGS_VERBOSE
+}
+
+/*
+ * Metrics
+ */
+static TCGS_LayerVerdict_t TCGS_Layer_MetricsAfter(void *context, TCGS_LayerCommand_t *command)
+{
+	TCGS_LayerMetrics_t *metrics = context;
+	uint64 time = TCGS_GetTime() - command->start;
+	uint64 maxTime;
+	uint32 length = TCGS_GetTransferLength(command->commandBlock);
+
+	__sync_fetch_and_add(&metrics->commands, 1);
+	if (command->status != ERROR_SUCCESS || *command->interfaceError != INTERFACE_ERROR_GOOD)
+	{
+		__sync_fetch_and_add(&metrics->errors, 1);
+	}
+	else if (command->commandBlock->command == IF_SEND)
+	{
+		__sync_fetch_and_add(&metrics->bytesSent, length);
+	}
+	else
+	{
+		__sync_fetch_and_add(&metrics->bytesReceived, length);
+	}
+	__sync_fetch_and_add(&metrics->time, time);
+	do
+	{
+		maxTime = metrics->maxTime;
+	} while (time > maxTime && !__sync_bool_compare_and_swap(&metrics->maxTime, maxTime, time));
+	return LAYER_CONTINUE;
+}
+
+void TCGS_Layer_Metrics(TCGS_InterfaceLayer_t *layer, TCGS_LayerMetrics_t *metrics)
+{
+	memset(metrics, 0, sizeof(*metrics));
+	memset(layer, 0, sizeof(*layer));
+	layer->after = TCGS_Layer_MetricsAfter;
+	layer->context = metrics;
+}
+
+/*
+ * Retry
+ */
+//commands that don't change state of TPer
+static bool TCGS_Layer_IsIdempotent(const TCGS_CommandBlock_t *commandBlock)
+{
+	return commandBlock->command == IF_RECV || commandBlock->protocolId == 0x00;
+}
+
+static TCGS_LayerVerdict_t TCGS_Layer_RetryAfter(void *context, TCGS_LayerCommand_t *command)
+{
+	TCGS_LayerRetry_t *retry = context;
+	TCGS_Error_t error;
+
+	if ((command->status == ERROR_SUCCESS && *command->interfaceError == INTERFACE_ERROR_GOOD) ||
+		TCGS_IsOperationError(command->status) || command->attempt >= retry->limit ||
+		!retry->retryable(command->commandBlock))
+	{
+		return LAYER_CONTINUE;
+	}
+	//backoff doesn't outlast the operation
+	error = TCGS_Operation_Backoff(retry->delay, retry->maxDelay, command->attempt);
+	if (error != ERROR_SUCCESS)
+	{
+		command->status = error;
+		return LAYER_CONTINUE;
+	}
+	__sync_fetch_and_add(&retry->retries, 1);
+	return LAYER_RETRY;
+}
+
+void TCGS_Layer_Retry(TCGS_InterfaceLayer_t *layer, TCGS_LayerRetry_t *retry, uint32 limit,
+		uint64 delay, uint64 maxDelay)
+{
+	memset(retry, 0, sizeof(*retry));
+	retry->limit = limit;
+	retry->delay = delay;
+	retry->maxDelay = (maxDelay > delay) ? maxDelay : delay;
+	retry->retryable = TCGS_Layer_IsIdempotent;
+	memset(layer, 0, sizeof(*layer));
+	layer->after = TCGS_Layer_RetryAfter;
+	layer->context = retry;
+}
+
+/*
+ * Rate limiting
+ */
+static TCGS_LayerVerdict_t TCGS_Layer_RateLimitBefore(void *context, TCGS_LayerCommand_t *command)
+{
+	TCGS_LayerRateLimit_t *rateLimit = context;
+	TCGS_Error_t error;
+	uint64 now, next, slot;
+
+	//the command takes the first free slot, so concurrent commands don't get the same one
+	do
+	{
+		now = TCGS_GetTime();
+		next = rateLimit->next;
+		slot = (next > now) ? next : now;
+	} while (!__sync_bool_compare_and_swap(&rateLimit->next, next, slot + rateLimit->interval));
+	if (slot > now)
+	{
+		error = TCGS_Operation_Sleep(slot - now);
+		if (error != ERROR_SUCCESS)
+		{
+			command->status = error;
+			return LAYER_COMPLETE;
+		}
+	}
+	return LAYER_CONTINUE;
+}
+
+void TCGS_Layer_RateLimit(TCGS_InterfaceLayer_t *layer, TCGS_LayerRateLimit_t *rateLimit, uint64 interval)
+{
+	memset(rateLimit, 0, sizeof(*rateLimit));
+	rateLimit->interval = interval;
+	memset(layer, 0, sizeof(*layer));
+	layer->before = TCGS_Layer_RateLimitBefore;
+	layer->context = rateLimit;
+}
+
+/*
+ * Fault injection
+ */
+static TCGS_LayerVerdict_t TCGS_Layer_FaultBefore(void *context, TCGS_LayerCommand_t *command)
+{
+	TCGS_LayerFault_t *fault = context;
+
+	if (fault->period == 0 || __sync_add_and_fetch(&fault->count, 1) % fault->period != 0)
+	{
+		return LAYER_CONTINUE;
+	}
+	__sync_fetch_and_add(&fault->injected, 1);
+	//TPer reports interface errors of commands the transport has delivered
+	*command->interfaceError = fault->error;
+	command->status = (fault->error != INTERFACE_ERROR_GOOD) ? ERROR_SUCCESS : ERROR_INTERFACE;
+	return LAYER_COMPLETE;
+}
+
+void TCGS_Layer_Fault(TCGS_InterfaceLayer_t *layer, TCGS_LayerFault_t *fault, uint32 period,
+		TCGS_InterfaceError_t error)
+{
+	memset(fault, 0, sizeof(*fault));
+	fault->period = period;
+	fault->error = error;
+	memset(layer, 0, sizeof(*layer));
+	layer->before = TCGS_Layer_FaultBefore;
+	layer->context = fault;
+}
+
+/*
+ * Single flight
+ */
+static bool TCGS_Layer_IsReadOnly(TCGS_LayerCommand_t *command)
+{
+	TCGS_CommandBlock_t *commandBlock = command->commandBlock;
+
+	return commandBlock->command == IF_RECV &&
+		(commandBlock->protocolId == 0x00 || (commandBlock->protocolId == 0x01 && commandBlock->comId == 0x0001)) &&
+		TCGS_GetTransferLength(commandBlock) <= TCGS_SINGLE_FLIGHT_MAX_RESPONSE;
+}
+
+//FNV-1a of device, command block and input payload
+static uint64 TCGS_Layer_HashCommand(TCGS_Device_t *device, TCGS_LayerCommand_t *command)
+{
+	TCGS_CommandBlock_t *commandBlock = command->commandBlock;
+	uint64 hash = 0xCBF29CE484222325ULL;
+	uint64 fields[5];
+	const uint8 *p = (const uint8*)fields;
+	uint32 i;
+
+	fields[0] = (uint64)(size_t)device;
+	fields[1] = commandBlock->command;
+	fields[2] = commandBlock->protocolId | ((uint64)commandBlock->comId << 8);
+	fields[3] = commandBlock->length;
+	//commands differing only in payload are not identical
+	fields[4] = (command->inputPayload != NULL) ? TCGS_GetTransferLength(commandBlock) : 0;
+	for (i = 0; i < sizeof(fields); i++)
+	{
+		hash = (hash ^ p[i]) * 0x100000001B3ULL;
+	}
+	p = command->inputPayload;
+	for (i = 0; i < fields[4]; i++)
+	{
+		hash = (hash ^ p[i]) * 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+static TCGS_LayerVerdict_t TCGS_Layer_SingleFlightBefore(void *context, TCGS_LayerCommand_t *command)
+{
+	TCGS_LayerSingleFlight_t *singleFlight = context;
+	TCGS_Device_t *device = TCGS_GetCurrentDevice();
+	TCGS_SingleFlightSlot_t *slot, *free = NULL;
+	uint64 hash;
+	uint32 i;
+
+	if (!TCGS_Layer_IsReadOnly(command))
+	{
+		return LAYER_CONTINUE;
+	}
+	hash = TCGS_Layer_HashCommand(device, command);
+	pthread_mutex_lock(&singleFlight->lock);
+	for (i = 0; i < TCGS_SINGLE_FLIGHT_SLOTS; i++)
+	{
+		slot = &singleFlight->slots[i];
+		if (!slot->busy)
+		{
+			free = (free != NULL) ? free : slot;
+		}
+		else if (!slot->done && slot->hash == hash && slot->device == device &&
+			memcmp(&slot->commandBlock, command->commandBlock, sizeof(slot->commandBlock)) == 0)
+		{
+			break;
+		}
+	}
+	if (i == TCGS_SINGLE_FLIGHT_SLOTS)
+	{
+		//the command is sent, a full table leaves it unshared
+		if (free != NULL)
+		{
+			free->busy = TRUE;
+			free->done = FALSE;
+			free->hash = hash;
+			free->device = device;
+			free->commandBlock = *command->commandBlock;
+			free->leaderPayload = command->outputPayload;
+			free->waiters = 0;
+		}
+		singleFlight->sent++;
+		pthread_mutex_unlock(&singleFlight->lock);
+		return LAYER_CONTINUE;
+	}
+
+	slot->waiters++;
+	while (!slot->done)
+	{
+		pthread_cond_wait(&singleFlight->done, &singleFlight->lock);
+	}
+	command->status = slot->status;
+	*command->interfaceError = slot->interfaceError;
+	if (slot->status == ERROR_SUCCESS && command->outputPayload != NULL)
+	{
+		memcpy(command->outputPayload, slot->response, TCGS_GetTransferLength(command->commandBlock));
+	}
+	if (--slot->waiters == 0)
+	{
+		slot->busy = FALSE;
+	}
+	singleFlight->coalesced++;
+	pthread_mutex_unlock(&singleFlight->lock);
+	return LAYER_COMPLETE;
+}
+
+static TCGS_LayerVerdict_t TCGS_Layer_SingleFlightAfter(void *context, TCGS_LayerCommand_t *command)
+{
+	TCGS_LayerSingleFlight_t *singleFlight = context;
+	TCGS_SingleFlightSlot_t *slot;
+	uint32 i;
+
+	if (!TCGS_Layer_IsReadOnly(command))
+	{
+		return LAYER_CONTINUE;
+	}
+	pthread_mutex_lock(&singleFlight->lock);
+	for (i = 0; i < TCGS_SINGLE_FLIGHT_SLOTS; i++)
+	{
+		slot = &singleFlight->slots[i];
+		if (slot->busy && !slot->done && slot->leaderPayload == command->outputPayload &&
+			slot->device == TCGS_GetCurrentDevice())
+		{
+			slot->status = command->status;
+			slot->interfaceError = *command->interfaceError;
+			if (command->status == ERROR_SUCCESS && command->outputPayload != NULL)
+			{
+				memcpy(slot->response, command->outputPayload, TCGS_GetTransferLength(command->commandBlock));
+			}
+			slot->done = TRUE;
+			slot->leaderPayload = NULL;
+			if (slot->waiters == 0)
+			{
+				slot->busy = FALSE;
+			}
+			pthread_cond_broadcast(&singleFlight->done);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&singleFlight->lock);
+	return LAYER_CONTINUE;
+}
+
+void TCGS_Layer_SingleFlight(TCGS_InterfaceLayer_t *layer, TCGS_LayerSingleFlight_t *singleFlight)
+{
+	memset(singleFlight, 0, sizeof(*singleFlight));
+	pthread_mutex_init(&singleFlight->lock, NULL);
+	pthread_cond_init(&singleFlight->done, NULL);
+	memset(layer, 0, sizeof(*layer));
+	layer->before = TCGS_Layer_SingleFlightBefore;
+	layer->after = TCGS_Layer_SingleFlightAfter;
+	layer->context = singleFlight;
+}
+
+void TCGS_Layer_SingleFlightDestroy(TCGS_LayerSingleFlight_t *singleFlight)
+{
+	pthread_cond_destroy(&singleFlight->done);
+	pthread_mutex_destroy(&singleFlight->lock);
+}
@@ -0,0 +1,267 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_interface_chain.h
+///
+/// Chain of layers around interface functions
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_INTERFACE_CHAIN_H
+#define _TCGS_INTERFACE_CHAIN_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_interface.h"
+
+typedef enum
+{
+	LAYER_CONTINUE,     //pass the command on
+	LAYER_COMPLETE,     //returned by before hook: the command is completed by the layer
+	LAYER_RETRY,        //returned by after hook: the command is sent to inner layers again
+} TCGS_LayerVerdict_t;
+
+/*****************************************************************************
+ * \brief Interface command passing through chain
+ *
+ * \par Layer that completes the command sets status, interface error and
+ * output payload as backend would do.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_CommandBlock_t    *commandBlock;
+	void                   *inputPayload;
+	TCGS_InterfaceError_t  *interfaceError;
+	void                   *outputPayload;
+	TCGS_Error_t            status;     //status returned by backend or by completing layer
+	uint32                  attempt;    //number of retries of the command
+	uint64                  start;      //time the command entered the chain
+} TCGS_LayerCommand_t;
+
+typedef TCGS_LayerVerdict_t (*TCGS_LayerHook_t)(void *context, TCGS_LayerCommand_t *command);
+
+/*****************************************************************************
+ * \brief Layer of chain
+ *
+ * \par Before hooks are called from the outer layer to the inner one,
+ * after hooks are called in reverse order for layers whose before hooks
+ * were called. Hooks are called concurrently for commands of different
+ * devices, context shared by the devices shall be protected by the layer.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_LayerHook_t  before;     //may be NULL
+	TCGS_LayerHook_t  after;      //may be NULL
+	void             *context;
+} TCGS_InterfaceLayer_t;
+
+/*****************************************************************************
+ * \brief Interface functions with layers around backend
+ *
+ * \par Layers are resolved when the chain is built: layers without hooks
+ * are dropped and layers of backend chain are appended, so a command passes
+ * through one flat array of layers. Chain without layers has the backend
+ * send function in funcs and costs nothing per command.
+ *****************************************************************************/
+typedef struct TCGS_InterfaceChain
+{
+	TCGS_InterfaceFunctions_t  funcs;   //functions to install for devices
+	TCGS_SendCommand_t         backend;
+	uint32                     layerCount;
+	TCGS_InterfaceLayer_t      layers[TCGS_INTERFACE_CHAIN_LAYERS];
+} TCGS_InterfaceChain_t;
+
+/*****************************************************************************
+ * \brief Builds chain of layers around backend
+ *
+ * @param[out] chain        chain
+ * @param[in]  backend      interface functions the commands are sent with,
+ *                          may be functions of another chain
+ * @param[in]  layers       layers from the outer one to the inner one
+ * @param[in]  count        number of layers
+ *
+ * \return ERROR_SUCCESS if chain is built, ERROR_PARAMETER if there are
+ * more than TCGS_INTERFACE_CHAIN_LAYERS layers with hooks
+ *
+ * \see TCGS_Device_Init, TCGS_SetInterfaceFunctions
+ *****************************************************************************/
+TCGS_Error_t TCGS_InterfaceChain_Init(TCGS_InterfaceChain_t *chain, TCGS_InterfaceFunctions_t *backend,
+		const TCGS_InterfaceLayer_t *layers, uint32 count);
+
+/*****************************************************************************
+ * \brief Sends command through layers of chain
+ *
+ * \par Called by TCGS_Device_SendCommand for functions of chain with layers.
+ *
+ * \see TCGS_Device_SendCommand
+ *****************************************************************************/
+TCGS_Error_t TCGS_InterfaceChain_SendCommand(TCGS_InterfaceChain_t *chain,
+    TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
+    TCGS_InterfaceError_t *interfaceError, void *outputPayload);
+
+/*****************************************************************************
+ * \brief Tracing layer: prints commands and ComPackets to stdout
+ *
+ * \par The layer has no hooks if the library is built without TCGS_VERBOSE.
+ *
+ * @param[out] layer        layer
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Layer_Trace(TCGS_InterfaceLayer_t *layer);
+
+typedef struct
+{
+	uint64  commands;
+	uint64  errors;         //commands failed by transport or TPer
+	uint64  bytesSent;
+	uint64  bytesReceived;
+	uint64  time;           //total nanoseconds spent in inner layers and backend
+	uint64  maxTime;
+} TCGS_LayerMetrics_t;
+
+/*****************************************************************************
+ * \brief Metrics layer: counts commands, errors, payload bytes and time
+ *
+ * @param[out] layer        layer
+ * @param[out] metrics      counters, zeroed by the function
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Layer_Metrics(TCGS_InterfaceLayer_t *layer, TCGS_LayerMetrics_t *metrics);
+
+//returns TRUE if the command may be sent to TPer again
+typedef bool (*TCGS_LayerRetryable_t)(const TCGS_CommandBlock_t *commandBlock);
+
+typedef struct
+{
+	uint32                 limit;      //retries of a command
+	uint64                 delay;      //nanoseconds before the first retry, doubled for every next one
+	uint64                 maxDelay;   //upper bound of delay in nanoseconds
+	TCGS_LayerRetryable_t  retryable;  //commands that are retried, may be replaced by caller
+	uint64                 retries;
+} TCGS_LayerRetry_t;
+
+/*****************************************************************************
+ * \brief Retry layer: sends failed command again with exponential backoff
+ *
+ * \par Only transport failures and interface errors are retried, TPer
+ * responses are passed up as is. Commands are not retried after current
+ * operation of the thread is expired or cancelled. Delay is spread as by
+ * TCGS_Operation_Backoff.
+ *
+ * \par By default only IF-RECV and security protocol 0x00 commands are
+ * retried. IF-SEND of ComPacket is not: TPer may have done its methods or
+ * queued its response already, and the session would get out of step.
+ * Layer whose inner layers fail commands before they reach TPer may retry
+ * all of them with its own predicate.
+ *
+ * @param[out] layer        layer
+ * @param[out] retry        state of the layer
+ * @param[in]  limit        retries of a command
+ * @param[in]  delay        nanoseconds before the first retry
+ * @param[in]  maxDelay     upper bound of delay in nanoseconds
+ *
+ * \return None
+ *
+ * \see TCGS_Operation_Backoff
+ *****************************************************************************/
+void TCGS_Layer_Retry(TCGS_InterfaceLayer_t *layer, TCGS_LayerRetry_t *retry, uint32 limit,
+		uint64 delay, uint64 maxDelay);
+
+typedef struct
+{
+	uint64  interval;       //minimal nanoseconds between commands
+	uint64  next;           //time the next command may be sent
+} TCGS_LayerRateLimit_t;
+
+/*****************************************************************************
+ * \brief Rate limiting layer: commands are delayed to keep interval between them
+ *
+ * \par Commands of all devices using the layer share the rate. Command
+ * whose operation expires while it is delayed is not sent.
+ *
+ * @param[out] layer        layer
+ * @param[out] rateLimit    state of the layer
+ * @param[in]  interval     minimal nanoseconds between commands
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Layer_RateLimit(TCGS_InterfaceLayer_t *layer, TCGS_LayerRateLimit_t *rateLimit, uint64 interval);
+
+typedef struct
+{
+	uint32                 period;     //every period-th command fails, 0 disables injection
+	TCGS_InterfaceError_t  error;      //interface error of failed command
+	uint32                 count;
+	uint64                 injected;
+} TCGS_LayerFault_t;
+
+/*****************************************************************************
+ * \brief Fault injection layer: fails commands without sending them
+ *
+ * @param[out] layer        layer
+ * @param[out] fault        state of the layer
+ * @param[in]  period       every period-th command fails
+ * @param[in]  error        interface error of failed command, INTERFACE_ERROR_GOOD
+ *                          fails it in transport with ERROR_INTERFACE
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Layer_Fault(TCGS_InterfaceLayer_t *layer, TCGS_LayerFault_t *fault, uint32 period,
+		TCGS_InterfaceError_t error);
+
+//read-only command in flight and its response
+typedef struct
+{
+	bool                    busy;
+	bool                    done;           //response is in the slot
+	uint64                  hash;           //hash of device, command block and input payload
+	TCGS_Device_t          *device;
+	TCGS_CommandBlock_t     commandBlock;
+	void                   *leaderPayload;  //output payload of the command being sent
+	uint32                  waiters;        //commands waiting for the response
+	TCGS_Error_t            status;
+	TCGS_InterfaceError_t   interfaceError;
+	uint8                   response[TCGS_SINGLE_FLIGHT_MAX_RESPONSE];
+} TCGS_SingleFlightSlot_t;
+
+typedef struct
+{
+	pthread_mutex_t          lock;
+	pthread_cond_t           done;
+	TCGS_SingleFlightSlot_t  slots[TCGS_SINGLE_FLIGHT_SLOTS];
+	uint64                   sent;          //read-only commands sent to inner layers
+	uint64                   coalesced;     //commands completed with response of another one
+} TCGS_LayerSingleFlight_t;
+
+/*****************************************************************************
+ * \brief Single-flight layer: identical read-only commands of a device in
+ * flight at once are sent only once
+ *
+ * \par Level 0 Discovery and security protocol 0x00 commands are read-only.
+ * Command is identified by hash of its device, command block and input
+ * payload with its length. The first command is sent, commands identical to
+ * it wait and get a copy of its response, status and interface error.
+ * Commands of ComPackets are never coalesced, as TPer answers every IF-RECV
+ * of a session only once. The layer shall be the outer one, so waiting
+ * commands don't pass other layers.
+ *
+ * @param[out] layer        layer
+ * @param[out] singleFlight state of the layer
+ *
+ * \return None
+ *
+ * \see TCGS_Layer_SingleFlightDestroy
+ *****************************************************************************/
+void TCGS_Layer_SingleFlight(TCGS_InterfaceLayer_t *layer, TCGS_LayerSingleFlight_t *singleFlight);
+
+/*****************************************************************************
+ * \brief Releases state of single-flight layer
+ *
+ * \par No command shall be in flight through the layer.
+ *****************************************************************************/
+void TCGS_Layer_SingleFlightDestroy(TCGS_LayerSingleFlight_t *singleFlight);
+
+#endif //_TCGS_INTERFACE_CHAIN_H
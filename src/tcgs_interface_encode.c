@@ -16,7 +16,7 @@
 #include "tcgs_verbose.h"
 
 
-TCGS_Level0Discovery_Header_t *TCGS_DecodeLevel0Discovery (void* data)
+TCGS_Level0Discovery_Header_t *TCGS_DecodeLevel0DiscoveryQuiet(void* data)
 {
 	TCGS_Level0Discovery_Feature_t *iter;
 	#define header ((TCGS_Level0Discovery_Header_t*)data)
@@ -39,18 +39,44 @@ TCGS_Level0Discovery_Header_t *TCGS_DecodeLevel0Discovery (void* data)
 		case FEATURE_LOCKING:
 			//no decoding required
 			break;
+		case FEATURE_GEOMETRY:
+			((TCGS_Level0Discovery_FeatureGeometry_t*)iter)->LogicalBlockSize =
+					_swap32(((TCGS_Level0Discovery_FeatureGeometry_t*)iter)->LogicalBlockSize);
+			((TCGS_Level0Discovery_FeatureGeometry_t*)iter)->AlignmentGranularity =
+					_swap64(((TCGS_Level0Discovery_FeatureGeometry_t*)iter)->AlignmentGranularity);
+			((TCGS_Level0Discovery_FeatureGeometry_t*)iter)->LowestAlignedLBA =
+					_swap64(((TCGS_Level0Discovery_FeatureGeometry_t*)iter)->LowestAlignedLBA);
+			break;
 		case FEATURE_OPAL1:
 			((TCGS_Level0Discovery_FeatureOpal1_t*)iter)->baseComID =
 					_swap16(((TCGS_Level0Discovery_FeatureOpal1_t*)iter)->baseComID);
 			((TCGS_Level0Discovery_FeatureOpal1_t*)iter)->numberOfComIDs =
 					_swap16(((TCGS_Level0Discovery_FeatureOpal1_t*)iter)->numberOfComIDs);
 			break;
+		case FEATURE_OPAL2:
+			((TCGS_Level0Discovery_FeatureOpal2_t*)iter)->baseComID =
+					_swap16(((TCGS_Level0Discovery_FeatureOpal2_t*)iter)->baseComID);
+			((TCGS_Level0Discovery_FeatureOpal2_t*)iter)->numberOfComIDs =
+					_swap16(((TCGS_Level0Discovery_FeatureOpal2_t*)iter)->numberOfComIDs);
+			((TCGS_Level0Discovery_FeatureOpal2_t*)iter)->numberOfAdminsSupported =
+					_swap16(((TCGS_Level0Discovery_FeatureOpal2_t*)iter)->numberOfAdminsSupported);
+			((TCGS_Level0Discovery_FeatureOpal2_t*)iter)->numberOfUsersSupported =
+					_swap16(((TCGS_Level0Discovery_FeatureOpal2_t*)iter)->numberOfUsersSupported);
+			break;
 		//TODO: add decoding for other features
 		}
         iter = TCGS_GetLevel0DiscoveryNextFeatureHeader(header, iter);
 	}
-#if defined(TCGS_VERBOSE)
+	return header;
+	#undef header
+}
+
+TCGS_Level0Discovery_Header_t *TCGS_DecodeLevel0Discovery (void* data)
+{
+	TCGS_Level0Discovery_Header_t *header = TCGS_DecodeLevel0DiscoveryQuiet(data);
+
+#if TCGS_VERBOSE
 	TCGS_PrintLevel0Discovery(header);
-#endif //defined(TCGS_VERBOSE)
+#endif //TCGS_VERBOSE
 	return header;
 }
@@ -10,6 +10,7 @@
 #define TCGS_INTERFACE_ENCODE_H_
 
 #include "tcgs_types.h"
+#include "tcgs_stream.h"
 
 #define _swap16(x) (((((uint16)((x) & 0xFF00)) >> 8)) | ((uint16)(((x) & 0x00FF) << 8)))
 
@@ -20,15 +21,42 @@
 	 (((uint32)((x) & 0xFF000000)) >> 24))
 
 #define _swap64(value)                                \
-	(((((uint64)(x))<<56) & 0xFF00000000000000ULL)  | \
-	 ((((uint64)(x))<<40) & 0x00FF000000000000ULL)  | \
-	 ((((uint64)(x))<<24) & 0x0000FF0000000000ULL)  | \
-	 ((((uint64)(x))<< 8) & 0x000000FF00000000ULL)  | \
-	 ((((uint64)(x))>> 8) & 0x00000000FF000000ULL)  | \
-	 ((((uint64)(x))>>24) & 0x0000000000FF0000ULL)  | \
-	 ((((uint64)(x))>>40) & 0x000000000000FF00ULL)  | \
-	 ((((uint64)(x))>>56) & 0x00000000000000FFULL))
+	(((((uint64)(value))<<56) & 0xFF00000000000000ULL)  | \
+	 ((((uint64)(value))<<40) & 0x00FF000000000000ULL)  | \
+	 ((((uint64)(value))<<24) & 0x0000FF0000000000ULL)  | \
+	 ((((uint64)(value))<< 8) & 0x000000FF00000000ULL)  | \
+	 ((((uint64)(value))>> 8) & 0x00000000FF000000ULL)  | \
+	 ((((uint64)(value))>>24) & 0x0000000000FF0000ULL)  | \
+	 ((((uint64)(value))>>40) & 0x000000000000FF00ULL)  | \
+	 ((((uint64)(value))>>56) & 0x00000000000000FFULL))
+
+//big-endian fields of packets are stored as byte arrays
+#define _getBE16(p) ((uint16)(((uint16)(p)[0] << 8) | (uint16)(p)[1]))
+
+#define _getBE32(p) \
+	(((uint32)(p)[0] << 24) | ((uint32)(p)[1] << 16) | ((uint32)(p)[2] << 8) | (uint32)(p)[3])
+
+#define _putBE16(p, x) \
+	do { (p)[0] = (uint8)((x) >> 8); (p)[1] = (uint8)(x); } while (0)
+
+#define _putBE32(p, x) \
+	do { (p)[0] = (uint8)((x) >> 24); (p)[1] = (uint8)((x) >> 16); \
+	     (p)[2] = (uint8)((x) >> 8);  (p)[3] = (uint8)(x); } while (0)
 
 TCGS_Level0Discovery_Header_t* TCGS_DecodeLevel0Discovery();
 
+/*****************************************************************************
+ * \brief Decode Level 0 Discovery data in place without printing it
+ *
+ * \par TCGS_DecodeLevel0Discovery prints decoded data when TCGS_VERBOSE is
+ * set, this function is used where data is decoded repeatedly.
+ *
+ * @param[in,out] data  Level 0 Discovery data as received from TPer
+ *
+ * \return header of decoded data
+ *
+ * \see TCGS_DecodeLevel0Discovery
+ *****************************************************************************/
+TCGS_Level0Discovery_Header_t* TCGS_DecodeLevel0DiscoveryQuiet(void* data);
+
 #endif //#TCGS_INTERFACE_ENCODE_H_
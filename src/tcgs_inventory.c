@@ -0,0 +1,467 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_inventory.c
+///
+/// Snapshot of Level 0 Discovery state of a fleet mappable by other processes
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_builder.h"
+#include "tcgs_interface.h"
+#include "tcgs_interface_encode.h"
+#include "tcgs_parser.h"
+#include "tcgs_inventory.h"
+
+//sections of snapshot start at cache lines
+#define TCGS_INVENTORY_ALIGNMENT 64
+
+#define _base(inventory)    ((uint8*)(inventory)->header)
+#define _column(inventory, flag) \
+	((uint64*)(_base(inventory) + (inventory)->header->flagsOffset) + (flag) * (inventory)->header->flagWords)
+#define _records(inventory) \
+	((TCGS_InventoryRecord_t*)(_base(inventory) + (inventory)->header->recordsOffset))
+#define _index(inventory) \
+	((TCGS_InventoryIndexEntry_t*)(_base(inventory) + (inventory)->header->indexOffset))
+
+static uint64 TCGS_Inventory_Align(uint64 offset)
+{
+	return (offset + TCGS_INVENTORY_ALIGNMENT - 1) & ~(uint64)(TCGS_INVENTORY_ALIGNMENT - 1);
+}
+
+/*
+ * Computes offsets of sections and size of snapshot
+ */
+static bool TCGS_Inventory_Layout(TCGS_InventoryHeader_t *header, uint32 capacity, uint32 level0Size)
+{
+	uint64 offset = TCGS_Inventory_Align(sizeof(TCGS_InventoryHeader_t));
+
+	memset(header, 0, sizeof(*header));
+	header->magic = TCGS_INVENTORY_MAGIC;
+	header->version = TCGS_INVENTORY_VERSION;
+	header->headerSize = sizeof(TCGS_InventoryHeader_t);
+	header->capacity = capacity;
+	header->flagWords = (capacity + 63) / 64;
+	header->flagsOffset = (uint32)offset;
+	offset = TCGS_Inventory_Align(offset + (uint64)INVENTORY_FLAG_COUNT * header->flagWords * sizeof(uint64));
+	header->recordsOffset = (uint32)offset;
+	offset = TCGS_Inventory_Align(offset + (uint64)capacity * sizeof(TCGS_InventoryRecord_t));
+	header->indexOffset = (uint32)offset;
+	offset = TCGS_Inventory_Align(offset + (uint64)capacity * sizeof(TCGS_InventoryIndexEntry_t));
+	header->level0Offset = (uint32)offset;
+	header->level0Size = level0Size;
+	offset = TCGS_Inventory_Align(offset + level0Size);
+	header->size = (uint32)offset;
+	return offset <= 0xFFFFFFFFULL;
+}
+
+uint32 TCGS_Inventory_Size(uint32 capacity, uint32 level0Size)
+{
+	TCGS_InventoryHeader_t layout;
+
+	return TCGS_Inventory_Layout(&layout, capacity, level0Size) ? layout.size : 0;
+}
+
+TCGS_Error_t TCGS_Inventory_Init(TCGS_Inventory_t *inventory, void *buffer, uint32 size,
+		uint32 capacity, uint32 level0Size)
+{
+	TCGS_InventoryHeader_t layout;
+
+	if (!TCGS_Inventory_Layout(&layout, capacity, level0Size) || size < layout.size ||
+		((uintptr_t)buffer & (sizeof(uint64) - 1)) != 0)
+	{
+		return ERROR_PARAMETER;
+	}
+	memset(buffer, 0, layout.size);
+	memcpy(buffer, &layout, sizeof(layout));
+	inventory->header = buffer;
+	inventory->size = layout.size;
+	inventory->mapped = FALSE;
+	return ERROR_SUCCESS;
+}
+
+/*
+ * Returns position of device ID in the index, or where it is to be inserted
+ */
+static uint32 TCGS_Inventory_Search(const TCGS_Inventory_t *inventory, uint64 deviceId)
+{
+	const TCGS_InventoryIndexEntry_t *index = _index(inventory);
+	uint32 low = 0;
+	uint32 high = inventory->header->count;
+	uint32 middle;
+
+	while (low < high)
+	{
+		middle = low + (high - low) / 2;
+		if (index[middle].deviceId < deviceId)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+static void TCGS_Inventory_Decode(TCGS_InventoryRecord_t *record, const void *level0, uint32 length)
+{
+	uint32 buffer[TCGS_BLOCK_SIZE / sizeof(uint32)];
+	TCGS_Level0Discovery_Header_t *header;
+	TCGS_Level0Discovery_FeatureTper_t *tper;
+	TCGS_Level0Discovery_FeatureLocking_t *locking;
+	TCGS_Level0Discovery_FeatureGeometry_t *geometry;
+	TCGS_Level0Discovery_FeatureOpal1_t *opal1;
+	TCGS_Level0Discovery_FeatureOpal2_t *opal2;
+	uint32 limit;
+
+	//response is decoded in place, the copy in snapshot stays raw
+	memset(buffer, 0, sizeof(buffer));
+	memcpy(buffer, level0, length);
+	//features are looked up within the response only
+	limit = (length > sizeof(uint32)) ? length - sizeof(uint32) : 0;
+	if (_getBE32((uint8*)buffer) > limit)
+	{
+		_putBE32((uint8*)buffer, limit);
+	}
+	header = TCGS_DecodeLevel0DiscoveryQuiet(buffer);
+	record->flags |= 1 << INVENTORY_FLAG_RESPONDING;
+	record->versionMajor = header->versionMajor;
+	record->versionMinor = header->versionMinor;
+
+	tper = TCGS_GetLevel0DiscoveryFeatureTperHeader(header);
+	if (tper != NULL)
+	{
+		record->flags |= 1 << INVENTORY_FLAG_TPER;
+		record->flags |= tper->comIdManagementSupported << INVENTORY_FLAG_COMID_MANAGEMENT;
+	}
+	locking = TCGS_GetLevel0DiscoveryFeatureLockingHeader(header);
+	if (locking != NULL)
+	{
+		record->flags |= locking->lockingSupport << INVENTORY_FLAG_LOCKING_SUPPORTED;
+		record->flags |= locking->lockingEnabled << INVENTORY_FLAG_LOCKING_ENABLED;
+		record->flags |= locking->locked << INVENTORY_FLAG_LOCKED;
+		record->flags |= locking->mediaEncryption << INVENTORY_FLAG_MEDIA_ENCRYPTION;
+		record->flags |= locking->MBREnabled << INVENTORY_FLAG_MBR_ENABLED;
+		record->flags |= locking->MBRDone << INVENTORY_FLAG_MBR_DONE;
+	}
+	geometry = TCGS_GetLevel0DiscoveryFeatureGeometryHeader(header);
+	if (geometry != NULL)
+	{
+		record->flags |= 1 << INVENTORY_FLAG_GEOMETRY;
+		record->logicalBlockSize = geometry->LogicalBlockSize;
+		record->alignmentGranularity = geometry->AlignmentGranularity;
+		record->lowestAlignedLBA = geometry->LowestAlignedLBA;
+	}
+	if (TCGS_GetLevel0DiscoveryFeatureEnterpriseHeader(header) != NULL)
+	{
+		record->flags |= 1 << INVENTORY_FLAG_ENTERPRISE;
+	}
+	opal1 = TCGS_GetLevel0DiscoveryFeatureOpal1Header(header);
+	if (opal1 != NULL)
+	{
+		record->flags |= 1 << INVENTORY_FLAG_OPAL1;
+		record->baseComId = opal1->baseComID;
+		record->numberOfComIds = opal1->numberOfComIDs;
+	}
+	opal2 = TCGS_GetLevel0DiscoveryFeatureOpal2Header(header);
+	if (opal2 != NULL)
+	{
+		record->flags |= 1 << INVENTORY_FLAG_OPAL2;
+		record->baseComId = opal2->baseComID;
+		record->numberOfComIds = opal2->numberOfComIDs;
+		record->numberOfAdmins = opal2->numberOfAdminsSupported;
+		record->numberOfUsers = opal2->numberOfUsersSupported;
+	}
+}
+
+TCGS_Error_t TCGS_Inventory_Add(TCGS_Inventory_t *inventory, uint64 deviceId,
+		const void *level0, uint32 length)
+{
+	TCGS_InventoryHeader_t *header = inventory->header;
+	TCGS_InventoryIndexEntry_t *index = _index(inventory);
+	TCGS_InventoryRecord_t *record;
+	uint32 row = header->count;
+	uint32 position;
+	uint32 flag;
+
+	if (level0 == NULL)
+	{
+		length = 0;
+	}
+	position = TCGS_Inventory_Search(inventory, deviceId);
+	if (row == header->capacity || length > TCGS_BLOCK_SIZE ||
+		length > header->level0Size - header->level0Used ||
+		(position < row && index[position].deviceId == deviceId))
+	{
+		return ERROR_PARAMETER;
+	}
+
+	record = &_records(inventory)[row];
+	memset(record, 0, sizeof(*record));
+	record->deviceId = deviceId;
+	if (length > 0)
+	{
+		record->level0Offset = header->level0Offset + header->level0Used;
+		record->level0Length = length;
+		memcpy(_base(inventory) + record->level0Offset, level0, length);
+		header->level0Used += length;
+		TCGS_Inventory_Decode(record, level0, length);
+	}
+	for (flag = 0; flag < INVENTORY_FLAG_COUNT; flag++)
+	{
+		if (record->flags & (1 << flag))
+		{
+			_column(inventory, flag)[row / 64] |= 1ULL << (row % 64);
+		}
+	}
+
+	memmove(&index[position + 1], &index[position], (row - position) * sizeof(*index));
+	index[position].deviceId = deviceId;
+	index[position].row = row;
+	index[position].reserved = 0;
+	header->count++;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Inventory_Discover(TCGS_Inventory_t *inventory, TCGS_Device_t *device,
+		uint64 deviceId)
+{
+	uint32 buffer[TCGS_BLOCK_SIZE / sizeof(uint32)];
+	TCGS_CommandBlock_t commandBlock;
+	TCGS_InterfaceError_t errorInterface;
+	TCGS_Error_t error;
+	uint32 length;
+
+	TCGS_PrepareInterfaceCommand(LEVEL0_DISCOVERY, NULL, &commandBlock, NULL);
+	if (TCGS_Device_SendCommand(device, &commandBlock, NULL, &errorInterface, buffer) != ERROR_SUCCESS ||
+		errorInterface != INTERFACE_ERROR_GOOD)
+	{
+		error = TCGS_Inventory_Add(inventory, deviceId, NULL, 0);
+		return (error == ERROR_SUCCESS) ? ERROR_INTERFACE : error;
+	}
+	//length of parameter data doesn't include the length field
+	length = _getBE32((uint8*)buffer) + sizeof(uint32);
+	if (length > sizeof(buffer))
+	{
+		length = sizeof(buffer);
+	}
+	return TCGS_Inventory_Add(inventory, deviceId, buffer, length);
+}
+
+TCGS_Error_t TCGS_Inventory_Save(TCGS_Inventory_t *inventory, const char *path)
+{
+	char temporary[TCGS_BLOCK_SIZE];
+	const uint8 *data = _base(inventory);
+	uint32 left = inventory->size;
+	ssize_t written;
+	int fd;
+
+	if (snprintf(temporary, sizeof(temporary), "%s.%d", path, (int)getpid()) >= (int)sizeof(temporary))
+	{
+		return ERROR_INTERFACE;
+	}
+	inventory->header->created = (uint64)time(NULL);
+	fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		return ERROR_INTERFACE;
+	}
+	while (left > 0)
+	{
+		written = write(fd, data, left);
+		if (written <= 0)
+		{
+			break;
+		}
+		data += written;
+		left -= (uint32)written;
+	}
+	//readers see either the old or the complete new file
+	if (left > 0 || fsync(fd) != 0 || close(fd) != 0 || rename(temporary, path) != 0)
+	{
+		if (left > 0)
+		{
+			close(fd);
+		}
+		unlink(temporary);
+		return ERROR_INTERFACE;
+	}
+	return ERROR_SUCCESS;
+}
+
+/*
+ * Checks that sections of mapped snapshot are within the file
+ */
+static bool TCGS_Inventory_Validate(const TCGS_InventoryHeader_t *header, uint64 size)
+{
+	TCGS_InventoryHeader_t layout;
+
+	if (size < sizeof(*header) || header->magic != TCGS_INVENTORY_MAGIC ||
+		header->version != TCGS_INVENTORY_VERSION || header->headerSize != sizeof(*header) ||
+		header->size != size || header->count > header->capacity ||
+		header->level0Used > header->level0Size ||
+		!TCGS_Inventory_Layout(&layout, header->capacity, header->level0Size))
+	{
+		return FALSE;
+	}
+	return layout.size == header->size && layout.flagWords == header->flagWords &&
+		layout.flagsOffset == header->flagsOffset && layout.recordsOffset == header->recordsOffset &&
+		layout.indexOffset == header->indexOffset && layout.level0Offset == header->level0Offset;
+}
+
+TCGS_Error_t TCGS_Inventory_Map(TCGS_Inventory_t *inventory, const char *path)
+{
+	struct stat status;
+	void *data;
+	int fd;
+
+	memset(inventory, 0, sizeof(*inventory));
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return ERROR_INTERFACE;
+	}
+	if (fstat(fd, &status) != 0)
+	{
+		close(fd);
+		return ERROR_INTERFACE;
+	}
+	if (status.st_size < (off_t)sizeof(TCGS_InventoryHeader_t) || status.st_size > 0xFFFFFFFFLL)
+	{
+		close(fd);
+		return ERROR_PARSER;
+	}
+	data = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	//mapping stays valid after the file is closed
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		return ERROR_INTERFACE;
+	}
+	if (!TCGS_Inventory_Validate(data, status.st_size))
+	{
+		munmap(data, status.st_size);
+		return ERROR_PARSER;
+	}
+	inventory->header = data;
+	inventory->size = (uint32)status.st_size;
+	inventory->mapped = TRUE;
+	return ERROR_SUCCESS;
+}
+
+void TCGS_Inventory_Unmap(TCGS_Inventory_t *inventory)
+{
+	if (inventory->mapped)
+	{
+		munmap(inventory->header, inventory->size);
+	}
+	inventory->header = NULL;
+	inventory->size = 0;
+	inventory->mapped = FALSE;
+}
+
+const TCGS_InventoryRecord_t *TCGS_Inventory_Find(const TCGS_Inventory_t *inventory, uint64 deviceId)
+{
+	const TCGS_InventoryIndexEntry_t *index = _index(inventory);
+	uint32 position = TCGS_Inventory_Search(inventory, deviceId);
+
+	if (position == inventory->header->count || index[position].deviceId != deviceId)
+	{
+		return NULL;
+	}
+	return TCGS_Inventory_GetRecord(inventory, index[position].row);
+}
+
+const TCGS_InventoryRecord_t *TCGS_Inventory_GetRecord(const TCGS_Inventory_t *inventory, uint32 row)
+{
+	if (row >= inventory->header->count)
+	{
+		return NULL;
+	}
+	return &_records(inventory)[row];
+}
+
+const uint8 *TCGS_Inventory_GetLevel0(const TCGS_Inventory_t *inventory,
+		const TCGS_InventoryRecord_t *record, uint32 *length)
+{
+	const TCGS_InventoryHeader_t *header = inventory->header;
+
+	*length = 0;
+	//offsets of records of mapped file are not trusted
+	if (record->level0Length == 0 || record->level0Offset < header->level0Offset ||
+		(uint64)record->level0Offset + record->level0Length > (uint64)header->level0Offset + header->level0Used)
+	{
+		return NULL;
+	}
+	*length = record->level0Length;
+	return _base(inventory) + record->level0Offset;
+}
+
+bool TCGS_Inventory_GetFlag(const TCGS_Inventory_t *inventory, uint32 row, TCGS_InventoryFlag_t flag)
+{
+	if (row >= inventory->header->count || flag >= INVENTORY_FLAG_COUNT)
+	{
+		return FALSE;
+	}
+	return (_column(inventory, flag)[row / 64] >> (row % 64)) & 1;
+}
+
+uint32 TCGS_Inventory_CountFlag(const TCGS_Inventory_t *inventory, TCGS_InventoryFlag_t flag)
+{
+	const uint64 *column;
+	uint32 words = (inventory->header->count + 63) / 64;
+	uint32 count = 0;
+	uint32 i;
+
+	if (flag >= INVENTORY_FLAG_COUNT)
+	{
+		return 0;
+	}
+	//bits of rows not added are clear
+	column = _column(inventory, flag);
+	for (i = 0; i < words; i++)
+	{
+		count += __builtin_popcountll(column[i]);
+	}
+	return count;
+}
+
+uint32 TCGS_Inventory_NextWithFlag(const TCGS_Inventory_t *inventory, TCGS_InventoryFlag_t flag,
+		uint32 row)
+{
+	const uint64 *column;
+	uint32 count = inventory->header->count;
+	uint64 word;
+
+	if (flag >= INVENTORY_FLAG_COUNT || row >= count)
+	{
+		return count;
+	}
+	column = _column(inventory, flag);
+	word = column[row / 64] & (~0ULL << (row % 64));
+	row -= row % 64;
+	while (word == 0)
+	{
+		row += 64;
+		if (row >= count)
+		{
+			return count;
+		}
+		word = column[row / 64];
+	}
+	row += __builtin_ctzll(word);
+	return (row < count) ? row : count;
+}
@@ -0,0 +1,220 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_inventory.h
+///
+/// Snapshot of Level 0 Discovery state of a fleet mappable by other processes
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_INVENTORY_H
+#define _TCGS_INVENTORY_H
+
+#include <stdbool.h>
+
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+
+#define TCGS_INVENTORY_MAGIC    0x49534754  //"TGSI"
+#define TCGS_INVENTORY_VERSION  1
+
+//flags of device, every flag is a bit column of the snapshot
+typedef enum
+{
+	INVENTORY_FLAG_RESPONDING,          //Level 0 Discovery succeeded
+	INVENTORY_FLAG_TPER,
+	INVENTORY_FLAG_COMID_MANAGEMENT,
+	INVENTORY_FLAG_LOCKING_SUPPORTED,
+	INVENTORY_FLAG_LOCKING_ENABLED,
+	INVENTORY_FLAG_LOCKED,
+	INVENTORY_FLAG_MEDIA_ENCRYPTION,
+	INVENTORY_FLAG_MBR_ENABLED,
+	INVENTORY_FLAG_MBR_DONE,
+	INVENTORY_FLAG_GEOMETRY,
+	INVENTORY_FLAG_ENTERPRISE,
+	INVENTORY_FLAG_OPAL1,
+	INVENTORY_FLAG_OPAL2,
+	INVENTORY_FLAG_COUNT
+} TCGS_InventoryFlag_t;
+
+//start of snapshot, offsets are from the start
+typedef struct
+{
+	uint32  magic;
+	uint16  version;
+	uint16  headerSize;
+	uint32  size;           //bytes of snapshot
+	uint32  capacity;       //records the snapshot has room for
+	uint32  count;          //records added
+	uint32  flagWords;      //64-bit words of every flag column
+	uint32  flagsOffset;    //INVENTORY_FLAG_COUNT columns of flags
+	uint32  recordsOffset;  //records in order of adding, the row of device
+	uint32  indexOffset;    //index entries sorted by device ID
+	uint32  level0Offset;   //raw Level 0 Discovery responses
+	uint32  level0Size;
+	uint32  level0Used;
+	uint64  created;        //seconds since the Epoch
+	uint8   reserved[8];
+} TCGS_InventoryHeader_t;
+
+//decoded state of device
+typedef struct
+{
+	uint64  deviceId;
+	uint64  alignmentGranularity;
+	uint64  lowestAlignedLBA;
+	uint32  logicalBlockSize;
+	uint32  flags;          //bits of TCGS_InventoryFlag_t, the same as in columns
+	uint32  level0Offset;   //raw response, offset from the start of snapshot
+	uint32  level0Length;   //0 if the device didn't respond
+	uint16  versionMajor;
+	uint16  versionMinor;
+	uint16  baseComId;
+	uint16  numberOfComIds;
+	uint16  numberOfAdmins;
+	uint16  numberOfUsers;
+	uint8   reserved[12];
+} TCGS_InventoryRecord_t;
+
+typedef struct
+{
+	uint64  deviceId;
+	uint32  row;
+	uint32  reserved;
+} TCGS_InventoryIndexEntry_t;
+
+/*****************************************************************************
+ * \brief Snapshot of Level 0 Discovery state of many devices
+ *
+ * \par The snapshot is one block with fixed layout in host byte order, so
+ * reporting tools map the file and query it without parsing. Hot flags are
+ * kept both in records and in bit columns, counting and listing devices by
+ * a flag scans one column. Devices are found by binary search of the index.
+ *
+ * \par The snapshot is built in a buffer of caller and saved to a new file
+ * that replaces the old one, processes that mapped the old file keep
+ * reading it.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_InventoryHeader_t  *header;
+	uint32                   size;
+	bool                     mapped;    //the snapshot is mapped file
+} TCGS_Inventory_t;
+
+/*****************************************************************************
+ * \brief Returns size of snapshot
+ *
+ * @param[in]  capacity     number of devices
+ * @param[in]  level0Size   bytes of all raw Level 0 Discovery responses
+ *
+ * \return size of buffer, 0 if the snapshot exceeds 4 GB
+ *****************************************************************************/
+uint32 TCGS_Inventory_Size(uint32 capacity, uint32 level0Size);
+
+/*****************************************************************************
+ * \brief Initializes empty snapshot in buffer of caller
+ *
+ * @param[out] inventory    inventory
+ * @param[out] buffer       buffer aligned to 8 bytes
+ * @param[in]  size         size of the buffer, see TCGS_Inventory_Size
+ * @param[in]  capacity     number of devices
+ * @param[in]  level0Size   bytes of all raw Level 0 Discovery responses
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if the buffer is too small or not
+ * aligned
+ *****************************************************************************/
+TCGS_Error_t TCGS_Inventory_Init(TCGS_Inventory_t *inventory, void *buffer, uint32 size,
+		uint32 capacity, uint32 level0Size);
+
+/*****************************************************************************
+ * \brief Adds raw Level 0 Discovery response of device to snapshot
+ *
+ * \par The response is copied as is, its copy is decoded to the record and
+ * the flag columns.
+ *
+ * @param[in]  inventory    inventory
+ * @param[in]  deviceId     ID of device unique within the snapshot
+ * @param[in]  level0       raw response, NULL if the device didn't respond
+ * @param[in]  length       length of the response, up to TCGS_BLOCK_SIZE
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if the snapshot is full or the
+ * device is already added
+ *****************************************************************************/
+TCGS_Error_t TCGS_Inventory_Add(TCGS_Inventory_t *inventory, uint64 deviceId,
+		const void *level0, uint32 length);
+
+/*****************************************************************************
+ * \brief Reads Level 0 Discovery of device and adds it to snapshot
+ *
+ * \par Device that fails Level 0 Discovery is added without
+ * INVENTORY_FLAG_RESPONDING.
+ *
+ * \return ERROR_SUCCESS, ERROR_INTERFACE if Level 0 Discovery failed, errors
+ * of TCGS_Inventory_Add
+ *****************************************************************************/
+TCGS_Error_t TCGS_Inventory_Discover(TCGS_Inventory_t *inventory, TCGS_Device_t *device,
+		uint64 deviceId);
+
+/*****************************************************************************
+ * \brief Writes snapshot to new file replacing the file at path
+ *
+ * \return ERROR_SUCCESS, ERROR_INTERFACE if the file is not written
+ *****************************************************************************/
+TCGS_Error_t TCGS_Inventory_Save(TCGS_Inventory_t *inventory, const char *path);
+
+/*****************************************************************************
+ * \brief Maps snapshot file read-only
+ *
+ * @param[out] inventory    inventory
+ * @param[in]  path         path of the file
+ *
+ * \return ERROR_SUCCESS, ERROR_INTERFACE if the file can't be mapped,
+ * ERROR_PARSER if the file is not a snapshot of this version
+ *
+ * \see TCGS_Inventory_Unmap
+ *****************************************************************************/
+TCGS_Error_t TCGS_Inventory_Map(TCGS_Inventory_t *inventory, const char *path);
+
+void TCGS_Inventory_Unmap(TCGS_Inventory_t *inventory);
+
+/*****************************************************************************
+ * \brief Finds record of device
+ *
+ * \return record, NULL if the device is not in the snapshot
+ *****************************************************************************/
+const TCGS_InventoryRecord_t *TCGS_Inventory_Find(const TCGS_Inventory_t *inventory, uint64 deviceId);
+
+const TCGS_InventoryRecord_t *TCGS_Inventory_GetRecord(const TCGS_Inventory_t *inventory, uint32 row);
+
+/*****************************************************************************
+ * \brief Returns raw Level 0 Discovery response of device
+ *
+ * @param[in]  inventory    inventory
+ * @param[in]  record       record of device
+ * @param[out] length       length of the response
+ *
+ * \return response, NULL if the device didn't respond
+ *****************************************************************************/
+const uint8 *TCGS_Inventory_GetLevel0(const TCGS_Inventory_t *inventory,
+		const TCGS_InventoryRecord_t *record, uint32 *length);
+
+bool TCGS_Inventory_GetFlag(const TCGS_Inventory_t *inventory, uint32 row, TCGS_InventoryFlag_t flag);
+
+/*****************************************************************************
+ * \brief Counts devices with flag set
+ *****************************************************************************/
+uint32 TCGS_Inventory_CountFlag(const TCGS_Inventory_t *inventory, TCGS_InventoryFlag_t flag);
+
+/*****************************************************************************
+ * \brief Finds the next device with flag set
+ *
+ * @param[in]  inventory    inventory
+ * @param[in]  flag         flag
+ * @param[in]  row          row the search starts from
+ *
+ * \return row of device, number of devices if there is no more devices
+ *****************************************************************************/
+uint32 TCGS_Inventory_NextWithFlag(const TCGS_Inventory_t *inventory, TCGS_InventoryFlag_t flag,
+		uint32 row);
+
+#endif //_TCGS_INVENTORY_H
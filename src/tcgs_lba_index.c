@@ -0,0 +1,314 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_lba_index.c
+///
+/// Index of locking ranges by LBA
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+#include "tcgs_table_iterator.h"
+#include "tcgs_uid.h"
+#include "tcgs_lba_index.h"
+
+#define TCGS_LBA_INDEX_NO_OWNER 0xFF
+
+#define _uidEqual(a, b) (memcmp((a), (b), sizeof(TCGS_UID_t)) == 0)
+
+//last LBA of range plus one, saturated at the end of LBA space
+static uint64 TCGS_LBAIndex_End(const TCGS_LBARange_t *range)
+{
+	return (range->start + range->length < range->start) ? ~0ULL : range->start + range->length;
+}
+
+static void TCGS_LBAIndex_AddSegment(TCGS_LBAIndex_t *index, uint64 start, uint8 owner)
+{
+	index->starts[index->segmentCount] = start;
+	index->owners[index->segmentCount] = owner;
+	index->locks[index->segmentCount] = (owner == TCGS_LBA_INDEX_NO_OWNER) ? 0 : index->ranges[owner].locks;
+	index->segmentCount++;
+}
+
+/*
+ * Splits LBA space into segments of ranges sorted by start, the gaps
+ * between them belong to Global Range
+ */
+static void TCGS_LBAIndex_Build(TCGS_LBAIndex_t *index)
+{
+	uint8 sorted[TCGS_LBA_INDEX_RANGES];
+	uint8 global = TCGS_LBA_INDEX_NO_OWNER;
+	uint32 i, j, count = 0;
+	uint64 cursor = 0;
+
+	for (i = 0; i < index->rangeCount; i++)
+	{
+		if (index->ranges[i].global)
+		{
+			global = i;
+			continue;
+		}
+		if (index->ranges[i].length == 0)
+		{
+			continue;
+		}
+		for (j = count; j > 0 && index->ranges[sorted[j - 1]].start > index->ranges[i].start; j--)
+		{
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = i;
+		count++;
+	}
+
+	index->segmentCount = 0;
+	for (i = 0; i < count; i++)
+	{
+		if (index->ranges[sorted[i]].start > cursor)
+		{
+			TCGS_LBAIndex_AddSegment(index, cursor, global);
+		}
+		TCGS_LBAIndex_AddSegment(index, index->ranges[sorted[i]].start, sorted[i]);
+		cursor = TCGS_LBAIndex_End(&index->ranges[sorted[i]]);
+	}
+	if (index->segmentCount == 0 || cursor != ~0ULL)
+	{
+		TCGS_LBAIndex_AddSegment(index, cursor, global);
+	}
+}
+
+void TCGS_LBAIndex_Init(TCGS_LBAIndex_t *index)
+{
+	memset(index, 0, sizeof(*index));
+	TCGS_LBAIndex_Build(index);
+}
+
+bool TCGS_LBAIndex_SetGeometry(TCGS_LBAIndex_t *index, TCGS_Level0Discovery_Header_t *header)
+{
+	TCGS_Level0Discovery_FeatureGeometry_t *geometry = TCGS_GetLevel0DiscoveryFeatureGeometryHeader(header);
+
+	if (geometry == NULL)
+	{
+		return FALSE;
+	}
+	index->logicalBlockSize = geometry->LogicalBlockSize;
+	index->alignmentGranularity = geometry->AlignmentGranularity;
+	index->lowestAlignedLBA = geometry->LowestAlignedLBA;
+	return TRUE;
+}
+
+TCGS_Error_t TCGS_LBAIndex_SetRange(TCGS_LBAIndex_t *index, const TCGS_UID_t *object,
+		uint64 start, uint64 length, uint8 locks)
+{
+	TCGS_LBARange_t *range = NULL;
+	bool global = _uidEqual(object, &TCGS_UID_Locking_GlobalRange);
+	uint32 i;
+
+	for (i = 0; i < index->rangeCount; i++)
+	{
+		if (_uidEqual(&index->ranges[i].object, object))
+		{
+			range = &index->ranges[i];
+		}
+		else if (!global && !index->ranges[i].global && length > 0 && index->ranges[i].length > 0 &&
+				start < TCGS_LBAIndex_End(&index->ranges[i]) &&
+				index->ranges[i].start < start + length)
+		{
+			return ERROR_PARAMETER;
+		}
+	}
+
+	if (range != NULL && (global || (range->start == start && range->length == length)))
+	{
+		//only lock state is changed, segments stay the same
+		range->locks = locks;
+		for (i = 0; i < index->segmentCount; i++)
+		{
+			if (index->owners[i] == range - index->ranges)
+			{
+				index->locks[i] = locks;
+			}
+		}
+		return ERROR_SUCCESS;
+	}
+	if (range == NULL)
+	{
+		if (index->rangeCount == TCGS_LBA_INDEX_RANGES)
+		{
+			return ERROR_PARAMETER;
+		}
+		range = &index->ranges[index->rangeCount++];
+		range->object = *object;
+		range->global = global;
+	}
+	range->start = global ? 0 : start;
+	range->length = global ? 0 : length;
+	range->locks = locks;
+	TCGS_LBAIndex_Build(index);
+	return ERROR_SUCCESS;
+}
+
+static uint64 TCGS_LBAIndex_GetColumn(TCGS_Parser_t *results, uint32 column)
+{
+	TCGS_Token_t token;
+
+	return TCGS_Parser_FindNamedValue(results, column, &token) ? token.value : 0;
+}
+
+/*
+ * Reads range and lock state of Locking table row
+ */
+static TCGS_Error_t TCGS_LBAIndex_Read(TCGS_Session_t *session, const TCGS_UID_t *object,
+		uint64 *start, uint64 *length, uint8 *locks)
+{
+	TCGS_Parser_t results;
+	TCGS_Error_t error;
+
+	error = TCGS_Get(session, object, TCGS_COLUMN_LOCKING_RANGE_START,
+			TCGS_COLUMN_LOCKING_WRITE_LOCKED, &results, NULL);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	*start = TCGS_LBAIndex_GetColumn(&results, TCGS_COLUMN_LOCKING_RANGE_START);
+	*length = TCGS_LBAIndex_GetColumn(&results, TCGS_COLUMN_LOCKING_RANGE_LENGTH);
+	*locks = 0;
+	if (TCGS_LBAIndex_GetColumn(&results, TCGS_COLUMN_LOCKING_READ_LOCK_ENABLED) &&
+		TCGS_LBAIndex_GetColumn(&results, TCGS_COLUMN_LOCKING_READ_LOCKED))
+	{
+		*locks |= TCGS_LBA_READ_LOCKED;
+	}
+	if (TCGS_LBAIndex_GetColumn(&results, TCGS_COLUMN_LOCKING_WRITE_LOCK_ENABLED) &&
+		TCGS_LBAIndex_GetColumn(&results, TCGS_COLUMN_LOCKING_WRITE_LOCKED))
+	{
+		*locks |= TCGS_LBA_WRITE_LOCKED;
+	}
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_LBAIndex_Load(TCGS_LBAIndex_t *index, TCGS_Session_t *session)
+{
+	TCGS_TableIterator_t iterator;
+	TCGS_UID_t objects[TCGS_LBA_INDEX_RANGES];
+	const TCGS_UID_t *row;
+	TCGS_LBARange_t *range;
+	TCGS_Error_t error;
+	uint32 i, count = 0;
+
+	error = TCGS_TableIterator_Start(&iterator, session, &TCGS_UID_Table_Locking, 0);
+	while (error == ERROR_SUCCESS && TCGS_TableIterator_Next(&iterator, &row))
+	{
+		if (count == TCGS_LBA_INDEX_RANGES)
+		{
+			error = ERROR_PARAMETER;
+			break;
+		}
+		objects[count++] = *row;
+	}
+	if (error == ERROR_SUCCESS)
+	{
+		error = TCGS_TableIterator_End(&iterator);
+	}
+	else
+	{
+		TCGS_TableIterator_End(&iterator);
+	}
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+
+	index->rangeCount = 0;
+	for (i = 0; i < count; i++)
+	{
+		range = &index->ranges[index->rangeCount++];
+		range->object = objects[i];
+		range->global = _uidEqual(&objects[i], &TCGS_UID_Locking_GlobalRange);
+		error = TCGS_LBAIndex_Read(session, &objects[i], &range->start, &range->length, &range->locks);
+		if (error != ERROR_SUCCESS)
+		{
+			break;
+		}
+		if (range->global)
+		{
+			range->start = 0;
+			range->length = 0;
+		}
+	}
+	if (error != ERROR_SUCCESS)
+	{
+		index->rangeCount = 0;
+	}
+	TCGS_LBAIndex_Build(index);
+	return error;
+}
+
+TCGS_Error_t TCGS_LBAIndex_Refresh(TCGS_LBAIndex_t *index, TCGS_Session_t *session,
+		const TCGS_UID_t *object)
+{
+	TCGS_Error_t error;
+	uint64 start, length;
+	uint8 locks;
+
+	error = TCGS_LBAIndex_Read(session, object, &start, &length, &locks);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	return TCGS_LBAIndex_SetRange(index, object, start, length, locks);
+}
+
+/*
+ * Returns the last segment that starts at or before LBA. The step is
+ * selected by comparison, so compiler emits conditional move instead of
+ * branch and the loop runs the same number of iterations for every LBA
+ */
+static uint32 TCGS_LBAIndex_Find(const TCGS_LBAIndex_t *index, uint64 lba)
+{
+	const uint64 *base = index->starts;
+	uint32 half, count = index->segmentCount;
+
+	while (count > 1)
+	{
+		half = count / 2;
+		base = (base[half] <= lba) ? base + half : base;
+		count -= half;
+	}
+	return base - index->starts;
+}
+
+uint8 TCGS_LBAIndex_Lookup(const TCGS_LBAIndex_t *index, uint64 lba)
+{
+	return index->locks[TCGS_LBAIndex_Find(index, lba)];
+}
+
+uint8 TCGS_LBAIndex_LookupExtent(const TCGS_LBAIndex_t *index, uint64 lba, uint64 count)
+{
+	uint64 end = (lba + count < lba) ? ~0ULL : lba + count;
+	uint32 i;
+	uint8 locks = 0;
+
+	if (count == 0)
+	{
+		return 0;
+	}
+	i = TCGS_LBAIndex_Find(index, lba);
+	do
+	{
+		locks |= index->locks[i++];
+	} while (i < index->segmentCount && index->starts[i] < end);
+	return locks;
+}
+
+bool TCGS_LBAIndex_IsAligned(const TCGS_LBAIndex_t *index, uint64 lba)
+{
+	if (index->alignmentGranularity == 0)
+	{
+		return TRUE;
+	}
+	return lba % index->alignmentGranularity == index->lowestAlignedLBA % index->alignmentGranularity;
+}
@@ -0,0 +1,145 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_lba_index.h
+///
+/// Index of locking ranges by LBA
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_LBA_INDEX_H
+#define _TCGS_LBA_INDEX_H
+
+#include <stdbool.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_session.h"
+
+//lock state of LBA
+#define TCGS_LBA_READ_LOCKED   0x01
+#define TCGS_LBA_WRITE_LOCKED  0x02
+
+//segments of LBA space: ranges and gaps between them
+#define TCGS_LBA_INDEX_SEGMENTS (2 * TCGS_LBA_INDEX_RANGES + 1)
+
+typedef struct
+{
+	TCGS_UID_t  object;         //row of Locking table
+	uint64      start;
+	uint64      length;         //0 for range that covers no LBA
+	uint8       locks;          //TCGS_LBA_READ_LOCKED, TCGS_LBA_WRITE_LOCKED
+	bool        global;         //Global Range covers LBAs outside of other ranges
+} TCGS_LBARange_t;
+
+/*****************************************************************************
+ * \brief Index of locking ranges by LBA
+ *
+ * \par LBA space is split into segments of contiguous LBAs that belong to
+ * the same range. Starts of segments are kept in a sorted array, so the
+ * segment of an LBA is found by binary search without branches. Change
+ * of lock state only updates the segments of the range, while change of
+ * RangeStart or RangeLength rebuilds the segments.
+ *
+ * \par The index also keeps Geometry feature of Level 0 Discovery to check
+ * alignment of ranges.
+ *****************************************************************************/
+typedef struct
+{
+	uint32           rangeCount;
+	TCGS_LBARange_t  ranges[TCGS_LBA_INDEX_RANGES];
+
+	uint32           segmentCount;
+	uint64           starts[TCGS_LBA_INDEX_SEGMENTS];   //first LBA of segment, starts[0] is 0
+	uint8            locks[TCGS_LBA_INDEX_SEGMENTS];
+	uint8            owners[TCGS_LBA_INDEX_SEGMENTS];   //range of segment
+
+	//Geometry feature, alignment is not required if granularity is 0
+	uint32           logicalBlockSize;
+	uint64           alignmentGranularity;
+	uint64           lowestAlignedLBA;
+} TCGS_LBAIndex_t;
+
+/*****************************************************************************
+ * \brief Initializes empty index: all LBAs are unlocked
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_LBAIndex_Init(TCGS_LBAIndex_t *index);
+
+/*****************************************************************************
+ * \brief Takes alignment requirements from Geometry feature
+ *
+ * @param[in]  index        index
+ * @param[in]  header       decoded Level 0 Discovery response
+ *
+ * \return TRUE if Geometry feature is reported by TPer
+ *
+ * \see TCGS_DecodeLevel0Discovery
+ *****************************************************************************/
+bool TCGS_LBAIndex_SetGeometry(TCGS_LBAIndex_t *index, TCGS_Level0Discovery_Header_t *header);
+
+/*****************************************************************************
+ * \brief Adds locking range or updates it
+ *
+ * \par Ranges other than Global Range shall not overlap, as TPer guarantees.
+ *
+ * @param[in]  index        index
+ * @param[in]  object       UID of range
+ * @param[in]  start        RangeStart
+ * @param[in]  length       RangeLength
+ * @param[in]  locks        lock state of the range
+ *
+ * \return ERROR_SUCCESS if range is updated, ERROR_PARAMETER if there is no
+ * room for a new range or the range overlaps another one
+ *****************************************************************************/
+TCGS_Error_t TCGS_LBAIndex_SetRange(TCGS_LBAIndex_t *index, const TCGS_UID_t *object,
+		uint64 start, uint64 length, uint8 locks);
+
+/*****************************************************************************
+ * \brief Reads ranges of Locking table
+ *
+ * \par Rows of Locking table are enumerated and RangeStart..WriteLocked
+ * columns of every row are read. Lock state of range is ReadLocked and
+ * WriteLocked masked with ReadLockEnabled and WriteLockEnabled.
+ *
+ * @param[in]  index        index
+ * @param[in]  session      open session to Locking SP
+ *
+ * \return ERROR_SUCCESS if index is loaded, error code otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_LBAIndex_Load(TCGS_LBAIndex_t *index, TCGS_Session_t *session);
+
+/*****************************************************************************
+ * \brief Reads one range again after it was changed
+ *
+ * \see TCGS_LBAIndex_Load
+ *****************************************************************************/
+TCGS_Error_t TCGS_LBAIndex_Refresh(TCGS_LBAIndex_t *index, TCGS_Session_t *session,
+		const TCGS_UID_t *object);
+
+/*****************************************************************************
+ * \brief Returns lock state of LBA
+ *
+ * \return uint8 TCGS_LBA_READ_LOCKED and TCGS_LBA_WRITE_LOCKED bits
+ *****************************************************************************/
+uint8 TCGS_LBAIndex_Lookup(const TCGS_LBAIndex_t *index, uint64 lba);
+
+/*****************************************************************************
+ * \brief Returns lock state of extent: bits of all LBAs of extent are combined
+ *
+ * @param[in]  index        index
+ * @param[in]  lba          first LBA
+ * @param[in]  count        number of LBAs
+ *
+ * \return uint8 TCGS_LBA_READ_LOCKED and TCGS_LBA_WRITE_LOCKED bits
+ *****************************************************************************/
+uint8 TCGS_LBAIndex_LookupExtent(const TCGS_LBAIndex_t *index, uint64 lba, uint64 count);
+
+/*****************************************************************************
+ * \brief Checks that LBA is aligned as Geometry feature requires
+ *
+ * \return TRUE if LBA is aligned or alignment is not required
+ *****************************************************************************/
+bool TCGS_LBAIndex_IsAligned(const TCGS_LBAIndex_t *index, uint64 lba);
+
+#endif //_TCGS_LBA_INDEX_H
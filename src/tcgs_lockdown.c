@@ -0,0 +1,318 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_lockdown.c
+///
+/// Locking of all ranges of many drives within latency budget
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <time.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+#include "tcgs_uid.h"
+#include "tcgs_time.h"
+#include "tcgs_operation.h"
+#include "libtcgstorage.h"
+#include "tcgs_lockdown.h"
+
+TCGS_Error_t TCGS_LockdownDrive_Init(TCGS_LockdownDrive_t *drive, TCGS_Device_t *device,
+		const TCGS_UID_t *authority, const void *credential, uint32 credentialLength,
+		const TCGS_UID_t *ranges, uint32 rangeCount)
+{
+	if (credentialLength > TCGS_MAX_CREDENTIAL_LENGTH || rangeCount > TCGS_LOCKDOWN_MAX_RANGES)
+	{
+		return ERROR_PARAMETER;
+	}
+	memset(drive, 0, sizeof(*drive));
+	drive->device = device;
+	drive->authority = *authority;
+	memcpy(drive->credential, credential, credentialLength);
+	drive->credentialLength = credentialLength;
+	memcpy(drive->ranges, ranges, rangeCount * sizeof(*ranges));
+	drive->rangeCount = rangeCount;
+	return ERROR_SUCCESS;
+}
+
+void TCGS_Lockdown_Init(TCGS_Lockdown_t *lockdown, TCGS_LockdownDrive_t *drives, uint32 count)
+{
+	pthread_condattr_t attributes;
+	uint32 i;
+
+	memset(lockdown, 0, sizeof(*lockdown));
+	lockdown->drives = drives;
+	lockdown->count = count;
+	pthread_mutex_init(&lockdown->lock, NULL);
+	//budget is measured with monotonic time of TCGS_GetTime
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&lockdown->fire, &attributes);
+	pthread_cond_init(&lockdown->done, &attributes);
+	pthread_condattr_destroy(&attributes);
+	for (i = 0; i < count; i++)
+	{
+		drives[i].lockdown = lockdown;
+	}
+}
+
+/*
+ * Starts session of the drive and builds ComPacket locking its ranges
+ */
+static TCGS_Error_t TCGS_Lockdown_Prepare(TCGS_LockdownDrive_t *drive)
+{
+	TCGS_Builder_t *builder;
+	TCGS_Error_t error;
+	uint32 i;
+
+	error = TCGS_StartSession(&drive->session, drive->device, &TCGS_UID_LockingSP, &drive->authority,
+			drive->credential, drive->credentialLength, TRUE, &drive->status);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	builder = TCGS_Session_StartPacket(&drive->session);
+	for (i = 0; i < drive->rangeCount; i++)
+	{
+		TCGS_Builder_AddSetUInt(builder, &drive->ranges[i], TCGS_COLUMN_LOCKING_READ_LOCKED, 1);
+		TCGS_Builder_AddSetUInt(builder, &drive->ranges[i], TCGS_COLUMN_LOCKING_WRITE_LOCKED, 1);
+	}
+	return ERROR_SUCCESS;
+}
+
+/*
+ * Sends prepared ComPacket and checks results of all Set methods
+ */
+static TCGS_Error_t TCGS_Lockdown_Lock(TCGS_LockdownDrive_t *drive)
+{
+	TCGS_Parser_t response;
+	TCGS_MethodStatus_t status;
+	TCGS_Error_t error;
+	uint32 i;
+
+	error = drive->session.open ? TCGS_Session_Exchange(&drive->session, &response) : ERROR_SESSION;
+	if (error == ERROR_SESSION)
+	{
+		//session wasn't started by arm or TPer has dropped it since, packet wasn't processed
+		drive->rearmed = TRUE;
+		error = TCGS_Lockdown_Prepare(drive);
+		if (error == ERROR_SUCCESS)
+		{
+			error = TCGS_Session_Exchange(&drive->session, &response);
+		}
+	}
+	for (i = 0; error == ERROR_SUCCESS && i < drive->rangeCount * 2; i++)
+	{
+		error = TCGS_Parser_GetResult(&response, NULL, &status);
+		if (error == ERROR_SUCCESS && status != METHOD_STATUS_SUCCESS)
+		{
+			drive->status = status;
+			error = ERROR_METHOD;
+		}
+	}
+	return error;
+}
+
+/*
+ * Checks locked bit of Locking feature reported by TPer
+ */
+static TCGS_Error_t TCGS_Lockdown_Confirm(TCGS_LockdownDrive_t *drive)
+{
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	TCGS_Level0Discovery_FeatureLocking_t *locking;
+	TCGS_Error_t error;
+
+	error = TCGS_Device_Level0DiscoveryQuiet(drive->device, buffer);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	locking = TCGS_GetLevel0DiscoveryFeatureLockingHeader((TCGS_Level0Discovery_Header_t*)buffer);
+	if (locking == NULL || !locking->locked)
+	{
+		drive->status = METHOD_STATUS_FAIL;
+		return ERROR_METHOD;
+	}
+	return ERROR_SUCCESS;
+}
+
+static void *TCGS_Lockdown_Drive(void *argument)
+{
+	TCGS_LockdownDrive_t *drive = argument;
+	TCGS_Lockdown_t *lockdown = drive->lockdown;
+	TCGS_Operation_t operation;
+	TCGS_Error_t error;
+	uint64 fireTime;
+
+	error = TCGS_Lockdown_Prepare(drive);
+	pthread_mutex_lock(&lockdown->lock);
+	drive->error = error;
+	drive->state = (error == ERROR_SUCCESS) ? LOCKDOWN_DRIVE_ARMED : LOCKDOWN_DRIVE_IDLE;
+	lockdown->settled++;
+	pthread_cond_broadcast(&lockdown->done);
+	while (!lockdown->fired && !lockdown->stop)
+	{
+		pthread_cond_wait(&lockdown->fire, &lockdown->lock);
+	}
+	if (!lockdown->fired)
+	{
+		pthread_mutex_unlock(&lockdown->lock);
+		if (drive->session.open)
+		{
+			TCGS_EndSession(&drive->session);
+		}
+		return NULL;
+	}
+	fireTime = lockdown->fireTime;
+	TCGS_Operation_Init(&operation, 0);
+	operation.deadline = lockdown->deadline;
+	drive->state = LOCKDOWN_DRIVE_FIRED;
+	pthread_mutex_unlock(&lockdown->lock);
+
+	//session interrupted by the budget is closed by the library
+	TCGS_Operation_Begin(&operation);
+	drive->status = METHOD_STATUS_SUCCESS;
+	error = TCGS_Lockdown_Lock(drive);
+	if (error == ERROR_SUCCESS)
+	{
+		error = TCGS_Lockdown_Confirm(drive);
+	}
+	TCGS_Operation_End(&operation);
+
+	pthread_mutex_lock(&lockdown->lock);
+	drive->error = error;
+	drive->latency = TCGS_GetTime() - fireTime;
+	drive->state = (error == ERROR_SUCCESS) ? LOCKDOWN_DRIVE_CONFIRMED : LOCKDOWN_DRIVE_FAILED;
+	lockdown->settled++;
+	pthread_cond_broadcast(&lockdown->done);
+	pthread_mutex_unlock(&lockdown->lock);
+
+	if (drive->session.open)
+	{
+		TCGS_EndSession(&drive->session);
+	}
+	return NULL;
+}
+
+static void TCGS_Lockdown_GetTimespec(uint64 time, struct timespec *timespec)
+{
+	timespec->tv_sec = time / TCGS_NSEC_PER_SEC;
+	timespec->tv_nsec = time % TCGS_NSEC_PER_SEC;
+}
+
+TCGS_Error_t TCGS_Lockdown_Arm(TCGS_Lockdown_t *lockdown)
+{
+	TCGS_LockdownDrive_t *drive;
+	TCGS_Error_t error = ERROR_SUCCESS;
+	uint32 i;
+
+	for (i = 0; i < lockdown->count; i++)
+	{
+		if (lockdown->drives[i].threadStarted)
+		{
+			return ERROR_PARAMETER;
+		}
+	}
+	pthread_mutex_lock(&lockdown->lock);
+	lockdown->fired = FALSE;
+	lockdown->stop = FALSE;
+	lockdown->settled = 0;
+	pthread_mutex_unlock(&lockdown->lock);
+	//drives start their sessions in parallel
+	for (i = 0; i < lockdown->count; i++)
+	{
+		drive = &lockdown->drives[i];
+		drive->state = LOCKDOWN_DRIVE_IDLE;
+		drive->error = ERROR_SUCCESS;
+		drive->status = METHOD_STATUS_SUCCESS;
+		drive->rearmed = FALSE;
+		drive->latency = 0;
+		if (pthread_create(&drive->thread, NULL, TCGS_Lockdown_Drive, drive) != 0)
+		{
+			pthread_mutex_lock(&lockdown->lock);
+			drive->error = ERROR_PARAMETER;
+			lockdown->settled++;
+			pthread_mutex_unlock(&lockdown->lock);
+			continue;
+		}
+		drive->threadStarted = TRUE;
+	}
+
+	pthread_mutex_lock(&lockdown->lock);
+	while (lockdown->settled < lockdown->count)
+	{
+		pthread_cond_wait(&lockdown->done, &lockdown->lock);
+	}
+	lockdown->settled = 0;
+	for (i = 0; i < lockdown->count && error == ERROR_SUCCESS; i++)
+	{
+		error = lockdown->drives[i].error;
+	}
+	pthread_mutex_unlock(&lockdown->lock);
+	return error;
+}
+
+TCGS_Error_t TCGS_Lockdown_Fire(TCGS_Lockdown_t *lockdown, uint64 budget, uint32 *missed)
+{
+	TCGS_LockdownDrive_t *drive;
+	TCGS_Error_t error = ERROR_SUCCESS;
+	struct timespec deadline;
+	uint32 late = 0, fired = 0, i;
+
+	pthread_mutex_lock(&lockdown->lock);
+	lockdown->fireTime = TCGS_GetTime();
+	lockdown->deadline = lockdown->fireTime + budget;
+	lockdown->fired = TRUE;
+	pthread_cond_broadcast(&lockdown->fire);
+	for (i = 0; i < lockdown->count; i++)
+	{
+		fired += lockdown->drives[i].threadStarted;
+	}
+	TCGS_Lockdown_GetTimespec(lockdown->deadline, &deadline);
+	while (lockdown->settled < fired &&
+		pthread_cond_timedwait(&lockdown->done, &lockdown->lock, &deadline) == 0)
+	{
+	}
+	for (i = 0; i < lockdown->count; i++)
+	{
+		drive = &lockdown->drives[i];
+		if (!drive->threadStarted ||
+			(drive->state == LOCKDOWN_DRIVE_FAILED && !TCGS_IsOperationError(drive->error)))
+		{
+			error = (error == ERROR_SUCCESS) ? drive->error : error;
+		}
+		else if (drive->state != LOCKDOWN_DRIVE_CONFIRMED || drive->latency > budget)
+		{
+			late++;
+		}
+	}
+	pthread_mutex_unlock(&lockdown->lock);
+	if (missed != NULL)
+	{
+		*missed = late;
+	}
+	return (late > 0) ? ERROR_TIMEOUT : error;
+}
+
+void TCGS_Lockdown_Destroy(TCGS_Lockdown_t *lockdown)
+{
+	uint32 i;
+
+	pthread_mutex_lock(&lockdown->lock);
+	lockdown->stop = TRUE;
+	pthread_cond_broadcast(&lockdown->fire);
+	pthread_mutex_unlock(&lockdown->lock);
+	for (i = 0; i < lockdown->count; i++)
+	{
+		if (lockdown->drives[i].threadStarted)
+		{
+			pthread_join(lockdown->drives[i].thread, NULL);
+			lockdown->drives[i].threadStarted = FALSE;
+		}
+	}
+}
@@ -0,0 +1,132 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_lockdown.h
+///
+/// Locking of all ranges of many drives within latency budget
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_LOCKDOWN_H
+#define _TCGS_LOCKDOWN_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_interface.h"
+#include "tcgs_session.h"
+
+typedef enum
+{
+	LOCKDOWN_DRIVE_IDLE,
+	LOCKDOWN_DRIVE_ARMED,       //session is open and ComPacket is built
+	LOCKDOWN_DRIVE_FIRED,       //ComPacket is being sent
+	LOCKDOWN_DRIVE_CONFIRMED,   //ranges are locked, Level 0 Discovery reports locked
+	LOCKDOWN_DRIVE_FAILED,
+} TCGS_LockdownDriveState_t;
+
+struct TCGS_Lockdown;
+
+/*****************************************************************************
+ * \brief Drive of lockdown
+ *
+ * \par Every drive has a thread waiting from TCGS_Lockdown_Arm till
+ * TCGS_Lockdown_Fire with session to Locking SP open and Set methods of
+ * ReadLocked and WriteLocked of its ranges built in the send buffer.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_Device_t                    *device;
+	TCGS_UID_t                        authority;
+	uint8                             credential[TCGS_MAX_CREDENTIAL_LENGTH];
+	uint32                            credentialLength;
+	TCGS_UID_t                        ranges[TCGS_LOCKDOWN_MAX_RANGES];
+	uint32                            rangeCount;
+	TCGS_Session_t                    session;
+	struct TCGS_Lockdown             *lockdown;
+	pthread_t                         thread;
+	bool                              threadStarted;
+
+	//report of the last lockdown
+	volatile TCGS_LockdownDriveState_t state;
+	TCGS_Error_t                      error;
+	TCGS_MethodStatus_t               status;     //status of failed method
+	bool                              rearmed;    //prepared session was lost, a new one was started
+	uint64                            latency;    //nanoseconds from fire to confirmation
+} TCGS_LockdownDrive_t;
+
+/*****************************************************************************
+ * \brief Lockdown of drives
+ *****************************************************************************/
+typedef struct TCGS_Lockdown
+{
+	TCGS_LockdownDrive_t  *drives;
+	uint32                 count;
+	pthread_mutex_t        lock;       //protects the fields below
+	pthread_cond_t         fire;       //signalled to drive threads by fire and destroy
+	pthread_cond_t         done;       //signalled by drive threads when a drive is settled
+	bool                   fired;
+	bool                   stop;
+	uint64                 fireTime;
+	uint64                 deadline;   //fire time plus budget
+	uint32                 settled;    //drives confirmed or failed
+} TCGS_Lockdown_t;
+
+/*****************************************************************************
+ * \brief Initializes drive of lockdown
+ *
+ * @param[out] drive            drive
+ * @param[in]  device           device, Level 0 Discovery is done
+ * @param[in]  authority        authority of Locking SP allowed to lock the ranges
+ * @param[in]  credential       credential of the authority
+ * @param[in]  credentialLength length of credential, up to TCGS_MAX_CREDENTIAL_LENGTH
+ * @param[in]  ranges           locking ranges of the drive
+ * @param[in]  rangeCount       number of ranges, up to TCGS_LOCKDOWN_MAX_RANGES
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if credential or ranges are too long
+ *****************************************************************************/
+TCGS_Error_t TCGS_LockdownDrive_Init(TCGS_LockdownDrive_t *drive, TCGS_Device_t *device,
+		const TCGS_UID_t *authority, const void *credential, uint32 credentialLength,
+		const TCGS_UID_t *ranges, uint32 rangeCount);
+
+void TCGS_Lockdown_Init(TCGS_Lockdown_t *lockdown, TCGS_LockdownDrive_t *drives, uint32 count);
+
+/*****************************************************************************
+ * \brief Prepares drives for lockdown
+ *
+ * \par Sessions of all drives are started, the ComPackets locking their
+ * ranges are built and drive threads wait for TCGS_Lockdown_Fire. Drive
+ * failed to arm is reported in its state and error, at fire it starts the
+ * session within the budget.
+ *
+ * \return ERROR_SUCCESS if all drives are armed, error of the first drive
+ * failed otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_Lockdown_Arm(TCGS_Lockdown_t *lockdown);
+
+/*****************************************************************************
+ * \brief Locks ranges of all armed drives in parallel
+ *
+ * \par Every drive sends its ComPacket and confirms locking with Level 0
+ * Discovery. Commands of drives are bounded by the budget, the call returns
+ * when every drive is confirmed or failed, or when the budget is over. State
+ * of drives that missed the budget is LOCKDOWN_DRIVE_FIRED or their error is
+ * ERROR_TIMEOUT. Sessions are closed after confirmation outside the budget.
+ *
+ * @param[in]  lockdown     armed lockdown
+ * @param[in]  budget       nanoseconds the drives shall be locked in
+ * @param[out] missed       number of drives not confirmed within budget, may be NULL
+ *
+ * \return ERROR_SUCCESS if all drives are confirmed, ERROR_TIMEOUT if a drive
+ * missed the budget, error of the first drive failed otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_Lockdown_Fire(TCGS_Lockdown_t *lockdown, uint64 budget, uint32 *missed);
+
+/*****************************************************************************
+ * \brief Closes sessions of drives that were not fired and joins drive threads
+ *
+ * \par The lockdown may be armed again after that.
+ *****************************************************************************/
+void TCGS_Lockdown_Destroy(TCGS_Lockdown_t *lockdown);
+
+#endif //_TCGS_LOCKDOWN_H
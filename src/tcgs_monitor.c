@@ -0,0 +1,210 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_monitor.c
+///
+/// Monitor of Level 0 Discovery state of many devices
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_interface.h"
+#include "tcgs_interface_encode.h"
+#include "tcgs_time.h"
+#include "tcgs_monitor.h"
+
+//default batch window is this part of the interval
+#define TCGS_MONITOR_WINDOW_FRACTION 64
+
+/*
+ * xorshift generator of jitter, 64-bit so jitter of seconds is not cut at
+ * 2^32 nanoseconds
+ */
+static uint64 TCGS_Monitor_Jitter(TCGS_Monitor_t *monitor)
+{
+	uint64 x = monitor->random;
+
+	if (monitor->jitter == 0)
+	{
+		return 0;
+	}
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	monitor->random = x;
+	return x % monitor->jitter;
+}
+
+/*
+ * FNV-1a hash of raw response
+ */
+static uint64 TCGS_Monitor_Hash(const uint8 *data, uint32 length)
+{
+	uint64 hash = 0xCBF29CE484222325ULL;
+
+	while (length-- > 0)
+	{
+		hash ^= *data++;
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+static void TCGS_Monitor_SiftDown(TCGS_Monitor_t *monitor, uint32 i)
+{
+	TCGS_MonitorEntry_t *entries = monitor->entries;
+	TCGS_MonitorEntry_t entry;
+	uint32 child;
+
+	while ((child = 2 * i + 1) < monitor->count)
+	{
+		if (child + 1 < monitor->count && entries[child + 1].nextPoll < entries[child].nextPoll)
+		{
+			child++;
+		}
+		if (entries[i].nextPoll <= entries[child].nextPoll)
+		{
+			break;
+		}
+		entry = entries[i];
+		entries[i] = entries[child];
+		entries[child] = entry;
+		i = child;
+	}
+}
+
+void TCGS_Monitor_Init(TCGS_Monitor_t *monitor, TCGS_MonitorEntry_t *entries,
+		TCGS_Device_t *devices, uint32 count, uint64 interval, uint64 jitter,
+		TCGS_MonitorCallback_t callback, void *context)
+{
+	uint64 now = TCGS_GetTime();
+	uint32 i;
+
+	memset(monitor, 0, sizeof(*monitor));
+	monitor->entries = entries;
+	monitor->count = count;
+	monitor->interval = interval;
+	monitor->jitter = jitter;
+	monitor->window = interval / TCGS_MONITOR_WINDOW_FRACTION;
+	monitor->random = now | 1;
+	monitor->callback = callback;
+	monitor->context = context;
+
+	memset(entries, 0, count * sizeof(*entries));
+	for (i = 0; i < count; i++)
+	{
+		entries[i].device = &devices[i];
+		entries[i].nextPoll = now + interval * i / count + TCGS_Monitor_Jitter(monitor);
+	}
+	for (i = count / 2; i > 0; i--)
+	{
+		TCGS_Monitor_SiftDown(monitor, i - 1);
+	}
+}
+
+static uint8 TCGS_Monitor_GetLocking(TCGS_Level0Discovery_Header_t *header)
+{
+	TCGS_Level0Discovery_FeatureLocking_t *locking = TCGS_GetLevel0DiscoveryFeatureLockingHeader(header);
+	uint8 bits = 0;
+
+	if (locking != NULL)
+	{
+		bits |= locking->lockingEnabled ? TCGS_MONITOR_LOCKING_ENABLED : 0;
+		bits |= locking->locked ? TCGS_MONITOR_LOCKED : 0;
+		bits |= locking->MBREnabled ? TCGS_MONITOR_MBR_ENABLED : 0;
+		bits |= locking->MBRDone ? TCGS_MONITOR_MBR_DONE : 0;
+	}
+	return bits;
+}
+
+/*
+ * Reads Level 0 Discovery of the device and reports it if it changed,
+ * unchanged response is not decoded
+ */
+static void TCGS_Monitor_PollEntry(TCGS_Monitor_t *monitor, TCGS_MonitorEntry_t *entry)
+{
+	uint32 buffer[TCGS_BLOCK_SIZE / sizeof(uint32)];
+	TCGS_CommandBlock_t commandBlock;
+	TCGS_InterfaceError_t errorInterface;
+	TCGS_Level0Discovery_Header_t *header;
+	uint32 length;
+	uint64 hash;
+
+	monitor->polls++;
+	TCGS_PrepareInterfaceCommand(LEVEL0_DISCOVERY, NULL, &commandBlock, NULL);
+	if (TCGS_Device_SendCommand(entry->device, &commandBlock, NULL, &errorInterface, buffer) != ERROR_SUCCESS ||
+		errorInterface != INTERFACE_ERROR_GOOD)
+	{
+		if (!entry->failed)
+		{
+			entry->failed = TRUE;
+			entry->length = 0;
+			monitor->events++;
+			monitor->callback(monitor, entry, MONITOR_EVENT_ERROR, NULL);
+		}
+		return;
+	}
+
+	//length of parameter data doesn't include the length field
+	length = _getBE32((uint8*)buffer) + sizeof(uint32);
+	if (length > sizeof(buffer))
+	{
+		length = sizeof(buffer);
+	}
+	hash = TCGS_Monitor_Hash((uint8*)buffer, length);
+	if (!entry->failed && entry->length == length && entry->hash == hash)
+	{
+		return;
+	}
+	entry->failed = FALSE;
+	entry->length = length;
+	entry->hash = hash;
+
+	header = TCGS_DecodeLevel0DiscoveryQuiet(buffer);
+	entry->previousLocking = entry->locking;
+	entry->locking = TCGS_Monitor_GetLocking(header);
+	monitor->events++;
+	monitor->callback(monitor, entry, MONITOR_EVENT_CHANGED, header);
+}
+
+uint64 TCGS_Monitor_Poll(TCGS_Monitor_t *monitor, uint64 now)
+{
+	TCGS_MonitorEntry_t *entry = monitor->entries;
+	uint32 polled;
+
+	if (monitor->count == 0)
+	{
+		return now + monitor->interval;
+	}
+	monitor->wakeups++;
+	//every device is polled at most once per wakeup
+	for (polled = 0; polled < monitor->count && entry->nextPoll <= now + monitor->window; polled++)
+	{
+		TCGS_Monitor_PollEntry(monitor, entry);
+		entry->nextPoll = now + monitor->interval + TCGS_Monitor_Jitter(monitor);
+		TCGS_Monitor_SiftDown(monitor, 0);
+	}
+	return entry->nextPoll;
+}
+
+void TCGS_Monitor_Run(TCGS_Monitor_t *monitor, volatile bool *stop)
+{
+	uint64 now, next;
+
+	while (!*stop)
+	{
+		now = TCGS_GetTime();
+		next = TCGS_Monitor_Poll(monitor, now);
+		now = TCGS_GetTime();
+		if (next > now)
+		{
+			//the stop flag is checked at least once in the interval
+			TCGS_Sleep((next - now < monitor->interval) ? next - now : monitor->interval);
+		}
+	}
+}
@@ -0,0 +1,126 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_monitor.h
+///
+/// Monitor of Level 0 Discovery state of many devices
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_MONITOR_H
+#define _TCGS_MONITOR_H
+
+#include <stdbool.h>
+
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+
+//bits of Locking feature reported in events
+#define TCGS_MONITOR_LOCKING_ENABLED  0x01
+#define TCGS_MONITOR_LOCKED           0x02
+#define TCGS_MONITOR_MBR_ENABLED      0x04
+#define TCGS_MONITOR_MBR_DONE         0x08
+
+typedef enum
+{
+	MONITOR_EVENT_CHANGED,      //the first response or response differs from the previous one
+	MONITOR_EVENT_ERROR,        //Level 0 Discovery failed, reported once until it succeeds again
+} TCGS_MonitorEvent_t;
+
+typedef struct
+{
+	TCGS_Device_t  *device;
+	void           *context;        //context of the device given by caller
+	uint64          nextPoll;       //time of the next poll in nanoseconds
+	uint64          hash;           //hash of the last response
+	uint32          length;         //length of the last response, 0 if unknown
+	bool            failed;         //the last poll failed
+	uint8           locking;        //TCGS_MONITOR_* bits of the last response
+	uint8           previousLocking;
+} TCGS_MonitorEntry_t;
+
+struct TCGS_Monitor;
+
+/*****************************************************************************
+ * \brief Receives events of monitor
+ *
+ * @param[in]  monitor      monitor
+ * @param[in]  entry        device that changed, locking and previousLocking
+ *                          contain Locking feature bits
+ * @param[in]  event        event
+ * @param[in]  header       decoded Level 0 Discovery response,
+ *                          NULL for MONITOR_EVENT_ERROR
+ *
+ * \return None
+ *****************************************************************************/
+typedef void (*TCGS_MonitorCallback_t)(struct TCGS_Monitor *monitor, TCGS_MonitorEntry_t *entry,
+		TCGS_MonitorEvent_t event, TCGS_Level0Discovery_Header_t *header);
+
+/*****************************************************************************
+ * \brief Monitor of Level 0 Discovery state of many devices
+ *
+ * \par Every device is polled once in the interval with random jitter, so
+ * polls of a fleet are spread over time instead of coming in bursts. Raw
+ * responses are only hashed: the response is decoded and reported when its
+ * hash or length differs from the previous one, so nothing is reported in
+ * steady state. Polls due within the batch window are done in one wakeup.
+ *
+ * \par Entries are kept in a heap ordered by time of the next poll, the
+ * order of entries in the array changes.
+ *****************************************************************************/
+typedef struct TCGS_Monitor
+{
+	TCGS_MonitorEntry_t     *entries;
+	uint32                   count;
+	uint64                   interval;      //nanoseconds between polls of device
+	uint64                   jitter;        //random delay added to interval
+	uint64                   window;        //polls due within the window are done at once
+	uint64                   random;        //state of jitter generator
+	TCGS_MonitorCallback_t   callback;
+	void                    *context;
+
+	//statistics
+	uint64                   polls;
+	uint64                   events;
+	uint64                   wakeups;
+} TCGS_Monitor_t;
+
+/*****************************************************************************
+ * \brief Initializes monitor of devices
+ *
+ * \par The first polls of devices are spread over the interval.
+ *
+ * @param[out] monitor      monitor
+ * @param[out] entries      array of count entries
+ * @param[in]  devices      array of count devices
+ * @param[in]  count        number of devices
+ * @param[in]  interval     nanoseconds between polls of device
+ * @param[in]  jitter       maximal random delay added to interval
+ * @param[in]  callback     receiver of events
+ * @param[in]  context      context of the callback
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Monitor_Init(TCGS_Monitor_t *monitor, TCGS_MonitorEntry_t *entries,
+		TCGS_Device_t *devices, uint32 count, uint64 interval, uint64 jitter,
+		TCGS_MonitorCallback_t callback, void *context);
+
+/*****************************************************************************
+ * \brief Polls devices that are due
+ *
+ * @param[in]  monitor      monitor
+ * @param[in]  now          current time, see TCGS_GetTime
+ *
+ * \return uint64 time of the next poll
+ *****************************************************************************/
+uint64 TCGS_Monitor_Poll(TCGS_Monitor_t *monitor, uint64 now);
+
+/*****************************************************************************
+ * \brief Polls devices until stop flag is set
+ *
+ * \par The thread sleeps between batches of polls.
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Monitor_Run(TCGS_Monitor_t *monitor, volatile bool *stop);
+
+#endif //_TCGS_MONITOR_H
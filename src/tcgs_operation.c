@@ -0,0 +1,153 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_operation.c
+///
+/// Deadlines and cancellation of operations with TPer
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_time.h"
+#include "tcgs_operation.h"
+
+//operation the thread runs
+static __thread TCGS_Operation_t *currentOperation;
+
+//xorshift state of backoff jitter, per thread so threads don't contend for it
+static __thread uint32 jitterState;
+
+void TCGS_Operation_Init(TCGS_Operation_t *operation, uint64 timeout)
+{
+	memset(operation, 0, sizeof(*operation));
+	if (timeout != 0)
+	{
+		operation->deadline = TCGS_GetTime() + timeout;
+	}
+}
+
+void TCGS_Operation_Begin(TCGS_Operation_t *operation)
+{
+	operation->parent = currentOperation;
+	operation->previous = currentOperation;
+	currentOperation = operation;
+}
+
+void TCGS_Operation_BeginCleanup(TCGS_Operation_t *operation)
+{
+	operation->parent = NULL;
+	operation->previous = currentOperation;
+	currentOperation = operation;
+}
+
+void TCGS_Operation_End(TCGS_Operation_t *operation)
+{
+	currentOperation = operation->previous;
+}
+
+void TCGS_Operation_Cancel(TCGS_Operation_t *operation)
+{
+	operation->cancelled = TRUE;
+	__sync_synchronize();
+}
+
+TCGS_Error_t TCGS_Operation_Check(void)
+{
+	TCGS_Operation_t *operation;
+	uint64 now = 0;
+
+	for (operation = currentOperation; operation != NULL; operation = operation->parent)
+	{
+		if (operation->cancelled)
+		{
+			return ERROR_CANCELLED;
+		}
+		if (operation->deadline != 0)
+		{
+			now = (now != 0) ? now : TCGS_GetTime();
+			if (now >= operation->deadline)
+			{
+				return ERROR_TIMEOUT;
+			}
+		}
+	}
+	return ERROR_SUCCESS;
+}
+
+uint64 TCGS_Operation_Remaining(void)
+{
+	TCGS_Operation_t *operation;
+	uint64 deadline = 0, now;
+
+	for (operation = currentOperation; operation != NULL; operation = operation->parent)
+	{
+		if (operation->deadline != 0 && (deadline == 0 || operation->deadline < deadline))
+		{
+			deadline = operation->deadline;
+		}
+	}
+	if (deadline == 0)
+	{
+		return TCGS_OPERATION_UNLIMITED;
+	}
+	now = TCGS_GetTime();
+	return (deadline > now) ? deadline - now : 0;
+}
+
+TCGS_Error_t TCGS_Operation_Sleep(uint64 duration)
+{
+	TCGS_Error_t error;
+	uint64 remaining, slice;
+
+	//cancellation is noticed between slices
+	while ((error = TCGS_Operation_Check()) == ERROR_SUCCESS && duration > 0)
+	{
+		remaining = TCGS_Operation_Remaining();
+		slice = TCGS_OPERATION_SLEEP_SLICE * TCGS_NSEC_PER_USEC;
+		slice = (duration < slice) ? duration : slice;
+		if (remaining < slice)
+		{
+			TCGS_Sleep(remaining);
+			return ERROR_TIMEOUT;
+		}
+		TCGS_Sleep(slice);
+		duration -= slice;
+	}
+	return error;
+}
+
+static uint64 TCGS_Operation_Random(void)
+{
+	uint32 x = (jitterState != 0) ? jitterState : ((uint32)TCGS_GetTime() | 1);
+	uint64 value;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	value = x;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	jitterState = x;
+	return (value << 32) | x;
+}
+
+TCGS_Error_t TCGS_Operation_Backoff(uint64 delay, uint64 maxDelay, uint32 attempt)
+{
+	//doubling stops at the bound, so it doesn't overflow for any attempt
+	while (attempt-- > 0 && delay < maxDelay)
+	{
+		delay = (delay > maxDelay / 2) ? maxDelay : delay << 1;
+	}
+	if (delay > maxDelay)
+	{
+		delay = maxDelay;
+	}
+	if (delay > 1)
+	{
+		delay = delay / 2 + TCGS_Operation_Random() % (delay / 2 + 1);
+	}
+	return TCGS_Operation_Sleep(delay);
+}
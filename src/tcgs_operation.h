@@ -0,0 +1,137 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_operation.h
+///
+/// Deadlines and cancellation of operations with TPer
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_OPERATION_H
+#define _TCGS_OPERATION_H
+
+#include <stdbool.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+
+//remaining time of operation without deadline
+#define TCGS_OPERATION_UNLIMITED 0xFFFFFFFFFFFFFFFFULL
+
+#define TCGS_IsOperationError(error) ((error) == ERROR_TIMEOUT || (error) == ERROR_CANCELLED)
+
+/*****************************************************************************
+ * \brief Operation of a thread with deadline and cancellation
+ *
+ * \par Interface commands, polling for responses and retries of the thread
+ * are bounded by the operation it has begun and by all operations enclosing
+ * it. Expired or cancelled operation fails commands with ERROR_TIMEOUT or
+ * ERROR_CANCELLED, session interrupted this way is closed.
+ *****************************************************************************/
+typedef struct TCGS_Operation
+{
+	uint64                  deadline;   //monotonic time the operation expires at, 0 if never
+	volatile bool           cancelled;
+	struct TCGS_Operation  *parent;     //enclosing operation, NULL for clean-up
+	struct TCGS_Operation  *previous;   //operation restored by TCGS_Operation_End
+} TCGS_Operation_t;
+
+/*****************************************************************************
+ * \brief Initializes operation
+ *
+ * @param[out] operation    operation
+ * @param[in]  timeout      nanoseconds from now the operation expires in, 0 if never
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Operation_Init(TCGS_Operation_t *operation, uint64 timeout);
+
+/*****************************************************************************
+ * \brief Makes operation the current one of the calling thread
+ *
+ * \par The operation is nested in the current one, so deadline and
+ * cancellation of the enclosing operation apply as well.
+ *
+ * @param[in]  operation    operation
+ *
+ * \return None
+ *
+ * \see TCGS_Operation_End
+ *****************************************************************************/
+void TCGS_Operation_Begin(TCGS_Operation_t *operation);
+
+/*****************************************************************************
+ * \brief Makes operation the current one regardless of enclosing operation
+ *
+ * \par Used to clean up after expired or cancelled operation, so the
+ * clean-up is bounded by its own deadline only.
+ *
+ * @param[in]  operation    operation
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Operation_BeginCleanup(TCGS_Operation_t *operation);
+
+/*****************************************************************************
+ * \brief Restores operation that was current before TCGS_Operation_Begin
+ *
+ * @param[in]  operation    current operation of the thread
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Operation_End(TCGS_Operation_t *operation);
+
+/*****************************************************************************
+ * \brief Cancels operation
+ *
+ * \par May be called by any thread. The thread running the operation stops
+ * at the next command, or within TCGS_OPERATION_SLEEP_SLICE if it waits.
+ *
+ * @param[in]  operation    operation
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Operation_Cancel(TCGS_Operation_t *operation);
+
+/*****************************************************************************
+ * \brief Checks current operation of the calling thread
+ *
+ * \return ERROR_SUCCESS if there is no current operation or it may go on,
+ * ERROR_CANCELLED or ERROR_TIMEOUT otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_Operation_Check(void);
+
+/*****************************************************************************
+ * \brief Returns time left to current operation of the calling thread
+ *
+ * \par Transports use it as timeout of the command sent to device.
+ *
+ * \return uint64 nanoseconds to the nearest deadline, TCGS_OPERATION_UNLIMITED
+ * if there is none
+ *****************************************************************************/
+uint64 TCGS_Operation_Remaining(void);
+
+/*****************************************************************************
+ * \brief Sleeps within current operation of the calling thread
+ *
+ * @param[in]  duration     time to sleep in nanoseconds
+ *
+ * \return ERROR_SUCCESS if the whole duration was slept, ERROR_TIMEOUT if
+ * deadline comes first, ERROR_CANCELLED if operation is cancelled meanwhile
+ *****************************************************************************/
+TCGS_Error_t TCGS_Operation_Sleep(uint64 duration);
+
+/*****************************************************************************
+ * \brief Sleeps before retry within current operation of the calling thread
+ *
+ * \par Delay before retry n is a random value between half and the whole of
+ * delay * 2^n, but not more than maxDelay. Random spread keeps commands
+ * failed by the same event from retrying at once.
+ *
+ * @param[in]  delay        nanoseconds before the first retry
+ * @param[in]  maxDelay     upper bound of delay in nanoseconds
+ * @param[in]  attempt      number of the retry, starting with 0
+ *
+ * \return the same codes as TCGS_Operation_Sleep
+ *****************************************************************************/
+TCGS_Error_t TCGS_Operation_Backoff(uint64 delay, uint64 maxDelay, uint32 attempt);
+
+#endif //_TCGS_OPERATION_H
@@ -10,6 +10,7 @@
 
 #include "tcgs_parser.h"
 #include "tcgs_stream.h"
+#include "tcgs_interface_encode.h"
 
 /*****************************************************************************
  * \brief Extracts the first Level 0 Discovery feature header from command
@@ -92,7 +93,358 @@ TCGS_Level0Discovery_Feature_t* TCGS_GetLevel0DiscoveryFeatureHeader(
 		{
 			return iter;
 		}
+		iter = TCGS_GetLevel0DiscoveryNextFeatureHeader(payload, iter);
 	}
 
 	return NULL;
 }
+
+TCGS_Error_t TCGS_ParseComPacket(const void *buffer, uint32 size,
+		TCGS_ComPacketInfo_t *info, TCGS_Parser_t *parser)
+{
+	const TCGS_ComPacketHeader_t *comPacket = (const TCGS_ComPacketHeader_t*)buffer;
+	const TCGS_PacketHeader_t *packet = (const TCGS_PacketHeader_t*)(comPacket + 1);
+	const TCGS_SubPacketHeader_t *subPacket = (const TCGS_SubPacketHeader_t*)(packet + 1);
+	uint32 comPacketLength, packetLength, subPacketLength;
+
+	TCGS_Parser_Init(parser, NULL, 0);
+	if (size < sizeof(TCGS_ComPacketHeader_t))
+	{
+		return ERROR_PARSER;
+	}
+	info->comId = _getBE16(comPacket->comId);
+	info->outstandingData = _getBE32(comPacket->outstandingData);
+	info->tperSessionNumber = 0;
+	info->hostSessionNumber = 0;
+
+	comPacketLength = _getBE32(comPacket->length);
+	if (comPacketLength == 0)
+	{
+		//no response is available (yet)
+		return ERROR_SUCCESS;
+	}
+	if (comPacketLength > size - sizeof(TCGS_ComPacketHeader_t) ||
+		comPacketLength < sizeof(TCGS_PacketHeader_t) + sizeof(TCGS_SubPacketHeader_t))
+	{
+		return ERROR_PARSER;
+	}
+	info->tperSessionNumber = _getBE32(packet->tperSessionNumber);
+	info->hostSessionNumber = _getBE32(packet->hostSessionNumber);
+
+	packetLength = _getBE32(packet->length);
+	subPacketLength = _getBE32(subPacket->length);
+	if (packetLength > comPacketLength - sizeof(TCGS_PacketHeader_t) ||
+		packetLength < sizeof(TCGS_SubPacketHeader_t) ||
+		subPacketLength > packetLength - sizeof(TCGS_SubPacketHeader_t))
+	{
+		return ERROR_PARSER;
+	}
+	TCGS_Parser_Init(parser, subPacket + 1, subPacketLength);
+
+	return ERROR_SUCCESS;
+}
+
+void TCGS_Parser_Init(TCGS_Parser_t *parser, const void *data, uint32 length)
+{
+	parser->data = (const uint8*)data;
+	parser->length = length;
+	parser->position = 0;
+}
+
+bool TCGS_Parser_AtEnd(TCGS_Parser_t *parser)
+{
+	TCGS_Token_t token;
+
+	return !TCGS_Parser_Peek(parser, &token);
+}
+
+/*
+ * Decodes token at current position, returns its length or 0 if the token
+ * is malformed or there is no more data
+ */
+static uint32 TCGS_Parser_Decode(TCGS_Parser_t *parser, TCGS_Token_t *token)
+{
+	const uint8 *data = parser->data + parser->position;
+	uint32 available = parser->length - parser->position;
+	uint32 header, length, i;
+	bool isBytes, isSigned;
+	uint8 first;
+
+	if (parser->position >= parser->length)
+	{
+		return 0;
+	}
+	first = data[0];
+	token->control = 0;
+	token->value = 0;
+
+	if (first <= 0x7F)
+	{
+		//tiny atom
+		token->type = (first & 0x40) ? TOKEN_TYPE_INT : TOKEN_TYPE_UINT;
+		token->value = first & TCGS_TINY_ATOM_MAX;
+		if ((first & 0x40) && (first & 0x20))
+		{
+			//sign extension of 6-bit two's complement value
+			token->value |= ~(uint64)TCGS_TINY_ATOM_MAX;
+		}
+		token->data = data;
+		token->length = 0;
+		return 1;
+	}
+	if (first >= TOKEN_START_LIST)
+	{
+		token->type = TOKEN_TYPE_CONTROL;
+		token->control = first;
+		token->data = NULL;
+		token->length = 0;
+		return 1;
+	}
+	if (first < TCGS_MEDIUM_ATOM)
+	{
+		header = 1;
+		isBytes = (first & 0x20) != 0;
+		isSigned = (first & 0x10) != 0;
+		length = first & 0x0F;
+	}
+	else if (first < TCGS_LONG_ATOM)
+	{
+		if (available < 2)
+		{
+			return 0;
+		}
+		header = 2;
+		isBytes = (first & 0x10) != 0;
+		isSigned = (first & 0x08) != 0;
+		length = ((uint32)(first & 0x07) << 8) | data[1];
+	}
+	else if (first <= (TCGS_LONG_ATOM | 0x03))
+	{
+		if (available < 4)
+		{
+			return 0;
+		}
+		header = 4;
+		isBytes = (first & 0x02) != 0;
+		isSigned = (first & 0x01) != 0;
+		length = ((uint32)data[1] << 16) | ((uint32)data[2] << 8) | data[3];
+	}
+	else
+	{
+		//reserved token
+		return 0;
+	}
+	if (length > available - header)
+	{
+		return 0;
+	}
+
+	token->data = data + header;
+	token->length = length;
+	if (isBytes)
+	{
+		token->type = TOKEN_TYPE_BYTES;
+	}
+	else
+	{
+		token->type = isSigned ? TOKEN_TYPE_INT : TOKEN_TYPE_UINT;
+		if (length > sizeof(uint64))
+		{
+			return 0;
+		}
+		for (i = 0; i < length; i++)
+		{
+			token->value = (token->value << 8) | token->data[i];
+		}
+	}
+	return header + length;
+}
+
+bool TCGS_Parser_Next(TCGS_Parser_t *parser, TCGS_Token_t *token)
+{
+	uint32 length;
+
+	do
+	{
+		length = TCGS_Parser_Decode(parser, token);
+		if (length == 0)
+		{
+			return FALSE;
+		}
+		parser->position += length;
+	} while (token->type == TOKEN_TYPE_CONTROL && token->control == TOKEN_EMPTY);
+
+	return TRUE;
+}
+
+bool TCGS_Parser_Peek(TCGS_Parser_t *parser, TCGS_Token_t *token)
+{
+	TCGS_Parser_t copy = *parser;
+
+	return TCGS_Parser_Next(&copy, token);
+}
+
+bool TCGS_Parser_Expect(TCGS_Parser_t *parser, TCGS_ControlToken_t control)
+{
+	TCGS_Token_t token;
+
+	if (!TCGS_Parser_Peek(parser, &token) ||
+		token.type != TOKEN_TYPE_CONTROL || token.control != (uint8)control)
+	{
+		return FALSE;
+	}
+	return TCGS_Parser_Next(parser, &token);
+}
+
+bool TCGS_Parser_SkipValue(TCGS_Parser_t *parser)
+{
+	TCGS_Token_t token;
+	uint32 depth = 0;
+
+	do
+	{
+		if (!TCGS_Parser_Next(parser, &token))
+		{
+			return FALSE;
+		}
+		if (token.type == TOKEN_TYPE_CONTROL)
+		{
+			switch (token.control)
+			{
+			case TOKEN_START_LIST:
+			case TOKEN_START_NAME:
+				depth++;
+				break;
+			case TOKEN_END_LIST:
+			case TOKEN_END_NAME:
+				if (depth == 0)
+				{
+					return FALSE;
+				}
+				depth--;
+				break;
+			default:
+				//only atoms, lists and named values are values
+				return FALSE;
+			}
+		}
+	} while (depth > 0);
+
+	return TRUE;
+}
+
+bool TCGS_Parser_GetUInt(TCGS_Parser_t *parser, uint64 *value)
+{
+	TCGS_Token_t token;
+
+	if (!TCGS_Parser_Peek(parser, &token) || token.type != TOKEN_TYPE_UINT)
+	{
+		return FALSE;
+	}
+	TCGS_Parser_Next(parser, &token);
+	*value = token.value;
+	return TRUE;
+}
+
+bool TCGS_Parser_GetBytes(TCGS_Parser_t *parser, const uint8 **data, uint32 *length)
+{
+	TCGS_Token_t token;
+
+	if (!TCGS_Parser_Peek(parser, &token) || token.type != TOKEN_TYPE_BYTES)
+	{
+		return FALSE;
+	}
+	TCGS_Parser_Next(parser, &token);
+	*data = token.data;
+	*length = token.length;
+	return TRUE;
+}
+
+bool TCGS_Parser_GetUID(TCGS_Parser_t *parser, TCGS_UID_t *uid)
+{
+	TCGS_Parser_t copy = *parser;
+	const uint8 *data;
+	uint32 length;
+
+	if (!TCGS_Parser_GetBytes(&copy, &data, &length) || length != sizeof(uid->bytes))
+	{
+		return FALSE;
+	}
+	memcpy(uid->bytes, data, sizeof(uid->bytes));
+	*parser = copy;
+	return TRUE;
+}
+
+TCGS_Error_t TCGS_Parser_GetResult(TCGS_Parser_t *parser, TCGS_Parser_t *results,
+		TCGS_MethodStatus_t *status)
+{
+	uint32 start, end;
+	uint64 value;
+
+	if (TCGS_Parser_Expect(parser, TOKEN_END_OF_SESSION))
+	{
+		return ERROR_SESSION;
+	}
+	start = parser->position;
+	if (!TCGS_Parser_SkipValue(parser) || parser->data[start] != TOKEN_START_LIST)
+	{
+		return ERROR_PARSER;
+	}
+	end = parser->position;
+	if (results != NULL)
+	{
+		//content of the list without START_LIST and END_LIST tokens
+		TCGS_Parser_Init(results, parser->data + start + 1, end - start - 2);
+	}
+
+	if (!TCGS_Parser_Expect(parser, TOKEN_END_OF_DATA) ||
+		!TCGS_Parser_Expect(parser, TOKEN_START_LIST) ||
+		!TCGS_Parser_GetUInt(parser, &value))
+	{
+		return ERROR_PARSER;
+	}
+	*status = (TCGS_MethodStatus_t)value;
+	//reserved fields of status list
+	while (!TCGS_Parser_Expect(parser, TOKEN_END_LIST))
+	{
+		if (!TCGS_Parser_SkipValue(parser))
+		{
+			return ERROR_PARSER;
+		}
+	}
+	return ERROR_SUCCESS;
+}
+
+bool TCGS_Parser_FindNamedValue(const TCGS_Parser_t *parser, uint64 name, TCGS_Token_t *value)
+{
+	TCGS_Parser_t iter = *parser;
+	TCGS_Token_t token;
+	uint64 tokenName;
+
+	while (TCGS_Parser_Next(&iter, &token))
+	{
+		if (token.type != TOKEN_TYPE_CONTROL || token.control != TOKEN_START_NAME)
+		{
+			//lists are looked through, other atoms are skipped
+			continue;
+		}
+		if (TCGS_Parser_GetUInt(&iter, &tokenName))
+		{
+			if (tokenName == name && TCGS_Parser_Peek(&iter, value) && value->type != TOKEN_TYPE_CONTROL)
+			{
+				return TRUE;
+			}
+		}
+		else if (!TCGS_Parser_SkipValue(&iter))
+		{
+			//name is not an integer
+			return FALSE;
+		}
+		//skip value of non-matching name and END_NAME
+		if (!TCGS_Parser_SkipValue(&iter) || !TCGS_Parser_Expect(&iter, TOKEN_END_NAME))
+		{
+			return FALSE;
+		}
+	}
+	return FALSE;
+}
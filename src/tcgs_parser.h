@@ -9,6 +9,9 @@
 #ifndef TCGS_PARSER_H_
 #define TCGS_PARSER_H_
 
+#include <stdbool.h>
+
+#include "tcgs_types.h"
 #include "tcgs_stream.h"
 
 /*****************************************************************************
@@ -58,7 +61,134 @@ TCGS_Level0Discovery_Feature_t* TCGS_GetLevel0DiscoveryFeatureHeader(
 
 #define TCGS_GetLevel0DiscoveryFeatureOpal1Header(payload) ((TCGS_Level0Discovery_FeatureOpal1_t*)TCGS_GetLevel0DiscoveryFeatureHeader(payload, FEATURE_OPAL1))
 
-#define TCGS_GetLevel0DiscoveryFeatureOpal2Header(payload) ((TCGS_Level0Discovery_FeatureOpal1_t*)TCGS_GetLevel0DiscoveryFeatureHeader(payload, FEATURE_OPAL2))
+#define TCGS_GetLevel0DiscoveryFeatureOpal2Header(payload) ((TCGS_Level0Discovery_FeatureOpal2_t*)TCGS_GetLevel0DiscoveryFeatureHeader(payload, FEATURE_OPAL2))
+
+typedef enum
+{
+	TOKEN_TYPE_UINT,
+	TOKEN_TYPE_INT,
+	TOKEN_TYPE_BYTES,
+	TOKEN_TYPE_CONTROL,
+} TCGS_TokenType_t;
+
+/*****************************************************************************
+ * \brief Decoded token of token stream
+ *
+ * Data of byte atoms is not copied, it points to the parsed buffer.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_TokenType_t type;
+	uint8            control;   //control token, for TOKEN_TYPE_CONTROL
+	uint64           value;     //value of integer atom up to 8 bytes long
+	const uint8     *data;      //data of atom
+	uint32           length;    //length of data of atom
+} TCGS_Token_t;
+
+/*****************************************************************************
+ * \brief Parser of token stream
+ *****************************************************************************/
+typedef struct
+{
+	const uint8 *data;
+	uint32       length;
+	uint32       position;
+} TCGS_Parser_t;
+
+/*****************************************************************************
+ * \brief Fields of ComPacket and Packet headers of a response
+ *****************************************************************************/
+typedef struct
+{
+	uint16 comId;
+	uint32 outstandingData;
+	uint32 tperSessionNumber;
+	uint32 hostSessionNumber;
+} TCGS_ComPacketInfo_t;
+
+/*****************************************************************************
+ * \brief Validates headers of ComPacket received from TPer and initializes
+ * parser with token stream of its first SubPacket
+ *
+ * @param[in]  buffer       received ComPacket
+ * @param[in]  size         size of the buffer
+ * @param[out] info         fields of headers
+ * @param[out] parser       parser of SubPacket data, empty if ComPacket
+ *                          has no data
+ *
+ * \return ERROR_SUCCESS if headers are consistent, ERROR_PARSER otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_ParseComPacket(const void *buffer, uint32 size,
+		TCGS_ComPacketInfo_t *info, TCGS_Parser_t *parser);
+
+void TCGS_Parser_Init(TCGS_Parser_t *parser, const void *data, uint32 length);
 
+/*****************************************************************************
+ * \brief Decodes the next token, empty atoms are skipped
+ *
+ * @param[in]  parser       parser
+ * @param[out] token        decoded token
+ *
+ * \return TRUE if token is decoded, FALSE at the end of data or
+ * if token is malformed
+ *****************************************************************************/
+bool TCGS_Parser_Next(TCGS_Parser_t *parser, TCGS_Token_t *token);
+
+/*****************************************************************************
+ * \brief Decodes the next token without moving the parser
+ *****************************************************************************/
+bool TCGS_Parser_Peek(TCGS_Parser_t *parser, TCGS_Token_t *token);
+
+bool TCGS_Parser_AtEnd(TCGS_Parser_t *parser);
+
+/*****************************************************************************
+ * \brief Consumes the next token if it is the specified control token
+ *
+ * \return TRUE if the token is consumed
+ *****************************************************************************/
+bool TCGS_Parser_Expect(TCGS_Parser_t *parser, TCGS_ControlToken_t control);
+
+/*****************************************************************************
+ * \brief Skips one value: atom, list or named value
+ *
+ * \return TRUE if the value is skipped, FALSE if data is malformed
+ *****************************************************************************/
+bool TCGS_Parser_SkipValue(TCGS_Parser_t *parser);
+
+bool TCGS_Parser_GetUInt(TCGS_Parser_t *parser, uint64 *value);
+bool TCGS_Parser_GetBytes(TCGS_Parser_t *parser, const uint8 **data, uint32 *length);
+bool TCGS_Parser_GetUID(TCGS_Parser_t *parser, TCGS_UID_t *uid);
+
+/*****************************************************************************
+ * \brief Parses result of method invocation
+ *
+ * \par The result consists of the list of returned values, End of Data token
+ * and the status list. Parser of the content of the returned list is
+ * initialized over the same data.
+ *
+ * @param[in]  parser       parser positioned at the result
+ * @param[out] results      parser of returned values, may be NULL
+ * @param[out] status       method status
+ *
+ * \return ERROR_SUCCESS if result is parsed, ERROR_SESSION if TPer closed
+ * the session, ERROR_PARSER if result is malformed
+ *****************************************************************************/
+TCGS_Error_t TCGS_Parser_GetResult(TCGS_Parser_t *parser, TCGS_Parser_t *results,
+		TCGS_MethodStatus_t *status);
+
+/*****************************************************************************
+ * \brief Finds named value with specified name
+ *
+ * \par The function looks through the values of parser (including nested
+ * lists, as returned by Get method) for named value with integer name
+ * and returns its value if it is an atom.
+ *
+ * @param[in]  parser       parser of list content, it is not moved
+ * @param[in]  name         name to find (e.g. column number)
+ * @param[out] value        found atom
+ *
+ * \return TRUE if the value is found
+ *****************************************************************************/
+bool TCGS_Parser_FindNamedValue(const TCGS_Parser_t *parser, uint64 name, TCGS_Token_t *value);
 
 #endif /* TCGS_PARSER_H_ */
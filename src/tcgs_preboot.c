@@ -0,0 +1,59 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_preboot.c
+///
+/// Static tables of devices and sessions of pre-boot image
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_interface.h"
+#include "tcgs_session.h"
+#include "tcgs_preboot.h"
+
+static TCGS_Device_t devices[TCGS_PREBOOT_MAX_DEVICES];
+static uint32 deviceCount;
+
+static TCGS_Session_t sessions[TCGS_PREBOOT_MAX_SESSIONS];
+static bool sessionBusy[TCGS_PREBOOT_MAX_SESSIONS];
+
+TCGS_Device_t *TCGS_Preboot_AddDevice(TCGS_InterfaceFunctions_t *funcs, void *context)
+{
+	uint32 index;
+
+	do
+	{
+		index = deviceCount;
+		if (index >= TCGS_PREBOOT_MAX_DEVICES)
+		{
+			return NULL;
+		}
+	} while (!__sync_bool_compare_and_swap(&deviceCount, index, index + 1));
+	TCGS_Device_Init(&devices[index], funcs, context);
+	return &devices[index];
+}
+
+TCGS_Session_t *TCGS_Preboot_AcquireSession(void)
+{
+	uint32 i;
+
+	for (i = 0; i < TCGS_PREBOOT_MAX_SESSIONS; i++)
+	{
+		if (__sync_bool_compare_and_swap(&sessionBusy[i], FALSE, TRUE))
+		{
+			return &sessions[i];
+		}
+	}
+	return NULL;
+}
+
+void TCGS_Preboot_ReleaseSession(TCGS_Session_t *session)
+{
+	uint32 index = (uint32)(session - sessions);
+
+	if (index < TCGS_PREBOOT_MAX_SESSIONS)
+	{
+		__sync_lock_release(&sessionBusy[index]);
+	}
+}
@@ -0,0 +1,50 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_preboot.h
+///
+/// Static tables of devices and sessions of pre-boot image
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_PREBOOT_H
+#define _TCGS_PREBOOT_H
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_interface.h"
+#include "tcgs_session.h"
+
+/*****************************************************************************
+ * \brief Adds device to the static table of devices
+ *
+ * \par The table holds TCGS_PREBOOT_MAX_DEVICES devices, the module is built
+ * in pre-boot profile only.
+ *
+ * @param[in]  funcs    interface functions of the device
+ * @param[in]  context  context of the interface functions
+ *
+ * \return TCGS_Device_t* initialized device, NULL if the table is full
+ *
+ * \see TCGS_Device_Init
+ *****************************************************************************/
+TCGS_Device_t *TCGS_Preboot_AddDevice(TCGS_InterfaceFunctions_t *funcs, void *context);
+
+/*****************************************************************************
+ * \brief Hands out session from the static table of sessions
+ *
+ * \par The table holds TCGS_PREBOOT_MAX_SESSIONS sessions, the session is
+ * started by TCGS_StartSession as usual.
+ *
+ * \return TCGS_Session_t* free session, NULL if all sessions are in use
+ *
+ * \see TCGS_Preboot_ReleaseSession
+ *****************************************************************************/
+TCGS_Session_t *TCGS_Preboot_AcquireSession(void);
+
+/*****************************************************************************
+ * \brief Returns session to the static table, the session shall be ended
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Preboot_ReleaseSession(TCGS_Session_t *session);
+
+#endif //_TCGS_PREBOOT_H
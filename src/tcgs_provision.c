@@ -0,0 +1,442 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_provision.c
+///
+/// Provisioning of new devices from template with checkpoints
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_interface.h"
+#include "tcgs_session.h"
+#include "tcgs_transaction.h"
+#include "tcgs_uid.h"
+#include "libtcgstorage.h"
+#include "tcgs_provision.h"
+
+//rows of C_PIN table share lower half of UID with their authorities
+#define TCGS_PROVISION_C_PIN_TABLE 0x0B
+
+void TCGS_Provision_Init(TCGS_Provision_t *provision, TCGS_Device_t *device,
+		const TCGS_ProvisionTemplate_t *provisionTemplate, TCGS_ProvisionCheckpoint_t *checkpoint,
+		TCGS_ProvisionSave_t save, void *context)
+{
+	memset(provision, 0, sizeof(*provision));
+	provision->device = device;
+	provision->provisionTemplate = provisionTemplate;
+	provision->checkpoint = checkpoint;
+	provision->save = save;
+	provision->context = context;
+}
+
+static TCGS_Error_t TCGS_Provision_Save(TCGS_Provision_t *provision)
+{
+	if (provision->save != NULL && !provision->save(provision->context, provision->checkpoint))
+	{
+		return ERROR_PARAMETER;
+	}
+	return ERROR_SUCCESS;
+}
+
+static TCGS_Error_t TCGS_Provision_Complete(TCGS_Provision_t *provision, TCGS_ProvisionStep_t step)
+{
+	provision->checkpoint->completed |= 1U << step;
+	return TCGS_Provision_Save(provision);
+}
+
+static bool TCGS_Provision_IsPending(TCGS_Provision_t *provision, TCGS_ProvisionStep_t first,
+		TCGS_ProvisionStep_t last)
+{
+	TCGS_ProvisionStep_t step;
+
+	for (step = first; step <= last; step++)
+	{
+		if (!TCGS_Provision_IsCompleted(provision->checkpoint, step))
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Detects SSC and checks that the template fits it. Steps the template
+ * doesn't need are completed without session.
+ */
+static TCGS_Error_t TCGS_Provision_Discover(TCGS_Provision_t *provision)
+{
+	const TCGS_ProvisionTemplate_t *provisionTemplate = provision->provisionTemplate;
+	uint32 buffer[TCGS_BLOCK_SIZE / sizeof(uint32)];
+	TCGS_Level0Discovery_Header_t *header = (TCGS_Level0Discovery_Header_t*)buffer;
+	TCGS_Level0Discovery_FeatureOpal2_t *opal2;
+	TCGS_Error_t error;
+
+	error = TCGS_Device_Level0DiscoveryQuiet(provision->device, buffer);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	opal2 = TCGS_GetLevel0DiscoveryFeatureOpal2Header(header);
+	if (opal2 != NULL)
+	{
+		provision->ssc = PROVISION_SSC_OPAL2;
+		//ownership can't be taken with MSID if initial SID PIN is vendor unique
+		if ((opal2->initialPinSidIndicator != 0 &&
+				!TCGS_Provision_IsCompleted(provision->checkpoint, PROVISION_STEP_TAKE_OWNERSHIP)) ||
+			provisionTemplate->userCount > opal2->numberOfUsersSupported)
+		{
+			return ERROR_PARAMETER;
+		}
+	}
+	else if (TCGS_GetLevel0DiscoveryFeatureOpal1Header(header) != NULL)
+	{
+		provision->ssc = PROVISION_SSC_OPAL1;
+	}
+	else if (TCGS_GetLevel0DiscoveryFeatureEnterpriseHeader(header) != NULL)
+	{
+		//Get, Set and Authenticate of Enterprise SSC have other UIDs and
+		//parameters than the Opal methods sent by the session helpers
+		provision->ssc = PROVISION_SSC_ENTERPRISE;
+		return ERROR_PARAMETER;
+	}
+	else
+	{
+		return ERROR_PARAMETER;
+	}
+
+	if (provisionTemplate->rangeCount == 0)
+	{
+		provision->checkpoint->completed |= 1U << PROVISION_STEP_RANGES;
+	}
+	if (provisionTemplate->userCount == 0)
+	{
+		provision->checkpoint->completed |= 1U << PROVISION_STEP_USERS;
+	}
+	if (provisionTemplate->mbr == NULL)
+	{
+		provision->checkpoint->completed |= 1U << PROVISION_STEP_MBR;
+	}
+	return ERROR_SUCCESS;
+}
+
+/*
+ * Starts read-write session without authority and authenticates the
+ * authority with the expected PIN or with the alternative one
+ */
+static TCGS_Error_t TCGS_Provision_StartSession(TCGS_Provision_t *provision, const TCGS_UID_t *sp,
+		const TCGS_UID_t *authority, const uint8 *pin, uint32 pinLength,
+		const uint8 *alternativePin, uint32 alternativePinLength, bool *alternative)
+{
+	TCGS_Session_t *session = &provision->session;
+	TCGS_Error_t error;
+
+	error = TCGS_StartSession(session, provision->device, sp, NULL, NULL, 0, TRUE, &provision->status);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	provision->sessions++;
+	*alternative = FALSE;
+	error = TCGS_Authenticate(session, authority, pin, pinLength, &provision->status);
+	if (error == ERROR_METHOD && alternativePin != NULL)
+	{
+		*alternative = TRUE;
+		error = TCGS_Authenticate(session, authority, alternativePin, alternativePinLength,
+				&provision->status);
+	}
+	if (error != ERROR_SUCCESS)
+	{
+		TCGS_EndSession(session);
+	}
+	return error;
+}
+
+static TCGS_Error_t TCGS_Provision_EndSession(TCGS_Provision_t *provision, TCGS_Error_t error)
+{
+	TCGS_Error_t endError = TCGS_EndSession(&provision->session);
+
+	return (error != ERROR_SUCCESS) ? error : endError;
+}
+
+/*
+ * Reads MSID within anonymous session, then authenticates SID with MSID
+ * and changes SID PIN in the same session
+ */
+static TCGS_Error_t TCGS_Provision_TakeOwnership(TCGS_Provision_t *provision)
+{
+	const TCGS_ProvisionTemplate_t *provisionTemplate = provision->provisionTemplate;
+	TCGS_Session_t *session = &provision->session;
+	TCGS_Parser_t results;
+	TCGS_Token_t token;
+	TCGS_Error_t error;
+
+	error = TCGS_StartSession(session, provision->device, &TCGS_UID_AdminSP, NULL, NULL, 0, TRUE,
+			&provision->status);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	provision->sessions++;
+	error = TCGS_Get(session, &TCGS_UID_C_PIN_MSID, TCGS_COLUMN_C_PIN_PIN, TCGS_COLUMN_C_PIN_PIN,
+			&results, &provision->status);
+	if (error == ERROR_SUCCESS && !TCGS_Parser_FindNamedValue(&results, TCGS_COLUMN_C_PIN_PIN, &token))
+	{
+		error = ERROR_PARSER;
+	}
+	if (error == ERROR_SUCCESS)
+	{
+		error = TCGS_Authenticate(session, &TCGS_UID_SID, token.data, token.length, &provision->status);
+		if (error == ERROR_METHOD)
+		{
+			//PIN was changed by interrupted run
+			error = TCGS_Authenticate(session, &TCGS_UID_SID, provisionTemplate->sidPin,
+					provisionTemplate->sidPinLength, &provision->status);
+		}
+		else if (error == ERROR_SUCCESS)
+		{
+			error = TCGS_SetBytes(session, &TCGS_UID_C_PIN_SID, TCGS_COLUMN_C_PIN_PIN,
+					provisionTemplate->sidPin, provisionTemplate->sidPinLength, &provision->status);
+		}
+	}
+	if (error == ERROR_SUCCESS)
+	{
+		error = TCGS_Provision_Complete(provision, PROVISION_STEP_TAKE_OWNERSHIP);
+	}
+	if (error != ERROR_SUCCESS)
+	{
+		TCGS_EndSession(session);
+	}
+	return error;
+}
+
+static TCGS_Error_t TCGS_Provision_Activate(TCGS_Provision_t *provision)
+{
+	TCGS_Builder_t *builder = TCGS_Session_StartPacket(&provision->session);
+
+	TCGS_Builder_StartCall(builder, &TCGS_UID_LockingSP, &TCGS_UID_Method_Activate);
+	TCGS_Builder_EndCall(builder);
+	return TCGS_Session_Call(&provision->session, NULL, &provision->status);
+}
+
+static TCGS_Error_t TCGS_Provision_RunAdminSP(TCGS_Provision_t *provision)
+{
+	const TCGS_ProvisionTemplate_t *provisionTemplate = provision->provisionTemplate;
+	TCGS_Error_t error;
+	bool alternative;
+
+	provision->step = PROVISION_STEP_TAKE_OWNERSHIP;
+	if (!TCGS_Provision_IsCompleted(provision->checkpoint, PROVISION_STEP_TAKE_OWNERSHIP))
+	{
+		error = TCGS_Provision_TakeOwnership(provision);
+	}
+	else
+	{
+		error = TCGS_Provision_StartSession(provision, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+				provisionTemplate->sidPin, provisionTemplate->sidPinLength, NULL, 0, &alternative);
+	}
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+
+	provision->step = PROVISION_STEP_ACTIVATE;
+	if (!TCGS_Provision_IsCompleted(provision->checkpoint, PROVISION_STEP_ACTIVATE))
+	{
+		error = TCGS_Provision_Activate(provision);
+		if (error == ERROR_SUCCESS)
+		{
+			error = TCGS_Provision_Complete(provision, PROVISION_STEP_ACTIVATE);
+		}
+	}
+	return TCGS_Provision_EndSession(provision, error);
+}
+
+static TCGS_Error_t TCGS_Provision_Ranges(TCGS_Provision_t *provision)
+{
+	const TCGS_ProvisionTemplate_t *provisionTemplate = provision->provisionTemplate;
+	const TCGS_ProvisionRange_t *range;
+	TCGS_Transaction_t transaction;
+	TCGS_Error_t error;
+	uint32 i;
+
+	error = TCGS_StartTransaction(&transaction, &provision->session);
+	for (i = 0; error == ERROR_SUCCESS && i < provisionTemplate->rangeCount; i++)
+	{
+		range = &provisionTemplate->ranges[i];
+		TCGS_Transaction_SetUInt(&transaction, NULL, &range->range,
+				TCGS_COLUMN_LOCKING_RANGE_START, range->start);
+		TCGS_Transaction_SetUInt(&transaction, NULL, &range->range,
+				TCGS_COLUMN_LOCKING_RANGE_LENGTH, range->length);
+		TCGS_Transaction_SetUInt(&transaction, NULL, &range->range,
+				TCGS_COLUMN_LOCKING_READ_LOCK_ENABLED, range->readLockEnabled);
+		error = TCGS_Transaction_SetUInt(&transaction, NULL, &range->range,
+				TCGS_COLUMN_LOCKING_WRITE_LOCK_ENABLED, range->writeLockEnabled);
+	}
+	return TCGS_EndTransaction(&transaction, error == ERROR_SUCCESS);
+}
+
+static TCGS_Error_t TCGS_Provision_Users(TCGS_Provision_t *provision)
+{
+	const TCGS_ProvisionTemplate_t *provisionTemplate = provision->provisionTemplate;
+	const TCGS_ProvisionUser_t *user;
+	TCGS_Transaction_t transaction;
+	TCGS_UID_t credential;
+	TCGS_Error_t error;
+	uint32 i;
+
+	error = TCGS_StartTransaction(&transaction, &provision->session);
+	for (i = 0; error == ERROR_SUCCESS && i < provisionTemplate->userCount; i++)
+	{
+		user = &provisionTemplate->users[i];
+		credential = user->authority;
+		credential.bytes[3] = TCGS_PROVISION_C_PIN_TABLE;
+		TCGS_Transaction_SetBytes(&transaction, NULL, &credential, TCGS_COLUMN_C_PIN_PIN,
+				user->pin, user->pinLength);
+		error = TCGS_Transaction_SetUInt(&transaction, NULL, &user->authority,
+				TCGS_COLUMN_AUTHORITY_ENABLED, 1);
+	}
+	return TCGS_EndTransaction(&transaction, error == ERROR_SUCCESS);
+}
+
+/*
+ * Writes the image from the checkpointed offset, so interrupted upload
+ * isn't started over
+ */
+static TCGS_Error_t TCGS_Provision_MBR(TCGS_Provision_t *provision)
+{
+	const TCGS_ProvisionTemplate_t *provisionTemplate = provision->provisionTemplate;
+	TCGS_ProvisionCheckpoint_t *checkpoint = provision->checkpoint;
+	TCGS_Builder_t *builder;
+	TCGS_Error_t error = ERROR_SUCCESS;
+	uint32 length;
+
+	while (error == ERROR_SUCCESS && checkpoint->mbrWritten < provisionTemplate->mbrLength)
+	{
+		length = provisionTemplate->mbrLength - checkpoint->mbrWritten;
+		if (length > TCGS_PROVISION_MBR_CHUNK_SIZE)
+		{
+			length = TCGS_PROVISION_MBR_CHUNK_SIZE;
+		}
+		builder = TCGS_Session_StartPacket(&provision->session);
+		TCGS_Builder_StartCall(builder, &TCGS_UID_MBR, &TCGS_UID_Method_Set);
+		TCGS_Builder_AddNamedUInt(builder, SET_WHERE, checkpoint->mbrWritten);
+		TCGS_Builder_AddNamedBytes(builder, SET_VALUES, provisionTemplate->mbr + checkpoint->mbrWritten, length);
+		TCGS_Builder_EndCall(builder);
+		error = TCGS_Session_Call(&provision->session, NULL, &provision->status);
+		if (error == ERROR_SUCCESS)
+		{
+			checkpoint->mbrWritten += length;
+			error = TCGS_Provision_Save(provision);
+		}
+	}
+	if (error == ERROR_SUCCESS)
+	{
+		error = TCGS_SetUInt(&provision->session, &TCGS_UID_MBRControl, TCGS_COLUMN_MBRCONTROL_ENABLE, 1,
+				&provision->status);
+	}
+	return error;
+}
+
+static TCGS_Error_t TCGS_Provision_RunLockingSP(TCGS_Provision_t *provision)
+{
+	const TCGS_ProvisionTemplate_t *provisionTemplate = provision->provisionTemplate;
+	TCGS_Error_t error;
+	bool adminSet = TCGS_Provision_IsCompleted(provision->checkpoint, PROVISION_STEP_ADMIN);
+	bool alternative;
+
+	//Admin1 PIN is the same as SID PIN after activation
+	provision->step = PROVISION_STEP_ADMIN;
+	if (adminSet)
+	{
+		error = TCGS_Provision_StartSession(provision, &TCGS_UID_LockingSP, &TCGS_UID_Admin1,
+				provisionTemplate->adminPin, provisionTemplate->adminPinLength,
+				provisionTemplate->sidPin, provisionTemplate->sidPinLength, &alternative);
+	}
+	else
+	{
+		error = TCGS_Provision_StartSession(provision, &TCGS_UID_LockingSP, &TCGS_UID_Admin1,
+				provisionTemplate->sidPin, provisionTemplate->sidPinLength,
+				provisionTemplate->adminPin, provisionTemplate->adminPinLength, &alternative);
+		if (error == ERROR_SUCCESS && !alternative)
+		{
+			error = TCGS_SetBytes(&provision->session, &TCGS_UID_C_PIN_Admin1, TCGS_COLUMN_C_PIN_PIN,
+					provisionTemplate->adminPin, provisionTemplate->adminPinLength, &provision->status);
+		}
+		if (error == ERROR_SUCCESS)
+		{
+			error = TCGS_Provision_Complete(provision, PROVISION_STEP_ADMIN);
+		}
+	}
+	if (error != ERROR_SUCCESS)
+	{
+		//session is closed if authentication failed
+		return provision->session.open ? TCGS_Provision_EndSession(provision, error) : error;
+	}
+
+	provision->step = PROVISION_STEP_RANGES;
+	if (!TCGS_Provision_IsCompleted(provision->checkpoint, PROVISION_STEP_RANGES))
+	{
+		error = TCGS_Provision_Ranges(provision);
+		if (error == ERROR_SUCCESS)
+		{
+			error = TCGS_Provision_Complete(provision, PROVISION_STEP_RANGES);
+		}
+	}
+	if (error == ERROR_SUCCESS)
+	{
+		provision->step = PROVISION_STEP_USERS;
+		if (!TCGS_Provision_IsCompleted(provision->checkpoint, PROVISION_STEP_USERS))
+		{
+			error = TCGS_Provision_Users(provision);
+			if (error == ERROR_SUCCESS)
+			{
+				error = TCGS_Provision_Complete(provision, PROVISION_STEP_USERS);
+			}
+		}
+	}
+	if (error == ERROR_SUCCESS)
+	{
+		provision->step = PROVISION_STEP_MBR;
+		if (!TCGS_Provision_IsCompleted(provision->checkpoint, PROVISION_STEP_MBR))
+		{
+			error = TCGS_Provision_MBR(provision);
+			if (error == ERROR_SUCCESS)
+			{
+				error = TCGS_Provision_Complete(provision, PROVISION_STEP_MBR);
+			}
+		}
+	}
+	return TCGS_Provision_EndSession(provision, error);
+}
+
+TCGS_Error_t TCGS_Provision_Run(TCGS_Provision_t *provision)
+{
+	TCGS_Error_t error;
+
+	provision->sessions = 0;
+	provision->step = PROVISION_STEP_TAKE_OWNERSHIP;
+	error = TCGS_Provision_Discover(provision);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	if (TCGS_Provision_IsPending(provision, PROVISION_STEP_TAKE_OWNERSHIP, PROVISION_STEP_ACTIVATE))
+	{
+		error = TCGS_Provision_RunAdminSP(provision);
+		if (error != ERROR_SUCCESS)
+		{
+			return error;
+		}
+	}
+	if (TCGS_Provision_IsPending(provision, PROVISION_STEP_ADMIN, PROVISION_STEP_MBR))
+	{
+		error = TCGS_Provision_RunLockingSP(provision);
+	}
+	return error;
+}
@@ -0,0 +1,159 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_provision.h
+///
+/// Provisioning of new devices from template with checkpoints
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_PROVISION_H
+#define _TCGS_PROVISION_H
+
+#include <stdbool.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_session.h"
+
+//steps are run in this order, steps of Admin SP share one session and
+//steps of Locking SP share another one
+typedef enum
+{
+	PROVISION_STEP_TAKE_OWNERSHIP,  //SID PIN is changed from MSID to PIN of template
+	PROVISION_STEP_ACTIVATE,        //Locking SP is activated
+	PROVISION_STEP_ADMIN,           //Admin1 PIN of Locking SP is set
+	PROVISION_STEP_RANGES,          //locking ranges are configured
+	PROVISION_STEP_USERS,           //PINs of users are set and users are enabled
+	PROVISION_STEP_MBR,             //shadow MBR image is written and shadowing is enabled
+	PROVISION_STEPS,
+} TCGS_ProvisionStep_t;
+
+//Security Subsystem Class detected with Level 0 Discovery
+typedef enum
+{
+	PROVISION_SSC_UNKNOWN,
+	PROVISION_SSC_OPAL1,
+	PROVISION_SSC_OPAL2,
+	PROVISION_SSC_ENTERPRISE,
+} TCGS_ProvisionSSC_t;
+
+typedef struct
+{
+	TCGS_UID_t  range;              //row of Locking table
+	uint64      start;
+	uint64      length;
+	bool        readLockEnabled;
+	bool        writeLockEnabled;
+} TCGS_ProvisionRange_t;
+
+typedef struct
+{
+	TCGS_UID_t  authority;          //user authority of Locking SP, its C_PIN row is derived from it
+	uint8       pin[TCGS_MAX_CREDENTIAL_LENGTH];
+	uint32      pinLength;
+} TCGS_ProvisionUser_t;
+
+/*****************************************************************************
+ * \brief Declarative description of provisioned device
+ *
+ * \par Steps of ranges, users and MBR are skipped if template has none of
+ * them. The template is the same for all devices of a run and is not
+ * changed by provisioning.
+ *****************************************************************************/
+typedef struct
+{
+	uint8                   sidPin[TCGS_MAX_CREDENTIAL_LENGTH];
+	uint32                  sidPinLength;
+	uint8                   adminPin[TCGS_MAX_CREDENTIAL_LENGTH];     //Admin1 of Locking SP
+	uint32                  adminPinLength;
+	uint32                  rangeCount;
+	TCGS_ProvisionRange_t   ranges[TCGS_PROVISION_MAX_RANGES];
+	uint32                  userCount;
+	TCGS_ProvisionUser_t    users[TCGS_PROVISION_MAX_USERS];
+	const uint8            *mbr;        //shadow MBR image, NULL if shadowing is not enabled
+	uint32                  mbrLength;
+} TCGS_ProvisionTemplate_t;
+
+/*****************************************************************************
+ * \brief Progress of provisioning of a device
+ *
+ * \par The structure has no pointers, so it may be stored as is. Checkpoint
+ * of a new device is zeroed.
+ *****************************************************************************/
+typedef struct
+{
+	uint32  completed;      //bits of completed steps
+	uint32  mbrWritten;     //bytes of MBR image written by unfinished MBR step
+} TCGS_ProvisionCheckpoint_t;
+
+#define TCGS_Provision_IsCompleted(checkpoint, step) (((checkpoint)->completed & (1U << (step))) != 0)
+
+/*****************************************************************************
+ * \brief Stores checkpoint
+ *
+ * @param[in]  context      context given to TCGS_Provision_Init
+ * @param[in]  checkpoint   checkpoint to store
+ *
+ * \return TRUE if checkpoint is stored, provisioning stops otherwise
+ *****************************************************************************/
+typedef bool (*TCGS_ProvisionSave_t)(void *context, const TCGS_ProvisionCheckpoint_t *checkpoint);
+
+/*****************************************************************************
+ * \brief Provisioning of one device
+ *
+ * \par Devices are independent, so many of them are provisioned at once by
+ * running provisioning of every device in its own thread.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_Device_t                   *device;
+	const TCGS_ProvisionTemplate_t  *provisionTemplate;
+	TCGS_ProvisionCheckpoint_t      *checkpoint;
+	TCGS_ProvisionSave_t             save;
+	void                            *context;
+	TCGS_Session_t                   session;
+	TCGS_ProvisionSSC_t              ssc;
+	TCGS_ProvisionStep_t             step;          //running step, the failed one after failure
+	TCGS_MethodStatus_t              status;        //status of the last method
+	uint32                           sessions;      //sessions started by the run
+} TCGS_Provision_t;
+
+/*****************************************************************************
+ * \brief Initializes provisioning of device
+ *
+ * @param[out] provision            provisioning
+ * @param[in]  device               device
+ * @param[in]  provisionTemplate    template
+ * @param[in]  checkpoint           zeroed checkpoint or checkpoint of interrupted run
+ * @param[in]  save                 stores checkpoint after every step, may be NULL
+ * @param[in]  context              context of save
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Provision_Init(TCGS_Provision_t *provision, TCGS_Device_t *device,
+		const TCGS_ProvisionTemplate_t *provisionTemplate, TCGS_ProvisionCheckpoint_t *checkpoint,
+		TCGS_ProvisionSave_t save, void *context);
+
+/*****************************************************************************
+ * \brief Runs steps that are not completed yet
+ *
+ * \par SSC of the device is detected with Level 0 Discovery. Only Opal 1.0
+ * and Opal 2.0 devices are provisioned, Enterprise SSC devices are rejected
+ * with ERROR_PARAMETER.
+ *
+ * \par Admin SP session is started anonymously, MSID is read and SID is
+ * authenticated within it. A step is completed when its changes are made,
+ * the checkpoint is stored after each step. Steps that change PIN may be
+ * done before the run was interrupted while the checkpoint was not stored,
+ * so both PINs are tried on resume.
+ *
+ * @param[in]  provision    provisioning
+ *
+ * \return ERROR_SUCCESS if all steps are completed, ERROR_PARAMETER if
+ * template doesn't fit the device or checkpoint is not stored, error of
+ * the failed step otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_Provision_Run(TCGS_Provision_t *provision);
+
+#endif //_TCGS_PROVISION_H
@@ -0,0 +1,207 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_resume.c
+///
+/// Unlock of drives on resume with credentials kept in kernel keyring
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/keyctl.h>
+#endif //__linux__
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+#include "tcgs_uid.h"
+#include "tcgs_hash.h"
+#include "libtcgstorage.h"
+#include "tcgs_resume.h"
+
+//keys are read and written with system calls, so libkeyutils is not needed
+#if defined(__linux__)
+#define TCGS_Resume_AddKey(description, data, length, keyring) \
+	syscall(__NR_add_key, "user", (description), (data), (size_t)(length), (keyring))
+#define TCGS_Resume_KeyCtl(command, a, b, c, d) \
+	syscall(__NR_keyctl, (command), (a), (b), (c), (d))
+#endif //__linux__
+
+TCGS_Error_t TCGS_ResumeDrive_Init(TCGS_ResumeDrive_t *drive, TCGS_Device_t *device,
+		const TCGS_UID_t *authority, const TCGS_UID_t *ranges, uint32 rangeCount)
+{
+	if (rangeCount > TCGS_RESUME_MAX_RANGES)
+	{
+		return ERROR_PARAMETER;
+	}
+	memset(drive, 0, sizeof(*drive));
+	drive->device = device;
+	drive->authority = *authority;
+	memcpy(drive->ranges, ranges, rangeCount * sizeof(*ranges));
+	drive->rangeCount = rangeCount;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Resume_StoreCredential(TCGS_ResumeDrive_t *drive, int keyring,
+		const char *description, const void *credential, uint32 credentialLength)
+{
+#if defined(__linux__)
+	long key;
+
+	if (credentialLength > TCGS_MAX_CREDENTIAL_LENGTH)
+	{
+		return ERROR_PARAMETER;
+	}
+	key = TCGS_Resume_AddKey(description, credential, credentialLength, keyring);
+	if (key <= 0)
+	{
+		return ERROR_PARAMETER;
+	}
+	drive->key = (int)key;
+	return ERROR_SUCCESS;
+#else
+	return ERROR_PARAMETER;
+#endif //__linux__
+}
+
+TCGS_Error_t TCGS_Resume_FindCredential(TCGS_ResumeDrive_t *drive, int keyring,
+		const char *description)
+{
+#if defined(__linux__)
+	long key = TCGS_Resume_KeyCtl(KEYCTL_SEARCH, keyring, "user", description, 0);
+
+	if (key <= 0)
+	{
+		return ERROR_PARAMETER;
+	}
+	drive->key = (int)key;
+	return ERROR_SUCCESS;
+#else
+	return ERROR_PARAMETER;
+#endif //__linux__
+}
+
+void TCGS_Resume_RevokeCredential(TCGS_ResumeDrive_t *drive)
+{
+#if defined(__linux__)
+	if (drive->key != 0)
+	{
+		TCGS_Resume_KeyCtl(KEYCTL_REVOKE, drive->key, 0, 0, 0);
+	}
+#endif //__linux__
+	drive->key = 0;
+}
+
+/*
+ * Reads credential from the key and starts session of the drive
+ */
+static TCGS_Error_t TCGS_Resume_StartSession(TCGS_ResumeDrive_t *drive)
+{
+	TCGS_Error_t error;
+	long length = -1;
+
+#if defined(__linux__)
+	if (drive->key != 0)
+	{
+		length = TCGS_Resume_KeyCtl(KEYCTL_READ, drive->key, drive->credential,
+				sizeof(drive->credential), 0);
+	}
+#endif //__linux__
+	if (length < 0 || length > (long)sizeof(drive->credential))
+	{
+		//part of longer key may be copied by older kernels
+		TCGS_Zeroize(drive->credential, sizeof(drive->credential));
+		return ERROR_PARAMETER;
+	}
+	error = TCGS_StartSession(&drive->session, drive->device, &TCGS_UID_LockingSP, &drive->authority,
+			drive->credential, (uint32)length, TRUE, &drive->status);
+	TCGS_Zeroize(drive->credential, sizeof(drive->credential));
+	return error;
+}
+
+static TCGS_Error_t TCGS_Resume_UnlockDrive(TCGS_ResumeDrive_t *drive)
+{
+	TCGS_Level0Discovery_FeatureLocking_t *locking;
+	TCGS_Builder_t *builder;
+	TCGS_Parser_t response;
+	TCGS_MethodStatus_t status;
+	TCGS_Error_t error, endError;
+	bool setMbrDone;
+	uint32 calls, i;
+
+	error = TCGS_Device_Level0DiscoveryQuiet(drive->device, drive->discovery);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	locking = TCGS_GetLevel0DiscoveryFeatureLockingHeader((TCGS_Level0Discovery_Header_t*)drive->discovery);
+	if (locking == NULL)
+	{
+		return ERROR_SUCCESS;
+	}
+	//shadow MBR is shown again after power loss until MBRDone is set
+	setMbrDone = locking->MBREnabled && !locking->MBRDone;
+	if (!locking->locked && !setMbrDone)
+	{
+		return ERROR_SUCCESS;
+	}
+
+	error = TCGS_Resume_StartSession(drive);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	builder = TCGS_Session_StartPacket(&drive->session);
+	for (i = 0; i < drive->rangeCount; i++)
+	{
+		TCGS_Builder_AddSetUInt(builder, &drive->ranges[i], TCGS_COLUMN_LOCKING_READ_LOCKED, 0);
+		TCGS_Builder_AddSetUInt(builder, &drive->ranges[i], TCGS_COLUMN_LOCKING_WRITE_LOCKED, 0);
+	}
+	calls = drive->rangeCount * 2;
+	if (setMbrDone)
+	{
+		TCGS_Builder_AddSetUInt(builder, &TCGS_UID_MBRControl, TCGS_COLUMN_MBRCONTROL_DONE, 1);
+		calls++;
+	}
+	error = TCGS_Session_Exchange(&drive->session, &response);
+	for (i = 0; error == ERROR_SUCCESS && i < calls; i++)
+	{
+		error = TCGS_Parser_GetResult(&response, NULL, &status);
+		if (error == ERROR_SUCCESS && status != METHOD_STATUS_SUCCESS)
+		{
+			drive->status = status;
+			error = ERROR_METHOD;
+		}
+	}
+	if (drive->session.open)
+	{
+		endError = TCGS_EndSession(&drive->session);
+		error = (error != ERROR_SUCCESS) ? error : endError;
+	}
+	drive->unlocked = (error == ERROR_SUCCESS);
+	return error;
+}
+
+TCGS_Error_t TCGS_Resume_Unlock(TCGS_ResumeDrive_t *drives, uint32 count)
+{
+	TCGS_Error_t error = ERROR_SUCCESS;
+	uint32 i;
+
+	for (i = 0; i < count; i++)
+	{
+		drives[i].status = METHOD_STATUS_SUCCESS;
+		drives[i].unlocked = FALSE;
+		drives[i].error = TCGS_Resume_UnlockDrive(&drives[i]);
+		if (error == ERROR_SUCCESS)
+		{
+			error = drives[i].error;
+		}
+	}
+	return error;
+}
@@ -0,0 +1,109 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_resume.h
+///
+/// Unlock of drives on resume with credentials kept in kernel keyring
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_RESUME_H
+#define _TCGS_RESUME_H
+
+#include <stdbool.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_session.h"
+
+/*****************************************************************************
+ * \brief Drive unlocked on resume
+ *
+ * \par Derived credential of the drive is stored in the kernel keyring at
+ * first unlock. All buffers of resume unlock are in the structure, so the
+ * unlock neither allocates memory nor derives credentials. Credential is read
+ * from the key right before StartSession and zeroized after it.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_Device_t        *device;
+	TCGS_UID_t            authority;
+	TCGS_UID_t            ranges[TCGS_RESUME_MAX_RANGES];
+	uint32                rangeCount;
+	int                   key;            //serial of key in kernel keyring, 0 if none
+	uint8                 credential[TCGS_MAX_CREDENTIAL_LENGTH];
+	uint8                 discovery[TCGS_BLOCK_SIZE];
+	TCGS_Session_t        session;
+
+	//result of the last resume unlock
+	TCGS_Error_t          error;
+	TCGS_MethodStatus_t   status;
+	bool                  unlocked;       //drive was locked and is unlocked now
+} TCGS_ResumeDrive_t;
+
+/*****************************************************************************
+ * \brief Initializes drive unlocked on resume
+ *
+ * @param[out] drive        drive
+ * @param[in]  device       device
+ * @param[in]  authority    authority of Locking SP allowed to unlock the ranges
+ * @param[in]  ranges       locking ranges of the drive
+ * @param[in]  rangeCount   number of ranges, up to TCGS_RESUME_MAX_RANGES
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if there are too many ranges
+ *****************************************************************************/
+TCGS_Error_t TCGS_ResumeDrive_Init(TCGS_ResumeDrive_t *drive, TCGS_Device_t *device,
+		const TCGS_UID_t *authority, const TCGS_UID_t *ranges, uint32 rangeCount);
+
+/*****************************************************************************
+ * \brief Stores credential of drive in kernel keyring
+ *
+ * \par Key of type "user" is added or updated, its serial is kept in the
+ * drive. Keyring is a special keyring ID, e.g. KEY_SPEC_USER_KEYRING, or
+ * serial of a keyring.
+ *
+ * @param[in,out] drive            drive
+ * @param[in]  keyring          keyring the key is linked to
+ * @param[in]  description      description of the key, e.g. "tcgs:" and serial number of drive
+ * @param[in]  credential       derived credential
+ * @param[in]  credentialLength length of credential, up to TCGS_MAX_CREDENTIAL_LENGTH
+ *
+ * \return ERROR_SUCCESS if the key is stored, ERROR_PARAMETER otherwise
+ *
+ * \see TCGS_DeriveCredential
+ *****************************************************************************/
+TCGS_Error_t TCGS_Resume_StoreCredential(TCGS_ResumeDrive_t *drive, int keyring,
+		const char *description, const void *credential, uint32 credentialLength);
+
+/*****************************************************************************
+ * \brief Finds key of drive stored before, e.g. by previous run of the process
+ *
+ * \return ERROR_SUCCESS if the key is found, ERROR_PARAMETER otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_Resume_FindCredential(TCGS_ResumeDrive_t *drive, int keyring,
+		const char *description);
+
+/*****************************************************************************
+ * \brief Revokes key of drive, the drive is not unlocked on resume after that
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Resume_RevokeCredential(TCGS_ResumeDrive_t *drive);
+
+/*****************************************************************************
+ * \brief Unlocks drives after resume
+ *
+ * \par Level 0 Discovery of every drive is done, locked drive is unlocked in
+ * one Locking SP session: ReadLocked and WriteLocked of its ranges are
+ * cleared and MBRDone is set if shadow MBR is enabled, all in one ComPacket.
+ * Drives that are not locked are skipped. Result of every drive is kept in
+ * it, a failed drive doesn't stop unlock of the others.
+ *
+ * @param[in,out] drives    drives
+ * @param[in]  count        number of drives
+ *
+ * \return ERROR_SUCCESS if no drive failed, error of the first failed drive otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_Resume_Unlock(TCGS_ResumeDrive_t *drives, uint32 count);
+
+#endif //_TCGS_RESUME_H
@@ -0,0 +1,179 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_retry.c
+///
+/// Retry of methods failed by transient errors with session replay
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+#include "tcgs_uid.h"
+#include "tcgs_time.h"
+#include "tcgs_operation.h"
+#include "tcgs_retry.h"
+
+//methods TPer may do twice with the same result
+static const TCGS_UID_t *idempotentMethods[] =
+{
+	&TCGS_UID_Method_Get,
+	&TCGS_UID_Method_Set,
+	&TCGS_UID_Method_Next,
+	&TCGS_UID_Method_Authenticate,
+};
+
+void TCGS_RetryPolicy_Init(TCGS_RetryPolicy_t *policy, uint32 limit, uint64 delay, uint64 maxDelay)
+{
+	memset(policy, 0, sizeof(*policy));
+	policy->limit = limit;
+	policy->delay = delay;
+	policy->maxDelay = (maxDelay > delay) ? maxDelay : delay;
+}
+
+TCGS_RetryAction_t TCGS_RetryPolicy_Classify(TCGS_Device_t *device, TCGS_Error_t error,
+		TCGS_MethodStatus_t status)
+{
+	switch (error)
+	{
+	case ERROR_METHOD:
+		if (status == METHOD_STATUS_SP_BUSY)
+		{
+			return RETRY_ACTION_REPLAY;
+		}
+		//StartSession found no free session of TPer
+		return (status == METHOD_STATUS_NO_SESSIONS_AVAILABLE) ? RETRY_ACTION_REOPEN : RETRY_ACTION_NONE;
+	case ERROR_SESSION:
+		return RETRY_ACTION_REOPEN;
+	case ERROR_INTERFACE:
+		switch (device->interfaceError)
+		{
+		case INTERFACE_ERROR_GOOD:
+			//transport failed or response didn't come, state of session is unknown
+			return RETRY_ACTION_REOPEN;
+		case INTERFACE_ERROR_SYNCHRONOUS_PROTOCOL_VIOLATION:
+			return RETRY_ACTION_REPLAY;
+		case INTERFACE_ERROR_DATA_PROTECTION:
+			//integrity failure of the drive, sending again would hide it
+			return RETRY_ACTION_NONE;
+		default:
+			return RETRY_ACTION_NONE;
+		}
+	default:
+		return RETRY_ACTION_NONE;
+	}
+}
+
+TCGS_Error_t TCGS_RetryPolicy_Backoff(TCGS_RetryPolicy_t *policy, uint32 attempt)
+{
+	return TCGS_Operation_Backoff(policy->delay, policy->maxDelay, attempt);
+}
+
+/*
+ * Checks that ComPacket of the session has only calls of idempotent methods
+ */
+static bool TCGS_RetryPolicy_IsIdempotent(TCGS_Session_t *session)
+{
+	TCGS_Parser_t parser;
+	TCGS_UID_t uid;
+	uint32 i;
+
+	TCGS_Parser_Init(&parser, session->sendBuffer + TCGS_PACKET_HEADERS_LENGTH,
+			TCGS_Builder_GetDataLength(&session->builder));
+	while (!TCGS_Parser_AtEnd(&parser))
+	{
+		if (TCGS_Parser_Expect(&parser, TOKEN_CALL))
+		{
+			if (!TCGS_Parser_GetUID(&parser, &uid) || !TCGS_Parser_GetUID(&parser, &uid))
+			{
+				return FALSE;
+			}
+			for (i = 0; i < sizeof(idempotentMethods) / sizeof(idempotentMethods[0]); i++)
+			{
+				if (memcmp(&uid, idempotentMethods[i], sizeof(uid)) == 0)
+				{
+					break;
+				}
+			}
+			if (i == sizeof(idempotentMethods) / sizeof(idempotentMethods[0]))
+			{
+				return FALSE;
+			}
+		}
+		//transaction and session tokens are not skipped as values
+		else if (!TCGS_Parser_Expect(&parser, TOKEN_END_OF_DATA) && !TCGS_Parser_SkipValue(&parser))
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static TCGS_Error_t TCGS_RetryPolicy_Reopen(TCGS_RetryPolicy_t *policy, TCGS_Session_t *session,
+		const void *credential, uint32 credentialLength, TCGS_MethodStatus_t *status)
+{
+	TCGS_UID_t sp = session->sp;
+	TCGS_UID_t authority = session->authority;
+	bool anybody = (memcmp(&authority, &TCGS_UID_Anybody, sizeof(authority)) == 0);
+
+	__sync_fetch_and_add(&policy->reopens, 1);
+	return TCGS_StartSession(session, session->device, &sp, anybody ? NULL : &authority,
+			anybody ? NULL : credential, credentialLength, session->write, status);
+}
+
+TCGS_Error_t TCGS_RetryPolicy_Call(TCGS_RetryPolicy_t *policy, TCGS_Session_t *session,
+		const void *credential, uint32 credentialLength,
+		TCGS_RetryBuild_t build, void *context,
+		TCGS_Parser_t *results, TCGS_MethodStatus_t *status)
+{
+	TCGS_MethodStatus_t methodStatus;
+	TCGS_RetryAction_t action;
+	TCGS_Error_t error;
+	bool idempotent;
+	uint32 attempt;
+
+	for (attempt = 0; ; attempt++)
+	{
+		methodStatus = METHOD_STATUS_SUCCESS;
+		idempotent = TRUE;
+		error = ERROR_SUCCESS;
+		if (!session->open)
+		{
+			error = TCGS_RetryPolicy_Reopen(policy, session, credential, credentialLength, &methodStatus);
+		}
+		if (error == ERROR_SUCCESS)
+		{
+			build(TCGS_Session_StartPacket(session), context);
+			idempotent = TCGS_RetryPolicy_IsIdempotent(session);
+			error = TCGS_Session_Call(session, results, &methodStatus);
+		}
+		action = TCGS_RetryPolicy_Classify(session->device, error, methodStatus);
+		//methods refused as busy were not done, lost ones may have been
+		if (action == RETRY_ACTION_NONE || attempt == policy->limit ||
+			(error != ERROR_METHOD && !idempotent))
+		{
+			break;
+		}
+		if (action == RETRY_ACTION_REOPEN && session->open)
+		{
+			TCGS_EndSession(session);
+		}
+		error = TCGS_RetryPolicy_Backoff(policy, attempt);
+		if (error != ERROR_SUCCESS)
+		{
+			break;
+		}
+		__sync_fetch_and_add(&policy->retries, 1);
+	}
+	if (status != NULL)
+	{
+		*status = methodStatus;
+	}
+	return error;
+}
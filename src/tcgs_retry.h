@@ -0,0 +1,128 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_retry.h
+///
+/// Retry of methods failed by transient errors with session replay
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_RETRY_H
+#define _TCGS_RETRY_H
+
+#include <stdbool.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+
+typedef enum
+{
+	RETRY_ACTION_NONE,      //permanent error or success
+	RETRY_ACTION_REPLAY,    //the same ComPacket may be sent again in the session
+	RETRY_ACTION_REOPEN,    //session is lost or its state is unknown, it is started again
+} TCGS_RetryAction_t;
+
+/*****************************************************************************
+ * \brief Policy of retries shared by sessions of many devices
+ *
+ * \par Delay before retry n is a random value between half and the whole of
+ * delay * 2^n, but not more than maxDelay. Random spread keeps sessions
+ * failed by the same event from retrying at once.
+ *****************************************************************************/
+typedef struct
+{
+	uint32  limit;          //retries of a method
+	uint64  delay;          //nanoseconds before the first retry
+	uint64  maxDelay;       //upper bound of delay in nanoseconds
+	uint64  retries;        //methods sent again
+	uint64  reopens;        //sessions started again
+} TCGS_RetryPolicy_t;
+
+/*****************************************************************************
+ * \brief Adds methods to ComPacket of session
+ *
+ * \par Called for every attempt, so it shall add the same methods each time.
+ *
+ * @param[in]  builder      builder of the session ComPacket
+ * @param[in]  context      context given to TCGS_RetryPolicy_Call
+ *
+ * \return None
+ *****************************************************************************/
+typedef void (*TCGS_RetryBuild_t)(TCGS_Builder_t *builder, void *context);
+
+/*****************************************************************************
+ * \brief Initializes retry policy
+ *
+ * @param[out] policy       policy
+ * @param[in]  limit        retries of a method
+ * @param[in]  delay        nanoseconds before the first retry
+ * @param[in]  maxDelay     upper bound of delay in nanoseconds
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_RetryPolicy_Init(TCGS_RetryPolicy_t *policy, uint32 limit, uint64 delay, uint64 maxDelay);
+
+/*****************************************************************************
+ * \brief Classifies failure of method of session
+ *
+ * \par Interface errors are taken from the last command sent to device.
+ * Busy SP and lack of free sessions are transient, as well as protocol
+ * violations of the interface. Invalid command parameters, data protection
+ * errors, authorization failures and expired or cancelled operations are
+ * permanent: data protection error is an integrity failure of the drive
+ * that resending doesn't fix and would hide.
+ *
+ * @param[in]  device       device of the session
+ * @param[in]  error        error returned by session function
+ * @param[in]  status       method status for ERROR_METHOD
+ *
+ * \return TCGS_RetryAction_t action recovering from the failure
+ *****************************************************************************/
+TCGS_RetryAction_t TCGS_RetryPolicy_Classify(TCGS_Device_t *device, TCGS_Error_t error,
+		TCGS_MethodStatus_t status);
+
+/*****************************************************************************
+ * \brief Waits before retry
+ *
+ * @param[in]  policy       policy
+ * @param[in]  attempt      number of the retry, starting with 0
+ *
+ * \return ERROR_SUCCESS, ERROR_TIMEOUT or ERROR_CANCELLED if operation of the
+ * thread is interrupted while waiting
+ *
+ * \see TCGS_Operation_Sleep
+ *****************************************************************************/
+TCGS_Error_t TCGS_RetryPolicy_Backoff(TCGS_RetryPolicy_t *policy, uint32 attempt);
+
+/*****************************************************************************
+ * \brief Invokes methods in session, retrying transient failures
+ *
+ * \par Methods refused by TPer as busy are sent again. ComPacket lost in
+ * transport or with the session is sent again only if all its methods are
+ * idempotent (Get, Set, Next, Authenticate) and not in transaction: other
+ * methods may have been done by TPer. Dropped session is started again with
+ * the same SP, authority and write mode, the authority is authenticated with
+ * the credential.
+ *
+ * @param[in]  policy           policy
+ * @param[in]  session          session, it may be closed by TPer
+ * @param[in]  credential       credential of authority of the session, NULL if none
+ * @param[in]  credentialLength length of credential
+ * @param[in]  build            adds methods to ComPacket
+ * @param[in]  context          context of build
+ * @param[out] results          parser of values returned by the first method, may be NULL
+ * @param[out] status           method status, may be NULL
+ *
+ * \return the same codes as TCGS_Session_Call for the last attempt
+ *
+ * \see TCGS_Session_Call, TCGS_RetryPolicy_Classify
+ *****************************************************************************/
+TCGS_Error_t TCGS_RetryPolicy_Call(TCGS_RetryPolicy_t *policy, TCGS_Session_t *session,
+		const void *credential, uint32 credentialLength,
+		TCGS_RetryBuild_t build, void *context,
+		TCGS_Parser_t *results, TCGS_MethodStatus_t *status);
+
+#endif //_TCGS_RETRY_H
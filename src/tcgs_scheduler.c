@@ -0,0 +1,288 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_scheduler.c
+///
+/// Priority scheduler of device operations sharing host bus adapters
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_interface.h"
+#include "tcgs_time.h"
+#include "tcgs_scheduler.h"
+
+void TCGS_SchedulerAdapter_Init(TCGS_SchedulerAdapter_t *adapter, uint32 limit)
+{
+	adapter->limit = (limit != 0) ? limit : 1;
+	adapter->inFlight = 0;
+}
+
+void TCGS_Scheduler_Init(TCGS_Scheduler_t *scheduler, TCGS_SchedulerQueue_t *queues,
+		TCGS_Device_t *devices, TCGS_SchedulerAdapter_t **adapters, uint32 count,
+		TCGS_SchedulerWorker_t *workers, uint32 workerCount)
+{
+	uint32 i;
+
+	memset(scheduler, 0, sizeof(*scheduler));
+	scheduler->queues = queues;
+	scheduler->queueCount = count;
+	scheduler->workers = workers;
+	scheduler->workerCount = workerCount;
+	pthread_mutex_init(&scheduler->lock, NULL);
+	pthread_cond_init(&scheduler->wake, NULL);
+
+	memset(queues, 0, count * sizeof(*queues));
+	for (i = 0; i < count; i++)
+	{
+		queues[i].device = &devices[i];
+		queues[i].adapter = adapters[i];
+		queues[i].owner = i % workerCount;
+	}
+	memset(workers, 0, workerCount * sizeof(*workers));
+	for (i = 0; i < workerCount; i++)
+	{
+		workers[i].scheduler = scheduler;
+		workers[i].index = i;
+		pthread_mutex_init(&workers[i].lock, NULL);
+	}
+}
+
+static bool TCGS_Scheduler_AcquireSlot(TCGS_SchedulerAdapter_t *adapter, TCGS_SchedulerClass_t priorityClass)
+{
+	uint32 limit = adapter->limit;
+	uint32 inFlight;
+
+	if (priorityClass == SCHEDULER_CLASS_BULK && limit > 1)
+	{
+		limit--;
+	}
+	do
+	{
+		inFlight = adapter->inFlight;
+		if (inFlight >= limit)
+		{
+			return FALSE;
+		}
+	} while (!__sync_bool_compare_and_swap(&adapter->inFlight, inFlight, inFlight + 1));
+	return TRUE;
+}
+
+/*
+ * Takes job of the given class that may be started from queues of the
+ * worker, the search starts with the next queue after the last taken one.
+ * Lock of the worker is held by the caller.
+ */
+static TCGS_SchedulerJob_t *TCGS_Scheduler_TakeJob(TCGS_Scheduler_t *scheduler,
+		TCGS_SchedulerWorker_t *worker, uint32 priorityClass, TCGS_SchedulerQueue_t **taken)
+{
+	TCGS_SchedulerQueue_t *queue;
+	TCGS_SchedulerJob_t *job;
+	uint32 owned, k, position;
+
+	if (worker->index >= scheduler->queueCount)
+	{
+		return NULL;
+	}
+	owned = (scheduler->queueCount - worker->index + scheduler->workerCount - 1) / scheduler->workerCount;
+	for (k = 0; k < owned; k++)
+	{
+		position = (worker->cursor + k) % owned;
+		queue = &scheduler->queues[worker->index + position * scheduler->workerCount];
+		job = queue->head[priorityClass];
+		if (job == NULL || queue->running ||
+			!TCGS_Scheduler_AcquireSlot(queue->adapter, priorityClass))
+		{
+			continue;
+		}
+		queue->head[priorityClass] = job->next;
+		if (queue->head[priorityClass] == NULL)
+		{
+			queue->tail[priorityClass] = NULL;
+		}
+		queue->running = TRUE;
+		worker->cursor = position + 1;
+		*taken = queue;
+		return job;
+	}
+	return NULL;
+}
+
+static void TCGS_Scheduler_Run(TCGS_Scheduler_t *scheduler, TCGS_SchedulerWorker_t *worker,
+		TCGS_SchedulerQueue_t *queue, TCGS_SchedulerJob_t *job)
+{
+	TCGS_SchedulerClassStats_t *stats = &scheduler->stats[job->priorityClass];
+	TCGS_SchedulerWorker_t *owner = &scheduler->workers[queue->owner];
+	uint64 wait = TCGS_GetTime() - job->enqueued;
+	uint64 maxWait;
+
+	__sync_fetch_and_sub(&stats->depth, 1);
+	__sync_fetch_and_add(&stats->started, 1);
+	__sync_fetch_and_add(&stats->waitTime, wait);
+	do
+	{
+		maxWait = stats->maxWait;
+	} while (wait > maxWait && !__sync_bool_compare_and_swap(&stats->maxWait, maxWait, wait));
+
+	job->error = job->work(queue->device, job->context);
+	worker->jobs++;
+
+	__sync_fetch_and_sub(&queue->adapter->inFlight, 1);
+	pthread_mutex_lock(&owner->lock);
+	queue->running = FALSE;
+	pthread_mutex_unlock(&owner->lock);
+
+	pthread_mutex_lock(&scheduler->lock);
+	job->done = TRUE;
+	scheduler->pending--;
+	scheduler->events++;
+	pthread_cond_broadcast(&scheduler->wake);
+	pthread_mutex_unlock(&scheduler->lock);
+}
+
+static void *TCGS_Scheduler_Worker(void *argument)
+{
+	TCGS_SchedulerWorker_t *worker = argument;
+	TCGS_Scheduler_t *scheduler = worker->scheduler;
+	TCGS_SchedulerWorker_t *victim;
+	TCGS_SchedulerQueue_t *queue = NULL;
+	TCGS_SchedulerJob_t *job;
+	uint64 seen;
+	uint32 priorityClass, k;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&scheduler->lock);
+		seen = scheduler->events;
+		pthread_mutex_unlock(&scheduler->lock);
+
+		//by class, own queues first, then queues of the other workers, so a
+		//free adapter slot is not taken by own bulk job while a locking job
+		//of another worker waits
+		job = NULL;
+		for (priorityClass = 0; priorityClass < SCHEDULER_CLASSES && job == NULL; priorityClass++)
+		{
+			for (k = 0; k < scheduler->workerCount && job == NULL; k++)
+			{
+				victim = &scheduler->workers[(worker->index + k) % scheduler->workerCount];
+				pthread_mutex_lock(&victim->lock);
+				job = TCGS_Scheduler_TakeJob(scheduler, victim, priorityClass, &queue);
+				pthread_mutex_unlock(&victim->lock);
+			}
+		}
+		if (job != NULL)
+		{
+			worker->stolen += (k > 1) ? 1 : 0;
+			TCGS_Scheduler_Run(scheduler, worker, queue, job);
+			continue;
+		}
+
+		//nothing may be started until a job is submitted or completed
+		pthread_mutex_lock(&scheduler->lock);
+		while (scheduler->events == seen && !(scheduler->stop && scheduler->pending == 0))
+		{
+			pthread_cond_wait(&scheduler->wake, &scheduler->lock);
+		}
+		if (scheduler->stop && scheduler->pending == 0)
+		{
+			pthread_mutex_unlock(&scheduler->lock);
+			break;
+		}
+		pthread_mutex_unlock(&scheduler->lock);
+	}
+	return NULL;
+}
+
+static void TCGS_Scheduler_Join(TCGS_Scheduler_t *scheduler, uint32 count)
+{
+	uint32 i;
+
+	pthread_mutex_lock(&scheduler->lock);
+	scheduler->stop = TRUE;
+	pthread_cond_broadcast(&scheduler->wake);
+	pthread_mutex_unlock(&scheduler->lock);
+	for (i = 0; i < count; i++)
+	{
+		pthread_join(scheduler->workers[i].thread, NULL);
+	}
+}
+
+TCGS_Error_t TCGS_Scheduler_Start(TCGS_Scheduler_t *scheduler)
+{
+	uint32 i;
+
+	for (i = 0; i < scheduler->workerCount; i++)
+	{
+		if (pthread_create(&scheduler->workers[i].thread, NULL, TCGS_Scheduler_Worker,
+				&scheduler->workers[i]) != 0)
+		{
+			TCGS_Scheduler_Join(scheduler, i);
+			return ERROR_PARAMETER;
+		}
+	}
+	return ERROR_SUCCESS;
+}
+
+void TCGS_Scheduler_Stop(TCGS_Scheduler_t *scheduler)
+{
+	uint32 i;
+
+	TCGS_Scheduler_Join(scheduler, scheduler->workerCount);
+	for (i = 0; i < scheduler->workerCount; i++)
+	{
+		pthread_mutex_destroy(&scheduler->workers[i].lock);
+	}
+	pthread_cond_destroy(&scheduler->wake);
+	pthread_mutex_destroy(&scheduler->lock);
+}
+
+void TCGS_Scheduler_Submit(TCGS_Scheduler_t *scheduler, uint32 device, TCGS_SchedulerJob_t *job,
+		TCGS_SchedulerClass_t priorityClass, TCGS_SchedulerWork_t work, void *context)
+{
+	TCGS_SchedulerQueue_t *queue = &scheduler->queues[device];
+	TCGS_SchedulerWorker_t *owner = &scheduler->workers[queue->owner];
+
+	job->work = work;
+	job->context = context;
+	job->priorityClass = priorityClass;
+	job->error = ERROR_SUCCESS;
+	job->done = FALSE;
+	job->next = NULL;
+
+	//counted before a worker may take the job
+	pthread_mutex_lock(&scheduler->lock);
+	scheduler->pending++;
+	pthread_mutex_unlock(&scheduler->lock);
+	__sync_fetch_and_add(&scheduler->stats[priorityClass].depth, 1);
+
+	pthread_mutex_lock(&owner->lock);
+	job->enqueued = TCGS_GetTime();
+	if (queue->tail[priorityClass] != NULL)
+	{
+		queue->tail[priorityClass]->next = job;
+	}
+	else
+	{
+		queue->head[priorityClass] = job;
+	}
+	queue->tail[priorityClass] = job;
+	pthread_mutex_unlock(&owner->lock);
+
+	pthread_mutex_lock(&scheduler->lock);
+	scheduler->events++;
+	pthread_cond_broadcast(&scheduler->wake);
+	pthread_mutex_unlock(&scheduler->lock);
+}
+
+TCGS_Error_t TCGS_Scheduler_Wait(TCGS_Scheduler_t *scheduler, TCGS_SchedulerJob_t *job)
+{
+	pthread_mutex_lock(&scheduler->lock);
+	while (!job->done)
+	{
+		pthread_cond_wait(&scheduler->wake, &scheduler->lock);
+	}
+	pthread_mutex_unlock(&scheduler->lock);
+	return job->error;
+}
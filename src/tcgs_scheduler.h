@@ -0,0 +1,174 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_scheduler.h
+///
+/// Priority scheduler of device operations sharing host bus adapters
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_SCHEDULER_H
+#define _TCGS_SCHEDULER_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_interface.h"
+
+//priority classes, jobs of a lower class are started first
+typedef enum
+{
+	SCHEDULER_CLASS_LOCKING,    //lock and unlock of ranges
+	SCHEDULER_CLASS_ADMIN,      //configuration and queries
+	SCHEDULER_CLASS_BULK,       //audits, MBR uploads and other long transfers
+	SCHEDULER_CLASSES,
+} TCGS_SchedulerClass_t;
+
+/*****************************************************************************
+ * \brief Adapter (HBA, NVMe switch) shared by devices
+ *
+ * \par Bulk jobs leave one slot of the adapter to jobs of other classes if
+ * limit is above one.
+ *****************************************************************************/
+typedef struct
+{
+	uint32           limit;      //jobs of devices of the adapter run at once
+	volatile uint32  inFlight;
+} TCGS_SchedulerAdapter_t;
+
+/*****************************************************************************
+ * \brief Runs job on device
+ *
+ * @param[in]  device       device of the queue the job is submitted to
+ * @param[in]  context      context of the job
+ *
+ * \return error of the job
+ *****************************************************************************/
+typedef TCGS_Error_t (*TCGS_SchedulerWork_t)(TCGS_Device_t *device, void *context);
+
+typedef struct TCGS_SchedulerJob
+{
+	TCGS_SchedulerWork_t       work;
+	void                      *context;
+	TCGS_SchedulerClass_t      priorityClass;
+	TCGS_Error_t               error;      //returned by work
+	uint64                     enqueued;
+	volatile bool              done;
+	struct TCGS_SchedulerJob  *next;
+} TCGS_SchedulerJob_t;
+
+//jobs of one device, run one at a time in order of submission within class
+typedef struct
+{
+	TCGS_Device_t            *device;
+	TCGS_SchedulerAdapter_t  *adapter;
+	TCGS_SchedulerJob_t      *head[SCHEDULER_CLASSES];
+	TCGS_SchedulerJob_t      *tail[SCHEDULER_CLASSES];
+	bool                      running;
+	uint32                    owner;      //worker the queue belongs to
+} TCGS_SchedulerQueue_t;
+
+struct TCGS_Scheduler;
+
+typedef struct
+{
+	struct TCGS_Scheduler  *scheduler;
+	uint32                  index;
+	pthread_t               thread;
+	pthread_mutex_t         lock;       //protects queues of the worker
+	uint32                  cursor;     //own queue the next search starts with
+	uint64                  jobs;       //jobs run by the worker
+	uint64                  stolen;     //jobs taken from queues of other workers
+} TCGS_SchedulerWorker_t;
+
+typedef struct
+{
+	volatile uint32  depth;      //jobs waiting in queues
+	uint64           started;
+	uint64           waitTime;   //total nanoseconds from submission to start
+	uint64           maxWait;
+} TCGS_SchedulerClassStats_t;
+
+/*****************************************************************************
+ * \brief Scheduler of jobs of many devices
+ *
+ * \par Every queue belongs to a worker. A worker starts the job of the
+ * highest class among its queues whose device is idle and whose adapter has
+ * a free slot. Worker without such a job steals one from queues of other
+ * workers, so a long job doesn't hold up the other devices of its worker.
+ *****************************************************************************/
+typedef struct TCGS_Scheduler
+{
+	TCGS_SchedulerQueue_t       *queues;
+	uint32                       queueCount;
+	TCGS_SchedulerWorker_t      *workers;
+	uint32                       workerCount;
+	pthread_mutex_t              lock;       //protects events, stop, pending and done flags of jobs
+	pthread_cond_t               wake;       //signalled on every event
+	uint64                       events;     //submissions and completions
+	bool                         stop;
+	uint32                       pending;    //jobs submitted and not done
+	TCGS_SchedulerClassStats_t   stats[SCHEDULER_CLASSES];
+} TCGS_Scheduler_t;
+
+void TCGS_SchedulerAdapter_Init(TCGS_SchedulerAdapter_t *adapter, uint32 limit);
+
+/*****************************************************************************
+ * \brief Initializes scheduler
+ *
+ * \par Queues are assigned to workers in turn. Workers are started by
+ * TCGS_Scheduler_Start, jobs may be submitted before.
+ *
+ * @param[out] scheduler    scheduler
+ * @param[out] queues       queues, one per device
+ * @param[in]  devices      devices
+ * @param[in]  adapters     adapter of every device
+ * @param[in]  count        number of devices
+ * @param[out] workers      workers
+ * @param[in]  workerCount  number of workers
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Scheduler_Init(TCGS_Scheduler_t *scheduler, TCGS_SchedulerQueue_t *queues,
+		TCGS_Device_t *devices, TCGS_SchedulerAdapter_t **adapters, uint32 count,
+		TCGS_SchedulerWorker_t *workers, uint32 workerCount);
+
+/*****************************************************************************
+ * \brief Starts worker threads
+ *
+ * \return ERROR_SUCCESS, ERROR_PARAMETER if a thread is not created
+ *****************************************************************************/
+TCGS_Error_t TCGS_Scheduler_Start(TCGS_Scheduler_t *scheduler);
+
+/*****************************************************************************
+ * \brief Runs submitted jobs to completion and stops workers
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Scheduler_Stop(TCGS_Scheduler_t *scheduler);
+
+/*****************************************************************************
+ * \brief Queues job of device
+ *
+ * @param[in]  scheduler        scheduler
+ * @param[in]  device           index of the device
+ * @param[out] job              job, kept by caller until it is done
+ * @param[in]  priorityClass    class of the job
+ * @param[in]  work             function of the job
+ * @param[in]  context          context of work
+ *
+ * \return None
+ *
+ * \see TCGS_Scheduler_Wait
+ *****************************************************************************/
+void TCGS_Scheduler_Submit(TCGS_Scheduler_t *scheduler, uint32 device, TCGS_SchedulerJob_t *job,
+		TCGS_SchedulerClass_t priorityClass, TCGS_SchedulerWork_t work, void *context);
+
+/*****************************************************************************
+ * \brief Waits for job to be done
+ *
+ * \return error returned by work of the job
+ *****************************************************************************/
+TCGS_Error_t TCGS_Scheduler_Wait(TCGS_Scheduler_t *scheduler, TCGS_SchedulerJob_t *job);
+
+#endif //_TCGS_SCHEDULER_H
@@ -0,0 +1,557 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_session.c
+///
+/// Sessions with Security Providers of TPer
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+#include "tcgs_uid.h"
+#include "tcgs_time.h"
+#include "tcgs_operation.h"
+#include "tcgs_comid.h"
+
+//host session numbers are unique within the process
+static uint32 lastHostSessionNumber;
+
+static void TCGS_Session_SetStatus(TCGS_MethodStatus_t *status, TCGS_MethodStatus_t value)
+{
+	if (status != NULL)
+	{
+		*status = value;
+	}
+}
+
+static TCGS_Error_t TCGS_Session_SendPacket(TCGS_Session_t *session)
+{
+	TCGS_CommandBlock_t commandBlock;
+	TCGS_InterfaceError_t interfaceError;
+	TCGS_Error_t status;
+
+	TCGS_PrepareInterfaceCommand(PACKET, session->sendBuffer, &commandBlock, NULL);
+	status = TCGS_Device_SendCommand(session->device, &commandBlock, session->sendBuffer,
+			&interfaceError, NULL);
+	if (status != ERROR_SUCCESS || interfaceError != INTERFACE_ERROR_GOOD)
+	{
+		return TCGS_IsOperationError(status) ? status : ERROR_INTERFACE;
+	}
+	return ERROR_SUCCESS;
+}
+
+/*
+ * Repeats IF-RECV while TPer reports that the response is not ready yet.
+ * Lock of the device is held by the caller for the whole poll, sleeps
+ * included: TPer answers ComPackets on a ComID one at a time, IF-SEND of
+ * another thread before the response is read would violate the synchronous
+ * protocol. The wait is bounded by TCGS_SESSION_POLL_LIMIT and by the
+ * deadline of the operation.
+ */
+static TCGS_Error_t TCGS_Session_Poll(TCGS_Session_t *session,
+		uint32 tperSessionNumber, uint32 hostSessionNumber,
+		uint8 *buffer, uint32 size, TCGS_Parser_t *response)
+{
+	TCGS_CommandBlock_t commandBlock;
+	TCGS_InterfaceError_t interfaceError;
+	TCGS_ComPacketInfo_t info;
+	TCGS_Error_t status;
+	uint32 attempt;
+
+	TCGS_PrepareInterfaceCommand(PACKET_RESPONSE, session->sendBuffer, &commandBlock, NULL);
+	//TPer doesn't write past the buffer, the transfer is whole blocks
+	if (size < TCGS_GetTransferLength(&commandBlock))
+	{
+		commandBlock.length = size / TCGS_BLOCK_SIZE;
+	}
+	if (commandBlock.length == 0)
+	{
+		return ERROR_PARAMETER;
+	}
+	for (attempt = 0; attempt < TCGS_SESSION_POLL_LIMIT; attempt++)
+	{
+		status = TCGS_Device_SendCommand(session->device, &commandBlock, NULL,
+				&interfaceError, buffer);
+		if (status != ERROR_SUCCESS || interfaceError != INTERFACE_ERROR_GOOD)
+		{
+			return TCGS_IsOperationError(status) ? status : ERROR_INTERFACE;
+		}
+		status = TCGS_ParseComPacket(buffer, size, &info, response);
+		if (status != ERROR_SUCCESS)
+		{
+			return status;
+		}
+		if (response->length > 0)
+		{
+			if (info.tperSessionNumber != tperSessionNumber ||
+				info.hostSessionNumber != hostSessionNumber)
+			{
+				return ERROR_SESSION;
+			}
+			return ERROR_SUCCESS;
+		}
+		if (info.outstandingData == 0)
+		{
+			//TPer has nothing to return: the packet was discarded
+			return ERROR_SESSION;
+		}
+		status = TCGS_Operation_Sleep(TCGS_SESSION_POLL_INTERVAL * TCGS_NSEC_PER_USEC);
+		if (status != ERROR_SUCCESS)
+		{
+			return status;
+		}
+	}
+	return ERROR_INTERFACE;
+}
+
+/*
+ * Reads response to ComPacket sent by TCGS_Session_Send into the buffer of
+ * the session, the device is locked by the caller. Response of another
+ * session is read within the clean-up time, so it doesn't depend on the
+ * operation of the thread that locked the device next.
+ */
+static void TCGS_Session_Drain(TCGS_Session_t *session, bool own)
+{
+	TCGS_Operation_t cleanup;
+
+	if (!own)
+	{
+		TCGS_Operation_Init(&cleanup, TCGS_OPERATION_CLEANUP_TIMEOUT * TCGS_NSEC_PER_MSEC);
+		TCGS_Operation_BeginCleanup(&cleanup);
+	}
+	session->pendingError = TCGS_Session_Poll(session, session->tperSessionNumber,
+			session->hostSessionNumber, session->pendingBuffer, session->pendingSize,
+			&session->pendingResponse);
+	if (!own)
+	{
+		TCGS_Operation_End(&cleanup);
+	}
+	session->device->pendingSession = NULL;
+}
+
+/*
+ * Locks device for exchange of the session. Response pending for a session
+ * of the device is read first, so it isn't returned to this exchange.
+ */
+static TCGS_Error_t TCGS_Session_LockDevice(TCGS_Session_t *session)
+{
+	TCGS_Device_t *device = session->device;
+	TCGS_Error_t error;
+
+	error = TCGS_Device_Lock(device);
+	if (error == ERROR_SUCCESS && device->pendingSession != NULL)
+	{
+		TCGS_Session_Drain(device->pendingSession, device->pendingSession == session);
+	}
+	return error;
+}
+
+/*
+ * Reads SyncSession invoked by TPer in response to StartSession, the session
+ * is open if TPer accepted it
+ */
+static TCGS_Error_t TCGS_Session_Synchronize(TCGS_Session_t *session, TCGS_Parser_t *response,
+		TCGS_MethodStatus_t *status)
+{
+	TCGS_Parser_t results;
+	TCGS_MethodStatus_t methodStatus;
+	TCGS_Error_t error;
+	TCGS_UID_t uid;
+	uint64 hostSessionNumber, tperSessionNumber;
+
+	//SyncSession is invoked by TPer on the host
+	if (TCGS_Parser_Expect(response, TOKEN_CALL) &&
+		(!TCGS_Parser_GetUID(response, &uid) || memcmp(&uid, &TCGS_UID_SMUID, sizeof(uid)) != 0 ||
+		 !TCGS_Parser_GetUID(response, &uid) || memcmp(&uid, &TCGS_UID_Method_SyncSession, sizeof(uid)) != 0))
+	{
+		return ERROR_PARSER;
+	}
+	error = TCGS_Parser_GetResult(response, &results, &methodStatus);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	TCGS_Session_SetStatus(status, methodStatus);
+	if (methodStatus != METHOD_STATUS_SUCCESS)
+	{
+		return ERROR_METHOD;
+	}
+	if (!TCGS_Parser_GetUInt(&results, &hostSessionNumber) ||
+		!TCGS_Parser_GetUInt(&results, &tperSessionNumber) ||
+		hostSessionNumber != session->hostSessionNumber)
+	{
+		return ERROR_PARSER;
+	}
+	session->tperSessionNumber = (uint32)tperSessionNumber;
+	session->open = TRUE;
+
+	return ERROR_SUCCESS;
+}
+
+/*
+ * Closes session whose exchange was interrupted by expired or cancelled
+ * operation. Response to the interrupted ComPacket is drained first, so it
+ * isn't returned to the next exchange on the ComID. ComID is reset if TPer
+ * doesn't answer within the clean-up time.
+ */
+static void TCGS_Session_Abort(TCGS_Session_t *session)
+{
+	TCGS_Operation_t cleanup;
+	TCGS_Parser_t response;
+	TCGS_Error_t error;
+
+	TCGS_Operation_Init(&cleanup, TCGS_OPERATION_CLEANUP_TIMEOUT * TCGS_NSEC_PER_MSEC);
+	TCGS_Operation_BeginCleanup(&cleanup);
+	if (TCGS_Session_LockDevice(session) != ERROR_SUCCESS)
+	{
+		//ComID is held by another process beyond the clean-up time
+		session->open = FALSE;
+		TCGS_Operation_End(&cleanup);
+		return;
+	}
+	if (session->open)
+	{
+		error = TCGS_Session_Poll(session, session->tperSessionNumber, session->hostSessionNumber,
+				session->receiveBuffer, sizeof(session->receiveBuffer), &response);
+	}
+	else
+	{
+		//TPer may have started the session before StartSession was interrupted
+		error = TCGS_Session_Poll(session, 0, 0,
+				session->receiveBuffer, sizeof(session->receiveBuffer), &response);
+		if (error == ERROR_SUCCESS)
+		{
+			TCGS_Session_Synchronize(session, &response, NULL);
+		}
+	}
+	if (error == ERROR_SESSION)
+	{
+		//there was no response outstanding
+		error = ERROR_SUCCESS;
+	}
+
+	if (error == ERROR_SUCCESS && session->open)
+	{
+		TCGS_Builder_Init(&session->builder, session->sendBuffer, sizeof(session->sendBuffer));
+		TCGS_Builder_StartComPacket(&session->builder, session->device->comId,
+				session->tperSessionNumber, session->hostSessionNumber);
+		TCGS_Builder_AddToken(&session->builder, TOKEN_END_OF_SESSION);
+		error = TCGS_Builder_EndComPacket(&session->builder);
+		if (error == ERROR_SUCCESS)
+		{
+			error = TCGS_Session_SendPacket(session);
+		}
+		if (error == ERROR_SUCCESS)
+		{
+			error = TCGS_Session_Poll(session, session->tperSessionNumber, session->hostSessionNumber,
+					session->receiveBuffer, sizeof(session->receiveBuffer), &response);
+		}
+	}
+	TCGS_Device_Unlock(session->device);
+
+	if (error != ERROR_SUCCESS)
+	{
+		TCGS_StackReset(session->device, session->device->comId);
+	}
+	session->open = FALSE;
+	TCGS_Operation_End(&cleanup);
+}
+
+/*
+ * Sends ComPacket from the builder and polls TPer for response. Session
+ * numbers of the response shall be the same as of the request.
+ */
+static TCGS_Error_t TCGS_Session_Transfer(TCGS_Session_t *session,
+		uint32 tperSessionNumber, uint32 hostSessionNumber, TCGS_Parser_t *response)
+{
+	TCGS_Error_t status;
+
+	status = TCGS_Builder_EndComPacket(&session->builder);
+	if (status != ERROR_SUCCESS)
+	{
+		return status;
+	}
+	//IF-RECV shall return response to IF-SEND of the same thread
+	status = TCGS_Session_LockDevice(session);
+	if (status != ERROR_SUCCESS)
+	{
+		return status;
+	}
+	status = TCGS_Session_SendPacket(session);
+	if (status == ERROR_SUCCESS)
+	{
+		status = TCGS_Session_Poll(session, tperSessionNumber, hostSessionNumber,
+				session->receiveBuffer, sizeof(session->receiveBuffer), response);
+	}
+	TCGS_Device_Unlock(session->device);
+	if (TCGS_IsOperationError(status))
+	{
+		TCGS_Session_Abort(session);
+	}
+	return status;
+}
+
+/*
+ * Receives response to ComPacket sent by TCGS_Session_Send unless another
+ * exchange on the device has read it already
+ */
+static void TCGS_Session_Complete(TCGS_Session_t *session)
+{
+	if (!session->pending || session->pendingReceived)
+	{
+		return;
+	}
+	//the response is read when the device is locked, the lock of device
+	//with arbiter may fail only after Send has read it
+	if (TCGS_Session_LockDevice(session) == ERROR_SUCCESS)
+	{
+		TCGS_Device_Unlock(session->device);
+	}
+	session->pendingReceived = TRUE;
+	if (session->pendingError == ERROR_SESSION)
+	{
+		session->open = FALSE;
+	}
+	else if (TCGS_IsOperationError(session->pendingError))
+	{
+		TCGS_Session_Abort(session);
+	}
+}
+
+TCGS_Error_t TCGS_StartSession(TCGS_Session_t *session, TCGS_Device_t *device,
+		const TCGS_UID_t *sp, const TCGS_UID_t *authority,
+		const void *challenge, uint32 challengeLength, bool write,
+		TCGS_MethodStatus_t *status)
+{
+	TCGS_Parser_t response;
+	TCGS_Error_t error;
+
+	session->device = device;
+	session->open = FALSE;
+	session->hostSessionNumber = __sync_add_and_fetch(&lastHostSessionNumber, 1);
+	session->tperSessionNumber = 0;
+	session->sp = *sp;
+	session->authority = (authority != NULL) ? *authority : TCGS_UID_Anybody;
+	session->write = write;
+	session->pending = FALSE;
+	TCGS_Builder_Init(&session->builder, session->sendBuffer, sizeof(session->sendBuffer));
+
+	//Session Manager calls are sent outside of any session
+	TCGS_Builder_StartComPacket(&session->builder, device->comId, 0, 0);
+	TCGS_Builder_StartCall(&session->builder, &TCGS_UID_SMUID, &TCGS_UID_Method_StartSession);
+	TCGS_Builder_AddUInt(&session->builder, session->hostSessionNumber);
+	TCGS_Builder_AddUID(&session->builder, sp);
+	TCGS_Builder_AddUInt(&session->builder, write ? 1 : 0);
+	if (challenge != NULL)
+	{
+		TCGS_Builder_AddNamedBytes(&session->builder, START_SESSION_HOST_CHALLENGE, challenge, challengeLength);
+	}
+	if (authority != NULL)
+	{
+		TCGS_Builder_AddNamedUID(&session->builder, START_SESSION_HOST_SIGNING_AUTHORITY, authority);
+	}
+	TCGS_Builder_EndCall(&session->builder);
+
+	error = TCGS_Session_Transfer(session, 0, 0, &response);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	return TCGS_Session_Synchronize(session, &response, status);
+}
+
+TCGS_Error_t TCGS_EndSession(TCGS_Session_t *session)
+{
+	TCGS_Parser_t response;
+	TCGS_Error_t error;
+
+	if (!session->open)
+	{
+		return ERROR_SESSION;
+	}
+	TCGS_Session_StartPacket(session);
+	TCGS_Builder_AddToken(&session->builder, TOKEN_END_OF_SESSION);
+	error = TCGS_Session_Exchange(session, &response);
+	session->open = FALSE;
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	return TCGS_Parser_Expect(&response, TOKEN_END_OF_SESSION) ? ERROR_SUCCESS : ERROR_PARSER;
+}
+
+TCGS_Builder_t *TCGS_Session_StartPacket(TCGS_Session_t *session)
+{
+	//send buffer is reused only when TPer has answered the previous ComPacket
+	TCGS_Session_Complete(session);
+	TCGS_Builder_Init(&session->builder, session->sendBuffer, sizeof(session->sendBuffer));
+	TCGS_Builder_StartComPacket(&session->builder, session->device->comId,
+			session->tperSessionNumber, session->hostSessionNumber);
+	return &session->builder;
+}
+
+TCGS_Error_t TCGS_Session_Exchange(TCGS_Session_t *session, TCGS_Parser_t *response)
+{
+	TCGS_Error_t error;
+
+	if (!session->open)
+	{
+		return ERROR_SESSION;
+	}
+	error = TCGS_Session_Transfer(session, session->tperSessionNumber,
+			session->hostSessionNumber, response);
+	if (error == ERROR_SESSION)
+	{
+		session->open = FALSE;
+	}
+	return error;
+}
+
+TCGS_Error_t TCGS_Session_Send(TCGS_Session_t *session, void *buffer, uint32 size)
+{
+	TCGS_Error_t error;
+
+	if (!session->open)
+	{
+		return ERROR_SESSION;
+	}
+	if (size < TCGS_BLOCK_SIZE)
+	{
+		//no block of the response fits the buffer
+		return ERROR_PARAMETER;
+	}
+	error = TCGS_Builder_EndComPacket(&session->builder);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	error = TCGS_Session_LockDevice(session);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	error = TCGS_Session_SendPacket(session);
+	if (error != ERROR_SUCCESS)
+	{
+		TCGS_Device_Unlock(session->device);
+		if (TCGS_IsOperationError(error))
+		{
+			TCGS_Session_Abort(session);
+		}
+		return error;
+	}
+	session->pending = TRUE;
+	session->pendingReceived = FALSE;
+	session->pendingBuffer = buffer;
+	session->pendingSize = size;
+	//the lock is not held across return, next exchange on the device reads the response
+	session->device->pendingSession = session;
+	if (session->device->arbiter != NULL)
+	{
+		//exchanges of other processes can't read it for the session
+		TCGS_Session_Drain(session, TRUE);
+	}
+	TCGS_Device_Unlock(session->device);
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_Session_Receive(TCGS_Session_t *session, TCGS_Parser_t *response)
+{
+	if (!session->pending)
+	{
+		return ERROR_PARAMETER;
+	}
+	TCGS_Session_Complete(session);
+	session->pending = FALSE;
+	*response = session->pendingResponse;
+	return session->pendingError;
+}
+
+TCGS_Error_t TCGS_Session_Call(TCGS_Session_t *session, TCGS_Parser_t *results,
+		TCGS_MethodStatus_t *status)
+{
+	TCGS_Parser_t response;
+	TCGS_MethodStatus_t methodStatus;
+	TCGS_Error_t error;
+
+	error = TCGS_Session_Exchange(session, &response);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	error = TCGS_Parser_GetResult(&response, results, &methodStatus);
+	if (error == ERROR_SESSION)
+	{
+		//TPer aborted the session
+		session->open = FALSE;
+	}
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	TCGS_Session_SetStatus(status, methodStatus);
+	return (methodStatus == METHOD_STATUS_SUCCESS) ? ERROR_SUCCESS : ERROR_METHOD;
+}
+
+TCGS_Error_t TCGS_Get(TCGS_Session_t *session, const TCGS_UID_t *object,
+		uint32 startColumn, uint32 endColumn, TCGS_Parser_t *results,
+		TCGS_MethodStatus_t *status)
+{
+	TCGS_Builder_AddGet(TCGS_Session_StartPacket(session), object, startColumn, endColumn);
+	return TCGS_Session_Call(session, results, status);
+}
+
+TCGS_Error_t TCGS_SetUInt(TCGS_Session_t *session, const TCGS_UID_t *object,
+		uint32 column, uint64 value, TCGS_MethodStatus_t *status)
+{
+	TCGS_Builder_AddSetUInt(TCGS_Session_StartPacket(session), object, column, value);
+	return TCGS_Session_Call(session, NULL, status);
+}
+
+TCGS_Error_t TCGS_SetBytes(TCGS_Session_t *session, const TCGS_UID_t *object,
+		uint32 column, const void *data, uint32 length, TCGS_MethodStatus_t *status)
+{
+	TCGS_Builder_AddSetBytes(TCGS_Session_StartPacket(session), object, column, data, length);
+	return TCGS_Session_Call(session, NULL, status);
+}
+
+TCGS_Error_t TCGS_Authenticate(TCGS_Session_t *session, const TCGS_UID_t *authority,
+		const void *challenge, uint32 challengeLength, TCGS_MethodStatus_t *status)
+{
+	TCGS_Builder_t *builder = TCGS_Session_StartPacket(session);
+	TCGS_Parser_t results;
+	TCGS_Error_t error;
+	uint64 authenticated;
+
+	TCGS_Builder_StartCall(builder, &TCGS_UID_ThisSP, &TCGS_UID_Method_Authenticate);
+	TCGS_Builder_AddUID(builder, authority);
+	if (challenge != NULL)
+	{
+		TCGS_Builder_AddNamedBytes(builder, 0, challenge, challengeLength);
+	}
+	TCGS_Builder_EndCall(builder);
+
+	error = TCGS_Session_Call(session, &results, status);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	if (!TCGS_Parser_GetUInt(&results, &authenticated))
+	{
+		return ERROR_PARSER;
+	}
+	if (!authenticated)
+	{
+		TCGS_Session_SetStatus(status, METHOD_STATUS_NOT_AUTHORIZED);
+		return ERROR_METHOD;
+	}
+	session->authority = *authority;
+	return ERROR_SUCCESS;
+}
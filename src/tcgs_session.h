@@ -0,0 +1,230 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_session.h
+///
+/// Sessions with Security Providers of TPer
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_SESSION_H
+#define _TCGS_SESSION_H
+
+#include <stdbool.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+
+/*****************************************************************************
+ * \brief Session with SP
+ *
+ * The structure contains buffers for ComPackets of the session, so a session
+ * doesn't allocate memory. Parsers returned by session functions point to the
+ * receive buffer and stay valid until the next method of the session.
+ *****************************************************************************/
+typedef struct TCGS_Session
+{
+	TCGS_Device_t  *device;
+	uint32          hostSessionNumber;
+	uint32          tperSessionNumber;
+	TCGS_UID_t      sp;
+	TCGS_UID_t      authority;          //Anybody if session was started without authentication
+	bool            write;
+	bool            open;
+	TCGS_Builder_t  builder;
+	uint8           sendBuffer[TCGS_MAX_COMPACKET_SIZE];
+	uint8           receiveBuffer[TCGS_MAX_COMPACKET_SIZE];
+
+	//ComPacket sent with TCGS_Session_Send, its response is read by the next
+	//exchange on the device or by TCGS_Session_Receive
+	bool            pending;
+	bool            pendingReceived;    //response was received before the next method
+	uint8          *pendingBuffer;
+	uint32          pendingSize;
+	TCGS_Error_t    pendingError;
+	TCGS_Parser_t   pendingResponse;
+} TCGS_Session_t;
+
+/*****************************************************************************
+ * \brief Starts session with SP
+ *
+ * \par StartSession method is invoked on Session Manager and SyncSession
+ * response is awaited. If authority is specified the host is authenticated
+ * within StartSession, so no separate Authenticate round trip is needed.
+ *
+ * @param[out] session          session to start
+ * @param[in]  device           device, device->comId is used for the session
+ * @param[in]  sp               UID of SP
+ * @param[in]  authority        host signing authority, NULL for Anybody
+ * @param[in]  challenge        credential of the authority, NULL if none
+ * @param[in]  challengeLength  length of the credential
+ * @param[in]  write            TRUE for read-write session
+ * @param[out] status           status of StartSession, may be NULL
+ *
+ * \return ERROR_SUCCESS if session is started, ERROR_METHOD if TPer refused
+ * to start session, other error code in case of transport or protocol error.
+ * Session started by TPer after interruption of the operation is closed.
+ *
+ * \see TCGS_EndSession
+ *****************************************************************************/
+TCGS_Error_t TCGS_StartSession(TCGS_Session_t *session, TCGS_Device_t *device,
+		const TCGS_UID_t *sp, const TCGS_UID_t *authority,
+		const void *challenge, uint32 challengeLength, bool write,
+		TCGS_MethodStatus_t *status);
+
+/*****************************************************************************
+ * \brief Closes session with End of Session token
+ *
+ * \par The session is considered closed even if TPer doesn't confirm it.
+ *
+ * \return ERROR_SUCCESS if TPer confirmed end of session, error code otherwise
+ *
+ * \see TCGS_StartSession
+ *****************************************************************************/
+TCGS_Error_t TCGS_EndSession(TCGS_Session_t *session);
+
+/*****************************************************************************
+ * \brief Starts ComPacket of the session
+ *
+ * \par Methods are added to the returned builder and sent with
+ * TCGS_Session_Exchange or TCGS_Session_Call.
+ *
+ * \return TCGS_Builder_t* builder of the session
+ *****************************************************************************/
+TCGS_Builder_t *TCGS_Session_StartPacket(TCGS_Session_t *session);
+
+/*****************************************************************************
+ * \brief Sends ComPacket of the session and receives response
+ *
+ * \par IF-RECV is repeated while TPer reports that the response is not ready.
+ * If TPer discards the packet (e.g. session was lost after power cycle or
+ * ComID reset) the session is marked closed.
+ *
+ * \par The device is locked from IF-SEND until the response is read, sleeps
+ * between IF-RECVs included, so exchanges of other threads on the device
+ * wait for the whole round trip.
+ *
+ * \par Exchange interrupted by expired or cancelled operation of the thread
+ * closes the session: the response is drained and End of Session is sent
+ * within TCGS_OPERATION_CLEANUP_TIMEOUT, ComID is reset with Stack Reset if
+ * TPer doesn't answer.
+ *
+ * @param[in]  session      session
+ * @param[out] response     parser of response token stream
+ *
+ * \return ERROR_SUCCESS if response is received, ERROR_SESSION if session is
+ * not open or was lost, ERROR_TIMEOUT or ERROR_CANCELLED if operation was
+ * interrupted, other error code otherwise
+ *
+ * \see TCGS_Operation_Begin
+ *****************************************************************************/
+TCGS_Error_t TCGS_Session_Exchange(TCGS_Session_t *session, TCGS_Parser_t *response);
+
+/*****************************************************************************
+ * \brief Sends ComPacket of the session without waiting for response
+ *
+ * \par TPer processes the ComPacket while the host is busy with other work,
+ * the response is received into the buffer by TCGS_Session_Receive. The
+ * device is not held until then: the next exchange on the device, of any
+ * session and thread, reads the response into the buffer first and keeps it
+ * for TCGS_Session_Receive. Device attached to arbiter reads the response
+ * before the function returns, as the lock of other processes is not held
+ * across calls. The response shall be received before the session is
+ * dropped.
+ *
+ * @param[in]  session      session
+ * @param[out] buffer       buffer for response ComPacket
+ * @param[in]  size         size of the buffer, the response is read in whole
+ *                          blocks of TCGS_BLOCK_SIZE up to
+ *                          TCGS_MAX_COMPACKET_SIZE that fit the buffer
+ *
+ * \return ERROR_SUCCESS if ComPacket is sent, ERROR_PARAMETER if the buffer
+ * is shorter than one block, error code otherwise
+ *
+ * \see TCGS_Session_Exchange
+ *****************************************************************************/
+TCGS_Error_t TCGS_Session_Send(TCGS_Session_t *session, void *buffer, uint32 size);
+
+/*****************************************************************************
+ * \brief Receives response to ComPacket sent by TCGS_Session_Send
+ *
+ * @param[in]  session      session
+ * @param[out] response     parser of response token stream, it points to
+ *                          the buffer passed to TCGS_Session_Send
+ *
+ * \return ERROR_PARAMETER if no ComPacket was sent, the same codes as
+ * TCGS_Session_Exchange otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_Session_Receive(TCGS_Session_t *session, TCGS_Parser_t *response);
+
+/*****************************************************************************
+ * \brief Sends ComPacket with one method invocation and parses its result
+ *
+ * @param[in]  session      session
+ * @param[out] results      parser of returned values, may be NULL
+ * @param[out] status       method status, may be NULL
+ *
+ * \return ERROR_SUCCESS if method succeeded, ERROR_METHOD if method status is
+ * not SUCCESS, other error code otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_Session_Call(TCGS_Session_t *session, TCGS_Parser_t *results,
+		TCGS_MethodStatus_t *status);
+
+/*****************************************************************************
+ * \brief Invokes Get method on object
+ *
+ * \par Returned columns are found with TCGS_Parser_FindNamedValue.
+ *
+ * @param[in]  session      session
+ * @param[in]  object       UID of object (table row)
+ * @param[in]  startColumn  first column to get
+ * @param[in]  endColumn    last column to get
+ * @param[out] results      parser of returned values
+ * @param[out] status       method status, may be NULL
+ *
+ * \return ERROR_SUCCESS if method succeeded, error code otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_Get(TCGS_Session_t *session, const TCGS_UID_t *object,
+		uint32 startColumn, uint32 endColumn, TCGS_Parser_t *results,
+		TCGS_MethodStatus_t *status);
+
+/*****************************************************************************
+ * \brief Invokes Set method on object to change one column
+ *
+ * @param[in]  session      session
+ * @param[in]  object       UID of object (table row)
+ * @param[in]  column       column to set
+ * @param[in]  value        new value of integer column
+ * @param[out] status       method status, may be NULL
+ *
+ * \return ERROR_SUCCESS if method succeeded, error code otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_SetUInt(TCGS_Session_t *session, const TCGS_UID_t *object,
+		uint32 column, uint64 value, TCGS_MethodStatus_t *status);
+
+/*****************************************************************************
+ * \brief Invokes Set method on object to change one column of bytes
+ *
+ * \see TCGS_SetUInt
+ *****************************************************************************/
+TCGS_Error_t TCGS_SetBytes(TCGS_Session_t *session, const TCGS_UID_t *object,
+		uint32 column, const void *data, uint32 length, TCGS_MethodStatus_t *status);
+
+/*****************************************************************************
+ * \brief Invokes Authenticate method on ThisSP
+ *
+ * @param[in]  session          session
+ * @param[in]  authority        authority to authenticate
+ * @param[in]  challenge        credential of the authority
+ * @param[in]  challengeLength  length of the credential
+ * @param[out] status           method status, may be NULL
+ *
+ * \return ERROR_SUCCESS if authority is authenticated, ERROR_METHOD if
+ * authentication failed, other error code otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_Authenticate(TCGS_Session_t *session, const TCGS_UID_t *authority,
+		const void *challenge, uint32 challengeLength, TCGS_MethodStatus_t *status);
+
+#endif //_TCGS_SESSION_H
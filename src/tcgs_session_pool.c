@@ -0,0 +1,247 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_session_pool.c
+///
+/// Pool of authenticated sessions of a device
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_session.h"
+#include "tcgs_session_pool.h"
+#include "tcgs_uid.h"
+#include "tcgs_time.h"
+
+void TCGS_SessionPool_Init(TCGS_SessionPool_t *pool, TCGS_Device_t *device, uint32 timeout)
+{
+	memset(pool, 0, sizeof(*pool));
+	pool->device = device;
+	pool->timeout = (uint64)(timeout != 0 ? timeout : TCGS_SESSION_POOL_TIMEOUT) * TCGS_NSEC_PER_MSEC;
+	pthread_mutex_init(&pool->lock, NULL);
+}
+
+void TCGS_SessionPool_Destroy(TCGS_SessionPool_t *pool)
+{
+	int i;
+
+	for (i = 0; i < TCGS_SESSION_POOL_SIZE; i++)
+	{
+		if (!pool->slots[i].busy && pool->slots[i].session.open)
+		{
+			TCGS_EndSession(&pool->slots[i].session);
+		}
+		memset(pool->slots[i].credential, 0, sizeof(pool->slots[i].credential));
+	}
+	pthread_mutex_destroy(&pool->lock);
+}
+
+static TCGS_PooledSession_t *TCGS_SessionPool_GetSlot(TCGS_Session_t *session)
+{
+	//session is the first field of the slot
+	return (TCGS_PooledSession_t*)session;
+}
+
+static bool TCGS_SessionPool_Matches(TCGS_PooledSession_t *slot,
+		const TCGS_UID_t *sp, const TCGS_UID_t *authority,
+		const void *credential, uint32 credentialLength, bool write)
+{
+	return memcmp(&slot->session.sp, sp, sizeof(*sp)) == 0 &&
+		memcmp(&slot->session.authority, authority, sizeof(*authority)) == 0 &&
+		slot->session.write == write &&
+		slot->credentialLength == credentialLength &&
+		(credentialLength == 0 || memcmp(slot->credential, credential, credentialLength) == 0);
+}
+
+static TCGS_Error_t TCGS_SessionPool_Start(TCGS_SessionPool_t *pool, TCGS_PooledSession_t *slot)
+{
+	TCGS_Session_t *session = &slot->session;
+	bool anybody = (memcmp(&session->authority, &TCGS_UID_Anybody, sizeof(TCGS_UID_t)) == 0);
+
+	return TCGS_StartSession(session, pool->device, &session->sp,
+			anybody ? NULL : &session->authority,
+			slot->credentialLength > 0 ? slot->credential : NULL, slot->credentialLength,
+			session->write, NULL);
+}
+
+static TCGS_Error_t TCGS_SessionPool_AcquireSlot(TCGS_SessionPool_t *pool,
+		const TCGS_UID_t *sp, const TCGS_UID_t *authority,
+		const void *credential, uint32 credentialLength, bool write,
+		TCGS_PooledSession_t **acquired, bool *reused)
+{
+	TCGS_PooledSession_t *slot, *freeSlot = NULL, *idleSlot = NULL;
+	uint64 now = TCGS_GetTime();
+	TCGS_Error_t error;
+	int i;
+
+	if (authority == NULL)
+	{
+		authority = &TCGS_UID_Anybody;
+	}
+	if (credentialLength > TCGS_MAX_CREDENTIAL_LENGTH)
+	{
+		return ERROR_PARAMETER;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < TCGS_SESSION_POOL_SIZE; i++)
+	{
+		slot = &pool->slots[i];
+		if (slot->busy)
+		{
+			continue;
+		}
+		if (!slot->session.open)
+		{
+			if (freeSlot == NULL || freeSlot->session.open)
+			{
+				freeSlot = slot;
+			}
+			continue;
+		}
+		if (now - slot->lastUsed > pool->timeout)
+		{
+			//TPer may have closed the session already, it is to be started again
+			if (freeSlot == NULL)
+			{
+				freeSlot = slot;
+			}
+			continue;
+		}
+		if (TCGS_SessionPool_Matches(slot, sp, authority, credential, credentialLength, write))
+		{
+			slot->busy = TRUE;
+			pthread_mutex_unlock(&pool->lock);
+			*acquired = slot;
+			*reused = TRUE;
+			return ERROR_SUCCESS;
+		}
+		if (idleSlot == NULL || slot->lastUsed < idleSlot->lastUsed)
+		{
+			idleSlot = slot;
+		}
+	}
+	slot = (freeSlot != NULL) ? freeSlot : idleSlot;
+	if (slot == NULL)
+	{
+		pthread_mutex_unlock(&pool->lock);
+		return ERROR_SESSION;
+	}
+	slot->busy = TRUE;
+	pthread_mutex_unlock(&pool->lock);
+
+	//round trips are done without holding the pool lock
+	if (slot->session.open)
+	{
+		TCGS_EndSession(&slot->session);
+	}
+	slot->session.sp = *sp;
+	slot->session.authority = *authority;
+	slot->session.write = write;
+	memcpy(slot->credential, credential, credentialLength);
+	slot->credentialLength = credentialLength;
+
+	error = TCGS_SessionPool_Start(pool, slot);
+	if (error != ERROR_SUCCESS)
+	{
+		memset(slot->credential, 0, sizeof(slot->credential));
+		slot->credentialLength = 0;
+		pthread_mutex_lock(&pool->lock);
+		slot->busy = FALSE;
+		pthread_mutex_unlock(&pool->lock);
+		return error;
+	}
+	*acquired = slot;
+	*reused = FALSE;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_SessionPool_Acquire(TCGS_SessionPool_t *pool,
+		const TCGS_UID_t *sp, const TCGS_UID_t *authority,
+		const void *credential, uint32 credentialLength, bool write,
+		TCGS_Session_t **session)
+{
+	TCGS_PooledSession_t *slot;
+	TCGS_Error_t error;
+	bool reused;
+
+	error = TCGS_SessionPool_AcquireSlot(pool, sp, authority, credential, credentialLength,
+			write, &slot, &reused);
+	if (error == ERROR_SUCCESS)
+	{
+		*session = &slot->session;
+	}
+	return error;
+}
+
+void TCGS_SessionPool_Release(TCGS_SessionPool_t *pool, TCGS_Session_t *session)
+{
+	TCGS_PooledSession_t *slot = TCGS_SessionPool_GetSlot(session);
+
+	pthread_mutex_lock(&pool->lock);
+	slot->lastUsed = TCGS_GetTime();
+	if (!session->open)
+	{
+		memset(slot->credential, 0, sizeof(slot->credential));
+		slot->credentialLength = 0;
+	}
+	slot->busy = FALSE;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+TCGS_Error_t TCGS_SessionPool_Reopen(TCGS_SessionPool_t *pool, TCGS_Session_t *session)
+{
+	TCGS_PooledSession_t *slot = TCGS_SessionPool_GetSlot(session);
+
+	session->open = FALSE;
+	return TCGS_SessionPool_Start(pool, slot);
+}
+
+void TCGS_SessionPool_Invalidate(TCGS_SessionPool_t *pool)
+{
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < TCGS_SESSION_POOL_SIZE; i++)
+	{
+		pool->slots[i].session.open = FALSE;
+		if (!pool->slots[i].busy)
+		{
+			memset(pool->slots[i].credential, 0, sizeof(pool->slots[i].credential));
+			pool->slots[i].credentialLength = 0;
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+TCGS_Error_t TCGS_SessionPool_Run(TCGS_SessionPool_t *pool,
+		const TCGS_UID_t *sp, const TCGS_UID_t *authority,
+		const void *credential, uint32 credentialLength, bool write,
+		TCGS_SessionOperation_t operation, void *context)
+{
+	TCGS_PooledSession_t *slot;
+	TCGS_Error_t error;
+	bool reused;
+
+	error = TCGS_SessionPool_AcquireSlot(pool, sp, authority, credential, credentialLength,
+			write, &slot, &reused);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	error = (*operation)(&slot->session, context);
+	if (error == ERROR_SESSION && reused)
+	{
+		//idle session died (power cycle, ComID reset, TPer timeout)
+		error = TCGS_SessionPool_Reopen(pool, &slot->session);
+		if (error == ERROR_SUCCESS)
+		{
+			error = (*operation)(&slot->session, context);
+		}
+	}
+	TCGS_SessionPool_Release(pool, &slot->session);
+
+	return error;
+}
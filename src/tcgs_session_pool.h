@@ -0,0 +1,150 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_session_pool.h
+///
+/// Pool of authenticated sessions of a device
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_SESSION_POOL_H
+#define _TCGS_SESSION_POOL_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_interface.h"
+#include "tcgs_session.h"
+
+typedef struct
+{
+	TCGS_Session_t session;
+	bool           busy;                //session is handed out to a caller
+	uint64         lastUsed;            //time the session was released, ns
+	uint8          credential[TCGS_MAX_CREDENTIAL_LENGTH];
+	uint32         credentialLength;
+} TCGS_PooledSession_t;
+
+/*****************************************************************************
+ * \brief Pool of sessions of one device
+ *
+ * The pool keeps sessions open after use, so subsequent requests for the
+ * same SP, authority and credential skip StartSession/SyncSession round trip.
+ * Idle sessions are closed when they were not used for pool timeout, which
+ * shall not exceed session timeout of TPer.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_Device_t        *device;
+	uint64                timeout;      //idle time after which a session is reopened, ns
+	pthread_mutex_t       lock;
+	TCGS_PooledSession_t  slots[TCGS_SESSION_POOL_SIZE];
+} TCGS_SessionPool_t;
+
+/*****************************************************************************
+ * \brief Operation executed within pooled session
+ *
+ * \par The operation shall return ERROR_SESSION without side effects if
+ * session was lost, so it can be repeated in a new session.
+ *
+ * \see TCGS_SessionPool_Run
+ *****************************************************************************/
+typedef TCGS_Error_t (*TCGS_SessionOperation_t)(TCGS_Session_t *session, void *context);
+
+/*****************************************************************************
+ * \brief Initializes session pool of the device
+ *
+ * @param[out] pool         pool to initialize
+ * @param[in]  device       device
+ * @param[in]  timeout      idle timeout of sessions in milliseconds, 0 for
+ *                          TCGS_SESSION_POOL_TIMEOUT
+ *
+ * \return None
+ *
+ * \see TCGS_SessionPool_Destroy
+ *****************************************************************************/
+void TCGS_SessionPool_Init(TCGS_SessionPool_t *pool, TCGS_Device_t *device, uint32 timeout);
+
+/*****************************************************************************
+ * \brief Closes idle sessions and destroys the pool
+ *
+ * \par All sessions shall be released before.
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_SessionPool_Destroy(TCGS_SessionPool_t *pool);
+
+/*****************************************************************************
+ * \brief Hands out open session for SP and authority
+ *
+ * \par An idle session started with the same parameters is reused, an
+ * expired one is closed and started again. When no idle session matches,
+ * a new session is started in a free slot or in place of the least recently
+ * used idle session.
+ *
+ * @param[in]  pool             pool
+ * @param[in]  sp               UID of SP
+ * @param[in]  authority        authority, NULL for Anybody
+ * @param[in]  credential       credential of the authority, NULL if none
+ * @param[in]  credentialLength length of the credential
+ * @param[in]  write            TRUE for read-write session
+ * @param[out] session          handed out session
+ *
+ * \return ERROR_SUCCESS if session is handed out, ERROR_SESSION if all
+ * sessions of the pool are in use, ERROR_PARAMETER if credential is longer
+ * than TCGS_MAX_CREDENTIAL_LENGTH, error of TCGS_StartSession otherwise
+ *
+ * \see TCGS_SessionPool_Release
+ *****************************************************************************/
+TCGS_Error_t TCGS_SessionPool_Acquire(TCGS_SessionPool_t *pool,
+		const TCGS_UID_t *sp, const TCGS_UID_t *authority,
+		const void *credential, uint32 credentialLength, bool write,
+		TCGS_Session_t **session);
+
+/*****************************************************************************
+ * \brief Returns session to the pool
+ *
+ * \par A session which was closed or lost while handed out frees its slot.
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_SessionPool_Release(TCGS_SessionPool_t *pool, TCGS_Session_t *session);
+
+/*****************************************************************************
+ * \brief Starts again handed out session that was lost
+ *
+ * \par The session is started with the same SP, authority and credential.
+ *
+ * \return ERROR_SUCCESS if session is started, error of TCGS_StartSession
+ * otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_SessionPool_Reopen(TCGS_SessionPool_t *pool, TCGS_Session_t *session);
+
+/*****************************************************************************
+ * \brief Forgets all sessions of the pool
+ *
+ * \par The function is to be called when sessions are known to be closed by
+ * TPer, e.g. after power cycle or Stack Reset. Idle sessions are dropped
+ * without End of Session, handed out ones are marked closed.
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_SessionPool_Invalidate(TCGS_SessionPool_t *pool);
+
+/*****************************************************************************
+ * \brief Executes operation within pooled session
+ *
+ * \par If reused session turns out to be lost the session is started again
+ * and the operation is repeated once, so callers don't see sessions that
+ * died while idle.
+ *
+ * \return result of the operation or error of TCGS_SessionPool_Acquire
+ *
+ * \see TCGS_SessionPool_Acquire
+ *****************************************************************************/
+TCGS_Error_t TCGS_SessionPool_Run(TCGS_SessionPool_t *pool,
+		const TCGS_UID_t *sp, const TCGS_UID_t *authority,
+		const void *credential, uint32 credentialLength, bool write,
+		TCGS_SessionOperation_t operation, void *context);
+
+#endif //_TCGS_SESSION_POOL_H
@@ -68,13 +68,13 @@ typedef struct {
     uint8		reserved	                :4;
     uint8		length;
 
-    uint8       reserved1                   :2;
     uint8		lockingSupport				:1;
     uint8		lockingEnabled				:1;
     uint8		locked						:1;
     uint8		mediaEncryption				:1;
     uint8		MBREnabled					:1;
     uint8		MBRDone						:1;
+    uint8       reserved1                   :2;
     uint8		reserved2[11];
 } TCGS_Level0Discovery_FeatureLocking_t;
 
@@ -123,4 +123,152 @@ typedef struct {
     uint8		reserved2[5];
 } TCGS_Level0Discovery_FeatureOpal2_t;
 
+// Unique identifier of table, object or method, see 5.1.3.75 (uid) of Core Specification
+typedef struct {
+    uint8		bytes[8];
+} TCGS_UID_t;
+
+// Headers of ComPacket, Packet and SubPacket, see 3.2.3 of Core Specification.
+// Multi-byte fields are big-endian, use _getBE/_putBE from tcgs_interface_encode.h
+typedef struct {
+    uint8		reserved[4];
+    uint8		comId[2];
+    uint8		comIdExtension[2];
+    uint8		outstandingData[4];
+    uint8		minTransfer[4];
+    uint8		length[4];
+} TCGS_ComPacketHeader_t;
+
+typedef struct {
+    uint8		tperSessionNumber[4];
+    uint8		hostSessionNumber[4];
+    uint8		sequenceNumber[4];
+    uint8		reserved[2];
+    uint8		ackType[2];
+    uint8		acknowledgement[4];
+    uint8		length[4];
+} TCGS_PacketHeader_t;
+
+typedef struct {
+    uint8		reserved[6];
+    uint8		kind[2];
+    uint8		length[4];
+} TCGS_SubPacketHeader_t;
+
+#define TCGS_PACKET_HEADERS_LENGTH (sizeof(TCGS_ComPacketHeader_t) + sizeof(TCGS_PacketHeader_t) + sizeof(TCGS_SubPacketHeader_t))
+
+// ComID management requests and responses of protocol 0x02, see 3.3.4.3 of Core Specification
+typedef enum
+{
+	COMID_REQUEST_VERIFY_COMID_VALID = 0x00000001,
+	COMID_REQUEST_STACK_RESET        = 0x00000002,
+} TCGS_ComIDRequestCode_t;
+
+typedef enum
+{
+	COMID_STATE_INVALID    = 0x00000000,
+	COMID_STATE_INACTIVE   = 0x00000001,
+	COMID_STATE_ISSUED     = 0x00000002,
+	COMID_STATE_ASSOCIATED = 0x00000003,
+} TCGS_ComIDState_t;
+
+typedef struct {
+    uint8		comId[2];
+    uint8		comIdExtension[2];
+    uint8		requestCode[4];
+} TCGS_ComIDRequest_t;
+
+typedef struct {
+    uint8		comId[2];
+    uint8		comIdExtension[2];
+    uint8		requestCode[4];
+    uint8		reserved[2];
+    uint8		availableDataLength[2];     //0 if response is not ready yet
+    uint8		data[4];                    //ComID state or Stack Reset status
+} TCGS_ComIDResponse_t;
+
+// Atoms, see 3.2.2.3.1 of Core Specification
+#define TCGS_TINY_ATOM_MAX         0x3F
+#define TCGS_SHORT_ATOM            0x80
+#define TCGS_SHORT_ATOM_BYTES      0xA0
+#define TCGS_SHORT_ATOM_MAX        0x0F
+#define TCGS_MEDIUM_ATOM           0xC0
+#define TCGS_MEDIUM_ATOM_BYTES     0xD0
+#define TCGS_MEDIUM_ATOM_MAX       0x07FF
+#define TCGS_LONG_ATOM             0xE0
+#define TCGS_LONG_ATOM_BYTES       0xE2
+
+// Control tokens, see 3.2.2.3.2 of Core Specification
+typedef enum
+{
+	TOKEN_START_LIST        = 0xF0,
+	TOKEN_END_LIST          = 0xF1,
+	TOKEN_START_NAME        = 0xF2,
+	TOKEN_END_NAME          = 0xF3,
+	TOKEN_CALL              = 0xF8,
+	TOKEN_END_OF_DATA       = 0xF9,
+	TOKEN_END_OF_SESSION    = 0xFA,
+	TOKEN_START_TRANSACTION = 0xFB,
+	TOKEN_END_TRANSACTION   = 0xFC,
+	TOKEN_EMPTY             = 0xFF,
+} TCGS_ControlToken_t;
+
+// Status codes of methods, see 5.1.5 of Core Specification
+typedef enum
+{
+	METHOD_STATUS_SUCCESS                 = 0x00,
+	METHOD_STATUS_NOT_AUTHORIZED          = 0x01,
+	METHOD_STATUS_SP_BUSY                 = 0x03,
+	METHOD_STATUS_SP_FAILED               = 0x04,
+	METHOD_STATUS_SP_DISABLED             = 0x05,
+	METHOD_STATUS_SP_FROZEN               = 0x06,
+	METHOD_STATUS_NO_SESSIONS_AVAILABLE   = 0x07,
+	METHOD_STATUS_UNIQUENESS_CONFLICT     = 0x08,
+	METHOD_STATUS_INSUFFICIENT_SPACE      = 0x09,
+	METHOD_STATUS_INSUFFICIENT_ROWS       = 0x0A,
+	METHOD_STATUS_INVALID_PARAMETER       = 0x0C,
+	METHOD_STATUS_TPER_MALFUNCTION        = 0x0F,
+	METHOD_STATUS_TRANSACTION_FAILURE     = 0x10,
+	METHOD_STATUS_RESPONSE_OVERFLOW       = 0x11,
+	METHOD_STATUS_AUTHORITY_LOCKED_OUT    = 0x12,
+	METHOD_STATUS_FAIL                    = 0x3F,
+} TCGS_MethodStatus_t;
+
+// Names of optional parameters of StartSession method, see 5.2.3.1 of Core Specification
+typedef enum
+{
+	START_SESSION_HOST_CHALLENGE          = 0,
+	START_SESSION_HOST_EXCHANGE_AUTHORITY = 1,
+	START_SESSION_HOST_EXCHANGE_CERT      = 2,
+	START_SESSION_HOST_SIGNING_AUTHORITY  = 3,
+	START_SESSION_HOST_SIGNING_CERT       = 4,
+	START_SESSION_SESSION_TIMEOUT         = 5,
+	START_SESSION_TRANS_TIMEOUT           = 6,
+	START_SESSION_INITIAL_CREDIT          = 7,
+	START_SESSION_SIGNED_HASH             = 8,
+} TCGS_StartSessionParameter_t;
+
+// Names of parameters of Get and Set methods, see 5.3.3.6 and 5.3.3.7 of Core Specification
+typedef enum
+{
+	CELLBLOCK_TABLE        = 0,
+	CELLBLOCK_START_ROW    = 1,
+	CELLBLOCK_END_ROW      = 2,
+	CELLBLOCK_START_COLUMN = 3,
+	CELLBLOCK_END_COLUMN   = 4,
+} TCGS_CellBlock_t;
+
+typedef enum
+{
+	SET_WHERE  = 0,
+	SET_VALUES = 1,
+} TCGS_SetParameter_t;
+
+// Names of parameters of Next method, see 5.3.3.13 of Core Specification
+typedef enum
+{
+	NEXT_WHERE = 0,
+	NEXT_COUNT = 1,
+} TCGS_NextParameter_t;
+
 #endif //_TCGS_STREAM_H  
@@ -0,0 +1,344 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_table_cache.c
+///
+/// Cache of table rows read within a session
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+#include "tcgs_table_cache.h"
+
+//bits of Locking feature the cache depends on
+#define TCGS_TABLE_CACHE_LOCKED       0x01
+#define TCGS_TABLE_CACHE_MBR_ENABLED  0x02
+#define TCGS_TABLE_CACHE_MBR_DONE     0x04
+
+void TCGS_TableCache_Init(TCGS_TableCache_t *cache, TCGS_Session_t *session)
+{
+	memset(cache, 0, sizeof(*cache));
+	cache->session = session;
+}
+
+void TCGS_TableCache_Invalidate(TCGS_TableCache_t *cache)
+{
+	cache->rowCount = 0;
+}
+
+/*
+ * Drops the cache if the session it was filled in is gone
+ */
+static TCGS_Error_t TCGS_TableCache_CheckSession(TCGS_TableCache_t *cache)
+{
+	TCGS_Session_t *session = cache->session;
+
+	if (!session->open)
+	{
+		TCGS_TableCache_Invalidate(cache);
+		return ERROR_SESSION;
+	}
+	if (session->tperSessionNumber != cache->tperSessionNumber ||
+		session->hostSessionNumber != cache->hostSessionNumber)
+	{
+		TCGS_TableCache_Invalidate(cache);
+		cache->tperSessionNumber = session->tperSessionNumber;
+		cache->hostSessionNumber = session->hostSessionNumber;
+	}
+	return ERROR_SUCCESS;
+}
+
+static TCGS_TableCacheRow_t *TCGS_TableCache_FindRow(TCGS_TableCache_t *cache, const TCGS_UID_t *object)
+{
+	uint32 i;
+
+	for (i = 0; i < cache->rowCount; i++)
+	{
+		if (memcmp(&cache->rows[i].object, object, sizeof(*object)) == 0)
+		{
+			cache->rows[i].lastUsed = ++cache->clock;
+			return &cache->rows[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Returns row of the object, the least recently used row is replaced when
+ * the cache is full
+ */
+static TCGS_TableCacheRow_t *TCGS_TableCache_AddRow(TCGS_TableCache_t *cache, const TCGS_UID_t *object)
+{
+	TCGS_TableCacheRow_t *row = TCGS_TableCache_FindRow(cache, object);
+	uint32 i;
+
+	if (row != NULL)
+	{
+		return row;
+	}
+	if (cache->rowCount < TCGS_TABLE_CACHE_ROWS)
+	{
+		row = &cache->rows[cache->rowCount++];
+	}
+	else
+	{
+		row = &cache->rows[0];
+		for (i = 1; i < TCGS_TABLE_CACHE_ROWS; i++)
+		{
+			if (cache->rows[i].lastUsed < row->lastUsed)
+			{
+				row = &cache->rows[i];
+			}
+		}
+	}
+	row->object = *object;
+	row->validColumns = 0;
+	row->lastUsed = ++cache->clock;
+	return row;
+}
+
+static void TCGS_TableCache_Store(TCGS_TableCacheRow_t *row, uint32 column, const TCGS_Token_t *token)
+{
+	TCGS_TableCacheValue_t *cell = &row->columns[column];
+
+	row->validColumns &= ~(1u << column);
+	memset(cell, 0, sizeof(*cell));
+	if (token == NULL)
+	{
+		cell->empty = TRUE;
+	}
+	else if (token->type == TOKEN_TYPE_BYTES)
+	{
+		if (token->length > sizeof(cell->bytes))
+		{
+			//too long to cache, the cell is read again on access
+			return;
+		}
+		cell->type = TOKEN_TYPE_BYTES;
+		cell->length = (uint8)token->length;
+		memcpy(cell->bytes, token->data, token->length);
+	}
+	else
+	{
+		cell->type = token->type;
+		cell->value = token->value;
+	}
+	row->validColumns |= 1u << column;
+}
+
+TCGS_Error_t TCGS_TableCache_Prefetch(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 startColumn, uint32 endColumn)
+{
+	TCGS_TableCacheRow_t *row;
+	TCGS_Parser_t results;
+	TCGS_Token_t token;
+	TCGS_Error_t error;
+	uint32 column;
+
+	if (startColumn > endColumn || endColumn >= TCGS_TABLE_CACHE_COLUMNS)
+	{
+		return ERROR_PARAMETER;
+	}
+	error = TCGS_TableCache_CheckSession(cache);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	cache->misses++;
+	error = TCGS_Get(cache->session, object, startColumn, endColumn, &results, NULL);
+	if (error != ERROR_SUCCESS)
+	{
+		if (!cache->session->open)
+		{
+			TCGS_TableCache_Invalidate(cache);
+		}
+		return error;
+	}
+
+	row = TCGS_TableCache_AddRow(cache, object);
+	for (column = startColumn; column <= endColumn; column++)
+	{
+		TCGS_TableCache_Store(row, column,
+				TCGS_Parser_FindNamedValue(&results, column, &token) ? &token : NULL);
+	}
+	return ERROR_SUCCESS;
+}
+
+/*
+ * Returns cached cell, reading it from TPer on miss
+ */
+static TCGS_Error_t TCGS_TableCache_Lookup(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 column, TCGS_TableCacheValue_t **cell)
+{
+	TCGS_TableCacheRow_t *row;
+	TCGS_Error_t error;
+
+	if (column >= TCGS_TABLE_CACHE_COLUMNS)
+	{
+		return ERROR_PARAMETER;
+	}
+	error = TCGS_TableCache_CheckSession(cache);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	row = TCGS_TableCache_FindRow(cache, object);
+	if (row != NULL && (row->validColumns & (1u << column)) != 0)
+	{
+		cache->hits++;
+	}
+	else
+	{
+		error = TCGS_TableCache_Prefetch(cache, object, column, column);
+		if (error != ERROR_SUCCESS)
+		{
+			return error;
+		}
+		row = TCGS_TableCache_FindRow(cache, object);
+		if ((row->validColumns & (1u << column)) == 0)
+		{
+			return ERROR_PARAMETER;
+		}
+	}
+	*cell = &row->columns[column];
+	return (*cell)->empty ? ERROR_PARSER : ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_TableCache_GetUInt(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 column, uint64 *value)
+{
+	TCGS_TableCacheValue_t *cell;
+	TCGS_Error_t error;
+
+	error = TCGS_TableCache_Lookup(cache, object, column, &cell);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	if (cell->type != TOKEN_TYPE_UINT)
+	{
+		return ERROR_PARSER;
+	}
+	*value = cell->value;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_TableCache_GetBytes(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 column, const uint8 **data, uint32 *length)
+{
+	TCGS_TableCacheValue_t *cell;
+	TCGS_Error_t error;
+
+	error = TCGS_TableCache_Lookup(cache, object, column, &cell);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	if (cell->type != TOKEN_TYPE_BYTES)
+	{
+		return ERROR_PARSER;
+	}
+	*data = cell->bytes;
+	*length = cell->length;
+	return ERROR_SUCCESS;
+}
+
+/*
+ * Updates cached cell after successful Set, the cell is dropped if Set failed
+ * as its value is unknown
+ */
+static TCGS_Error_t TCGS_TableCache_Update(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 column, TCGS_Error_t error, const TCGS_Token_t *token)
+{
+	TCGS_TableCacheRow_t *row;
+
+	if (!cache->session->open)
+	{
+		TCGS_TableCache_Invalidate(cache);
+		return error;
+	}
+	if (column >= TCGS_TABLE_CACHE_COLUMNS)
+	{
+		return error;
+	}
+	row = TCGS_TableCache_FindRow(cache, object);
+	if (row == NULL)
+	{
+		return error;
+	}
+	if (error == ERROR_SUCCESS)
+	{
+		TCGS_TableCache_Store(row, column, token);
+	}
+	else
+	{
+		row->validColumns &= ~(1u << column);
+	}
+	return error;
+}
+
+TCGS_Error_t TCGS_TableCache_SetUInt(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 column, uint64 value)
+{
+	TCGS_Token_t token;
+	TCGS_Error_t error;
+
+	error = TCGS_TableCache_CheckSession(cache);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	memset(&token, 0, sizeof(token));
+	token.type = TOKEN_TYPE_UINT;
+	token.value = value;
+	error = TCGS_SetUInt(cache->session, object, column, value, NULL);
+	return TCGS_TableCache_Update(cache, object, column, error, &token);
+}
+
+TCGS_Error_t TCGS_TableCache_SetBytes(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 column, const void *data, uint32 length)
+{
+	TCGS_Token_t token;
+	TCGS_Error_t error;
+
+	error = TCGS_TableCache_CheckSession(cache);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	memset(&token, 0, sizeof(token));
+	token.type = TOKEN_TYPE_BYTES;
+	token.data = data;
+	token.length = length;
+	error = TCGS_SetBytes(cache->session, object, column, data, length, NULL);
+	return TCGS_TableCache_Update(cache, object, column, error, &token);
+}
+
+bool TCGS_TableCache_CheckLevel0Discovery(TCGS_TableCache_t *cache,
+		TCGS_Level0Discovery_Header_t *header)
+{
+	TCGS_Level0Discovery_FeatureLocking_t *locking;
+	uint8 flags = 0;
+	bool changed;
+
+	locking = TCGS_GetLevel0DiscoveryFeatureLockingHeader(header);
+	if (locking != NULL)
+	{
+		flags |= locking->locked ? TCGS_TABLE_CACHE_LOCKED : 0;
+		flags |= locking->MBREnabled ? TCGS_TABLE_CACHE_MBR_ENABLED : 0;
+		flags |= locking->MBRDone ? TCGS_TABLE_CACHE_MBR_DONE : 0;
+	}
+	changed = cache->lockingFlagsKnown && flags != cache->lockingFlags;
+	cache->lockingFlags = flags;
+	cache->lockingFlagsKnown = TRUE;
+	if (changed)
+	{
+		TCGS_TableCache_Invalidate(cache);
+	}
+	return changed;
+}
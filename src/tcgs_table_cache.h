@@ -0,0 +1,144 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_table_cache.h
+///
+/// Cache of table rows read within a session
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_TABLE_CACHE_H
+#define _TCGS_TABLE_CACHE_H
+
+#include <stdbool.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_session.h"
+
+typedef struct
+{
+	bool    empty;      //TPer returned no value for the cell
+	uint8   type;       //TOKEN_TYPE_UINT or TOKEN_TYPE_BYTES
+	uint8   length;
+	uint64  value;
+	uint8   bytes[TCGS_TABLE_CACHE_CELL_SIZE];
+} TCGS_TableCacheValue_t;
+
+typedef struct
+{
+	TCGS_UID_t              object;
+	uint32                  validColumns;   //bit mask of cached columns
+	uint32                  lastUsed;
+	TCGS_TableCacheValue_t  columns[TCGS_TABLE_CACHE_COLUMNS];
+} TCGS_TableCacheRow_t;
+
+/*****************************************************************************
+ * \brief Cache of table rows of one session
+ *
+ * \par Cells are read from TPer on the first access (or prefetched with
+ * one Get of several columns) and updated by Set functions of the cache.
+ * The cache is dropped when the session is lost or restarted and when
+ * Level 0 Discovery shows that locking state changed behind the session,
+ * e.g. a range was locked by power cycle or MBRDone was reset.
+ *
+ * \par Sets done bypassing the cache (other sessions, transactions) are
+ * not seen, TCGS_TableCache_Invalidate is to be called after them.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_Session_t        *session;
+	uint32                 tperSessionNumber;   //session the cached values were read in
+	uint32                 hostSessionNumber;
+	bool                   lockingFlagsKnown;
+	uint8                  lockingFlags;        //locked, MBREnabled, MBRDone of last Level 0 Discovery
+	uint32                 clock;
+	uint32                 rowCount;
+	TCGS_TableCacheRow_t   rows[TCGS_TABLE_CACHE_ROWS];
+
+	//statistics
+	uint32                 hits;
+	uint32                 misses;
+} TCGS_TableCache_t;
+
+/*****************************************************************************
+ * \brief Initializes empty cache of the session
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_TableCache_Init(TCGS_TableCache_t *cache, TCGS_Session_t *session);
+
+/*****************************************************************************
+ * \brief Drops all cached rows
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_TableCache_Invalidate(TCGS_TableCache_t *cache);
+
+/*****************************************************************************
+ * \brief Reads columns of the row with one Get and caches them
+ *
+ * @param[in]  cache        cache
+ * @param[in]  object       UID of row
+ * @param[in]  startColumn  first column to read
+ * @param[in]  endColumn    last column to read, below TCGS_TABLE_CACHE_COLUMNS
+ *
+ * \return ERROR_SUCCESS if columns are read, error of TCGS_Get otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_TableCache_Prefetch(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 startColumn, uint32 endColumn);
+
+/*****************************************************************************
+ * \brief Returns integer cell, reading it from TPer if it is not cached
+ *
+ * @param[in]  cache        cache
+ * @param[in]  object       UID of row
+ * @param[in]  column       column
+ * @param[out] value        value of the cell
+ *
+ * \return ERROR_SUCCESS if value is returned, ERROR_PARSER if the cell is
+ * empty or not an integer, error of TCGS_Get otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_TableCache_GetUInt(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 column, uint64 *value);
+
+/*****************************************************************************
+ * \brief Returns byte cell, reading it from TPer if it is not cached
+ *
+ * \par Returned data points into the cache and stays valid until the next
+ * call of a cache function.
+ *
+ * \return ERROR_PARAMETER if the cell is longer than TCGS_TABLE_CACHE_CELL_SIZE
+ *
+ * \see TCGS_TableCache_GetUInt
+ *****************************************************************************/
+TCGS_Error_t TCGS_TableCache_GetBytes(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 column, const uint8 **data, uint32 *length);
+
+/*****************************************************************************
+ * \brief Sets cell and updates the cache if Set succeeded
+ *
+ * \see TCGS_SetUInt, TCGS_SetBytes
+ *****************************************************************************/
+TCGS_Error_t TCGS_TableCache_SetUInt(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 column, uint64 value);
+
+TCGS_Error_t TCGS_TableCache_SetBytes(TCGS_TableCache_t *cache, const TCGS_UID_t *object,
+		uint32 column, const void *data, uint32 length);
+
+/*****************************************************************************
+ * \brief Checks locking state reported by Level 0 Discovery
+ *
+ * \par The cache is dropped if locked, MBREnabled or MBRDone bits of Locking
+ * feature differ from those of the previous check.
+ *
+ * @param[in]  cache        cache
+ * @param[in]  header       decoded Level 0 Discovery response
+ *
+ * \return TRUE if the cache was dropped
+ *
+ * \see TCGS_DecodeLevel0Discovery
+ *****************************************************************************/
+bool TCGS_TableCache_CheckLevel0Discovery(TCGS_TableCache_t *cache,
+		TCGS_Level0Discovery_Header_t *header);
+
+#endif //_TCGS_TABLE_CACHE_H
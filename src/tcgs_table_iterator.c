@@ -0,0 +1,162 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_table_iterator.c
+///
+/// Enumeration of table rows with Next method
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+#include "tcgs_uid.h"
+#include "tcgs_table_iterator.h"
+
+//encoded UID: short atom header and 8 bytes
+#define TCGS_TABLE_ITERATOR_ROW_LENGTH (1 + sizeof(TCGS_UID_t))
+
+//tokens of result around the list of rows, status list and SubPacket padding
+#define TCGS_TABLE_ITERATOR_RESULT_LENGTH 16
+
+/*
+ * Sends Next for rows following where into the buffer
+ */
+static TCGS_Error_t TCGS_TableIterator_Request(TCGS_TableIterator_t *iterator,
+		const TCGS_UID_t *where, uint32 buffer)
+{
+	TCGS_Builder_t *builder = TCGS_Session_StartPacket(iterator->session);
+
+	TCGS_Builder_StartCall(builder, &iterator->table, &TCGS_UID_Method_Next);
+	if (where != NULL)
+	{
+		TCGS_Builder_AddNamedUID(builder, NEXT_WHERE, where);
+	}
+	TCGS_Builder_AddNamedUInt(builder, NEXT_COUNT, iterator->count);
+	TCGS_Builder_EndCall(builder);
+	return TCGS_Session_Send(iterator->session, iterator->buffers[buffer],
+			sizeof(iterator->buffers[buffer]));
+}
+
+/*
+ * Receives batch sent to the buffer and prefetches the following one
+ */
+static TCGS_Error_t TCGS_TableIterator_Receive(TCGS_TableIterator_t *iterator, uint32 buffer)
+{
+	TCGS_Parser_t response, results, rows;
+	TCGS_MethodStatus_t status;
+	const uint8 *last = NULL;
+	uint32 length, count = 0;
+	TCGS_Error_t error;
+
+	iterator->prefetched = FALSE;
+	error = TCGS_Session_Receive(iterator->session, &response);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	error = TCGS_Parser_GetResult(&response, &results, &status);
+	if (error == ERROR_SESSION)
+	{
+		iterator->session->open = FALSE;
+	}
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	if (status != METHOD_STATUS_SUCCESS)
+	{
+		return ERROR_METHOD;
+	}
+	if (!TCGS_Parser_Expect(&results, TOKEN_START_LIST))
+	{
+		return ERROR_PARSER;
+	}
+
+	//rows are validated once, so that Next only steps over them
+	rows = results;
+	while (!TCGS_Parser_Expect(&results, TOKEN_END_LIST))
+	{
+		if (!TCGS_Parser_GetBytes(&results, &last, &length) || length != sizeof(TCGS_UID_t))
+		{
+			return ERROR_PARSER;
+		}
+		count++;
+	}
+	rows.length = results.position - 1;
+	iterator->rows = rows;
+	iterator->buffer = buffer;
+	iterator->batchCount++;
+	iterator->last = (count < iterator->count);
+
+	if (!iterator->last)
+	{
+		error = TCGS_TableIterator_Request(iterator, (const TCGS_UID_t*)last, buffer ^ 1);
+		if (error != ERROR_SUCCESS)
+		{
+			return error;
+		}
+		iterator->prefetched = TRUE;
+	}
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_TableIterator_Start(TCGS_TableIterator_t *iterator, TCGS_Session_t *session,
+		const TCGS_UID_t *table, uint32 count)
+{
+	uint32 maxCount = (sizeof(iterator->buffers[0]) - TCGS_PACKET_HEADERS_LENGTH -
+			TCGS_TABLE_ITERATOR_RESULT_LENGTH) / TCGS_TABLE_ITERATOR_ROW_LENGTH;
+
+	iterator->session = session;
+	iterator->table = *table;
+	iterator->count = (count == 0 || count > maxCount) ? maxCount : count;
+	TCGS_Parser_Init(&iterator->rows, NULL, 0);
+	iterator->buffer = 0;
+	iterator->prefetched = FALSE;
+	iterator->last = TRUE;
+	iterator->batchCount = 0;
+
+	iterator->error = TCGS_TableIterator_Request(iterator, NULL, 0);
+	if (iterator->error == ERROR_SUCCESS)
+	{
+		iterator->error = TCGS_TableIterator_Receive(iterator, 0);
+	}
+	return iterator->error;
+}
+
+bool TCGS_TableIterator_Next(TCGS_TableIterator_t *iterator, const TCGS_UID_t **row)
+{
+	const uint8 *data;
+	uint32 length;
+
+	while (TCGS_Parser_AtEnd(&iterator->rows))
+	{
+		if (iterator->error != ERROR_SUCCESS || iterator->last)
+		{
+			return FALSE;
+		}
+		iterator->last = TRUE;
+		iterator->error = TCGS_TableIterator_Receive(iterator, iterator->buffer ^ 1);
+	}
+	TCGS_Parser_GetBytes(&iterator->rows, &data, &length);
+	*row = (const TCGS_UID_t*)data;
+	return TRUE;
+}
+
+TCGS_Error_t TCGS_TableIterator_End(TCGS_TableIterator_t *iterator)
+{
+	TCGS_Parser_t response;
+
+	if (iterator->prefetched)
+	{
+		//response is read into the buffers of the iterator, rows are not needed
+		TCGS_Session_Receive(iterator->session, &response);
+		iterator->prefetched = FALSE;
+	}
+	TCGS_Parser_Init(&iterator->rows, NULL, 0);
+	return iterator->error;
+}
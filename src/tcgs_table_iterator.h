@@ -0,0 +1,85 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_table_iterator.h
+///
+/// Enumeration of table rows with Next method
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_TABLE_ITERATOR_H
+#define _TCGS_TABLE_ITERATOR_H
+
+#include <stdbool.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+
+/*****************************************************************************
+ * \brief Iterator over rows of a table
+ *
+ * \par Rows are requested in batches by Next method with Count large enough
+ * to fill the ComPacket. When a batch is received, Next for the following
+ * batch is sent at once, so TPer prepares it while the caller walks through
+ * the current one. Row UIDs are not copied: they point into the buffer of
+ * the batch, while the following batch is received into the other buffer.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_Session_t  *session;
+	TCGS_UID_t       table;
+	uint32           count;         //rows requested by one Next
+	TCGS_Parser_t    rows;          //rows of current batch not returned yet
+	uint32           buffer;        //buffer of current batch
+	bool             prefetched;    //Next for the following batch is sent
+	bool             last;          //current batch is the last one
+	TCGS_Error_t     error;
+	uint32           batchCount;    //batches received
+	uint8            buffers[2][TCGS_MAX_COMPACKET_SIZE];
+} TCGS_TableIterator_t;
+
+/*****************************************************************************
+ * \brief Starts enumeration of table rows and receives the first batch
+ *
+ * \par TCGS_TableIterator_End shall be called when enumeration is finished
+ * or abandoned: the response to the prefetched batch shall be received
+ * before the buffers of the iterator are dropped. The device is not held
+ * while a batch is prefetched, the next exchange on the device reads the
+ * response into the iterator first.
+ *
+ * @param[out] iterator     iterator
+ * @param[in]  session      open session
+ * @param[in]  table        UID of table (e.g. 00 00 08 02 00 00 00 00 for Locking)
+ * @param[in]  count        rows in batch, 0 for as many as fit the ComPacket
+ *
+ * \return ERROR_SUCCESS if the first batch is received, error code otherwise
+ *
+ * \see TCGS_TableIterator_Next, TCGS_TableIterator_End
+ *****************************************************************************/
+TCGS_Error_t TCGS_TableIterator_Start(TCGS_TableIterator_t *iterator, TCGS_Session_t *session,
+		const TCGS_UID_t *table, uint32 count);
+
+/*****************************************************************************
+ * \brief Returns the next row of the table
+ *
+ * \par The returned UID stays valid until the iterator moves to the
+ * following batch, i.e. until it returns a row of another batch.
+ *
+ * @param[in]  iterator     iterator
+ * @param[out] row          UID of the row
+ *
+ * \return TRUE if row is returned, FALSE at the end of table or on error,
+ * see TCGS_TableIterator_End
+ *****************************************************************************/
+bool TCGS_TableIterator_Next(TCGS_TableIterator_t *iterator, const TCGS_UID_t **row);
+
+/*****************************************************************************
+ * \brief Ends enumeration, prefetched batch is dropped
+ *
+ * \return ERROR_SUCCESS if all rows were returned without errors or
+ * enumeration was abandoned, error of enumeration otherwise
+ *****************************************************************************/
+TCGS_Error_t TCGS_TableIterator_End(TCGS_TableIterator_t *iterator);
+
+#endif //_TCGS_TABLE_ITERATOR_H
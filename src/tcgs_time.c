@@ -0,0 +1,32 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_time.c
+///
+/// Monotonic time source of the library
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <time.h>
+
+#include "tcgs_types.h"
+#include "tcgs_time.h"
+
+uint64 TCGS_GetTime(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64)now.tv_sec * TCGS_NSEC_PER_SEC + (uint64)now.tv_nsec;
+}
+
+void TCGS_Sleep(uint64 duration)
+{
+	struct timespec delay;
+
+	delay.tv_sec  = duration / TCGS_NSEC_PER_SEC;
+	delay.tv_nsec = duration % TCGS_NSEC_PER_SEC;
+	while (nanosleep(&delay, &delay) != 0)
+	{
+		//continue sleeping after interruption by signal
+	}
+}
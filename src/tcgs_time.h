@@ -0,0 +1,33 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_time.h
+///
+/// Monotonic time source of the library
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_TIME_H
+#define _TCGS_TIME_H
+
+#include "tcgs_types.h"
+
+#define TCGS_NSEC_PER_USEC 1000ULL
+#define TCGS_NSEC_PER_MSEC 1000000ULL
+#define TCGS_NSEC_PER_SEC  1000000000ULL
+
+/*****************************************************************************
+ * \brief Return current value of monotonic clock
+ *
+ * \return uint64 time in nanoseconds since unspecified starting point
+ *****************************************************************************/
+uint64 TCGS_GetTime(void);
+
+/*****************************************************************************
+ * \brief Suspend calling thread
+ *
+ * @param[in]  duration     time to sleep in nanoseconds
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_Sleep(uint64 duration);
+
+#endif //_TCGS_TIME_H
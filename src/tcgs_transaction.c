@@ -0,0 +1,329 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_transaction.c
+///
+/// Transactions grouping method invocations of a session
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+#include "tcgs_transaction.h"
+
+//bytes kept free in ComPacket for SubPacket padding
+#define TCGS_TRANSACTION_RESERVE 3
+
+typedef enum
+{
+	TRANSACTION_METHOD_GET,
+	TRANSACTION_METHOD_SET_UINT,
+	TRANSACTION_METHOD_SET_BYTES,
+	TRANSACTION_METHOD_ENCODED,     //data holds the whole invocation
+} TCGS_TransactionMethodType_t;
+
+typedef struct
+{
+	TCGS_TransactionMethodType_t  type;
+	const TCGS_UID_t             *object;
+	uint32                        column;
+	uint32                        endColumn;
+	uint64                        value;
+	const void                   *data;
+	uint32                        length;
+} TCGS_TransactionMethod_t;
+
+static TCGS_Error_t TCGS_Transaction_Fail(TCGS_Transaction_t *transaction, TCGS_Error_t error)
+{
+	if (transaction->error == ERROR_SUCCESS)
+	{
+		transaction->error = error;
+	}
+	transaction->failed = TRUE;
+	return transaction->error;
+}
+
+static void TCGS_Transaction_StartPacket(TCGS_Transaction_t *transaction)
+{
+	TCGS_Builder_t *builder = TCGS_Session_StartPacket(transaction->session);
+
+	if (transaction->packetCount == 0)
+	{
+		TCGS_Builder_AddToken(builder, TOKEN_START_TRANSACTION);
+		TCGS_Builder_AddUInt(builder, 0);
+	}
+	transaction->packetStarted = TRUE;
+}
+
+static void TCGS_Transaction_Encode(TCGS_Builder_t *builder, const TCGS_TransactionMethod_t *method)
+{
+	switch (method->type)
+	{
+	case TRANSACTION_METHOD_GET:
+		TCGS_Builder_AddGet(builder, method->object, method->column, method->endColumn);
+		break;
+	case TRANSACTION_METHOD_SET_UINT:
+		TCGS_Builder_AddSetUInt(builder, method->object, method->column, method->value);
+		break;
+	case TRANSACTION_METHOD_SET_BYTES:
+		TCGS_Builder_AddSetBytes(builder, method->object, method->column, method->data, method->length);
+		break;
+	case TRANSACTION_METHOD_ENCODED:
+		TCGS_Builder_AddEncoded(builder, method->data, method->length);
+		break;
+	}
+}
+
+static bool TCGS_Transaction_Fits(TCGS_Builder_t *builder)
+{
+	return !builder->overflow && builder->length + TCGS_TRANSACTION_RESERVE <= builder->size;
+}
+
+/*
+ * Sends ComPacket with queued methods and distributes results to the calls
+ */
+static TCGS_Error_t TCGS_Transaction_Send(TCGS_Transaction_t *transaction, bool end, bool commit,
+		uint64 *endStatus)
+{
+	TCGS_Session_t *session = transaction->session;
+	TCGS_TransactionCall_t *call;
+	TCGS_Parser_t response, results;
+	TCGS_MethodStatus_t status;
+	TCGS_Error_t error;
+	uint64 startStatus;
+	uint32 pendingCount, i;
+
+	if (end)
+	{
+		TCGS_Builder_AddToken(&session->builder, TOKEN_END_TRANSACTION);
+		TCGS_Builder_AddUInt(&session->builder, commit ? 0 : 1);
+	}
+	error = TCGS_Session_Exchange(session, &response);
+	//the ComPacket is consumed even if the exchange fails, its methods are never sent again
+	transaction->packetStarted = FALSE;
+	pendingCount = transaction->pendingCount;
+	transaction->pendingCount = 0;
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+
+	if (transaction->packetCount++ == 0)
+	{
+		if (!TCGS_Parser_Expect(&response, TOKEN_START_TRANSACTION) ||
+			!TCGS_Parser_GetUInt(&response, &startStatus))
+		{
+			return ERROR_PARSER;
+		}
+		if (startStatus != 0)
+		{
+			//TPer refused the transaction and ignored the methods
+			return ERROR_METHOD;
+		}
+		transaction->started = TRUE;
+	}
+
+	for (i = 0; i < pendingCount; i++)
+	{
+		error = TCGS_Parser_GetResult(&response, &results, &status);
+		if (error == ERROR_SESSION)
+		{
+			session->open = FALSE;
+		}
+		if (error != ERROR_SUCCESS)
+		{
+			return error;
+		}
+		call = transaction->pending[i];
+		if (status != METHOD_STATUS_SUCCESS)
+		{
+			TCGS_Transaction_Fail(transaction, ERROR_METHOD);
+		}
+		if (call == NULL)
+		{
+			continue;
+		}
+		call->status = status;
+		call->done = TRUE;
+		call->resultsLength = results.length;
+		if (call->results != NULL)
+		{
+			if (results.length > call->resultsSize)
+			{
+				return ERROR_PARAMETER;
+			}
+			memcpy(call->results, results.data, results.length);
+		}
+	}
+
+	if (end && (!TCGS_Parser_Expect(&response, TOKEN_END_TRANSACTION) ||
+		!TCGS_Parser_GetUInt(&response, endStatus)))
+	{
+		return ERROR_PARSER;
+	}
+	return ERROR_SUCCESS;
+}
+
+static TCGS_Error_t TCGS_Transaction_Queue(TCGS_Transaction_t *transaction, TCGS_TransactionCall_t *call,
+		const TCGS_TransactionMethod_t *method)
+{
+	TCGS_Builder_t *builder = &transaction->session->builder;
+	TCGS_Error_t error;
+	uint32 mark;
+
+	if (transaction->failed)
+	{
+		return transaction->error;
+	}
+	if (call != NULL)
+	{
+		call->done = FALSE;
+		call->resultsLength = 0;
+		call->status = METHOD_STATUS_FAIL;
+	}
+	if (!transaction->packetStarted)
+	{
+		TCGS_Transaction_StartPacket(transaction);
+	}
+
+	mark = builder->length;
+	TCGS_Transaction_Encode(builder, method);
+	if (!TCGS_Transaction_Fits(builder) || transaction->pendingCount == TCGS_TRANSACTION_MAX_CALLS)
+	{
+		//the method goes to the next ComPacket
+		builder->length = mark;
+		builder->overflow = FALSE;
+		if (transaction->pendingCount == 0)
+		{
+			return TCGS_Transaction_Fail(transaction, ERROR_BUILDER);
+		}
+		error = TCGS_Transaction_Send(transaction, FALSE, FALSE, NULL);
+		if (error != ERROR_SUCCESS)
+		{
+			return TCGS_Transaction_Fail(transaction, error);
+		}
+		if (transaction->failed)
+		{
+			return transaction->error;
+		}
+		TCGS_Transaction_StartPacket(transaction);
+		TCGS_Transaction_Encode(builder, method);
+		if (!TCGS_Transaction_Fits(builder))
+		{
+			return TCGS_Transaction_Fail(transaction, ERROR_BUILDER);
+		}
+	}
+	transaction->pending[transaction->pendingCount++] = call;
+	return ERROR_SUCCESS;
+}
+
+TCGS_Error_t TCGS_StartTransaction(TCGS_Transaction_t *transaction, TCGS_Session_t *session)
+{
+	memset(transaction, 0, sizeof(*transaction));
+	transaction->session = session;
+	return session->open ? ERROR_SUCCESS : ERROR_SESSION;
+}
+
+TCGS_Error_t TCGS_Transaction_Get(TCGS_Transaction_t *transaction, TCGS_TransactionCall_t *call,
+		const TCGS_UID_t *object, uint32 startColumn, uint32 endColumn)
+{
+	TCGS_TransactionMethod_t method;
+
+	memset(&method, 0, sizeof(method));
+	method.type = TRANSACTION_METHOD_GET;
+	method.object = object;
+	method.column = startColumn;
+	method.endColumn = endColumn;
+	return TCGS_Transaction_Queue(transaction, call, &method);
+}
+
+TCGS_Error_t TCGS_Transaction_SetUInt(TCGS_Transaction_t *transaction, TCGS_TransactionCall_t *call,
+		const TCGS_UID_t *object, uint32 column, uint64 value)
+{
+	TCGS_TransactionMethod_t method;
+
+	memset(&method, 0, sizeof(method));
+	method.type = TRANSACTION_METHOD_SET_UINT;
+	method.object = object;
+	method.column = column;
+	method.value = value;
+	return TCGS_Transaction_Queue(transaction, call, &method);
+}
+
+TCGS_Error_t TCGS_Transaction_SetBytes(TCGS_Transaction_t *transaction, TCGS_TransactionCall_t *call,
+		const TCGS_UID_t *object, uint32 column, const void *data, uint32 length)
+{
+	TCGS_TransactionMethod_t method;
+
+	memset(&method, 0, sizeof(method));
+	method.type = TRANSACTION_METHOD_SET_BYTES;
+	method.object = object;
+	method.column = column;
+	method.data = data;
+	method.length = length;
+	return TCGS_Transaction_Queue(transaction, call, &method);
+}
+
+TCGS_Error_t TCGS_Transaction_AddEncoded(TCGS_Transaction_t *transaction, TCGS_TransactionCall_t *call,
+		const void *tokens, uint32 length)
+{
+	TCGS_TransactionMethod_t method;
+
+	memset(&method, 0, sizeof(method));
+	method.type = TRANSACTION_METHOD_ENCODED;
+	method.data = tokens;
+	method.length = length;
+	return TCGS_Transaction_Queue(transaction, call, &method);
+}
+
+TCGS_Error_t TCGS_EndTransaction(TCGS_Transaction_t *transaction, bool commit)
+{
+	TCGS_Error_t error;
+	uint64 endStatus = 1;
+
+	commit = commit && !transaction->failed;
+	if (transaction->packetCount == 0 && transaction->pendingCount == 0)
+	{
+		//nothing was sent to TPer
+		transaction->packetStarted = FALSE;
+		return transaction->failed ? transaction->error : ERROR_SUCCESS;
+	}
+	if (transaction->pendingCount > 0)
+	{
+		//End Transaction is sent once results of all methods are checked
+		error = TCGS_Transaction_Send(transaction, FALSE, FALSE, NULL);
+		if (error != ERROR_SUCCESS)
+		{
+			TCGS_Transaction_Fail(transaction, error);
+		}
+		commit = commit && !transaction->failed;
+	}
+	if (!transaction->session->open)
+	{
+		return TCGS_Transaction_Fail(transaction, ERROR_SESSION);
+	}
+	TCGS_Transaction_StartPacket(transaction);
+	error = TCGS_Transaction_Send(transaction, TRUE, commit, &endStatus);
+	if (error != ERROR_SUCCESS)
+	{
+		return TCGS_Transaction_Fail(transaction, error);
+	}
+	if (transaction->failed)
+	{
+		return transaction->error;
+	}
+	if (commit && endStatus != 0)
+	{
+		return TCGS_Transaction_Fail(transaction, ERROR_METHOD);
+	}
+	return ERROR_SUCCESS;
+}
+
+void TCGS_TransactionCall_GetResults(TCGS_TransactionCall_t *call, TCGS_Parser_t *results)
+{
+	TCGS_Parser_Init(results, call->results, (call->results != NULL) ? call->resultsLength : 0);
+}
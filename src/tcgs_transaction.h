@@ -0,0 +1,142 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_transaction.h
+///
+/// Transactions grouping method invocations of a session
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_TRANSACTION_H
+#define _TCGS_TRANSACTION_H
+
+#include <stdbool.h>
+
+#include "tcgs_config.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_parser.h"
+#include "tcgs_session.h"
+
+/*****************************************************************************
+ * \brief Method invocation queued in transaction
+ *
+ * \par Returned values are copied to the buffer of the call when response of
+ * the ComPacket with the call is received. The structure shall stay valid
+ * until the transaction is ended.
+ *****************************************************************************/
+typedef struct
+{
+	uint8               *results;       //buffer for token stream of returned values, may be NULL
+	uint32               resultsSize;
+	uint32               resultsLength;
+	TCGS_MethodStatus_t  status;
+	bool                 done;          //response of the method is received
+} TCGS_TransactionCall_t;
+
+/*****************************************************************************
+ * \brief Transaction within session
+ *
+ * \par Methods are encoded into the ComPacket of the session as they are
+ * queued. When the next method doesn't fit the ComPacket, the ComPacket is
+ * sent and results of its methods are received, so any number of methods
+ * can be queued. Either all methods of the transaction take effect or none.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_Session_t          *session;
+	TCGS_TransactionCall_t  *pending[TCGS_TRANSACTION_MAX_CALLS];   //calls of current ComPacket
+	uint32                   pendingCount;
+	bool                     packetStarted; //ComPacket of the session holds queued methods
+	bool                     started;       //StartTransaction was confirmed by TPer
+	bool                     failed;        //a method failed, the transaction is to be aborted
+	TCGS_Error_t             error;         //first error of the transaction
+	uint32                   packetCount;   //ComPackets sent within the transaction
+} TCGS_Transaction_t;
+
+/*****************************************************************************
+ * \brief Starts transaction
+ *
+ * \par Start Transaction token is sent with the first ComPacket of queued
+ * methods, so starting transaction doesn't cost a round trip.
+ *
+ * @param[out] transaction  transaction to start
+ * @param[in]  session      open read-write session
+ *
+ * \return ERROR_SUCCESS if transaction is started, ERROR_SESSION if session
+ * is not open
+ *
+ * \see TCGS_EndTransaction
+ *****************************************************************************/
+TCGS_Error_t TCGS_StartTransaction(TCGS_Transaction_t *transaction, TCGS_Session_t *session);
+
+/*****************************************************************************
+ * \brief Queues Get method in transaction
+ *
+ * @param[in]  transaction  transaction
+ * @param[out] call         call to receive status and returned values
+ * @param[in]  object       UID of object (table row)
+ * @param[in]  startColumn  first column to get
+ * @param[in]  endColumn    last column to get
+ *
+ * \return ERROR_SUCCESS if method is queued, error of the transaction
+ * otherwise: no methods are queued after a failure
+ *
+ * \see TCGS_Get
+ *****************************************************************************/
+TCGS_Error_t TCGS_Transaction_Get(TCGS_Transaction_t *transaction, TCGS_TransactionCall_t *call,
+		const TCGS_UID_t *object, uint32 startColumn, uint32 endColumn);
+
+/*****************************************************************************
+ * \brief Queues Set method of one column in transaction
+ *
+ * @param[out] call         call to receive status, may be NULL
+ *
+ * \see TCGS_Transaction_Get, TCGS_SetUInt
+ *****************************************************************************/
+TCGS_Error_t TCGS_Transaction_SetUInt(TCGS_Transaction_t *transaction, TCGS_TransactionCall_t *call,
+		const TCGS_UID_t *object, uint32 column, uint64 value);
+
+TCGS_Error_t TCGS_Transaction_SetBytes(TCGS_Transaction_t *transaction, TCGS_TransactionCall_t *call,
+		const TCGS_UID_t *object, uint32 column, const void *data, uint32 length);
+
+/*****************************************************************************
+ * \brief Queues method invocation encoded in advance in transaction
+ *
+ * \par The tokens are the whole invocation from Call token to method
+ * status list, they are copied to ComPacket before the function returns.
+ *
+ * @param[out] call         call to receive status and results, may be NULL
+ * @param[in]  tokens       encoded invocation
+ * @param[in]  length       length of the invocation
+ *
+ * \see TCGS_Transaction_Get, TCGS_Builder_AddEncoded
+ *****************************************************************************/
+TCGS_Error_t TCGS_Transaction_AddEncoded(TCGS_Transaction_t *transaction, TCGS_TransactionCall_t *call,
+		const void *tokens, uint32 length);
+
+/*****************************************************************************
+ * \brief Ends transaction
+ *
+ * \par Remaining methods are sent in one ComPacket, End Transaction token
+ * follows in a separate one when their results are known. The transaction
+ * is committed only if commit is requested and all methods succeeded,
+ * otherwise it is aborted and TPer discards all changes.
+ *
+ * @param[in]  transaction  transaction
+ * @param[in]  commit       TRUE to commit, FALSE to abort
+ *
+ * \return ERROR_SUCCESS if transaction is committed or aborted on request,
+ * ERROR_METHOD if a method failed or TPer aborted the transaction, the first
+ * error of the transaction otherwise
+ *
+ * \see TCGS_StartTransaction
+ *****************************************************************************/
+TCGS_Error_t TCGS_EndTransaction(TCGS_Transaction_t *transaction, bool commit);
+
+/*****************************************************************************
+ * \brief Initializes parser of values returned by call of transaction
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_TransactionCall_GetResults(TCGS_TransactionCall_t *call, TCGS_Parser_t *results);
+
+#endif //_TCGS_TRANSACTION_H
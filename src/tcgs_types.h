@@ -20,7 +20,13 @@ typedef enum
 {
 	ERROR_SUCCESS,
 	ERROR_BUILDER,
-	ERROR_INTERFACE
+	ERROR_INTERFACE,
+	ERROR_PARSER,     //response of TPer is malformed
+	ERROR_SESSION,    //session is not open or was closed by TPer
+	ERROR_METHOD,     //method returned status other than SUCCESS
+	ERROR_PARAMETER,  //invalid argument of library function
+	ERROR_TIMEOUT,    //deadline of operation has passed
+	ERROR_CANCELLED,  //operation was cancelled
 } TCGS_Error_t;
 
 //minimal block size of the storage device
@@ -0,0 +1,48 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_uid.c
+///
+/// UIDs of SPs, tables, objects, authorities and methods
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_uid.h"
+
+const TCGS_UID_t TCGS_UID_SMUID                = {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF}};
+const TCGS_UID_t TCGS_UID_ThisSP               = {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01}};
+const TCGS_UID_t TCGS_UID_Method_Properties    = {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x01}};
+const TCGS_UID_t TCGS_UID_Method_StartSession  = {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x02}};
+const TCGS_UID_t TCGS_UID_Method_SyncSession   = {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x03}};
+
+const TCGS_UID_t TCGS_UID_Method_Next          = {{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x08}};
+const TCGS_UID_t TCGS_UID_Method_Get           = {{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x16}};
+const TCGS_UID_t TCGS_UID_Method_Set           = {{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x17}};
+const TCGS_UID_t TCGS_UID_Method_Authenticate  = {{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x1C}};
+const TCGS_UID_t TCGS_UID_Method_Revert        = {{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x02, 0x02}};
+const TCGS_UID_t TCGS_UID_Method_Activate      = {{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x02, 0x03}};
+
+const TCGS_UID_t TCGS_UID_AdminSP              = {{0x00, 0x00, 0x02, 0x05, 0x00, 0x00, 0x00, 0x01}};
+const TCGS_UID_t TCGS_UID_LockingSP            = {{0x00, 0x00, 0x02, 0x05, 0x00, 0x00, 0x00, 0x02}};
+
+const TCGS_UID_t TCGS_UID_Table_Authority      = {{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00}};
+const TCGS_UID_t TCGS_UID_Table_C_PIN          = {{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x00, 0x00}};
+const TCGS_UID_t TCGS_UID_Table_ACE            = {{0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00}};
+const TCGS_UID_t TCGS_UID_Table_Locking        = {{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x00}};
+
+const TCGS_UID_t TCGS_UID_Anybody              = {{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x01}};
+const TCGS_UID_t TCGS_UID_SID                  = {{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x06}};
+const TCGS_UID_t TCGS_UID_Admin1               = {{0x00, 0x00, 0x00, 0x09, 0x00, 0x01, 0x00, 0x01}};
+const TCGS_UID_t TCGS_UID_User1                = {{0x00, 0x00, 0x00, 0x09, 0x00, 0x03, 0x00, 0x01}};
+
+const TCGS_UID_t TCGS_UID_C_PIN_SID            = {{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x00, 0x01}};
+const TCGS_UID_t TCGS_UID_C_PIN_MSID           = {{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x84, 0x02}};
+const TCGS_UID_t TCGS_UID_C_PIN_Admin1         = {{0x00, 0x00, 0x00, 0x0B, 0x00, 0x01, 0x00, 0x01}};
+const TCGS_UID_t TCGS_UID_C_PIN_User1          = {{0x00, 0x00, 0x00, 0x0B, 0x00, 0x03, 0x00, 0x01}};
+
+const TCGS_UID_t TCGS_UID_Locking_GlobalRange  = {{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x01}};
+const TCGS_UID_t TCGS_UID_Locking_Range1       = {{0x00, 0x00, 0x08, 0x02, 0x00, 0x03, 0x00, 0x01}};
+
+const TCGS_UID_t TCGS_UID_MBRControl           = {{0x00, 0x00, 0x08, 0x03, 0x00, 0x00, 0x00, 0x01}};
+const TCGS_UID_t TCGS_UID_MBR                  = {{0x00, 0x00, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00}};
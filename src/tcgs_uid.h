@@ -0,0 +1,71 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_uid.h
+///
+/// UIDs of SPs, tables, objects, authorities and methods
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_UID_H
+#define _TCGS_UID_H
+
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+
+//Session Manager and methods invoked on it, see 5.2 of Core Specification
+extern const TCGS_UID_t TCGS_UID_SMUID;
+extern const TCGS_UID_t TCGS_UID_ThisSP;
+extern const TCGS_UID_t TCGS_UID_Method_Properties;
+extern const TCGS_UID_t TCGS_UID_Method_StartSession;
+extern const TCGS_UID_t TCGS_UID_Method_SyncSession;
+
+//Methods invoked within session
+extern const TCGS_UID_t TCGS_UID_Method_Next;
+extern const TCGS_UID_t TCGS_UID_Method_Get;
+extern const TCGS_UID_t TCGS_UID_Method_Set;
+extern const TCGS_UID_t TCGS_UID_Method_Authenticate;
+extern const TCGS_UID_t TCGS_UID_Method_Revert;
+extern const TCGS_UID_t TCGS_UID_Method_Activate;
+
+//Security Providers
+extern const TCGS_UID_t TCGS_UID_AdminSP;
+extern const TCGS_UID_t TCGS_UID_LockingSP;
+
+//Tables enumerated with Next method
+extern const TCGS_UID_t TCGS_UID_Table_Authority;
+extern const TCGS_UID_t TCGS_UID_Table_C_PIN;
+extern const TCGS_UID_t TCGS_UID_Table_ACE;
+extern const TCGS_UID_t TCGS_UID_Table_Locking;
+
+//Authorities
+extern const TCGS_UID_t TCGS_UID_Anybody;
+extern const TCGS_UID_t TCGS_UID_SID;
+extern const TCGS_UID_t TCGS_UID_Admin1;
+extern const TCGS_UID_t TCGS_UID_User1;
+#define TCGS_COLUMN_AUTHORITY_ENABLED 5
+
+//C_PIN table rows and its columns
+extern const TCGS_UID_t TCGS_UID_C_PIN_SID;
+extern const TCGS_UID_t TCGS_UID_C_PIN_MSID;
+extern const TCGS_UID_t TCGS_UID_C_PIN_Admin1;
+extern const TCGS_UID_t TCGS_UID_C_PIN_User1;
+#define TCGS_COLUMN_C_PIN_PIN 3
+
+//Locking table rows and its columns
+extern const TCGS_UID_t TCGS_UID_Locking_GlobalRange;
+extern const TCGS_UID_t TCGS_UID_Locking_Range1;
+#define TCGS_COLUMN_LOCKING_RANGE_START        3
+#define TCGS_COLUMN_LOCKING_RANGE_LENGTH       4
+#define TCGS_COLUMN_LOCKING_READ_LOCK_ENABLED  5
+#define TCGS_COLUMN_LOCKING_WRITE_LOCK_ENABLED 6
+#define TCGS_COLUMN_LOCKING_READ_LOCKED        7
+#define TCGS_COLUMN_LOCKING_WRITE_LOCKED       8
+
+//MBRControl table row and its columns
+extern const TCGS_UID_t TCGS_UID_MBRControl;
+#define TCGS_COLUMN_MBRCONTROL_ENABLE 1
+#define TCGS_COLUMN_MBRCONTROL_DONE   2
+
+//Byte table of shadow MBR
+extern const TCGS_UID_t TCGS_UID_MBR;
+
+#endif //_TCGS_UID_H
@@ -0,0 +1,211 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_uid_catalog.c
+///
+/// Catalog of UIDs, generated by tools/gen_uid_catalog.py, do not edit
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include "tcgs_uid_catalog.h"
+
+#if TCGS_UID_CATALOG_NAME_LENGTH < 37
+#error TCGS_UID_CATALOG_NAME_LENGTH is too small for the catalog
+#endif
+
+#if TCGS_FEATURE_CATALOG_NAME_LENGTH < 11
+#error TCGS_FEATURE_CATALOG_NAME_LENGTH is too small for the catalog
+#endif
+
+const uint32 TCGS_UIDCatalog_Size = 143;
+
+//sorted by UID
+const TCGS_UIDCatalogEntry_t TCGS_UIDCatalog[143] =
+{
+	{{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01}}, UID_KIND_OBJECT, "ThisSP"},
+	{{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF}}, UID_KIND_OBJECT, "SMUID"},
+	{{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x01}}, UID_KIND_METHOD, "Method_Properties"},
+	{{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x02}}, UID_KIND_METHOD, "Method_StartSession"},
+	{{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x03}}, UID_KIND_METHOD, "Method_SyncSession"},
+	{{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x04}}, UID_KIND_METHOD, "Method_StartTrustedSession"},
+	{{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x05}}, UID_KIND_METHOD, "Method_SyncTrustedSession"},
+	{{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x06}}, UID_KIND_METHOD, "Method_CloseSession"},
+	{{{0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_Table"},
+	{{{0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_SPInfo"},
+	{{{0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_SPTemplates"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_MethodID"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x06}}, UID_KIND_METHOD, "Method_EnterpriseGet"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x07}}, UID_KIND_METHOD, "Method_EnterpriseSet"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x08}}, UID_KIND_METHOD, "Method_Next"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x0C}}, UID_KIND_METHOD, "Method_EnterpriseAuthenticate"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x0D}}, UID_KIND_METHOD, "Method_GetACL"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x10}}, UID_KIND_METHOD, "Method_GenKey"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x11}}, UID_KIND_METHOD, "Method_RevertSP"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x16}}, UID_KIND_METHOD, "Method_Get"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x17}}, UID_KIND_METHOD, "Method_Set"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x1C}}, UID_KIND_METHOD, "Method_Authenticate"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x02, 0x02}}, UID_KIND_METHOD, "Method_Revert"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x02, 0x03}}, UID_KIND_METHOD, "Method_Activate"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x06, 0x01}}, UID_KIND_METHOD, "Method_Random"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x08, 0x01}}, UID_KIND_METHOD, "Method_Reactivate"},
+	{{{0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x08, 0x03}}, UID_KIND_METHOD, "Method_Erase"},
+	{{{0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_AccessControl"},
+	{{{0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_ACE"},
+	{{{0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x01}}, UID_KIND_OBJECT, "ACE_Anybody"},
+	{{{0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x02}}, UID_KIND_OBJECT, "ACE_Admin"},
+	{{{0x00, 0x00, 0x00, 0x08, 0x00, 0x03, 0xE0, 0x00}}, UID_KIND_OBJECT, "ACE_Locking_GlobalRange_Set_RdLocked"},
+	{{{0x00, 0x00, 0x00, 0x08, 0x00, 0x03, 0xE0, 0x01}}, UID_KIND_OBJECT, "ACE_Locking_Range1_Set_RdLocked"},
+	{{{0x00, 0x00, 0x00, 0x08, 0x00, 0x03, 0xE8, 0x00}}, UID_KIND_OBJECT, "ACE_Locking_GlobalRange_Set_WrLocked"},
+	{{{0x00, 0x00, 0x00, 0x08, 0x00, 0x03, 0xE8, 0x01}}, UID_KIND_OBJECT, "ACE_Locking_Range1_Set_WrLocked"},
+	{{{0x00, 0x00, 0x00, 0x08, 0x00, 0x03, 0xF8, 0x01}}, UID_KIND_OBJECT, "ACE_MBRControl_Set_DoneToDOR"},
+	{{{0x00, 0x00, 0x00, 0x08, 0x00, 0x03, 0xFC, 0x00}}, UID_KIND_OBJECT, "ACE_DataStore_Get_All"},
+	{{{0x00, 0x00, 0x00, 0x08, 0x00, 0x03, 0xFC, 0x01}}, UID_KIND_OBJECT, "ACE_DataStore_Set_All"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_Authority"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x01}}, UID_KIND_AUTHORITY, "Anybody"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x02}}, UID_KIND_AUTHORITY, "Admins"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x03}}, UID_KIND_AUTHORITY, "Makers"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x06}}, UID_KIND_AUTHORITY, "SID"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x02, 0x01}}, UID_KIND_AUTHORITY, "AdminSP_Admin1"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x00}}, UID_KIND_AUTHORITY, "BandMasters"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x01}}, UID_KIND_AUTHORITY, "BandMaster0"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x02}}, UID_KIND_AUTHORITY, "BandMaster1"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x03}}, UID_KIND_AUTHORITY, "BandMaster2"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x04}}, UID_KIND_AUTHORITY, "BandMaster3"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x05}}, UID_KIND_AUTHORITY, "BandMaster4"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x06}}, UID_KIND_AUTHORITY, "BandMaster5"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x07}}, UID_KIND_AUTHORITY, "BandMaster6"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x08}}, UID_KIND_AUTHORITY, "BandMaster7"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x09}}, UID_KIND_AUTHORITY, "BandMaster8"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x0A}}, UID_KIND_AUTHORITY, "BandMaster9"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x0B}}, UID_KIND_AUTHORITY, "BandMaster10"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x0C}}, UID_KIND_AUTHORITY, "BandMaster11"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x0D}}, UID_KIND_AUTHORITY, "BandMaster12"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x0E}}, UID_KIND_AUTHORITY, "BandMaster13"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x0F}}, UID_KIND_AUTHORITY, "BandMaster14"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x80, 0x10}}, UID_KIND_AUTHORITY, "BandMaster15"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x84, 0x01}}, UID_KIND_AUTHORITY, "EraseMaster"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x01, 0x00, 0x01}}, UID_KIND_AUTHORITY, "Admin1"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x01, 0x00, 0x02}}, UID_KIND_AUTHORITY, "Admin2"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x01, 0x00, 0x03}}, UID_KIND_AUTHORITY, "Admin3"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x01, 0x00, 0x04}}, UID_KIND_AUTHORITY, "Admin4"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x01, 0xFF, 0x01}}, UID_KIND_AUTHORITY, "PSID"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x03, 0x00, 0x00}}, UID_KIND_AUTHORITY, "Users"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x03, 0x00, 0x01}}, UID_KIND_AUTHORITY, "User1"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x03, 0x00, 0x02}}, UID_KIND_AUTHORITY, "User2"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x03, 0x00, 0x03}}, UID_KIND_AUTHORITY, "User3"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x03, 0x00, 0x04}}, UID_KIND_AUTHORITY, "User4"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x03, 0x00, 0x05}}, UID_KIND_AUTHORITY, "User5"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x03, 0x00, 0x06}}, UID_KIND_AUTHORITY, "User6"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x03, 0x00, 0x07}}, UID_KIND_AUTHORITY, "User7"},
+	{{{0x00, 0x00, 0x00, 0x09, 0x00, 0x03, 0x00, 0x08}}, UID_KIND_AUTHORITY, "User8"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_C_PIN"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x00, 0x01}}, UID_KIND_OBJECT, "C_PIN_SID"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x02, 0x01}}, UID_KIND_OBJECT, "C_PIN_AdminSP_Admin1"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x80, 0x01}}, UID_KIND_OBJECT, "C_PIN_BandMaster0"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x80, 0x02}}, UID_KIND_OBJECT, "C_PIN_BandMaster1"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x80, 0x03}}, UID_KIND_OBJECT, "C_PIN_BandMaster2"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x80, 0x04}}, UID_KIND_OBJECT, "C_PIN_BandMaster3"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x84, 0x01}}, UID_KIND_OBJECT, "C_PIN_EraseMaster"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x84, 0x02}}, UID_KIND_OBJECT, "C_PIN_MSID"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x01, 0x00, 0x01}}, UID_KIND_OBJECT, "C_PIN_Admin1"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x01, 0x00, 0x02}}, UID_KIND_OBJECT, "C_PIN_Admin2"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x01, 0x00, 0x03}}, UID_KIND_OBJECT, "C_PIN_Admin3"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x01, 0x00, 0x04}}, UID_KIND_OBJECT, "C_PIN_Admin4"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x01, 0xFF, 0x01}}, UID_KIND_OBJECT, "C_PIN_PSID"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x03, 0x00, 0x01}}, UID_KIND_OBJECT, "C_PIN_User1"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x03, 0x00, 0x02}}, UID_KIND_OBJECT, "C_PIN_User2"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x03, 0x00, 0x03}}, UID_KIND_OBJECT, "C_PIN_User3"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x03, 0x00, 0x04}}, UID_KIND_OBJECT, "C_PIN_User4"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x03, 0x00, 0x05}}, UID_KIND_OBJECT, "C_PIN_User5"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x03, 0x00, 0x06}}, UID_KIND_OBJECT, "C_PIN_User6"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x03, 0x00, 0x07}}, UID_KIND_OBJECT, "C_PIN_User7"},
+	{{{0x00, 0x00, 0x00, 0x0B, 0x00, 0x03, 0x00, 0x08}}, UID_KIND_OBJECT, "C_PIN_User8"},
+	{{{0x00, 0x00, 0x00, 0x1D, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_SecretProtect"},
+	{{{0x00, 0x00, 0x02, 0x01, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_TPerInfo"},
+	{{{0x00, 0x00, 0x02, 0x01, 0x00, 0x03, 0x00, 0x01}}, UID_KIND_OBJECT, "TPerInfo"},
+	{{{0x00, 0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_Template"},
+	{{{0x00, 0x00, 0x02, 0x05, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_SP"},
+	{{{0x00, 0x00, 0x02, 0x05, 0x00, 0x00, 0x00, 0x01}}, UID_KIND_SP, "AdminSP"},
+	{{{0x00, 0x00, 0x02, 0x05, 0x00, 0x00, 0x00, 0x02}}, UID_KIND_SP, "LockingSP"},
+	{{{0x00, 0x00, 0x02, 0x05, 0x00, 0x01, 0x00, 0x01}}, UID_KIND_SP, "EnterpriseLockingSP"},
+	{{{0x00, 0x00, 0x08, 0x01, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_LockingInfo"},
+	{{{0x00, 0x00, 0x08, 0x01, 0x00, 0x00, 0x00, 0x01}}, UID_KIND_OBJECT, "LockingInfo"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_Locking"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x01}}, UID_KIND_OBJECT, "Locking_GlobalRange"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x02}}, UID_KIND_OBJECT, "Locking_Band1"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x03}}, UID_KIND_OBJECT, "Locking_Band2"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x04}}, UID_KIND_OBJECT, "Locking_Band3"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x05}}, UID_KIND_OBJECT, "Locking_Band4"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x06}}, UID_KIND_OBJECT, "Locking_Band5"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x07}}, UID_KIND_OBJECT, "Locking_Band6"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x08}}, UID_KIND_OBJECT, "Locking_Band7"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x09}}, UID_KIND_OBJECT, "Locking_Band8"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x0A}}, UID_KIND_OBJECT, "Locking_Band9"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x0B}}, UID_KIND_OBJECT, "Locking_Band10"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x0C}}, UID_KIND_OBJECT, "Locking_Band11"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x0D}}, UID_KIND_OBJECT, "Locking_Band12"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x0E}}, UID_KIND_OBJECT, "Locking_Band13"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x0F}}, UID_KIND_OBJECT, "Locking_Band14"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0x10}}, UID_KIND_OBJECT, "Locking_Band15"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x03, 0x00, 0x01}}, UID_KIND_OBJECT, "Locking_Range1"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x03, 0x00, 0x02}}, UID_KIND_OBJECT, "Locking_Range2"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x03, 0x00, 0x03}}, UID_KIND_OBJECT, "Locking_Range3"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x03, 0x00, 0x04}}, UID_KIND_OBJECT, "Locking_Range4"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x03, 0x00, 0x05}}, UID_KIND_OBJECT, "Locking_Range5"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x03, 0x00, 0x06}}, UID_KIND_OBJECT, "Locking_Range6"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x03, 0x00, 0x07}}, UID_KIND_OBJECT, "Locking_Range7"},
+	{{{0x00, 0x00, 0x08, 0x02, 0x00, 0x03, 0x00, 0x08}}, UID_KIND_OBJECT, "Locking_Range8"},
+	{{{0x00, 0x00, 0x08, 0x03, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_MBRControl"},
+	{{{0x00, 0x00, 0x08, 0x03, 0x00, 0x00, 0x00, 0x01}}, UID_KIND_OBJECT, "MBRControl"},
+	{{{0x00, 0x00, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "MBR"},
+	{{{0x00, 0x00, 0x08, 0x05, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_K_AES_128"},
+	{{{0x00, 0x00, 0x08, 0x05, 0x00, 0x00, 0x00, 0x01}}, UID_KIND_OBJECT, "K_AES_128_GlobalRange_Key"},
+	{{{0x00, 0x00, 0x08, 0x05, 0x00, 0x03, 0x00, 0x01}}, UID_KIND_OBJECT, "K_AES_128_Range1_Key"},
+	{{{0x00, 0x00, 0x08, 0x06, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_K_AES_256"},
+	{{{0x00, 0x00, 0x08, 0x06, 0x00, 0x00, 0x00, 0x01}}, UID_KIND_OBJECT, "K_AES_256_GlobalRange_Key"},
+	{{{0x00, 0x00, 0x08, 0x06, 0x00, 0x03, 0x00, 0x01}}, UID_KIND_OBJECT, "K_AES_256_Range1_Key"},
+	{{{0x00, 0x00, 0x10, 0x01, 0x00, 0x00, 0x00, 0x00}}, UID_KIND_TABLE, "Table_DataStore"},
+};
+
+const uint32 TCGS_UIDCatalog_BucketCount = 72;
+
+//seed of name hash for each bucket
+const uint16 TCGS_UIDCatalog_Seeds[72] =
+{
+	7, 2, 0, 1, 0, 26, 0, 0, 7, 6, 2, 1,
+	3, 1, 3, 1, 2, 4, 2, 1, 33, 12, 6, 1,
+	3, 1, 25, 6, 3, 2, 2, 31, 0, 29, 5, 3,
+	2, 7, 5, 21, 15, 20, 4, 2, 0, 7, 4, 8,
+	7, 1, 8, 14, 3, 7, 2, 17, 7, 0, 12, 2,
+	2, 9, 22, 2, 21, 3, 92, 4, 17, 22, 33, 8,
+};
+
+//index of entry for each hash value
+const uint16 TCGS_UIDCatalog_Slots[143] =
+{
+	63, 91, 76, 83, 97, 103, 61, 114, 90, 9, 104, 136,
+	94, 119, 96, 44, 122, 102, 110, 23, 14, 65, 20, 16,
+	141, 33, 17, 64, 108, 22, 3, 13, 30, 57, 6, 88,
+	89, 105, 36, 62, 26, 107, 8, 11, 101, 42, 56, 78,
+	41, 138, 55, 81, 98, 72, 27, 130, 131, 87, 5, 43,
+	80, 106, 52, 140, 49, 24, 47, 86, 124, 120, 0, 127,
+	25, 37, 18, 35, 66, 129, 135, 46, 137, 48, 74, 50,
+	39, 128, 85, 54, 60, 126, 58, 133, 31, 10, 29, 67,
+	2, 69, 109, 70, 4, 84, 32, 40, 116, 132, 73, 123,
+	134, 68, 71, 38, 1, 92, 100, 19, 75, 82, 118, 12,
+	59, 113, 99, 45, 77, 21, 125, 7, 117, 53, 111, 51,
+	121, 142, 115, 15, 79, 112, 139, 34, 95, 28, 93,
+};
+
+const uint32 TCGS_FeatureCatalog_Size = 7;
+
+//sorted by feature code
+const TCGS_FeatureCatalogEntry_t TCGS_FeatureCatalog[7] =
+{
+	{0x0000, "RESERVED"},
+	{0x0001, "TPER"},
+	{0x0002, "LOCKING"},
+	{0x0003, "GEOMETRY"},
+	{0x0100, "ENTERPRISE"},
+	{0x0200, "OPAL1"},
+	{0x0203, "OPAL2"},
+};
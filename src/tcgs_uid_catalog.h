@@ -0,0 +1,98 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_uid_catalog.h
+///
+/// Catalog of known UIDs and their names
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _TCGS_UID_CATALOG_H
+#define _TCGS_UID_CATALOG_H
+
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+
+//longest name of catalog entry including terminating zero
+#define TCGS_UID_CATALOG_NAME_LENGTH 40
+
+//longest name of Level 0 Discovery feature including terminating zero
+#define TCGS_FEATURE_CATALOG_NAME_LENGTH 16
+
+typedef enum
+{
+	UID_KIND_SP,
+	UID_KIND_TABLE,
+	UID_KIND_OBJECT,
+	UID_KIND_METHOD,
+	UID_KIND_AUTHORITY,
+} TCGS_UIDKind_t;
+
+/*****************************************************************************
+ * \brief Entry of UID catalog
+ *
+ * \par Names are suffixes of TCGS_UID_ constants, e.g. "Locking_Range1" or
+ * "Method_Get". Names are stored in the entries, so the whole catalog is
+ * constant data without relocations.
+ *****************************************************************************/
+typedef struct
+{
+	TCGS_UID_t      uid;
+	TCGS_UIDKind_t  kind;
+	char            name[TCGS_UID_CATALOG_NAME_LENGTH];
+} TCGS_UIDCatalogEntry_t;
+
+/*****************************************************************************
+ * \brief Catalog of UIDs of Core Specification, Opal and Enterprise SSC
+ *
+ * \par The catalog is generated from tools/uid_catalog.txt by
+ * tools/gen_uid_catalog.py. Entries are sorted by UID. Names are found with
+ * minimal perfect hash: the bucket of the name gives the seed of the second
+ * hash, which gives the index of the entry.
+ *****************************************************************************/
+extern const uint32 TCGS_UIDCatalog_Size;
+extern const TCGS_UIDCatalogEntry_t TCGS_UIDCatalog[];
+extern const uint32 TCGS_UIDCatalog_BucketCount;
+extern const uint16 TCGS_UIDCatalog_Seeds[];
+extern const uint16 TCGS_UIDCatalog_Slots[];
+
+/*****************************************************************************
+ * \brief Entry of catalog of Level 0 Discovery features
+ *****************************************************************************/
+typedef struct
+{
+	uint16  code;
+	char    name[TCGS_FEATURE_CATALOG_NAME_LENGTH];
+} TCGS_FeatureCatalogEntry_t;
+
+/*****************************************************************************
+ * \brief Catalog of feature descriptors of Level 0 Discovery
+ *
+ * \par Generated from FEATURE lines of tools/uid_catalog.txt together with
+ * the UID catalog. Entries are sorted by feature code.
+ *****************************************************************************/
+extern const uint32 TCGS_FeatureCatalog_Size;
+extern const TCGS_FeatureCatalogEntry_t TCGS_FeatureCatalog[];
+
+/*****************************************************************************
+ * \brief Finds catalog entry by name
+ *
+ * @param[in]  name     name of UID, e.g. "Locking_GlobalRange"
+ *
+ * \return const TCGS_UIDCatalogEntry_t* entry, NULL if name is unknown
+ *****************************************************************************/
+const TCGS_UIDCatalogEntry_t *TCGS_UIDCatalog_FindName(const char *name);
+
+/*****************************************************************************
+ * \brief Finds catalog entry by UID
+ *
+ * \return const TCGS_UIDCatalogEntry_t* entry, NULL if UID is unknown
+ *****************************************************************************/
+const TCGS_UIDCatalogEntry_t *TCGS_UIDCatalog_FindUID(const TCGS_UID_t *uid);
+
+/*****************************************************************************
+ * \brief Finds feature catalog entry by feature code
+ *
+ * \return const TCGS_FeatureCatalogEntry_t* entry, NULL if feature is unknown
+ *****************************************************************************/
+const TCGS_FeatureCatalogEntry_t *TCGS_FeatureCatalog_FindCode(uint16 code);
+
+#endif //_TCGS_UID_CATALOG_H
@@ -0,0 +1,86 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_uid_lookup.c
+///
+/// Lookup of UID catalog by name and by UID, of feature catalog by code
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_uid_catalog.h"
+
+/*
+ * FNV-1a hash of name, the same as in tools/gen_uid_catalog.py
+ */
+static uint32 TCGS_UIDCatalog_Hash(const char *name, uint32 seed)
+{
+	uint32 hash = 0x811C9DC5 ^ seed;
+
+	while (*name != 0)
+	{
+		hash ^= (uint8)*name++;
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+const TCGS_UIDCatalogEntry_t *TCGS_UIDCatalog_FindName(const char *name)
+{
+	const TCGS_UIDCatalogEntry_t *entry;
+	uint32 seed;
+
+	seed = TCGS_UIDCatalog_Seeds[TCGS_UIDCatalog_Hash(name, 0) % TCGS_UIDCatalog_BucketCount];
+	entry = &TCGS_UIDCatalog[TCGS_UIDCatalog_Slots[TCGS_UIDCatalog_Hash(name, seed) % TCGS_UIDCatalog_Size]];
+	return (strcmp(entry->name, name) == 0) ? entry : NULL;
+}
+
+const TCGS_UIDCatalogEntry_t *TCGS_UIDCatalog_FindUID(const TCGS_UID_t *uid)
+{
+	uint32 low = 0, high = TCGS_UIDCatalog_Size, middle;
+	int order;
+
+	while (low < high)
+	{
+		middle = (low + high) / 2;
+		order = memcmp(uid->bytes, TCGS_UIDCatalog[middle].uid.bytes, sizeof(uid->bytes));
+		if (order == 0)
+		{
+			return &TCGS_UIDCatalog[middle];
+		}
+		if (order < 0)
+		{
+			high = middle;
+		}
+		else
+		{
+			low = middle + 1;
+		}
+	}
+	return NULL;
+}
+
+const TCGS_FeatureCatalogEntry_t *TCGS_FeatureCatalog_FindCode(uint16 code)
+{
+	uint32 low = 0, high = TCGS_FeatureCatalog_Size, middle;
+
+	while (low < high)
+	{
+		middle = (low + high) / 2;
+		if (code == TCGS_FeatureCatalog[middle].code)
+		{
+			return &TCGS_FeatureCatalog[middle];
+		}
+		if (code < TCGS_FeatureCatalog[middle].code)
+		{
+			high = middle;
+		}
+		else
+		{
+			low = middle + 1;
+		}
+	}
+	return NULL;
+}
@@ -7,157 +7,156 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include <string.h>
-#include <stdio.h>
+#include <unistd.h>
 
 #include "tcgs_config.h"
+#if TCGS_VERBOSE
+#include <stdio.h>
+#endif //TCGS_VERBOSE
 #include "tcgs_stream.h"
 #include "tcgs_parser.h"
 #include "tcgs_verbose.h"
 #include "tcgs_interface.h"
+#include "tcgs_uid_catalog.h"
+#include "tcgs_format.h"
+
+#if TCGS_VERBOSE
 
-#if defined(TCGS_VERBOSE)
+//text of command blocks and Level 0 Discovery is written to stdout in chunks
+#define VERBOSE_TEXT_CHUNK_SIZE 512
 
-static const char * const commandVerboseMap[IF_LAST] =
+/*
+ * Formats through formatter flushed to stdout, text printed before is
+ * flushed first to keep the order
+ */
+static void TCGS_Verbose_InitFormatter(TCGS_Formatter_t *formatter, char *buffer, uint32 capacity)
 {
-	"IF_SEND",
-	"IF_RECV",
-};
+	fflush(stdout);
+	TCGS_Formatter_Init(formatter, buffer, capacity, FORMAT_TEXT);
+	TCGS_Formatter_SetSink(formatter, STDOUT_FILENO);
+}
 
-char* TCGS_Verbose_GetCommand (TCGS_Command_t command, char* commandBuf)
+/*****************************************************************************
+ * \brief Print content of interface command block
+ *
+ * @param[in]  command  Pointer to command block structure
+ *
+ * \return None
+ *****************************************************************************/
+void TCGS_PrintCommand(TCGS_CommandBlock_t* command)
 {
-	if (command < IF_LAST)
-	{
-		sprintf(commandBuf, "%s", commandVerboseMap[command]);
-	}
-	else
-	{
-		sprintf(commandBuf, "%7d", command);
-	}
+	char buffer[VERBOSE_TEXT_CHUNK_SIZE];
+	TCGS_Formatter_t formatter;
 
-	return commandBuf;
+	TCGS_Verbose_InitFormatter(&formatter, buffer, sizeof(buffer));
+	TCGS_Format_Command(&formatter, NULL, command);
+	TCGS_Formatter_Flush(&formatter);
 }
 
-#define MAX_FEATURE_NAME_LENGTH sizeof("ENTERPRISE")
 typedef struct
 {
-	const TCGS_Level0Discovery_FeatureCode_t featureCode;
-	const char featureName[MAX_FEATURE_NAME_LENGTH];
-} featureVerboseMap_t;
-
-static const featureVerboseMap_t featureVerboseMap[] =
+	uint32      position;       //tokens since Call token
+	TCGS_UID_t  invokingId;
+	bool        secretName0;    //named value 0 is credential (challenge)
+	bool        secretValues;   //all byte values are credentials (C_PIN)
+	bool        named;          //the next token is name of named value
+	uint64      name;           //name of current named value
+} TCGS_VerboseCallState_t;
+
+/*
+ * Credentials passed to StartSession, Authenticate and Set of C_PIN
+ * are not printed
+ */
+static bool TCGS_Verbose_IsSecret(const TCGS_Token_t *token, void *context)
 {
-	{FEATURE_RESERVED,  "RESERVED"},
-	{FEATURE_TPER,      "TPER"},
-	{FEATURE_LOCKING,	"LOCKING"},
-	{FEATURE_GEOMETRY,	"GEOMETRY"},
-	{FEATURE_ENTERPRISE,"ENTERPRISE"},
-	{FEATURE_OPAL1,     "OPAL1"},
-	{FEATURE_OPAL2,		"OPAL2"},
-};
-
-const char * TCGS_Verbose_GetFeature (TCGS_Level0Discovery_FeatureCode_t featureCode, char* featureBuf)
-{
-	const char * result = NULL;
-	int i;
+	TCGS_VerboseCallState_t *state = context;
+	const TCGS_UIDCatalogEntry_t *method;
 
-	for (i = 0; i < sizeof(featureVerboseMap) / sizeof(featureVerboseMap[0]); i++)
+	if (token->type == TOKEN_TYPE_CONTROL)
 	{
-		if (featureVerboseMap[i].featureCode == featureCode)
+		if (token->control == TOKEN_CALL)
+		{
+			memset(state, 0, sizeof(*state));
+			state->position = 1;
+			state->name = ~0ULL;
+		}
+		state->named = (token->control == TOKEN_START_NAME);
+		if (token->control == TOKEN_END_NAME)
 		{
-			result = featureVerboseMap[i].featureName;
+			state->name = ~0ULL;
 		}
+		return FALSE;
 	}
-	if (result != NULL)
+	if (state->named)
 	{
-		sprintf(featureBuf, "%*s", (int)MAX_FEATURE_NAME_LENGTH, result);
+		state->named = FALSE;
+		state->name = token->value;
+		return FALSE;
 	}
-	else
+	if (state->position == 1 && token->type == TOKEN_TYPE_BYTES && token->length == sizeof(TCGS_UID_t))
 	{
-		sprintf(featureBuf, "0x%X", featureCode);
+		memcpy(state->invokingId.bytes, token->data, sizeof(TCGS_UID_t));
+		state->position++;
+		return FALSE;
 	}
-
-	return featureBuf;
+	if (state->position == 2 && token->type == TOKEN_TYPE_BYTES && token->length == sizeof(TCGS_UID_t))
+	{
+		method = TCGS_UIDCatalog_FindUID((const TCGS_UID_t*)token->data);
+		state->position++;
+		if (method != NULL && (strcmp(method->name, "Method_StartSession") == 0 ||
+				strcmp(method->name, "Method_Authenticate") == 0))
+		{
+			state->secretName0 = TRUE;
+		}
+		if (method != NULL && strcmp(method->name, "Method_Set") == 0 &&
+			state->invokingId.bytes[3] == 0x0B)
+		{
+			state->secretValues = TRUE;
+		}
+		return FALSE;
+	}
+	return token->type == TOKEN_TYPE_BYTES &&
+		((state->secretName0 && state->name == 0) || state->secretValues);
 }
 
-
 /*****************************************************************************
- * \brief Print content of interface command block
+ * \brief Print content of ComPacket
  *
- * @param[in]  command  Pointer to command block structure
+ * @param[in]  comPacket  ComPacket sent to or received from TPer
+ * @param[in]  size       size of the buffer
  *
  * \return None
  *****************************************************************************/
-void TCGS_PrintCommand(TCGS_CommandBlock_t* command)
-{
-	char commandBuf[sizeof(commandVerboseMap[0])];
-
-	printf( "Command:          %s\n"
-			"Protocol ID:         %4d\n"
-			"Transfer Length:     %4d\n"
-			"ComID:             0x%04X\n",
-			TCGS_Verbose_GetCommand(command->command, commandBuf),
-			command->protocolId,
-			command->length,
-			command->comId);
-}
-
-void TCGS_PrintLevel0DiscoveryFeature(TCGS_Level0Discovery_Feature_t *feature)
+void TCGS_PrintComPacket(const void *comPacket, uint32 size)
 {
-	char featureBuf[MAX_FEATURE_NAME_LENGTH];
-
-	printf(TCGS_VERBOSE_BLOCK_SEPARATOR "\n");
-	printf( "Feature Code: %*s\n"
-			"Version:              %3d\n"
-			"Length:               %3d\n",
-			(int)MAX_FEATURE_NAME_LENGTH, TCGS_Verbose_GetFeature(feature->code, featureBuf),
-			feature->version,
-			feature->length);
-
-	switch(feature->code)
+	char buffer[VERBOSE_TEXT_CHUNK_SIZE];
+	TCGS_Formatter_t formatter;
+	TCGS_ComPacketInfo_t info;
+	TCGS_Parser_t parser;
+	TCGS_VerboseCallState_t state;
+
+	memset(&state, 0, sizeof(state));
+	state.name = ~0ULL;
+	TCGS_Verbose_InitFormatter(&formatter, buffer, sizeof(buffer));
+	TCGS_Format_String(&formatter, NULL, TCGS_VERBOSE_BLOCK_SEPARATOR);
+	if (TCGS_ParseComPacket(comPacket, size, &info, &parser) != ERROR_SUCCESS)
 	{
-	case FEATURE_TPER:
-		#define featureTPer ((TCGS_Level0Discovery_FeatureTper_t*)(void*)feature)
-		printf( "Sync Supported:         %d\n"
-				"Async Supported:        %d\n"
-				"ACK/NAK Supported:      %d\n"
-				"Buf Mgmt Supported:     %d\n"
-				"Streaming Supported:    %d\n"
-				"ComID Mgmt Supported:   %d\n",
-				featureTPer->syncSupported,
-				featureTPer->asyncSupported,
-				featureTPer->ackSupported,
-				featureTPer->bufferManagementSupported,
-				featureTPer->streamingSupported,
-				featureTPer->comIdManagementSupported);
-		break;
-	case FEATURE_LOCKING:
-		#define featureLocking ((TCGS_Level0Discovery_FeatureLocking_t*)(void*)feature)
-		printf(
-			"Locking Supported:      %d\n"
-			"Locking Enabled:        %d\n"
-			"Locked:                 %d\n"
-			"Media Encr. Locked:     %d\n"
-			"MBR Enabled:            %d\n"
-			"MBR Done:               %d\n",
-			featureLocking->lockingSupport,
-			featureLocking->lockingEnabled,
-			featureLocking->locked,
-			featureLocking->mediaEncryption,
-			featureLocking->MBREnabled,
-			featureLocking->MBRDone);
-		break;
-	case FEATURE_OPAL1:
-		#define featureOpal1 ((TCGS_Level0Discovery_FeatureOpal1_t*)(void*)feature)
-		printf(
-			"Base ComID:        0x%04X\n"
-			"Number of ComIDs:     %3d\n"
-			"Range crossing:       %3d\n",
-			featureOpal1->baseComID,
-			featureOpal1->numberOfComIDs,
-			featureOpal1->rangeCrossing);
-		break;
+		TCGS_Format_String(&formatter, NULL, "Malformed ComPacket");
+		TCGS_Formatter_Flush(&formatter);
+		return;
 	}
+	TCGS_Format_BeginObject(&formatter, NULL);
+	TCGS_Format_UInt(&formatter, "TPer Session", info.tperSessionNumber);
+	TCGS_Format_UInt(&formatter, "Host Session", info.hostSessionNumber);
+	TCGS_Format_UInt(&formatter, "Outstanding", info.outstandingData);
+	if (parser.length != 0)
+	{
+		TCGS_Format_Tokens(&formatter, "Tokens", &parser, TCGS_Verbose_IsSecret, &state);
+	}
+	TCGS_Format_EndObject(&formatter);
+	TCGS_Formatter_Flush(&formatter);
 }
+
 /*****************************************************************************
  * \brief Print content of Level 0 Discovery
  *
@@ -171,27 +170,15 @@ void TCGS_PrintLevel0DiscoveryFeature(TCGS_Level0Discovery_Feature_t *feature)
  *****************************************************************************/
 void TCGS_PrintLevel0Discovery(TCGS_Level0Discovery_Header_t* payload)
 {
-	TCGS_Level0Discovery_Feature_t* iter;
-
-	printf("LEVEL 0 DISCOVERY\n");
-
-	//printf( "Length:             %3d\n"
-	//		"Version Major:      %3d\n"
-	//		"Version Minor:      %3d\n",
-	//		header->length,
-	//		header->versionMajor,
-	//		header->versionMinor);
-
-	iter = TCGS_GetLevel0DiscoveryFirstFeatureHeader(payload);
-	while (iter != NULL)
-	{
-		TCGS_PrintLevel0DiscoveryFeature(iter);
-		iter = TCGS_GetLevel0DiscoveryNextFeatureHeader(payload, iter);
-	}
+	char buffer[VERBOSE_TEXT_CHUNK_SIZE];
+	TCGS_Formatter_t formatter;
 
-	return;
+	TCGS_Verbose_InitFormatter(&formatter, buffer, sizeof(buffer));
+	TCGS_Format_String(&formatter, NULL, "LEVEL 0 DISCOVERY");
+	TCGS_Format_Level0Discovery(&formatter, NULL, payload);
+	TCGS_Formatter_Flush(&formatter);
 }
 
-#endif //defined(TCGS_VERBOSE)
+#endif //TCGS_VERBOSE
 
 
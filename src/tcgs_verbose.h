@@ -12,7 +12,7 @@
 #include "tcgs_config.h"
 #include "tcgs_interface.h"
 
-#if defined(TCGS_VERBOSE)
+#if TCGS_VERBOSE
 
 #define TCGS_VERBOSE_COMMAND_SEPARATOR "======================================="
 #define TCGS_VERBOSE_BLOCK_SEPARATOR   "---------------------------------------"
@@ -26,6 +26,18 @@
  *****************************************************************************/
 void TCGS_PrintCommand(TCGS_CommandBlock_t* command);
 
+/*****************************************************************************
+ * \brief Print content of ComPacket, known UIDs are printed by names
+ *
+ * @param[in]  comPacket  ComPacket sent to or received from TPer
+ * @param[in]  size       size of the buffer
+ *
+ * \return None
+ *
+ * \see TCGS_UIDCatalog_FindUID
+ *****************************************************************************/
+void TCGS_PrintComPacket(const void *comPacket, uint32 size);
+
 /*****************************************************************************
  * \brief Print content of Level 0 Discovery
  *
@@ -39,6 +51,6 @@ void TCGS_PrintCommand(TCGS_CommandBlock_t* command);
  *****************************************************************************/
 void TCGS_PrintLevel0Discovery(TCGS_Level0Discovery_Header_t* payload);
 
-#endif //defined(TCGS_VERBOSE)
+#endif //TCGS_VERBOSE
 
 #endif /* TCGS_VERBOSE_H_ */
@@ -0,0 +1,370 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_cxxbench.cpp
+///
+/// Microbenchmarks of C++ front end against the C calls it wraps
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Usage: tcgs_cxxbench [-n iterations]
+ *
+ * Checks first that invocations encoded at compile time are the same tokens
+ * as the C builder writes and that UIDs of the front end are the UIDs of the
+ * library, then times the same work done with the C API and with the C++
+ * front end:
+ *
+ *   encode_get         Get method added to ComPacket
+ *   encode_set         Set method of integer column added to ComPacket
+ *   session_get        Get method in session with virtual TPer
+ *   transaction_get    transaction of 8 Get methods with virtual TPer
+ *
+ * Encoding runs the given number of iterations, exchanges with virtual TPer
+ * one hundredth of it. A JSON line is written per benchmark with nanoseconds
+ * per iteration of both. Verbose output of the library goes to stderr.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libtcgstorage.hpp"
+
+extern "C" {
+#include "libtcgstorage.h"
+#include "tcgs_interface.h"
+#include "tcgs_uid.h"
+#include "tcgs_time.h"
+#include "vtper.h"
+}
+
+#define BENCH_DEFAULT_ITERATIONS 1000000
+#define BENCH_TRANSACTION_CALLS  8
+
+using MSIDGet = tcgs::Get<tcgs::uid::C_PIN_MSID, TCGS_COLUMN_C_PIN_PIN, TCGS_COLUMN_C_PIN_PIN>;
+using RangeGet = tcgs::Get<tcgs::uid::Locking_Range1, TCGS_COLUMN_LOCKING_RANGE_START,
+		TCGS_COLUMN_LOCKING_WRITE_LOCKED>;
+using RangeSet = tcgs::SetUInt<tcgs::uid::Locking_Range1, TCGS_COLUMN_LOCKING_RANGE_LENGTH>;
+using PinSet = tcgs::SetBytes<tcgs::uid::C_PIN_SID, TCGS_COLUMN_C_PIN_PIN>;
+
+static TCGS_InterfaceFunctions_t virtualFuncs =
+{
+	(TCGS_SendCommand_t)&TCGS_VTPER_SendCommand,
+	NULL,
+};
+
+static FILE *output;
+static uint8 packets[2][TCGS_MAX_COMPACKET_SIZE];
+
+//keeps stores of the loop from being merged across iterations
+static inline void BENCH_Barrier(void)
+{
+	__asm__ __volatile__("" ::: "memory");
+}
+
+static void BENCH_Usage(void)
+{
+	fprintf(stderr, "usage: tcgs_cxxbench [-n iterations]\n");
+}
+
+static void BENCH_Report(const char *name, uint64 iterations, uint64 timeC, uint64 timeCxx, uint64 errors)
+{
+	fprintf(output, "{\"benchmark\":\"%s\",\"iterations\":%llu,\"c\":%.1f,\"cxx\":%.1f,\"errors\":%llu}\n",
+			name, (unsigned long long)iterations, (double)timeC / iterations, (double)timeCxx / iterations,
+			(unsigned long long)errors);
+}
+
+static bool BENCH_Same(const char *name, const TCGS_Builder_t *c, const TCGS_Builder_t *cxx)
+{
+	if (c->overflow || cxx->overflow || c->length != cxx->length ||
+		memcmp(c->buffer, cxx->buffer, c->length) != 0)
+	{
+		fprintf(stderr, "tcgs_cxxbench: %s is encoded differently by C++ front end\n", name);
+		return false;
+	}
+	return true;
+}
+
+static bool BENCH_Check(TCGS_Session_t *session, tcgs::Session &cxxSession)
+{
+	static const struct
+	{
+		uint64             value;
+		const TCGS_UID_t  *uid;
+	} uids[] =
+	{
+		{tcgs::uid::ThisSP, &TCGS_UID_ThisSP},
+		{tcgs::uid::Method_Get, &TCGS_UID_Method_Get},
+		{tcgs::uid::Method_Set, &TCGS_UID_Method_Set},
+		{tcgs::uid::AdminSP, &TCGS_UID_AdminSP},
+		{tcgs::uid::LockingSP, &TCGS_UID_LockingSP},
+		{tcgs::uid::Anybody, &TCGS_UID_Anybody},
+		{tcgs::uid::SID, &TCGS_UID_SID},
+		{tcgs::uid::Admin1, &TCGS_UID_Admin1},
+		{tcgs::uid::User1, &TCGS_UID_User1},
+		{tcgs::uid::C_PIN_SID, &TCGS_UID_C_PIN_SID},
+		{tcgs::uid::C_PIN_MSID, &TCGS_UID_C_PIN_MSID},
+		{tcgs::uid::C_PIN_Admin1, &TCGS_UID_C_PIN_Admin1},
+		{tcgs::uid::C_PIN_User1, &TCGS_UID_C_PIN_User1},
+		{tcgs::uid::Locking_GlobalRange, &TCGS_UID_Locking_GlobalRange},
+		{tcgs::uid::Locking_Range1, &TCGS_UID_Locking_Range1},
+		{tcgs::uid::MBRControl, &TCGS_UID_MBRControl},
+	};
+	static const uint8 pin[] = "0123456789abcdef0123456789abcdef";
+	TCGS_Builder_t c, cxx;
+	TCGS_Parser_t results;
+	TCGS_MethodStatus_t status;
+	tcgs::Results cxxResults;
+	tcgs::Bytes value;
+	uint32 i;
+
+	for (i = 0; i < sizeof(uids) / sizeof(uids[0]); i++)
+	{
+		TCGS_UID_t uid = tcgs::ToUID(uids[i].value);
+
+		if (memcmp(&uid, uids[i].uid, sizeof(uid)) != 0)
+		{
+			fprintf(stderr, "tcgs_cxxbench: UID %016llx differs from the library\n",
+					(unsigned long long)uids[i].value);
+			return false;
+		}
+	}
+
+	TCGS_Builder_Init(&c, packets[0], sizeof(packets[0]));
+	TCGS_Builder_Init(&cxx, packets[1], sizeof(packets[1]));
+	TCGS_Builder_AddGet(&c, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_RANGE_START,
+			TCGS_COLUMN_LOCKING_WRITE_LOCKED);
+	RangeGet::Add(&cxx);
+	if (!BENCH_Same("Get", &c, &cxx))
+	{
+		return false;
+	}
+	c.length = cxx.length = 0;
+	TCGS_Builder_AddSetUInt(&c, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_RANGE_LENGTH, 0x123456789ULL);
+	RangeSet::Add(&cxx, 0x123456789ULL);
+	if (!BENCH_Same("Set of integer", &c, &cxx))
+	{
+		return false;
+	}
+	c.length = cxx.length = 0;
+	TCGS_Builder_AddSetBytes(&c, &TCGS_UID_C_PIN_SID, TCGS_COLUMN_C_PIN_PIN, pin, sizeof(pin) - 1);
+	PinSet::Add(&cxx, tcgs::Bytes(pin, sizeof(pin) - 1));
+	if (!BENCH_Same("Set of bytes", &c, &cxx))
+	{
+		return false;
+	}
+
+	//the same MSID is read by both, the C++ view points to the response
+	if (TCGS_Get(session, &TCGS_UID_C_PIN_MSID, TCGS_COLUMN_C_PIN_PIN, TCGS_COLUMN_C_PIN_PIN,
+			&results, &status) != ERROR_SUCCESS ||
+		cxxSession.Call<MSIDGet>(&cxxResults) != ERROR_SUCCESS ||
+		cxxResults.Status() != METHOD_STATUS_SUCCESS ||
+		!cxxResults.Find(TCGS_COLUMN_C_PIN_PIN, value) ||
+		value.size() != strlen(VTPER_MSID) || memcmp(value.data(), VTPER_MSID, value.size()) != 0 ||
+		value.data() < cxxSession.Native()->receiveBuffer ||
+		value.data() >= cxxSession.Native()->receiveBuffer + sizeof(cxxSession.Native()->receiveBuffer))
+	{
+		fprintf(stderr, "tcgs_cxxbench: Get of MSID failed\n");
+		return false;
+	}
+	return true;
+}
+
+static void BENCH_Encode(uint64 iterations)
+{
+	TCGS_Builder_t builder;
+	uint64 start, timeC, timeCxx;
+	uint64 i;
+
+	TCGS_Builder_Init(&builder, packets[0], sizeof(packets[0]));
+	start = TCGS_GetTime();
+	for (i = 0; i < iterations; i++)
+	{
+		builder.length = TCGS_PACKET_HEADERS_LENGTH;
+		TCGS_Builder_AddGet(&builder, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_RANGE_START,
+				TCGS_COLUMN_LOCKING_WRITE_LOCKED);
+		BENCH_Barrier();
+	}
+	timeC = TCGS_GetTime() - start;
+	start = TCGS_GetTime();
+	for (i = 0; i < iterations; i++)
+	{
+		builder.length = TCGS_PACKET_HEADERS_LENGTH;
+		RangeGet::Add(&builder);
+		BENCH_Barrier();
+	}
+	timeCxx = TCGS_GetTime() - start;
+	BENCH_Report("encode_get", iterations, timeC, timeCxx, 0);
+
+	start = TCGS_GetTime();
+	for (i = 0; i < iterations; i++)
+	{
+		builder.length = TCGS_PACKET_HEADERS_LENGTH;
+		TCGS_Builder_AddSetUInt(&builder, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_RANGE_LENGTH, i);
+		BENCH_Barrier();
+	}
+	timeC = TCGS_GetTime() - start;
+	start = TCGS_GetTime();
+	for (i = 0; i < iterations; i++)
+	{
+		builder.length = TCGS_PACKET_HEADERS_LENGTH;
+		RangeSet::Add(&builder, i);
+		BENCH_Barrier();
+	}
+	timeCxx = TCGS_GetTime() - start;
+	BENCH_Report("encode_set", iterations, timeC, timeCxx, 0);
+}
+
+static void BENCH_Exchange(TCGS_Session_t *session, tcgs::Session &cxxSession, uint64 iterations)
+{
+	TCGS_TransactionCall_t calls[BENCH_TRANSACTION_CALLS];
+	uint8 callResults[BENCH_TRANSACTION_CALLS][64];
+	TCGS_Transaction_t transaction;
+	TCGS_Parser_t results;
+	TCGS_MethodStatus_t status;
+	tcgs::Results cxxResults;
+	uint64 start, timeC, timeCxx, errors = 0;
+	uint64 i;
+	uint32 j;
+
+	start = TCGS_GetTime();
+	for (i = 0; i < iterations; i++)
+	{
+		if (TCGS_Get(session, &TCGS_UID_C_PIN_MSID, TCGS_COLUMN_C_PIN_PIN, TCGS_COLUMN_C_PIN_PIN,
+				&results, &status) != ERROR_SUCCESS)
+		{
+			errors++;
+		}
+	}
+	timeC = TCGS_GetTime() - start;
+	start = TCGS_GetTime();
+	for (i = 0; i < iterations; i++)
+	{
+		if (cxxSession.Call<MSIDGet>(&cxxResults) != ERROR_SUCCESS)
+		{
+			errors++;
+		}
+	}
+	timeCxx = TCGS_GetTime() - start;
+	BENCH_Report("session_get", iterations, timeC, timeCxx, errors);
+
+	for (j = 0; j < BENCH_TRANSACTION_CALLS; j++)
+	{
+		memset(&calls[j], 0, sizeof(calls[j]));
+		calls[j].results = callResults[j];
+		calls[j].resultsSize = sizeof(callResults[j]);
+	}
+	errors = 0;
+	start = TCGS_GetTime();
+	for (i = 0; i < iterations; i++)
+	{
+		TCGS_StartTransaction(&transaction, session);
+		for (j = 0; j < BENCH_TRANSACTION_CALLS; j++)
+		{
+			TCGS_Transaction_Get(&transaction, &calls[j], &TCGS_UID_C_PIN_MSID,
+					TCGS_COLUMN_C_PIN_PIN, TCGS_COLUMN_C_PIN_PIN);
+		}
+		if (TCGS_EndTransaction(&transaction, TRUE) != ERROR_SUCCESS)
+		{
+			errors++;
+		}
+	}
+	timeC = TCGS_GetTime() - start;
+	start = TCGS_GetTime();
+	for (i = 0; i < iterations; i++)
+	{
+		tcgs::Transaction cxxTransaction;
+
+		cxxTransaction.Start(cxxSession);
+		for (j = 0; j < BENCH_TRANSACTION_CALLS; j++)
+		{
+			cxxTransaction.Call<MSIDGet>(&calls[j]);
+		}
+		if (cxxTransaction.Commit() != ERROR_SUCCESS)
+		{
+			errors++;
+		}
+	}
+	timeCxx = TCGS_GetTime() - start;
+	BENCH_Report("transaction_get", iterations, timeC, timeCxx, errors);
+}
+
+int main(int argc, char **argv)
+{
+	static TCGS_VTPer_t tper;
+	static TCGS_Session_t session;
+	uint64 iterations = BENCH_DEFAULT_ITERATIONS;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	TCGS_Device_t device;
+	int resultFd;
+	int option;
+	uint32 i;
+
+	while ((option = getopt(argc, argv, "n:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'n':
+			iterations = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			BENCH_Usage();
+			return 2;
+		}
+	}
+	if (optind != argc || iterations < 100)
+	{
+		BENCH_Usage();
+		return 2;
+	}
+
+	//stdout is kept for results, verbose output of the library is moved to stderr
+	resultFd = dup(STDOUT_FILENO);
+	output = (resultFd < 0) ? NULL : fdopen(resultFd, "w");
+	if (output == NULL)
+	{
+		fprintf(stderr, "tcgs_cxxbench: cannot open output: %s\n", strerror(errno));
+		return 2;
+	}
+	fflush(stdout);
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &virtualFuncs, &tper);
+	if (TCGS_Device_Level0Discovery(&device, buffer) != ERROR_SUCCESS)
+	{
+		fprintf(stderr, "tcgs_cxxbench: discovery of TPer failed\n");
+		return 1;
+	}
+	{
+		tcgs::Session cxxSession;
+
+		if (TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, NULL, NULL, 0, FALSE, NULL) != ERROR_SUCCESS ||
+			cxxSession.Start(&device, TCGS_UID_AdminSP) != ERROR_SUCCESS)
+		{
+			fprintf(stderr, "tcgs_cxxbench: sessions with TPer failed\n");
+			return 1;
+		}
+		if (!BENCH_Check(&session, cxxSession))
+		{
+			return 1;
+		}
+		BENCH_Encode(iterations);
+		BENCH_Exchange(&session, cxxSession, iterations / 100);
+		TCGS_EndSession(&session);
+	}
+	//the C++ session is closed by its destructor
+	for (i = 0; i < VTPER_MAX_SESSIONS; i++)
+	{
+		if (tper.sessions[i].open)
+		{
+			fprintf(stderr, "tcgs_cxxbench: session left open\n");
+			return 1;
+		}
+	}
+	TCGS_Device_Destroy(&device);
+	fclose(output);
+	return 0;
+}
@@ -0,0 +1,543 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgs_loadgen.c
+///
+/// Load generator of mixed operations on a fleet of virtual TPers
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Usage: tcgs_loadgen [-n tpers] [-j threads] [-r rate] [-d duration] [-m mix]
+ *
+ * Creates up to 10000 virtual TPers and runs operations on them through the
+ * whole library stack at open-loop arrival rate (operations per second).
+ * Arrivals are Poisson with the given rate, they are scheduled regardless of
+ * completion of preceding operations, so latency counts from the scheduled
+ * arrival and includes the time the operation waited for a busy thread.
+ *
+ * Mix is the weights of operations, discover:unlock:range:table:
+ *
+ *   discover    Level 0 Discovery
+ *   unlock      session to Locking SP, ReadLocked and WriteLocked of Range1 cleared
+ *   range       session to Locking SP, transaction setting start and length of Range1
+ *   table       session to Locking SP, Set of a byte table (MBR) chunk
+ *
+ * TPers are split among threads, a thread runs operations of its own TPers
+ * only. A JSON line is written per operation type at the end: throughput,
+ * latency percentiles in microseconds and CPU time of the thread per
+ * operation. Verbose output of the library goes to stderr. Instances of
+ * TPers are allocated zeroed and take about 12KB until transactions and MBR
+ * writes touch them.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libtcgstorage.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_builder.h"
+#include "tcgs_session.h"
+#include "tcgs_transaction.h"
+#include "tcgs_uid.h"
+#include "tcgs_time.h"
+#include "vtper.h"
+
+#define LOADGEN_MAX_TPERS        10000
+#define LOADGEN_MAX_THREADS      256
+#define LOADGEN_DEFAULT_TPERS    100
+#define LOADGEN_DEFAULT_RATE     1000
+#define LOADGEN_DEFAULT_DURATION 10
+#define LOADGEN_TABLE_CHUNK_SIZE 512
+
+//latency histogram: 16 linear buckets per power of two of nanoseconds
+#define LOADGEN_HISTOGRAM_SUB_BITS 4
+#define LOADGEN_HISTOGRAM_BUCKETS  (64 << LOADGEN_HISTOGRAM_SUB_BITS)
+
+typedef enum
+{
+	LOADGEN_DISCOVER,
+	LOADGEN_UNLOCK,
+	LOADGEN_RANGE,
+	LOADGEN_TABLE,
+	LOADGEN_OPERATIONS,
+} LOADGEN_OperationType_t;
+
+static const char *operationNames[] =
+{
+	"discover",
+	"unlock",
+	"range",
+	"table",
+};
+
+typedef struct
+{
+	uint64  count;
+	uint64  errors;
+	uint64  cpuTime;        //nanoseconds of thread CPU time
+	uint64  maxLatency;
+	uint64  histogram[LOADGEN_HISTOGRAM_BUCKETS];
+} LOADGEN_Statistics_t;
+
+typedef struct
+{
+	uint32                index;
+	pthread_t             thread;
+	uint32                random;     //xorshift state
+	uint64                late;       //operations started after the next arrival was due
+	TCGS_Session_t        session;
+	LOADGEN_Statistics_t  statistics[LOADGEN_OPERATIONS];
+} LOADGEN_Thread_t;
+
+typedef struct
+{
+	TCGS_VTPer_t   *tper;
+	TCGS_Device_t   device;
+} LOADGEN_TPer_t;
+
+static LOADGEN_TPer_t *tpers;
+static uint32 tperCount = LOADGEN_DEFAULT_TPERS;
+static LOADGEN_Thread_t *threads;
+static uint32 threadCount;
+static double rate = LOADGEN_DEFAULT_RATE;
+static uint64 duration = LOADGEN_DEFAULT_DURATION * TCGS_NSEC_PER_SEC;
+static uint32 mix[LOADGEN_OPERATIONS] = { 4, 2, 1, 1 };
+static uint32 mixTotal;
+static uint64 startTime;
+static FILE *output;
+
+static TCGS_InterfaceFunctions_t virtualFuncs =
+{
+	(TCGS_SendCommand_t)&TCGS_VTPER_SendCommand,
+	NULL,
+};
+
+static void LOADGEN_Usage(void)
+{
+	fprintf(stderr, "usage: tcgs_loadgen [-n tpers] [-j threads] [-r rate] [-d duration] "
+			"[-m discover:unlock:range:table]\n");
+}
+
+static uint32 LOADGEN_Random(LOADGEN_Thread_t *thread)
+{
+	uint32 x = thread->random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	thread->random = x;
+	return x;
+}
+
+/*
+ * Returns exponentially distributed interval to the next arrival
+ */
+static uint64 LOADGEN_NextInterval(LOADGEN_Thread_t *thread, double threadRate)
+{
+	double uniform = (LOADGEN_Random(thread) + 1.0) / 4294967296.0;
+
+	return (uint64)(-log(uniform) / threadRate * TCGS_NSEC_PER_SEC);
+}
+
+static uint64 LOADGEN_GetCPUTime(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+	return (uint64)time.tv_sec * TCGS_NSEC_PER_SEC + time.tv_nsec;
+}
+
+static uint32 LOADGEN_GetBucket(uint64 value)
+{
+	uint32 exponent;
+
+	if (value < (1 << LOADGEN_HISTOGRAM_SUB_BITS))
+	{
+		return (uint32)value;
+	}
+	exponent = 63 - __builtin_clzll(value);
+	return ((exponent - LOADGEN_HISTOGRAM_SUB_BITS + 1) << LOADGEN_HISTOGRAM_SUB_BITS) +
+			(uint32)((value >> (exponent - LOADGEN_HISTOGRAM_SUB_BITS)) & ((1 << LOADGEN_HISTOGRAM_SUB_BITS) - 1));
+}
+
+/*
+ * Returns the upper bound of values of the bucket
+ */
+static uint64 LOADGEN_GetBucketValue(uint32 bucket)
+{
+	uint32 exponent = bucket >> LOADGEN_HISTOGRAM_SUB_BITS;
+	uint64 sub = bucket & ((1 << LOADGEN_HISTOGRAM_SUB_BITS) - 1);
+
+	if (exponent == 0)
+	{
+		return sub;
+	}
+	exponent += LOADGEN_HISTOGRAM_SUB_BITS - 1;
+	return (((1ULL << LOADGEN_HISTOGRAM_SUB_BITS) + sub + 1) << (exponent - LOADGEN_HISTOGRAM_SUB_BITS)) - 1;
+}
+
+static TCGS_Error_t LOADGEN_StartSession(LOADGEN_TPer_t *tper, TCGS_Session_t *session)
+{
+	//Admin1 PIN of virtual TPer is empty
+	return TCGS_StartSession(session, &tper->device, &TCGS_UID_LockingSP, &TCGS_UID_Admin1,
+			"", 0, TRUE, NULL);
+}
+
+static TCGS_Error_t LOADGEN_EndSession(TCGS_Session_t *session, TCGS_Error_t error)
+{
+	TCGS_Error_t endError = TCGS_EndSession(session);
+
+	return (error != ERROR_SUCCESS) ? error : endError;
+}
+
+static TCGS_Error_t LOADGEN_Discover(LOADGEN_TPer_t *tper)
+{
+	uint8 buffer[TCGS_BLOCK_SIZE];
+
+	return TCGS_Device_Level0DiscoveryQuiet(&tper->device, buffer);
+}
+
+static TCGS_Error_t LOADGEN_Unlock(LOADGEN_TPer_t *tper, TCGS_Session_t *session)
+{
+	TCGS_Error_t error;
+
+	error = LOADGEN_StartSession(tper, session);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	error = TCGS_SetUInt(session, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_READ_LOCKED, 0, NULL);
+	if (error == ERROR_SUCCESS)
+	{
+		error = TCGS_SetUInt(session, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_WRITE_LOCKED, 0, NULL);
+	}
+	return LOADGEN_EndSession(session, error);
+}
+
+static TCGS_Error_t LOADGEN_SetRange(LOADGEN_Thread_t *thread, LOADGEN_TPer_t *tper)
+{
+	TCGS_Session_t *session = &thread->session;
+	TCGS_Transaction_t transaction;
+	TCGS_Error_t error;
+
+	error = LOADGEN_StartSession(tper, session);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	error = TCGS_StartTransaction(&transaction, session);
+	if (error == ERROR_SUCCESS)
+	{
+		TCGS_Transaction_SetUInt(&transaction, NULL, &TCGS_UID_Locking_Range1,
+				TCGS_COLUMN_LOCKING_RANGE_START, (LOADGEN_Random(thread) % 1024) * 2048);
+		TCGS_Transaction_SetUInt(&transaction, NULL, &TCGS_UID_Locking_Range1,
+				TCGS_COLUMN_LOCKING_RANGE_LENGTH, 2048);
+		error = TCGS_EndTransaction(&transaction, TRUE);
+	}
+	return LOADGEN_EndSession(session, error);
+}
+
+static TCGS_Error_t LOADGEN_WriteTable(LOADGEN_Thread_t *thread, LOADGEN_TPer_t *tper)
+{
+	uint8 chunk[LOADGEN_TABLE_CHUNK_SIZE];
+	TCGS_Session_t *session = &thread->session;
+	TCGS_Builder_t *builder;
+	TCGS_Error_t error;
+	uint64 where;
+
+	error = LOADGEN_StartSession(tper, session);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	memset(chunk, (uint8)LOADGEN_Random(thread), sizeof(chunk));
+	where = (LOADGEN_Random(thread) % (VTPER_MBR_SIZE / sizeof(chunk))) * sizeof(chunk);
+	builder = TCGS_Session_StartPacket(session);
+	TCGS_Builder_StartCall(builder, &TCGS_UID_MBR, &TCGS_UID_Method_Set);
+	TCGS_Builder_AddNamedUInt(builder, SET_WHERE, where);
+	TCGS_Builder_AddNamedBytes(builder, SET_VALUES, chunk, sizeof(chunk));
+	TCGS_Builder_EndCall(builder);
+	error = TCGS_Session_Call(session, NULL, NULL);
+	return LOADGEN_EndSession(session, error);
+}
+
+static TCGS_Error_t LOADGEN_Run(LOADGEN_Thread_t *thread, LOADGEN_OperationType_t type, LOADGEN_TPer_t *tper)
+{
+	switch (type)
+	{
+	case LOADGEN_DISCOVER:
+		return LOADGEN_Discover(tper);
+	case LOADGEN_UNLOCK:
+		return LOADGEN_Unlock(tper, &thread->session);
+	case LOADGEN_RANGE:
+		return LOADGEN_SetRange(thread, tper);
+	case LOADGEN_TABLE:
+		return LOADGEN_WriteTable(thread, tper);
+	default:
+		return ERROR_PARAMETER;
+	}
+}
+
+static LOADGEN_OperationType_t LOADGEN_PickOperation(LOADGEN_Thread_t *thread)
+{
+	uint32 weight = LOADGEN_Random(thread) % mixTotal;
+	uint32 type;
+
+	for (type = 0; weight >= mix[type]; type++)
+	{
+		weight -= mix[type];
+	}
+	return type;
+}
+
+static void *LOADGEN_Worker(void *argument)
+{
+	LOADGEN_Thread_t *thread = argument;
+	LOADGEN_Statistics_t *statistics;
+	LOADGEN_OperationType_t type;
+	LOADGEN_TPer_t *tper;
+	//TPers of the thread are index, index + threadCount, ...
+	uint32 ownCount = (tperCount - thread->index + threadCount - 1) / threadCount;
+	double threadRate = rate / threadCount;
+	uint64 arrival = startTime, end = startTime + duration;
+	uint64 now, cpu, latency;
+	TCGS_Error_t error;
+
+	if (ownCount == 0)
+	{
+		return NULL;
+	}
+	while ((arrival += LOADGEN_NextInterval(thread, threadRate)) < end)
+	{
+		now = TCGS_GetTime();
+		if (arrival > now)
+		{
+			TCGS_Sleep(arrival - now);
+		}
+		else if (now - arrival > TCGS_NSEC_PER_MSEC)
+		{
+			thread->late++;
+		}
+		type = LOADGEN_PickOperation(thread);
+		tper = &tpers[thread->index + (LOADGEN_Random(thread) % ownCount) * threadCount];
+		cpu = LOADGEN_GetCPUTime();
+		error = LOADGEN_Run(thread, type, tper);
+		now = TCGS_GetTime();
+
+		statistics = &thread->statistics[type];
+		statistics->count++;
+		statistics->errors += (error != ERROR_SUCCESS);
+		statistics->cpuTime += LOADGEN_GetCPUTime() - cpu;
+		latency = now - arrival;
+		statistics->histogram[LOADGEN_GetBucket(latency)]++;
+		if (latency > statistics->maxLatency)
+		{
+			statistics->maxLatency = latency;
+		}
+	}
+	return NULL;
+}
+
+static double LOADGEN_Percentile(const LOADGEN_Statistics_t *statistics, double fraction)
+{
+	uint64 rank = (uint64)ceil(statistics->count * fraction), seen = 0;
+	uint32 bucket;
+
+	for (bucket = 0; bucket < LOADGEN_HISTOGRAM_BUCKETS; bucket++)
+	{
+		seen += statistics->histogram[bucket];
+		if (seen >= rank && seen > 0)
+		{
+			return (double)LOADGEN_GetBucketValue(bucket) / TCGS_NSEC_PER_USEC;
+		}
+	}
+	return 0;
+}
+
+static void LOADGEN_Report(uint64 elapsed)
+{
+	LOADGEN_Statistics_t total;
+	uint64 late = 0;
+	uint32 type, i, bucket;
+
+	for (i = 0; i < threadCount; i++)
+	{
+		late += threads[i].late;
+	}
+	for (type = 0; type < LOADGEN_OPERATIONS; type++)
+	{
+		if (mix[type] == 0)
+		{
+			continue;
+		}
+		memset(&total, 0, sizeof(total));
+		for (i = 0; i < threadCount; i++)
+		{
+			const LOADGEN_Statistics_t *statistics = &threads[i].statistics[type];
+
+			total.count += statistics->count;
+			total.errors += statistics->errors;
+			total.cpuTime += statistics->cpuTime;
+			if (statistics->maxLatency > total.maxLatency)
+			{
+				total.maxLatency = statistics->maxLatency;
+			}
+			for (bucket = 0; bucket < LOADGEN_HISTOGRAM_BUCKETS; bucket++)
+			{
+				total.histogram[bucket] += statistics->histogram[bucket];
+			}
+		}
+		fprintf(output, "{\"operation\":\"%s\",\"tpers\":%u,\"threads\":%u,\"rate\":%.1f,"
+				"\"count\":%llu,\"errors\":%llu,\"throughput\":%.1f,"
+				"\"p50\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f,\"cpu\":%.2f,\"late\":%llu}\n",
+				operationNames[type], tperCount, threadCount, rate * mix[type] / mixTotal,
+				(unsigned long long)total.count, (unsigned long long)total.errors,
+				(double)total.count * TCGS_NSEC_PER_SEC / elapsed,
+				LOADGEN_Percentile(&total, 0.5), LOADGEN_Percentile(&total, 0.99),
+				LOADGEN_Percentile(&total, 0.999), (double)total.maxLatency / TCGS_NSEC_PER_USEC,
+				(total.count > 0) ? (double)total.cpuTime / total.count / TCGS_NSEC_PER_USEC : 0.0,
+				(unsigned long long)late);
+	}
+}
+
+static bool LOADGEN_ParseMix(const char *text)
+{
+	char *end;
+	uint32 type;
+
+	mixTotal = 0;
+	for (type = 0; type < LOADGEN_OPERATIONS; type++)
+	{
+		errno = 0;
+		mix[type] = strtoul(text, &end, 10);
+		if (errno != 0 || end == text || (*end != (type + 1 < LOADGEN_OPERATIONS ? ':' : '\0')))
+		{
+			return FALSE;
+		}
+		mixTotal += mix[type];
+		text = end + 1;
+	}
+	return mixTotal > 0;
+}
+
+int main(int argc, char **argv)
+{
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	int resultFd;
+	uint64 elapsed;
+	uint32 i;
+	int option;
+
+	threadCount = (processors > 0) ? processors : 1;
+	mixTotal = mix[0] + mix[1] + mix[2] + mix[3];
+	while ((option = getopt(argc, argv, "n:j:r:d:m:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'n':
+			tperCount = strtoul(optarg, NULL, 10);
+			break;
+		case 'j':
+			threadCount = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			rate = strtod(optarg, NULL);
+			break;
+		case 'd':
+			duration = (uint64)(strtod(optarg, NULL) * TCGS_NSEC_PER_SEC);
+			break;
+		case 'm':
+			if (!LOADGEN_ParseMix(optarg))
+			{
+				LOADGEN_Usage();
+				return 2;
+			}
+			break;
+		default:
+			LOADGEN_Usage();
+			return 2;
+		}
+	}
+	if (optind != argc || tperCount == 0 || tperCount > LOADGEN_MAX_TPERS || threadCount == 0 ||
+		threadCount > LOADGEN_MAX_THREADS || !(rate > 0) || duration == 0)
+	{
+		LOADGEN_Usage();
+		return 2;
+	}
+	if (threadCount > tperCount)
+	{
+		threadCount = tperCount;
+	}
+
+	//stdout is kept for results, verbose output of the library is moved to stderr
+	resultFd = dup(STDOUT_FILENO);
+	output = (resultFd < 0) ? NULL : fdopen(resultFd, "w");
+	if (output == NULL)
+	{
+		fprintf(stderr, "tcgs_loadgen: cannot open output: %s\n", strerror(errno));
+		return 2;
+	}
+	fflush(stdout);
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+
+	tpers = calloc(tperCount, sizeof(LOADGEN_TPer_t));
+	threads = calloc(threadCount, sizeof(LOADGEN_Thread_t));
+	if (tpers == NULL || threads == NULL)
+	{
+		fprintf(stderr, "tcgs_loadgen: out of memory\n");
+		return 1;
+	}
+	for (i = 0; i < tperCount; i++)
+	{
+		//zeroed instances, pages are taken on first use
+		tpers[i].tper = calloc(1, sizeof(TCGS_VTPer_t));
+		if (tpers[i].tper == NULL)
+		{
+			fprintf(stderr, "tcgs_loadgen: out of memory\n");
+			return 1;
+		}
+		TCGS_VTPer_InitZeroedInstance(tpers[i].tper);
+		TCGS_Device_Init(&tpers[i].device, &virtualFuncs, tpers[i].tper);
+		if (LOADGEN_Discover(&tpers[i]) != ERROR_SUCCESS)
+		{
+			fprintf(stderr, "tcgs_loadgen: discovery of TPer %u failed\n", i);
+			return 1;
+		}
+	}
+
+	startTime = TCGS_GetTime();
+	for (i = 0; i < threadCount; i++)
+	{
+		threads[i].index = i;
+		threads[i].random = (uint32)(startTime >> 10) * 2654435761U + i * 40503U + 1;
+		if (pthread_create(&threads[i].thread, NULL, LOADGEN_Worker, &threads[i]) != 0)
+		{
+			fprintf(stderr, "tcgs_loadgen: failed to start thread\n");
+			return 1;
+		}
+	}
+	for (i = 0; i < threadCount; i++)
+	{
+		pthread_join(threads[i].thread, NULL);
+	}
+	elapsed = TCGS_GetTime() - startTime;
+	LOADGEN_Report(elapsed);
+
+	for (i = 0; i < tperCount; i++)
+	{
+		TCGS_Device_Destroy(&tpers[i].device);
+		free(tpers[i].tper);
+	}
+	free(tpers);
+	free(threads);
+	fclose(output);
+	return 0;
+}
@@ -0,0 +1,1058 @@
+/////////////////////////////////////////////////////////////////////////////
+/// tcgsctl.c
+///
+/// Batch execution of manifest operations on a fleet of devices
+///
+/// (c) Artem Zankovich, 2012
+/////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Usage: tcgsctl [-j jobs] [-o output] [-t timeout] manifest
+ *
+ * Manifest is a text file, one statement per line, '#' starts a comment:
+ *
+ *   device <id> virtual                 virtual TPer
+ *   device <id> ata <path>              ATA device
+ *   <id> discover
+ *   <id> unlock <range> <authority> <pin>
+ *   <id> lock <range> <authority> <pin>
+ *   <id> set-range <range> <start> <length> <authority> <pin>
+ *   <id> mbr-upload <file> <authority> <pin>
+ *   <id> revert <pin>
+ *   <id> provision <template> <checkpoint>
+ *
+ * Ranges and authorities are names of UID catalog (Locking_Range1, Admin1),
+ * PIN @msid stands for MSID read from the device, PIN - for empty one.
+ *
+ * Provisioning template is a text file of the same syntax:
+ *
+ *   sid <pin>                           SID PIN replacing MSID
+ *   admin <pin>                         Admin1 PIN of Locking SP
+ *   range <range> <start> <length>      range with read and write locks enabled
+ *   user <authority> <pin>              enabled user of Locking SP
+ *   mbr <file>                          shadow MBR image
+ *
+ * Checkpoint file of the device is updated after every step of provisioning,
+ * so a rerun of the manifest resumes interrupted provisioning. Devices are processed
+ * concurrently by the jobs, operations of one device are run in manifest
+ * order and the rest of them are skipped after a failure. A JSON line is
+ * written for every operation. Verbose output of the library goes to stderr.
+ *
+ * Timeout in milliseconds bounds every operation, the device that doesn't
+ * complete it in time fails with ERROR_TIMEOUT and its session is closed.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libtcgstorage.h"
+#include "tcgs_types.h"
+#include "tcgs_stream.h"
+#include "tcgs_interface.h"
+#include "tcgs_interface_ata.h"
+#include "tcgs_session.h"
+#include "tcgs_transaction.h"
+#include "tcgs_provision.h"
+#include "tcgs_uid.h"
+#include "tcgs_uid_catalog.h"
+#include "tcgs_time.h"
+#include "tcgs_operation.h"
+#include "vtper.h"
+
+#define TCGSCTL_MAX_DEVICES      256
+#define TCGSCTL_MAX_OPERATIONS   4096
+#define TCGSCTL_MAX_NAME_LENGTH  63
+#define TCGSCTL_MAX_PATH_LENGTH  255
+#define TCGSCTL_MAX_LINE_LENGTH  1024
+#define TCGSCTL_MAX_ARGUMENTS    8
+#define TCGSCTL_MBR_CHUNK_SIZE   1024
+#define TCGSCTL_DEFAULT_JOBS     4
+#define TCGSCTL_MAX_TEMPLATES    16
+
+//PIN to be replaced with MSID of the device
+#define TCGSCTL_PIN_MSID "@msid"
+//empty PIN
+#define TCGSCTL_PIN_EMPTY "-"
+
+typedef enum
+{
+	OP_DISCOVER,
+	OP_UNLOCK,
+	OP_LOCK,
+	OP_SET_RANGE,
+	OP_MBR_UPLOAD,
+	OP_REVERT,
+	OP_PROVISION,
+} TCGSCTL_OperationType_t;
+
+static const char *operationNames[] =
+{
+	"discover",
+	"unlock",
+	"lock",
+	"set-range",
+	"mbr-upload",
+	"revert",
+	"provision",
+};
+
+//number of arguments following operation name
+static const uint32 operationArguments[] = {0, 3, 3, 5, 3, 1, 2};
+
+static const char *errorNames[] =
+{
+	"ERROR_SUCCESS",
+	"ERROR_BUILDER",
+	"ERROR_INTERFACE",
+	"ERROR_PARSER",
+	"ERROR_SESSION",
+	"ERROR_METHOD",
+	"ERROR_PARAMETER",
+	"ERROR_TIMEOUT",
+	"ERROR_CANCELLED",
+};
+
+typedef struct
+{
+	TCGSCTL_OperationType_t  type;
+	uint32                   device;
+	uint32                   line;
+	TCGS_UID_t               range;
+	TCGS_UID_t               authority;
+	char                     pin[TCGS_MAX_CREDENTIAL_LENGTH + 1];
+	uint64                   start;
+	uint64                   length;
+	char                     path[TCGSCTL_MAX_PATH_LENGTH + 1];
+	uint32                   provisionTemplate;     //index in templates
+} TCGSCTL_Operation_t;
+
+typedef struct
+{
+	char                      path[TCGSCTL_MAX_PATH_LENGTH + 1];
+	TCGS_ProvisionTemplate_t  provisionTemplate;
+} TCGSCTL_Template_t;
+
+static const char *stepNames[] =
+{
+	"take-ownership",
+	"activate",
+	"admin",
+	"ranges",
+	"users",
+	"mbr",
+};
+
+static const char *sscNames[] =
+{
+	"unknown",
+	"opal1",
+	"opal2",
+	"enterprise",
+};
+
+typedef struct
+{
+	char            name[TCGSCTL_MAX_NAME_LENGTH + 1];
+	TCGS_Interface_t interface;
+	char            path[TCGSCTL_MAX_PATH_LENGTH + 1];
+	TCGS_VTPer_t   *tper;
+	TCGS_Device_t   device;
+	uint32          sequence;
+} TCGSCTL_Device_t;
+
+//result of operation reported in JSON line
+typedef struct
+{
+	TCGS_Error_t         error;
+	TCGS_MethodStatus_t  status;
+	bool                 statusKnown;
+	char                 details[256];   //additional JSON members
+} TCGSCTL_Result_t;
+
+static TCGSCTL_Device_t devices[TCGSCTL_MAX_DEVICES];
+static uint32 deviceCount;
+static TCGSCTL_Operation_t operations[TCGSCTL_MAX_OPERATIONS];
+static uint32 operationCount;
+static uint32 nextDevice;
+static TCGSCTL_Template_t templates[TCGSCTL_MAX_TEMPLATES];
+static uint32 templateCount;
+static uint64 operationTimeout;     //nanoseconds, 0 if operations have no deadline
+
+//devices of the manifest declared as virtual are served by virtual TPer instances
+static TCGS_InterfaceFunctions_t virtualFuncs =
+{
+	(TCGS_SendCommand_t)&TCGS_VTPER_SendCommand,
+	NULL,
+};
+
+static FILE *output;
+static pthread_mutex_t outputLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void TCGSCTL_Usage(void)
+{
+	fprintf(stderr, "usage: tcgsctl [-j jobs] [-o output] [-t timeout] manifest\n");
+}
+
+static int TCGSCTL_FindDevice(const char *name)
+{
+	uint32 i;
+
+	for (i = 0; i < deviceCount; i++)
+	{
+		if (strcmp(devices[i].name, name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+static bool TCGSCTL_IsName(const char *name)
+{
+	const char *c;
+
+	if (*name == '\0' || strlen(name) > TCGSCTL_MAX_NAME_LENGTH)
+	{
+		return FALSE;
+	}
+	for (c = name; *c != '\0'; c++)
+	{
+		if (!((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') ||
+			*c == '_' || *c == '-' || *c == '.'))
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static bool TCGSCTL_ParseUID(const char *name, TCGS_UIDKind_t kind, TCGS_UID_t *uid)
+{
+	const TCGS_UIDCatalogEntry_t *entry = TCGS_UIDCatalog_FindName(name);
+
+	if (entry == NULL || entry->kind != kind)
+	{
+		return FALSE;
+	}
+	*uid = entry->uid;
+	return TRUE;
+}
+
+static bool TCGSCTL_ParseUInt(const char *text, uint64 *value)
+{
+	char *end;
+
+	errno = 0;
+	*value = strtoull(text, &end, 0);
+	return errno == 0 && *text != '\0' && *end == '\0';
+}
+
+static bool TCGSCTL_ParsePin(const char *text, char *pin)
+{
+	if (strlen(text) > TCGS_MAX_CREDENTIAL_LENGTH)
+	{
+		return FALSE;
+	}
+	strcpy(pin, (strcmp(text, TCGSCTL_PIN_EMPTY) == 0) ? "" : text);
+	return TRUE;
+}
+
+static bool TCGSCTL_ParseCredential(const char *text, uint8 *credential, uint32 *length)
+{
+	char pin[TCGS_MAX_CREDENTIAL_LENGTH + 1];
+
+	if (!TCGSCTL_ParsePin(text, pin) || strcmp(pin, TCGSCTL_PIN_MSID) == 0)
+	{
+		return FALSE;
+	}
+	*length = strlen(pin);
+	memcpy(credential, pin, *length);
+	return TRUE;
+}
+
+/*
+ * Reads the whole file to memory kept until exit
+ */
+static uint8 *TCGSCTL_ReadFile(const char *path, uint32 *length)
+{
+	uint8 *data = NULL;
+	long size;
+	FILE *file;
+
+	file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		return NULL;
+	}
+	if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0)
+	{
+		data = malloc(size);
+		if (data != NULL && fread(data, 1, size, file) != (size_t)size)
+		{
+			free(data);
+			data = NULL;
+		}
+		*length = size;
+	}
+	fclose(file);
+	return data;
+}
+
+static bool TCGSCTL_ParseTemplateStatement(TCGS_ProvisionTemplate_t *provisionTemplate,
+		char **arguments, uint32 count)
+{
+	TCGS_ProvisionRange_t *range;
+	TCGS_ProvisionUser_t *user;
+
+	if (strcmp(arguments[0], "sid") == 0 && count == 2)
+	{
+		return TCGSCTL_ParseCredential(arguments[1], provisionTemplate->sidPin,
+				&provisionTemplate->sidPinLength);
+	}
+	if (strcmp(arguments[0], "admin") == 0 && count == 2)
+	{
+		return TCGSCTL_ParseCredential(arguments[1], provisionTemplate->adminPin,
+				&provisionTemplate->adminPinLength);
+	}
+	if (strcmp(arguments[0], "range") == 0 && count == 4 &&
+		provisionTemplate->rangeCount < TCGS_PROVISION_MAX_RANGES)
+	{
+		range = &provisionTemplate->ranges[provisionTemplate->rangeCount++];
+		range->readLockEnabled = TRUE;
+		range->writeLockEnabled = TRUE;
+		return TCGSCTL_ParseUID(arguments[1], UID_KIND_OBJECT, &range->range) &&
+			TCGSCTL_ParseUInt(arguments[2], &range->start) &&
+			TCGSCTL_ParseUInt(arguments[3], &range->length);
+	}
+	if (strcmp(arguments[0], "user") == 0 && count == 3 &&
+		provisionTemplate->userCount < TCGS_PROVISION_MAX_USERS)
+	{
+		user = &provisionTemplate->users[provisionTemplate->userCount++];
+		return TCGSCTL_ParseUID(arguments[1], UID_KIND_AUTHORITY, &user->authority) &&
+			TCGSCTL_ParseCredential(arguments[2], user->pin, &user->pinLength);
+	}
+	if (strcmp(arguments[0], "mbr") == 0 && count == 2 && provisionTemplate->mbr == NULL)
+	{
+		provisionTemplate->mbr = TCGSCTL_ReadFile(arguments[1], &provisionTemplate->mbrLength);
+		return provisionTemplate->mbr != NULL;
+	}
+	return FALSE;
+}
+
+/*
+ * Splits line into arguments, '#' starts a comment
+ */
+static bool TCGSCTL_ParseLine(char *text, char **arguments, uint32 *count)
+{
+	char *comment, *context;
+
+	comment = strchr(text, '#');
+	if (comment != NULL)
+	{
+		*comment = '\0';
+	}
+	*count = 0;
+	for (arguments[0] = strtok_r(text, " \t\r\n", &context);
+		arguments[*count] != NULL && *count < TCGSCTL_MAX_ARGUMENTS;
+		arguments[*count] = strtok_r(NULL, " \t\r\n", &context))
+	{
+		(*count)++;
+	}
+	return arguments[*count] == NULL;
+}
+
+/*
+ * Parses template once for all devices provisioned with it
+ */
+static int TCGSCTL_ParseTemplate(const char *path)
+{
+	TCGSCTL_Template_t *entry;
+	char text[TCGSCTL_MAX_LINE_LENGTH];
+	char *arguments[TCGSCTL_MAX_ARGUMENTS + 1];
+	uint32 i, count, line = 0;
+	FILE *file;
+
+	for (i = 0; i < templateCount; i++)
+	{
+		if (strcmp(templates[i].path, path) == 0)
+		{
+			return i;
+		}
+	}
+	if (templateCount == TCGSCTL_MAX_TEMPLATES || strlen(path) > TCGSCTL_MAX_PATH_LENGTH)
+	{
+		return -1;
+	}
+	file = fopen(path, "r");
+	if (file == NULL)
+	{
+		fprintf(stderr, "tcgsctl: cannot open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	entry = &templates[templateCount];
+	memset(entry, 0, sizeof(*entry));
+	strcpy(entry->path, path);
+	while (fgets(text, sizeof(text), file) != NULL)
+	{
+		line++;
+		if (!TCGSCTL_ParseLine(text, arguments, &count) ||
+			(count > 0 && !TCGSCTL_ParseTemplateStatement(&entry->provisionTemplate, arguments, count)))
+		{
+			fprintf(stderr, "tcgsctl: %s:%u: invalid statement\n", path, line);
+			fclose(file);
+			return -1;
+		}
+	}
+	fclose(file);
+	return templateCount++;
+}
+
+static bool TCGSCTL_ParseDevice(char **arguments, uint32 count)
+{
+	TCGSCTL_Device_t *device;
+
+	if (count < 3 || !TCGSCTL_IsName(arguments[1]) || TCGSCTL_FindDevice(arguments[1]) >= 0 ||
+		deviceCount == TCGSCTL_MAX_DEVICES)
+	{
+		return FALSE;
+	}
+	device = &devices[deviceCount];
+	strcpy(device->name, arguments[1]);
+	if (strcmp(arguments[2], "virtual") == 0 && count == 3)
+	{
+		device->interface = INTERFACE_UNKNOWN;
+	}
+	else if (strcmp(arguments[2], "ata") == 0 && count == 4 &&
+			strlen(arguments[3]) <= TCGSCTL_MAX_PATH_LENGTH)
+	{
+		device->interface = INTERFACE_ATA;
+		strcpy(device->path, arguments[3]);
+	}
+	else
+	{
+		return FALSE;
+	}
+	deviceCount++;
+	return TRUE;
+}
+
+static bool TCGSCTL_ParseOperation(char **arguments, uint32 count, uint32 line)
+{
+	TCGSCTL_Operation_t *operation = &operations[operationCount];
+	int device = TCGSCTL_FindDevice(arguments[0]);
+	int provisionTemplate;
+	uint32 type;
+
+	if (device < 0 || count < 2 || operationCount == TCGSCTL_MAX_OPERATIONS)
+	{
+		return FALSE;
+	}
+	for (type = 0; type < sizeof(operationNames) / sizeof(operationNames[0]); type++)
+	{
+		if (strcmp(arguments[1], operationNames[type]) == 0)
+		{
+			break;
+		}
+	}
+	if (type == sizeof(operationNames) / sizeof(operationNames[0]) ||
+		count != operationArguments[type] + 2)
+	{
+		return FALSE;
+	}
+
+	memset(operation, 0, sizeof(*operation));
+	operation->type = type;
+	operation->device = device;
+	operation->line = line;
+	arguments += 2;
+	switch (operation->type)
+	{
+	case OP_DISCOVER:
+		break;
+	case OP_UNLOCK:
+	case OP_LOCK:
+		if (!TCGSCTL_ParseUID(arguments[0], UID_KIND_OBJECT, &operation->range) ||
+			!TCGSCTL_ParseUID(arguments[1], UID_KIND_AUTHORITY, &operation->authority) ||
+			!TCGSCTL_ParsePin(arguments[2], operation->pin))
+		{
+			return FALSE;
+		}
+		break;
+	case OP_SET_RANGE:
+		if (!TCGSCTL_ParseUID(arguments[0], UID_KIND_OBJECT, &operation->range) ||
+			!TCGSCTL_ParseUInt(arguments[1], &operation->start) ||
+			!TCGSCTL_ParseUInt(arguments[2], &operation->length) ||
+			!TCGSCTL_ParseUID(arguments[3], UID_KIND_AUTHORITY, &operation->authority) ||
+			!TCGSCTL_ParsePin(arguments[4], operation->pin))
+		{
+			return FALSE;
+		}
+		break;
+	case OP_MBR_UPLOAD:
+		if (strlen(arguments[0]) > TCGSCTL_MAX_PATH_LENGTH ||
+			!TCGSCTL_ParseUID(arguments[1], UID_KIND_AUTHORITY, &operation->authority) ||
+			!TCGSCTL_ParsePin(arguments[2], operation->pin))
+		{
+			return FALSE;
+		}
+		strcpy(operation->path, arguments[0]);
+		break;
+	case OP_REVERT:
+		operation->authority = TCGS_UID_SID;
+		if (!TCGSCTL_ParsePin(arguments[0], operation->pin))
+		{
+			return FALSE;
+		}
+		break;
+	case OP_PROVISION:
+		provisionTemplate = TCGSCTL_ParseTemplate(arguments[0]);
+		if (provisionTemplate < 0 || strlen(arguments[1]) > TCGSCTL_MAX_PATH_LENGTH)
+		{
+			return FALSE;
+		}
+		operation->provisionTemplate = provisionTemplate;
+		strcpy(operation->path, arguments[1]);
+		break;
+	}
+	operationCount++;
+	return TRUE;
+}
+
+static bool TCGSCTL_ParseManifest(const char *path)
+{
+	char text[TCGSCTL_MAX_LINE_LENGTH];
+	char *arguments[TCGSCTL_MAX_ARGUMENTS + 1];
+	uint32 count, line = 0;
+	bool parsed;
+	FILE *file;
+
+	file = fopen(path, "r");
+	if (file == NULL)
+	{
+		fprintf(stderr, "tcgsctl: cannot open %s: %s\n", path, strerror(errno));
+		return FALSE;
+	}
+	while (fgets(text, sizeof(text), file) != NULL)
+	{
+		line++;
+		if (!TCGSCTL_ParseLine(text, arguments, &count))
+		{
+			parsed = FALSE;
+		}
+		else if (count == 0)
+		{
+			continue;
+		}
+		else if (strcmp(arguments[0], "device") == 0)
+		{
+			parsed = TCGSCTL_ParseDevice(arguments, count);
+		}
+		else
+		{
+			parsed = TCGSCTL_ParseOperation(arguments, count, line);
+		}
+		if (!parsed)
+		{
+			fprintf(stderr, "tcgsctl: %s:%u: invalid statement\n", path, line);
+			fclose(file);
+			return FALSE;
+		}
+	}
+	fclose(file);
+	return TRUE;
+}
+
+static void TCGSCTL_Report(TCGSCTL_Device_t *device, TCGSCTL_Operation_t *operation,
+		const char *state, TCGSCTL_Result_t *result, uint64 time)
+{
+	pthread_mutex_lock(&outputLock);
+	fprintf(output, "{\"device\":\"%s\",\"seq\":%u,\"line\":%u,\"op\":\"%s\",\"status\":\"%s\"",
+			device->name, device->sequence++, operation->line, operationNames[operation->type], state);
+	if (result != NULL)
+	{
+		fprintf(output, ",\"error\":\"%s\"", errorNames[result->error]);
+		if (result->statusKnown)
+		{
+			fprintf(output, ",\"methodStatus\":%u", result->status);
+		}
+		fprintf(output, ",\"ms\":%llu%s", (unsigned long long)(time / TCGS_NSEC_PER_MSEC),
+				result->details);
+	}
+	fprintf(output, "}\n");
+	fflush(output);
+	pthread_mutex_unlock(&outputLock);
+}
+
+/*
+ * Reads MSID with anonymous session to Admin SP
+ */
+static TCGS_Error_t TCGSCTL_ReadMSID(TCGSCTL_Device_t *device, TCGS_Session_t *session,
+		char *pin, TCGSCTL_Result_t *result)
+{
+	TCGS_Parser_t results;
+	TCGS_Token_t token;
+	TCGS_Error_t error;
+
+	error = TCGS_StartSession(session, &device->device, &TCGS_UID_AdminSP, NULL, NULL, 0, FALSE,
+			&result->status);
+	result->statusKnown = TRUE;
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	error = TCGS_Get(session, &TCGS_UID_C_PIN_MSID, TCGS_COLUMN_C_PIN_PIN, TCGS_COLUMN_C_PIN_PIN,
+			&results, &result->status);
+	if (error == ERROR_SUCCESS)
+	{
+		if (!TCGS_Parser_FindNamedValue(&results, TCGS_COLUMN_C_PIN_PIN, &token) ||
+			token.length > TCGS_MAX_CREDENTIAL_LENGTH)
+		{
+			error = ERROR_PARSER;
+		}
+		else
+		{
+			memcpy(pin, token.data, token.length);
+			pin[token.length] = '\0';
+		}
+	}
+	TCGS_EndSession(session);
+	return error;
+}
+
+static TCGS_Error_t TCGSCTL_StartSession(TCGSCTL_Device_t *device, TCGS_Session_t *session,
+		const TCGS_UID_t *sp, TCGSCTL_Operation_t *operation, TCGSCTL_Result_t *result)
+{
+	char pin[TCGS_MAX_CREDENTIAL_LENGTH + 1];
+	TCGS_Error_t error;
+
+	strcpy(pin, operation->pin);
+	if (strcmp(pin, TCGSCTL_PIN_MSID) == 0)
+	{
+		error = TCGSCTL_ReadMSID(device, session, pin, result);
+		if (error != ERROR_SUCCESS)
+		{
+			return error;
+		}
+	}
+	error = TCGS_StartSession(session, &device->device, sp, &operation->authority,
+			pin, strlen(pin), TRUE, &result->status);
+	result->statusKnown = TRUE;
+	memset(pin, 0, sizeof(pin));
+	return error;
+}
+
+static TCGS_Error_t TCGSCTL_EndSession(TCGS_Session_t *session, TCGS_Error_t error)
+{
+	TCGS_Error_t endError = TCGS_EndSession(session);
+
+	return (error != ERROR_SUCCESS) ? error : endError;
+}
+
+static TCGS_Error_t TCGSCTL_Discover(TCGSCTL_Device_t *device, TCGSCTL_Result_t *result)
+{
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	TCGS_Level0Discovery_FeatureLocking_t *locking;
+	TCGS_Error_t error;
+
+	error = TCGS_Device_Level0Discovery(&device->device, buffer);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	locking = TCGS_GetLevel0DiscoveryFeatureLockingHeader((TCGS_Level0Discovery_Header_t*)buffer);
+	if (locking == NULL)
+	{
+		snprintf(result->details, sizeof(result->details), ",\"comId\":%u,\"locking\":false",
+				device->device.comId);
+	}
+	else
+	{
+		snprintf(result->details, sizeof(result->details),
+				",\"comId\":%u,\"locking\":true,\"lockingEnabled\":%s,\"locked\":%s,"
+				"\"mbrEnabled\":%s,\"mbrDone\":%s",
+				device->device.comId,
+				locking->lockingEnabled ? "true" : "false", locking->locked ? "true" : "false",
+				locking->MBREnabled ? "true" : "false", locking->MBRDone ? "true" : "false");
+	}
+	return ERROR_SUCCESS;
+}
+
+static TCGS_Error_t TCGSCTL_SetLocked(TCGSCTL_Device_t *device, TCGS_Session_t *session,
+		TCGSCTL_Operation_t *operation, TCGSCTL_Result_t *result)
+{
+	TCGS_Transaction_t transaction;
+	TCGS_Error_t error;
+	bool locked = (operation->type == OP_LOCK);
+
+	error = TCGSCTL_StartSession(device, session, &TCGS_UID_LockingSP, operation, result);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	error = TCGS_StartTransaction(&transaction, session);
+	if (error == ERROR_SUCCESS)
+	{
+		TCGS_Transaction_SetUInt(&transaction, NULL, &operation->range,
+				TCGS_COLUMN_LOCKING_READ_LOCKED, locked);
+		TCGS_Transaction_SetUInt(&transaction, NULL, &operation->range,
+				TCGS_COLUMN_LOCKING_WRITE_LOCKED, locked);
+		error = TCGS_EndTransaction(&transaction, TRUE);
+	}
+	return TCGSCTL_EndSession(session, error);
+}
+
+static TCGS_Error_t TCGSCTL_SetRange(TCGSCTL_Device_t *device, TCGS_Session_t *session,
+		TCGSCTL_Operation_t *operation, TCGSCTL_Result_t *result)
+{
+	TCGS_Transaction_t transaction;
+	TCGS_Error_t error;
+
+	error = TCGSCTL_StartSession(device, session, &TCGS_UID_LockingSP, operation, result);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	error = TCGS_StartTransaction(&transaction, session);
+	if (error == ERROR_SUCCESS)
+	{
+		TCGS_Transaction_SetUInt(&transaction, NULL, &operation->range,
+				TCGS_COLUMN_LOCKING_RANGE_START, operation->start);
+		TCGS_Transaction_SetUInt(&transaction, NULL, &operation->range,
+				TCGS_COLUMN_LOCKING_RANGE_LENGTH, operation->length);
+		TCGS_Transaction_SetUInt(&transaction, NULL, &operation->range,
+				TCGS_COLUMN_LOCKING_READ_LOCK_ENABLED, 1);
+		TCGS_Transaction_SetUInt(&transaction, NULL, &operation->range,
+				TCGS_COLUMN_LOCKING_WRITE_LOCK_ENABLED, 1);
+		error = TCGS_EndTransaction(&transaction, TRUE);
+	}
+	return TCGSCTL_EndSession(session, error);
+}
+
+/*
+ * Writes image to MBR table with Set of byte table and enables MBR shadowing
+ */
+static TCGS_Error_t TCGSCTL_UploadMBR(TCGSCTL_Device_t *device, TCGS_Session_t *session,
+		TCGSCTL_Operation_t *operation, TCGSCTL_Result_t *result)
+{
+	uint8 chunk[TCGSCTL_MBR_CHUNK_SIZE];
+	TCGS_Builder_t *builder;
+	TCGS_Error_t error;
+	uint64 where = 0;
+	size_t length;
+	FILE *file;
+
+	file = fopen(operation->path, "rb");
+	if (file == NULL)
+	{
+		return ERROR_PARAMETER;
+	}
+	error = TCGSCTL_StartSession(device, session, &TCGS_UID_LockingSP, operation, result);
+	while (error == ERROR_SUCCESS && (length = fread(chunk, 1, sizeof(chunk), file)) > 0)
+	{
+		builder = TCGS_Session_StartPacket(session);
+		TCGS_Builder_StartCall(builder, &TCGS_UID_MBR, &TCGS_UID_Method_Set);
+		TCGS_Builder_AddNamedUInt(builder, SET_WHERE, where);
+		TCGS_Builder_AddNamedBytes(builder, SET_VALUES, chunk, length);
+		TCGS_Builder_EndCall(builder);
+		error = TCGS_Session_Call(session, NULL, &result->status);
+		where += length;
+	}
+	if (error == ERROR_SUCCESS && ferror(file))
+	{
+		error = ERROR_PARAMETER;
+	}
+	fclose(file);
+	if (error == ERROR_SUCCESS)
+	{
+		error = TCGS_SetUInt(session, &TCGS_UID_MBRControl, TCGS_COLUMN_MBRCONTROL_ENABLE, 1,
+				&result->status);
+	}
+	if (session->open)
+	{
+		error = TCGSCTL_EndSession(session, error);
+	}
+	snprintf(result->details, sizeof(result->details), ",\"bytes\":%llu", (unsigned long long)where);
+	return error;
+}
+
+static TCGS_Error_t TCGSCTL_Revert(TCGSCTL_Device_t *device, TCGS_Session_t *session,
+		TCGSCTL_Operation_t *operation, TCGSCTL_Result_t *result)
+{
+	TCGS_Builder_t *builder;
+	TCGS_Error_t error;
+
+	error = TCGSCTL_StartSession(device, session, &TCGS_UID_AdminSP, operation, result);
+	if (error != ERROR_SUCCESS)
+	{
+		return error;
+	}
+	builder = TCGS_Session_StartPacket(session);
+	TCGS_Builder_StartCall(builder, &TCGS_UID_AdminSP, &TCGS_UID_Method_Revert);
+	TCGS_Builder_EndCall(builder);
+	error = TCGS_Session_Call(session, NULL, &result->status);
+	if (error != ERROR_SUCCESS)
+	{
+		return TCGSCTL_EndSession(session, error);
+	}
+	//TPer closes the session itself after successful Revert
+	TCGS_EndSession(session);
+	return ERROR_SUCCESS;
+}
+
+static void TCGSCTL_LoadCheckpoint(const char *path, TCGS_ProvisionCheckpoint_t *checkpoint)
+{
+	FILE *file = fopen(path, "rb");
+
+	if (file == NULL || fread(checkpoint, sizeof(*checkpoint), 1, file) != 1)
+	{
+		//provisioning of the device is not started yet
+		memset(checkpoint, 0, sizeof(*checkpoint));
+	}
+	if (file != NULL)
+	{
+		fclose(file);
+	}
+}
+
+/*
+ * Checkpoint is written to temporary file that replaces the old one, so
+ * the file always holds a complete checkpoint
+ */
+static bool TCGSCTL_SaveCheckpoint(void *context, const TCGS_ProvisionCheckpoint_t *checkpoint)
+{
+	const char *path = context;
+	char temporary[TCGSCTL_MAX_PATH_LENGTH + 8];
+	bool saved;
+	FILE *file;
+
+	snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+	file = fopen(temporary, "wb");
+	if (file == NULL)
+	{
+		return FALSE;
+	}
+	saved = (fwrite(checkpoint, sizeof(*checkpoint), 1, file) == 1);
+	saved = (fclose(file) == 0) && saved;
+	return saved && rename(temporary, path) == 0;
+}
+
+static TCGS_Error_t TCGSCTL_Provision(TCGSCTL_Device_t *device, TCGSCTL_Operation_t *operation,
+		TCGSCTL_Result_t *result)
+{
+	TCGS_ProvisionCheckpoint_t checkpoint;
+	TCGS_Provision_t provision;
+	TCGS_Error_t error;
+
+	TCGSCTL_LoadCheckpoint(operation->path, &checkpoint);
+	TCGS_Provision_Init(&provision, &device->device,
+			&templates[operation->provisionTemplate].provisionTemplate, &checkpoint,
+			TCGSCTL_SaveCheckpoint, operation->path);
+	error = TCGS_Provision_Run(&provision);
+	result->status = provision.status;
+	result->statusKnown = TRUE;
+	snprintf(result->details, sizeof(result->details),
+			",\"ssc\":\"%s\",\"step\":\"%s\",\"sessions\":%u",
+			sscNames[provision.ssc], (error == ERROR_SUCCESS) ? "done" : stepNames[provision.step],
+			provision.sessions);
+	return error;
+}
+
+static TCGS_Error_t TCGSCTL_Run(TCGSCTL_Device_t *device, TCGS_Session_t *session,
+		TCGSCTL_Operation_t *operation, TCGSCTL_Result_t *result)
+{
+	switch (operation->type)
+	{
+	case OP_DISCOVER:
+		return TCGSCTL_Discover(device, result);
+	case OP_UNLOCK:
+	case OP_LOCK:
+		return TCGSCTL_SetLocked(device, session, operation, result);
+	case OP_SET_RANGE:
+		return TCGSCTL_SetRange(device, session, operation, result);
+	case OP_MBR_UPLOAD:
+		return TCGSCTL_UploadMBR(device, session, operation, result);
+	case OP_REVERT:
+		return TCGSCTL_Revert(device, session, operation, result);
+	case OP_PROVISION:
+		return TCGSCTL_Provision(device, operation, result);
+	}
+	return ERROR_PARAMETER;
+}
+
+/*
+ * Runs operations of the device in manifest order
+ */
+static bool TCGSCTL_RunDevice(TCGSCTL_Device_t *device, TCGS_Session_t *session)
+{
+	TCGSCTL_Operation_t *operation;
+	TCGSCTL_Result_t result;
+	TCGS_Operation_t deadline;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	bool failed = FALSE;
+	uint64 start;
+	uint32 i;
+
+	if (device->interface == INTERFACE_UNKNOWN)
+	{
+		TCGS_VTPer_InitInstance(device->tper);
+		TCGS_Device_Init(&device->device, &virtualFuncs, device->tper);
+	}
+	else
+	{
+		TCGS_Device_Init(&device->device, &TCGS_Interface_ATA_Funcs, device->path);
+	}
+	//base ComID is needed for sessions even if the manifest has no discover
+	TCGS_Operation_Init(&deadline, operationTimeout);
+	TCGS_Operation_Begin(&deadline);
+	TCGS_Device_Level0Discovery(&device->device, buffer);
+	TCGS_Operation_End(&deadline);
+
+	for (i = 0; i < operationCount; i++)
+	{
+		operation = &operations[i];
+		if (operation->device != device - devices)
+		{
+			continue;
+		}
+		if (failed)
+		{
+			TCGSCTL_Report(device, operation, "skipped", NULL, 0);
+			continue;
+		}
+		memset(&result, 0, sizeof(result));
+		start = TCGS_GetTime();
+		TCGS_Operation_Init(&deadline, operationTimeout);
+		TCGS_Operation_Begin(&deadline);
+		result.error = TCGSCTL_Run(device, session, operation, &result);
+		TCGS_Operation_End(&deadline);
+		failed = (result.error != ERROR_SUCCESS);
+		TCGSCTL_Report(device, operation, failed ? "failed" : "ok", &result, TCGS_GetTime() - start);
+	}
+	TCGS_Device_Destroy(&device->device);
+	return !failed;
+}
+
+static uint32 failedDevices;
+
+static void *TCGSCTL_Worker(void *argument)
+{
+	TCGS_Session_t *session = argument;
+	uint32 i;
+
+	while ((i = __sync_fetch_and_add(&nextDevice, 1)) < deviceCount)
+	{
+		if (!TCGSCTL_RunDevice(&devices[i], session))
+		{
+			__sync_fetch_and_add(&failedDevices, 1);
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *outputPath = NULL;
+	uint32 jobs = TCGSCTL_DEFAULT_JOBS;
+	TCGS_Session_t *sessions;
+	pthread_t *threads;
+	int option, resultFd;
+	uint32 i;
+
+	while ((option = getopt(argc, argv, "j:o:t:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'j':
+			jobs = atoi(optarg);
+			break;
+		case 'o':
+			outputPath = optarg;
+			break;
+		case 't':
+			operationTimeout = strtoull(optarg, NULL, 10) * TCGS_NSEC_PER_MSEC;
+			break;
+		default:
+			TCGSCTL_Usage();
+			return 2;
+		}
+	}
+	if (optind != argc - 1 || jobs == 0)
+	{
+		TCGSCTL_Usage();
+		return 2;
+	}
+	if (!TCGSCTL_ParseManifest(argv[optind]))
+	{
+		return 2;
+	}
+
+	//stdout is kept for results, verbose output of the library is moved to stderr
+	if (outputPath != NULL)
+	{
+		output = fopen(outputPath, "w");
+	}
+	else
+	{
+		resultFd = dup(STDOUT_FILENO);
+		output = (resultFd < 0) ? NULL : fdopen(resultFd, "w");
+	}
+	if (output == NULL)
+	{
+		fprintf(stderr, "tcgsctl: cannot open output: %s\n", strerror(errno));
+		return 2;
+	}
+	fflush(stdout);
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+
+	if (jobs > deviceCount)
+	{
+		jobs = (deviceCount > 0) ? deviceCount : 1;
+	}
+	for (i = 0; i < deviceCount; i++)
+	{
+		if (devices[i].interface == INTERFACE_UNKNOWN)
+		{
+			devices[i].tper = malloc(sizeof(TCGS_VTPer_t));
+			if (devices[i].tper == NULL)
+			{
+				fprintf(stderr, "tcgsctl: out of memory\n");
+				return 2;
+			}
+		}
+	}
+	sessions = calloc(jobs, sizeof(TCGS_Session_t));
+	threads = calloc(jobs, sizeof(pthread_t));
+	if (sessions == NULL || threads == NULL)
+	{
+		fprintf(stderr, "tcgsctl: out of memory\n");
+		return 2;
+	}
+
+	TCGS_InitHost();
+	for (i = 0; i < jobs; i++)
+	{
+		pthread_create(&threads[i], NULL, TCGSCTL_Worker, &sessions[i]);
+	}
+	for (i = 0; i < jobs; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	TCGS_DestroyHost();
+
+	for (i = 0; i < deviceCount; i++)
+	{
+		free(devices[i].tper);
+	}
+	for (i = 0; i < templateCount; i++)
+	{
+		free((void*)templates[i].provisionTemplate.mbr);
+	}
+	free(sessions);
+	free(threads);
+	fclose(output);
+	return (failedDevices == 0) ? 0 : 1;
+}
@@ -15,6 +15,7 @@
 TCGS_InterfaceFunctions_t TCGS_Interface_Virtual_Funcs =
 {
 	(TCGS_SendCommand_t)&TCGS_Virtual_SendCommand,
+	NULL,
 };
 
 
@@ -31,7 +32,7 @@ TCGS_InterfaceFunctions_t TCGS_Interface_Virtual_Funcs =
  * code and payload). Error code ERROR_INTERFACE is returned otherwise
  *
  *****************************************************************************/
-TCGS_InterfaceError_t TCGS_Virtual_SendCommand(
+TCGS_Error_t TCGS_Virtual_SendCommand(
     TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
     TCGS_InterfaceError_t *tperError, void *outputPayload)
 {
@@ -27,7 +27,7 @@ extern TCGS_InterfaceFunctions_t TCGS_Interface_Virtual_Funcs;
  * (error status code and payload). Error code ERROR_INTERFACE is returned otherwise
  *
  *****************************************************************************/
-TCGS_InterfaceError_t TCGS_Virtual_SendCommand(
+TCGS_Error_t TCGS_Virtual_SendCommand(
     TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
     TCGS_InterfaceError_t *tperError, void *outputPayload);
 
@@ -13,6 +13,13 @@
 #include <google/cmockery.h>   
 
 #include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/keyctl.h>
 
 // If unit testing is enabled override assert with mock_assert().
 #if UNIT_TESTING
@@ -30,6 +37,32 @@ extern void mock_assert(const int result, const char* const expression,
 #include "tcgs_interface.h"
 #include "tcgs_interface_virtual.h"
 #include "tcgs_interface_encode.h"
+#include "tcgs_interface_capture.h"
+#include "tcgs_interface_chain.h"
+#include "tcgs_operation.h"
+#include "tcgs_retry.h"
+#include "tcgs_scheduler.h"
+#include "tcgs_lockdown.h"
+#include "tcgs_resume.h"
+#include "tcgs_time.h"
+#include "tcgs_session.h"
+#include "tcgs_session_pool.h"
+#include "tcgs_uid.h"
+#include "tcgs_lba_index.h"
+#include "tcgs_monitor.h"
+#include "tcgs_comid.h"
+#include "tcgs_provision.h"
+#include "tcgs_time.h"
+#include "tcgs_uid_catalog.h"
+#include "tcgs_format.h"
+#include "tcgs_arbiter.h"
+#include "tcgs_inventory.h"
+#include "tcgs_transaction.h"
+#include "tcgs_table_cache.h"
+#include "tcgs_table_iterator.h"
+#include "tcgs_hash.h"
+#include "tcgs_credential.h"
+#include "vtper.h"
 
 /**
  * \brief Test base types size
@@ -82,11 +115,1964 @@ void test_tcgs_host_level0discovery_virtual(void **state)
     assert_int_equal(headerTper->length, 12);
 }
 
+/**
+ * \brief Test for Level0Discovery of device: base ComID and Revert of virtual TPer
+ */
+void test_tcgs_device_level0discovery(void **state)
+{
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t session;
+	TCGS_Builder_t *builder;
+	TCGS_MethodStatus_t status;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	uint8 quiet[TCGS_BLOCK_SIZE];
+
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &TCGS_Interface_Virtual_Funcs, &tper);
+	assert_int_equal(TCGS_Device_Level0Discovery(&device, buffer), ERROR_SUCCESS);
+	assert_int_equal(device.comId, VTPER_BASE_COMID);
+	//non-printing read decodes the same data
+	device.comId = 0;
+	assert_int_equal(TCGS_Device_Level0DiscoveryQuiet(&device, quiet), ERROR_SUCCESS);
+	assert_int_equal(device.comId, VTPER_BASE_COMID);
+	assert_memory_equal(quiet, buffer, TCGS_BLOCK_SIZE);
+
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			VTPER_MSID, strlen(VTPER_MSID), TRUE, &status), ERROR_SUCCESS);
+	assert_int_equal(TCGS_SetBytes(&session, &TCGS_UID_C_PIN_SID, TCGS_COLUMN_C_PIN_PIN,
+			"secret", 6, &status), ERROR_SUCCESS);
+	builder = TCGS_Session_StartPacket(&session);
+	TCGS_Builder_StartCall(builder, &TCGS_UID_AdminSP, &TCGS_UID_Method_Revert);
+	TCGS_Builder_EndCall(builder);
+	assert_int_equal(TCGS_Session_Call(&session, NULL, &status), ERROR_SUCCESS);
+	TCGS_EndSession(&session);
+
+	//SID PIN is reset to MSID
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			VTPER_MSID, strlen(VTPER_MSID), FALSE, &status), ERROR_SUCCESS);
+	assert_int_equal(TCGS_EndSession(&session), ERROR_SUCCESS);
+	TCGS_Device_Destroy(&device);
+}
+
+/**
+ * \brief Test for reclaim of ComID from session left open by crashed host
+ */
+void test_tcgs_comid_reclaim(void **state)
+{
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t orphan, session;
+	TCGS_MethodStatus_t status;
+	TCGS_ComIDState_t comIdState;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	bool reset;
+
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &TCGS_Interface_Virtual_Funcs, &tper);
+	assert_int_equal(TCGS_Device_Level0Discovery(&device, buffer), ERROR_SUCCESS);
+
+	//the session is never closed
+	assert_int_equal(TCGS_StartSession(&orphan, &device, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			VTPER_MSID, strlen(VTPER_MSID), TRUE, &status), ERROR_SUCCESS);
+	assert_int_equal(TCGS_VerifyComID(&device, device.comId, &comIdState), ERROR_SUCCESS);
+	assert_int_equal(comIdState, COMID_STATE_ASSOCIATED);
+
+	assert_int_equal(TCGS_Device_ReclaimComID(&device, (TCGS_Level0Discovery_Header_t*)buffer, &reset),
+			ERROR_SUCCESS);
+	assert_true(reset);
+	assert_false(tper.sessions[0].open);
+
+	//clean ComID is not reset
+	assert_int_equal(TCGS_Device_ReclaimComID(&device, (TCGS_Level0Discovery_Header_t*)buffer, &reset),
+			ERROR_SUCCESS);
+	assert_false(reset);
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			VTPER_MSID, strlen(VTPER_MSID), TRUE, &status), ERROR_SUCCESS);
+	assert_int_equal(TCGS_EndSession(&session), ERROR_SUCCESS);
+	TCGS_Device_Destroy(&device);
+}
+
+typedef struct
+{
+	TCGS_ProvisionCheckpoint_t  stored;
+	uint32                      saves;
+	uint32                      limit;      //saves that succeed
+} ProvisionStore_t;
+
+static bool test_provision_save(void *context, const TCGS_ProvisionCheckpoint_t *checkpoint)
+{
+	ProvisionStore_t *store = context;
+
+	if (store->saves == store->limit)
+	{
+		return FALSE;
+	}
+	store->saves++;
+	store->stored = *checkpoint;
+	return TRUE;
+}
+
+/**
+ * \brief Test for provisioning from template interrupted and resumed from checkpoint
+ */
+void test_tcgs_provision(void **state)
+{
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_ProvisionTemplate_t provisionTemplate;
+	TCGS_ProvisionCheckpoint_t checkpoint;
+	TCGS_Provision_t provision;
+	TCGS_VTPer_Object_t *object;
+	ProvisionStore_t store;
+	uint8 mbr[3000];
+	uint32 i;
+
+	for (i = 0; i < sizeof(mbr); i++)
+	{
+		mbr[i] = (uint8)i;
+	}
+	memset(&provisionTemplate, 0, sizeof(provisionTemplate));
+	memcpy(provisionTemplate.sidPin, "owner", 5);
+	provisionTemplate.sidPinLength = 5;
+	memcpy(provisionTemplate.adminPin, "admin", 5);
+	provisionTemplate.adminPinLength = 5;
+	provisionTemplate.rangeCount = 1;
+	provisionTemplate.ranges[0].range = TCGS_UID_Locking_Range1;
+	provisionTemplate.ranges[0].start = 0x1000;
+	provisionTemplate.ranges[0].length = 0x2000;
+	provisionTemplate.ranges[0].readLockEnabled = TRUE;
+	provisionTemplate.ranges[0].writeLockEnabled = TRUE;
+	provisionTemplate.userCount = 1;
+	provisionTemplate.users[0].authority = TCGS_UID_User1;
+	memcpy(provisionTemplate.users[0].pin, "user", 4);
+	provisionTemplate.users[0].pinLength = 4;
+	provisionTemplate.mbr = mbr;
+	provisionTemplate.mbrLength = sizeof(mbr);
+
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &TCGS_Interface_Virtual_Funcs, &tper);
+
+	//the run is interrupted after Admin1 PIN is set but before it is checkpointed
+	memset(&store, 0, sizeof(store));
+	store.limit = 2;
+	memset(&checkpoint, 0, sizeof(checkpoint));
+	TCGS_Provision_Init(&provision, &device, &provisionTemplate, &checkpoint, test_provision_save, &store);
+	assert_int_equal(TCGS_Provision_Run(&provision), ERROR_PARAMETER);
+	assert_int_equal(provision.ssc, PROVISION_SSC_OPAL1);
+	assert_int_equal(provision.step, PROVISION_STEP_ADMIN);
+	assert_int_equal(provision.sessions, 2);
+	assert_true(tper.lockingActive);
+	assert_false(tper.sessions[0].open);
+
+	//resumed run takes one session and tries both Admin1 PINs
+	checkpoint = store.stored;
+	assert_true(TCGS_Provision_IsCompleted(&checkpoint, PROVISION_STEP_ACTIVATE));
+	assert_false(TCGS_Provision_IsCompleted(&checkpoint, PROVISION_STEP_ADMIN));
+	store.limit = ~0U;
+	TCGS_Provision_Init(&provision, &device, &provisionTemplate, &checkpoint, test_provision_save, &store);
+	assert_int_equal(TCGS_Provision_Run(&provision), ERROR_SUCCESS);
+	assert_int_equal(provision.sessions, 1);
+	assert_int_equal(store.stored.completed, (1U << PROVISION_STEPS) - 1);
+	assert_int_equal(store.stored.mbrWritten, sizeof(mbr));
+
+	object = TCGS_VTPer_FindObject(&tper, &TCGS_UID_C_PIN_SID);
+	assert_memory_equal(object->columns[TCGS_COLUMN_C_PIN_PIN].bytes, "owner", 5);
+	object = TCGS_VTPer_FindObject(&tper, &TCGS_UID_C_PIN_Admin1);
+	assert_memory_equal(object->columns[TCGS_COLUMN_C_PIN_PIN].bytes, "admin", 5);
+	object = TCGS_VTPer_FindObject(&tper, &TCGS_UID_Locking_Range1);
+	assert_int_equal(object->columns[TCGS_COLUMN_LOCKING_RANGE_LENGTH].value, 0x2000);
+	assert_int_equal(object->columns[TCGS_COLUMN_LOCKING_WRITE_LOCK_ENABLED].value, 1);
+	object = TCGS_VTPer_FindObject(&tper, &TCGS_UID_User1);
+	assert_int_equal(object->columns[TCGS_COLUMN_AUTHORITY_ENABLED].value, 1);
+	object = TCGS_VTPer_FindObject(&tper, &TCGS_UID_MBRControl);
+	assert_int_equal(object->columns[TCGS_COLUMN_MBRCONTROL_ENABLE].value, 1);
+	assert_memory_equal(tper.mbr, mbr, sizeof(mbr));
+
+	//completed provisioning starts no session
+	TCGS_Provision_Init(&provision, &device, &provisionTemplate, &checkpoint, test_provision_save, &store);
+	assert_int_equal(TCGS_Provision_Run(&provision), ERROR_SUCCESS);
+	assert_int_equal(provision.sessions, 0);
+
+	//Enterprise device is rejected before any session, even for ownership only
+	TCGS_VTPer_InitInstance(&tper);
+	tper.enterprise = TRUE;
+	provisionTemplate.adminPinLength = 0;
+	provisionTemplate.rangeCount = 0;
+	provisionTemplate.userCount = 0;
+	provisionTemplate.mbr = NULL;
+	memset(&checkpoint, 0, sizeof(checkpoint));
+	TCGS_Provision_Init(&provision, &device, &provisionTemplate, &checkpoint, test_provision_save, &store);
+	assert_int_equal(TCGS_Provision_Run(&provision), ERROR_PARAMETER);
+	assert_int_equal(provision.ssc, PROVISION_SSC_ENTERPRISE);
+	assert_int_equal(provision.sessions, 0);
+	assert_int_equal(tper.startSessionCount, 0);
+	assert_int_equal(checkpoint.completed, 0);
+	TCGS_Device_Destroy(&device);
+}
+
+/**
+ * \brief Test for recording of Level0Discovery exchange and its replaying
+ */
+void test_tcgs_capture_record_replay(void **state)
+{
+	TCGS_CommandBlock_t commandBlock;
+	TCGS_InterfaceError_t error;
+	TCGS_Error_t status;
+	uint8 recorded[TCGS_BLOCK_SIZE];
+	uint8 replayed[TCGS_BLOCK_SIZE];
+	char path[] = "/tmp/tcgs_captureXXXXXX";
+	int i;
+
+	close(mkstemp(path));
+	memset(recorded, 0, sizeof(recorded));
+	TCGS_PrepareInterfaceCommand(LEVEL0_DISCOVERY, NULL, &commandBlock, NULL);
+	TCGS_SetInterfaceFunctions(&TCGS_Interface_Virtual_Funcs);
+	assert_int_equal(TCGS_Capture_StartRecord(path), ERROR_SUCCESS);
+	status = TCGS_SendCommand(&commandBlock, NULL, &error, recorded);
+	assert_int_equal(status, ERROR_SUCCESS);
+	assert_int_equal(TCGS_Capture_StopRecord(), ERROR_SUCCESS);
+	assert_true(TCGS_GetInterfaceFunctions() == &TCGS_Interface_Virtual_Funcs);
+
+	assert_int_equal(TCGS_Capture_OpenReplay(path, CAPTURE_REPLAY_MAXIMUM_SPEED), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Capture_GetReplayRecordCount(), 1);
+	for (i = 0; i < 3; i++)
+	{
+		memset(replayed, 0xFF, sizeof(replayed));
+		TCGS_Capture_RewindReplay();
+		status = TCGS_SendCommand(&commandBlock, NULL, &error, replayed);
+		assert_int_equal(status, ERROR_SUCCESS);
+		assert_int_equal(error, INTERFACE_ERROR_GOOD);
+		assert_memory_equal(recorded, replayed, sizeof(recorded));
+	}
+	//conversation is over, no more records
+	status = TCGS_SendCommand(&commandBlock, NULL, &error, replayed);
+	assert_int_equal(status, ERROR_INTERFACE);
+	assert_int_equal(error, INTERFACE_ERROR_SYNCHRONOUS_PROTOCOL_VIOLATION);
+	TCGS_Capture_CloseReplay();
+	assert_true(TCGS_GetInterfaceFunctions() == &TCGS_Interface_Virtual_Funcs);
+	unlink(path);
+}
+
+typedef struct
+{
+	TCGS_VTPer_t    tper;
+	TCGS_Device_t   device;
+	TCGS_Error_t    error;
+} CaptureDevice_t;
+
+//sends Level 0 Discovery of one device through the shared recording layer
+static void *CaptureDiscovery(void *argument)
+{
+	CaptureDevice_t *capture = argument;
+	TCGS_CommandBlock_t commandBlock;
+	TCGS_InterfaceError_t error;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	uint32 i;
+
+	TCGS_PrepareInterfaceCommand(LEVEL0_DISCOVERY, NULL, &commandBlock, NULL);
+	for (i = 0; i < 50 && capture->error == ERROR_SUCCESS; i++)
+	{
+		capture->error = TCGS_Device_SendCommand(&capture->device, &commandBlock, NULL, &error, buffer);
+	}
+	return NULL;
+}
+
+/**
+ * \brief Test for recording layer shared by concurrent devices: records
+ * are written whole, failed write is reported
+ */
+void test_tcgs_capture_concurrent(void **state)
+{
+	static CaptureDevice_t devices[4];
+	TCGS_InterfaceLayer_t layer;
+	TCGS_InterfaceChain_t chain;
+	TCGS_CommandBlock_t commandBlock;
+	TCGS_InterfaceError_t error;
+	pthread_t threads[4];
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	char path[] = "/tmp/tcgs_captureXXXXXX";
+	uint32 i;
+
+	close(mkstemp(path));
+	assert_int_equal(TCGS_Capture_StartRecordLayer(path, &layer), ERROR_SUCCESS);
+	assert_int_equal(TCGS_InterfaceChain_Init(&chain, &TCGS_Interface_Virtual_Funcs, &layer, 1), ERROR_SUCCESS);
+	for (i = 0; i < 4; i++)
+	{
+		TCGS_VTPer_InitInstance(&devices[i].tper);
+		TCGS_Device_Init(&devices[i].device, &chain.funcs, &devices[i].tper);
+		devices[i].error = ERROR_SUCCESS;
+		assert_int_equal(pthread_create(&threads[i], NULL, CaptureDiscovery, &devices[i]), 0);
+	}
+	for (i = 0; i < 4; i++)
+	{
+		pthread_join(threads[i], NULL);
+		assert_int_equal(devices[i].error, ERROR_SUCCESS);
+		TCGS_Device_Destroy(&devices[i].device);
+	}
+	assert_int_equal(TCGS_Capture_StopRecord(), ERROR_SUCCESS);
+
+	//every record is replayed in order
+	TCGS_SetInterfaceFunctions(&TCGS_Interface_Virtual_Funcs);
+	assert_int_equal(TCGS_Capture_OpenReplay(path, CAPTURE_REPLAY_MAXIMUM_SPEED), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Capture_GetReplayRecordCount(), 200);
+	TCGS_PrepareInterfaceCommand(LEVEL0_DISCOVERY, NULL, &commandBlock, NULL);
+	for (i = 0; i < 200; i++)
+	{
+		assert_int_equal(TCGS_SendCommand(&commandBlock, NULL, &error, buffer), ERROR_SUCCESS);
+		assert_int_equal(error, INTERFACE_ERROR_GOOD);
+	}
+	TCGS_Capture_CloseReplay();
+	unlink(path);
+
+	//records buffered by stdio fail to be written when recording is stopped
+	assert_int_equal(TCGS_Capture_StartRecordLayer("/dev/full", &layer), ERROR_SUCCESS);
+	assert_int_equal(TCGS_InterfaceChain_Init(&chain, &TCGS_Interface_Virtual_Funcs, &layer, 1), ERROR_SUCCESS);
+	TCGS_VTPer_InitInstance(&devices[0].tper);
+	TCGS_Device_Init(&devices[0].device, &chain.funcs, &devices[0].tper);
+	assert_int_equal(TCGS_Device_SendCommand(&devices[0].device, &commandBlock, NULL, &error, buffer), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Capture_StopRecord(), ERROR_INTERFACE);
+	TCGS_Device_Destroy(&devices[0].device);
+}
+
+static bool RetryAll(const TCGS_CommandBlock_t *commandBlock)
+{
+	return TRUE;
+}
+
+/**
+ * \brief Test for chain of layers: retry over injected faults, metrics,
+ * flattening of nested chains, record and replay layers
+ */
+void test_tcgs_interface_chain(void **state)
+{
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t session;
+	TCGS_MethodStatus_t status;
+	TCGS_InterfaceChain_t chain, outer;
+	TCGS_InterfaceLayer_t layers[3];
+	TCGS_LayerMetrics_t metrics, outerMetrics;
+	TCGS_LayerRetry_t retry;
+	TCGS_LayerFault_t fault;
+	TCGS_CommandBlock_t commandBlock;
+	TCGS_InterfaceError_t error;
+	uint8 recorded[TCGS_BLOCK_SIZE];
+	uint8 replayed[TCGS_BLOCK_SIZE];
+	char path[] = "/tmp/tcgs_captureXXXXXX";
+
+	//chain without layers is the backend itself
+	assert_int_equal(TCGS_InterfaceChain_Init(&chain, &TCGS_Interface_Virtual_Funcs, NULL, 0), ERROR_SUCCESS);
+	assert_true(chain.funcs.chain == NULL);
+	assert_true(chain.funcs.send == TCGS_Interface_Virtual_Funcs.send);
+
+	TCGS_Layer_Metrics(&layers[0], &metrics);
+	TCGS_Layer_Retry(&layers[1], &retry, 2, 0, 0);
+	//faults are injected before commands reach TPer, any command may be sent again
+	retry.retryable = RetryAll;
+	TCGS_Layer_Fault(&layers[2], &fault, 3, INTERFACE_ERROR_DATA_PROTECTION);
+	assert_int_equal(TCGS_InterfaceChain_Init(&chain, &TCGS_Interface_Virtual_Funcs, layers, 3), ERROR_SUCCESS);
+	TCGS_Layer_Metrics(&layers[0], &outerMetrics);
+	assert_int_equal(TCGS_InterfaceChain_Init(&outer, &chain.funcs, layers, 1), ERROR_SUCCESS);
+	assert_int_equal(outer.layerCount, 4);
+	assert_true(outer.backend == TCGS_Interface_Virtual_Funcs.send);
+
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &outer.funcs, &tper);
+	assert_int_equal(TCGS_Device_Level0Discovery(&device, recorded), ERROR_SUCCESS);
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			VTPER_MSID, strlen(VTPER_MSID), TRUE, &status), ERROR_SUCCESS);
+	assert_int_equal(TCGS_EndSession(&session), ERROR_SUCCESS);
+	TCGS_Device_Destroy(&device);
+
+	//every third command failed and was retried, layers above retry saw no failure
+	assert_true(fault.injected > 0);
+	assert_int_equal(retry.retries, fault.injected);
+	assert_int_equal(metrics.errors, 0);
+	assert_int_equal(metrics.commands + fault.injected, fault.count);
+	assert_int_equal(outerMetrics.commands, metrics.commands);
+
+	//by default ComPacket IF-SEND is not sent again, Level 0 Discovery is
+	TCGS_Layer_Retry(&layers[0], &retry, 2, 1000, 4000);
+	TCGS_Layer_Fault(&layers[1], &fault, 1, INTERFACE_ERROR_DATA_PROTECTION);
+	assert_int_equal(TCGS_InterfaceChain_Init(&chain, &TCGS_Interface_Virtual_Funcs, layers, 2), ERROR_SUCCESS);
+	TCGS_Device_Init(&device, &chain.funcs, &tper);
+	TCGS_PrepareInterfaceCommand(LEVEL0_DISCOVERY, NULL, &commandBlock, NULL);
+	assert_int_equal(TCGS_Device_SendCommand(&device, &commandBlock, NULL, &error, recorded), ERROR_SUCCESS);
+	assert_int_equal(error, INTERFACE_ERROR_DATA_PROTECTION);
+	assert_int_equal(retry.retries, 2);
+	memset(recorded, 0, sizeof(recorded));
+	commandBlock.command = IF_SEND;
+	commandBlock.protocolId = 0x01;
+	commandBlock.comId = VTPER_BASE_COMID;
+	commandBlock.length = 1;
+	assert_int_equal(TCGS_Device_SendCommand(&device, &commandBlock, recorded, &error, NULL), ERROR_SUCCESS);
+	assert_int_equal(error, INTERFACE_ERROR_DATA_PROTECTION);
+	assert_int_equal(retry.retries, 2);
+	assert_int_equal(fault.injected, 4);
+	TCGS_Device_Destroy(&device);
+
+	//commands recorded by layer are replayed by layer, the backend isn't called
+	close(mkstemp(path));
+	assert_int_equal(TCGS_Capture_StartRecordLayer(path, &layers[0]), ERROR_SUCCESS);
+	assert_int_equal(TCGS_InterfaceChain_Init(&chain, &TCGS_Interface_Virtual_Funcs, layers, 1), ERROR_SUCCESS);
+	TCGS_PrepareInterfaceCommand(LEVEL0_DISCOVERY, NULL, &commandBlock, NULL);
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &chain.funcs, &tper);
+	assert_int_equal(TCGS_Device_SendCommand(&device, &commandBlock, NULL, &error, recorded), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Capture_StopRecord(), ERROR_SUCCESS);
+	TCGS_Device_Destroy(&device);
+
+	assert_int_equal(TCGS_Capture_OpenReplayLayer(path, CAPTURE_REPLAY_MAXIMUM_SPEED, &layers[0]), ERROR_SUCCESS);
+	TCGS_Layer_Fault(&layers[1], &fault, 1, INTERFACE_ERROR_DATA_PROTECTION);
+	assert_int_equal(TCGS_InterfaceChain_Init(&chain, &TCGS_Interface_Virtual_Funcs, layers, 2), ERROR_SUCCESS);
+	TCGS_Device_Init(&device, &chain.funcs, &tper);
+	memset(replayed, 0xFF, sizeof(replayed));
+	assert_int_equal(TCGS_Device_SendCommand(&device, &commandBlock, NULL, &error, replayed), ERROR_SUCCESS);
+	assert_int_equal(error, INTERFACE_ERROR_GOOD);
+	assert_memory_equal(recorded, replayed, sizeof(recorded));
+	assert_int_equal(fault.count, 0);
+	TCGS_Capture_CloseReplay();
+	TCGS_Device_Destroy(&device);
+	unlink(path);
+}
+
+//layer of slow drive: every command takes 20ms
+static TCGS_LayerVerdict_t SlowBefore(void *context, TCGS_LayerCommand_t *command)
+{
+	TCGS_Sleep(20 * TCGS_NSEC_PER_MSEC);
+	return LAYER_CONTINUE;
+}
+
+typedef struct
+{
+	TCGS_Device_t  *device;
+	void           *payload;
+	uint8           buffer[TCGS_BLOCK_SIZE];
+	TCGS_Error_t    error;
+} SingleFlightRequest_t;
+
+static void *SingleFlightDiscovery(void *argument)
+{
+	SingleFlightRequest_t *request = argument;
+
+	request->error = TCGS_Device_Level0Discovery(request->device, request->buffer);
+	return NULL;
+}
+
+//read-only command of Level 0 Discovery with input payload of the request
+static void *SingleFlightPayload(void *argument)
+{
+	SingleFlightRequest_t *request = argument;
+	TCGS_CommandBlock_t commandBlock = {IF_RECV, 0x01, 1, 0x0001};
+	TCGS_InterfaceError_t error;
+
+	request->error = TCGS_Device_SendCommand(request->device, &commandBlock, request->payload,
+			&error, request->buffer);
+	return NULL;
+}
+
+/**
+ * \brief Test for single-flight layer: concurrent Level 0 Discoveries of a
+ * device are sent once, commands with different payloads and ComPackets are
+ * not coalesced
+ */
+void test_tcgs_single_flight(void **state)
+{
+	static TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t session;
+	TCGS_InterfaceChain_t chain;
+	TCGS_InterfaceLayer_t layers[3];
+	TCGS_LayerSingleFlight_t singleFlight;
+	TCGS_LayerMetrics_t metrics;
+	SingleFlightRequest_t requests[4];
+	pthread_t threads[4];
+	uint8 payloads[2][TCGS_BLOCK_SIZE];
+	uint64 coalesced;
+	uint32 i;
+
+	TCGS_Layer_SingleFlight(&layers[0], &singleFlight);
+	TCGS_Layer_Metrics(&layers[1], &metrics);
+	memset(&layers[2], 0, sizeof(layers[2]));
+	layers[2].before = SlowBefore;
+	assert_int_equal(TCGS_InterfaceChain_Init(&chain, &TCGS_Interface_Virtual_Funcs, layers, 3), ERROR_SUCCESS);
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &chain.funcs, &tper);
+
+	for (i = 0; i < 4; i++)
+	{
+		requests[i].device = &device;
+		requests[i].payload = NULL;
+		assert_int_equal(pthread_create(&threads[i], NULL, SingleFlightDiscovery, &requests[i]), 0);
+	}
+	for (i = 0; i < 4; i++)
+	{
+		pthread_join(threads[i], NULL);
+		assert_int_equal(requests[i].error, ERROR_SUCCESS);
+		assert_memory_equal(requests[i].buffer, requests[0].buffer, TCGS_BLOCK_SIZE);
+	}
+	assert_int_equal(singleFlight.sent + singleFlight.coalesced, 4);
+	assert_true(singleFlight.coalesced > 0);
+	assert_int_equal(metrics.commands, singleFlight.sent);
+	assert_true(TCGS_GetLevel0DiscoveryFeatureLockingHeader((TCGS_Level0Discovery_Header_t*)requests[3].buffer) != NULL);
+
+	//same command block with different payloads is sent twice
+	memset(payloads, 0, sizeof(payloads));
+	payloads[1][TCGS_BLOCK_SIZE - 1] = 1;
+	coalesced = singleFlight.coalesced;
+	for (i = 0; i < 2; i++)
+	{
+		requests[i].payload = payloads[i];
+		assert_int_equal(pthread_create(&threads[i], NULL, SingleFlightPayload, &requests[i]), 0);
+	}
+	for (i = 0; i < 2; i++)
+	{
+		pthread_join(threads[i], NULL);
+		assert_int_equal(requests[i].error, ERROR_SUCCESS);
+	}
+	assert_int_equal(singleFlight.sent + singleFlight.coalesced, 6);
+	assert_int_equal(singleFlight.coalesced, coalesced);
+	assert_int_equal(metrics.commands, singleFlight.sent);
+
+	//session commands pass the layer as is
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, NULL, NULL, 0, FALSE, NULL),
+			ERROR_SUCCESS);
+	assert_int_equal(TCGS_EndSession(&session), ERROR_SUCCESS);
+	assert_int_equal(singleFlight.sent + singleFlight.coalesced, 6);
+	assert_true(metrics.commands > singleFlight.sent);
+	TCGS_Device_Destroy(&device);
+	TCGS_Layer_SingleFlightDestroy(&singleFlight);
+}
+
+/*
+ * Layer of hung drive: IF-RECV of ComPackets reports that the response is
+ * not ready while stall is set
+ */
+static TCGS_LayerVerdict_t StallBefore(void *context, TCGS_LayerCommand_t *command)
+{
+	TCGS_ComPacketHeader_t *comPacket = command->outputPayload;
+
+	if (!*(bool*)context || command->commandBlock->command != IF_RECV ||
+		!TCGS_IsComPacketCommand(command->commandBlock))
+	{
+		return LAYER_CONTINUE;
+	}
+	memset(comPacket, 0, TCGS_GetTransferLength(command->commandBlock));
+	comPacket->outstandingData[3] = 1;
+	*command->interfaceError = INTERFACE_ERROR_GOOD;
+	command->status = ERROR_SUCCESS;
+	return LAYER_COMPLETE;
+}
+
+/**
+ * \brief Test for deadline and cancellation of operation: interrupted
+ * session is closed with End of Session or with Stack Reset of hung TPer
+ */
+void test_tcgs_operation_deadline(void **state)
+{
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t session;
+	TCGS_MethodStatus_t status;
+	TCGS_InterfaceChain_t chain;
+	TCGS_InterfaceLayer_t layer = {StallBefore, NULL, NULL};
+	TCGS_Operation_t operation, nested;
+	TCGS_Parser_t results;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	bool stall = FALSE;
+	uint32 sendCount;
+	uint64 start;
+
+	layer.context = &stall;
+	assert_int_equal(TCGS_InterfaceChain_Init(&chain, &TCGS_Interface_Virtual_Funcs, &layer, 1), ERROR_SUCCESS);
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &chain.funcs, &tper);
+	assert_int_equal(TCGS_Device_Level0Discovery(&device, buffer), ERROR_SUCCESS);
+
+	//hung TPer: the method times out, the drained response never comes, ComID is reset
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, NULL,
+			NULL, 0, FALSE, &status), ERROR_SUCCESS);
+	assert_true(tper.sessions[0].open);
+	stall = TRUE;
+	TCGS_Operation_Init(&operation, 5 * TCGS_NSEC_PER_MSEC);
+	TCGS_Operation_Begin(&operation);
+	start = TCGS_GetTime();
+	assert_int_equal(TCGS_Get(&session, &TCGS_UID_C_PIN_MSID, 3, 3, &results, &status), ERROR_TIMEOUT);
+	assert_true(TCGS_GetTime() - start < TCGS_OPERATION_CLEANUP_TIMEOUT * TCGS_NSEC_PER_MSEC);
+	assert_int_equal(TCGS_Operation_Check(), ERROR_TIMEOUT);
+	TCGS_Operation_End(&operation);
+	assert_int_equal(TCGS_Operation_Check(), ERROR_SUCCESS);
+	assert_false(session.open);
+	assert_false(tper.sessions[0].open);
+	stall = FALSE;
+
+	//cancelled enclosing operation: nothing is sent but End of Session
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, NULL,
+			NULL, 0, FALSE, &status), ERROR_SUCCESS);
+	TCGS_Operation_Init(&operation, 0);
+	TCGS_Operation_Begin(&operation);
+	TCGS_Operation_Init(&nested, 0);
+	TCGS_Operation_Begin(&nested);
+	assert_int_equal(TCGS_Operation_Remaining(), TCGS_OPERATION_UNLIMITED);
+	TCGS_Operation_Cancel(&operation);
+	sendCount = tper.sendCount;
+	assert_int_equal(TCGS_Get(&session, &TCGS_UID_C_PIN_MSID, 3, 3, &results, &status), ERROR_CANCELLED);
+	assert_int_equal(tper.sendCount, sendCount + 1);
+	assert_false(session.open);
+	assert_false(tper.sessions[0].open);
+	assert_int_equal(TCGS_Operation_Sleep(TCGS_NSEC_PER_SEC), ERROR_CANCELLED);
+	TCGS_Operation_End(&nested);
+	TCGS_Operation_End(&operation);
+
+	TCGS_Device_Destroy(&device);
+}
+
+static void BuildGetMSID(TCGS_Builder_t *builder, void *context)
+{
+	TCGS_Builder_AddGet(builder, &TCGS_UID_C_PIN_MSID, 3, 3);
+}
+
+static void BuildRevert(TCGS_Builder_t *builder, void *context)
+{
+	TCGS_Builder_StartCall(builder, &TCGS_UID_AdminSP, &TCGS_UID_Method_Revert);
+	TCGS_Builder_EndCall(builder);
+}
+
+/**
+ * \brief Test for retry policy: transient interface errors are replayed,
+ * dropped session is reopened and authenticated, non-idempotent methods
+ * are not replayed
+ */
+void test_tcgs_retry_policy(void **state)
+{
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t session;
+	TCGS_MethodStatus_t status;
+	TCGS_InterfaceChain_t chain;
+	TCGS_InterfaceLayer_t layer;
+	TCGS_LayerFault_t fault;
+	TCGS_RetryPolicy_t policy;
+	TCGS_Parser_t results;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	uint32 i;
+
+	assert_int_equal(TCGS_RetryPolicy_Classify(&device, ERROR_METHOD, METHOD_STATUS_SP_BUSY), RETRY_ACTION_REPLAY);
+	assert_int_equal(TCGS_RetryPolicy_Classify(&device, ERROR_METHOD, METHOD_STATUS_NOT_AUTHORIZED), RETRY_ACTION_NONE);
+	assert_int_equal(TCGS_RetryPolicy_Classify(&device, ERROR_SESSION, METHOD_STATUS_SUCCESS), RETRY_ACTION_REOPEN);
+	assert_int_equal(TCGS_RetryPolicy_Classify(&device, ERROR_TIMEOUT, METHOD_STATUS_SUCCESS), RETRY_ACTION_NONE);
+	device.interfaceError = INTERFACE_ERROR_DATA_PROTECTION;
+	assert_int_equal(TCGS_RetryPolicy_Classify(&device, ERROR_INTERFACE, METHOD_STATUS_SUCCESS), RETRY_ACTION_NONE);
+	device.interfaceError = INTERFACE_ERROR_SYNCHRONOUS_PROTOCOL_VIOLATION;
+	assert_int_equal(TCGS_RetryPolicy_Classify(&device, ERROR_INTERFACE, METHOD_STATUS_SUCCESS), RETRY_ACTION_REPLAY);
+
+	TCGS_Layer_Fault(&layer, &fault, 0, INTERFACE_ERROR_SYNCHRONOUS_PROTOCOL_VIOLATION);
+	assert_int_equal(TCGS_InterfaceChain_Init(&chain, &TCGS_Interface_Virtual_Funcs, &layer, 1), ERROR_SUCCESS);
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &chain.funcs, &tper);
+	assert_int_equal(TCGS_Device_Level0Discovery(&device, buffer), ERROR_SUCCESS);
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			VTPER_MSID, strlen(VTPER_MSID), TRUE, &status), ERROR_SUCCESS);
+
+	TCGS_RetryPolicy_Init(&policy, 3, TCGS_NSEC_PER_USEC, 10 * TCGS_NSEC_PER_USEC);
+	fault.period = 3;
+	for (i = 0; i < 4; i++)
+	{
+		assert_int_equal(TCGS_RetryPolicy_Call(&policy, &session, VTPER_MSID, strlen(VTPER_MSID),
+				BuildGetMSID, NULL, &results, &status), ERROR_SUCCESS);
+	}
+	assert_true(fault.injected > 0);
+	assert_int_equal(policy.retries, fault.injected);
+	assert_int_equal(policy.reopens, 0);
+	fault.period = 0;
+
+	//session dropped by power cycle is started again with SID authority
+	TCGS_VTPer_PowerCycle(&tper);
+	assert_int_equal(TCGS_RetryPolicy_Call(&policy, &session, VTPER_MSID, strlen(VTPER_MSID),
+			BuildGetMSID, NULL, &results, &status), ERROR_SUCCESS);
+	assert_int_equal(policy.reopens, 1);
+	assert_true(session.open);
+	assert_true(memcmp(&session.authority, &TCGS_UID_SID, sizeof(TCGS_UID_t)) == 0);
+
+	//Revert lost with the session is not sent again
+	TCGS_VTPer_PowerCycle(&tper);
+	assert_int_equal(TCGS_RetryPolicy_Call(&policy, &session, VTPER_MSID, strlen(VTPER_MSID),
+			BuildRevert, NULL, NULL, &status), ERROR_SESSION);
+	assert_int_equal(policy.reopens, 1);
+	assert_false(session.open);
+
+	TCGS_Device_Destroy(&device);
+}
+
+typedef struct
+{
+	uint32           order[8];
+	volatile uint32  count;
+	volatile uint32  running;
+	volatile uint32  maxRunning;
+	volatile bool    flag;
+} SchedulerLog_t;
+
+typedef struct
+{
+	SchedulerLog_t  *log;
+	uint32           id;
+} SchedulerJobContext_t;
+
+static TCGS_Error_t ScheduledRecord(TCGS_Device_t *device, void *context)
+{
+	SchedulerJobContext_t *job = context;
+	uint32 running = __sync_add_and_fetch(&job->log->running, 1);
+	uint32 maxRunning;
+
+	do
+	{
+		maxRunning = job->log->maxRunning;
+	} while (running > maxRunning && !__sync_bool_compare_and_swap(&job->log->maxRunning, maxRunning, running));
+	job->log->order[__sync_fetch_and_add(&job->log->count, 1)] = job->id;
+	TCGS_Sleep(TCGS_NSEC_PER_MSEC);
+	__sync_fetch_and_sub(&job->log->running, 1);
+	return ERROR_SUCCESS;
+}
+
+//waits for the flag set by another job of the same worker
+static TCGS_Error_t ScheduledWaitFlag(TCGS_Device_t *device, void *context)
+{
+	SchedulerLog_t *log = context;
+	uint32 i;
+
+	for (i = 0; i < 1000 && !log->flag; i++)
+	{
+		TCGS_Sleep(TCGS_NSEC_PER_MSEC);
+	}
+	return log->flag ? ERROR_SUCCESS : ERROR_TIMEOUT;
+}
+
+static TCGS_Error_t ScheduledSetFlag(TCGS_Device_t *device, void *context)
+{
+	((SchedulerLog_t*)context)->flag = TRUE;
+	return ERROR_SUCCESS;
+}
+
+/**
+ * \brief Test for scheduler: classes are started by priority, idle worker
+ * steals jobs of busy one, adapter limits jobs in flight
+ */
+void test_tcgs_scheduler(void **state)
+{
+	TCGS_Scheduler_t scheduler;
+	TCGS_SchedulerQueue_t queues[3];
+	TCGS_SchedulerWorker_t workers[2];
+	TCGS_SchedulerAdapter_t adapter;
+	TCGS_SchedulerAdapter_t *adapters[3] = {&adapter, &adapter, &adapter};
+	TCGS_SchedulerJob_t jobs[5];
+	SchedulerJobContext_t contexts[5];
+	TCGS_SchedulerClass_t classes[5] = {SCHEDULER_CLASS_BULK, SCHEDULER_CLASS_BULK,
+			SCHEDULER_CLASS_ADMIN, SCHEDULER_CLASS_BULK, SCHEDULER_CLASS_LOCKING};
+	TCGS_Device_t devices[3];
+	SchedulerLog_t log, gate;
+	uint32 i;
+
+	//jobs queued before start run by class, then in order of submission
+	memset(&log, 0, sizeof(log));
+	TCGS_SchedulerAdapter_Init(&adapter, 1);
+	TCGS_Scheduler_Init(&scheduler, queues, devices, adapters, 1, workers, 1);
+	for (i = 0; i < 5; i++)
+	{
+		contexts[i].log = &log;
+		contexts[i].id = i;
+		TCGS_Scheduler_Submit(&scheduler, 0, &jobs[i], classes[i], ScheduledRecord, &contexts[i]);
+	}
+	assert_int_equal(scheduler.stats[SCHEDULER_CLASS_BULK].depth, 3);
+	assert_int_equal(TCGS_Scheduler_Start(&scheduler), ERROR_SUCCESS);
+	for (i = 0; i < 5; i++)
+	{
+		assert_int_equal(TCGS_Scheduler_Wait(&scheduler, &jobs[i]), ERROR_SUCCESS);
+	}
+	TCGS_Scheduler_Stop(&scheduler);
+	assert_int_equal(log.order[0], 4);
+	assert_int_equal(log.order[1], 2);
+	assert_int_equal(log.order[2], 0);
+	assert_int_equal(log.order[3], 1);
+	assert_int_equal(log.order[4], 3);
+	assert_int_equal(scheduler.stats[SCHEDULER_CLASS_BULK].depth, 0);
+	assert_int_equal(scheduler.stats[SCHEDULER_CLASS_BULK].started, 3);
+	assert_true(scheduler.stats[SCHEDULER_CLASS_BULK].maxWait >= scheduler.stats[SCHEDULER_CLASS_LOCKING].maxWait);
+
+	//devices 0 and 2 belong to worker 0, the job of one of them is stolen by worker 1
+	memset(&log, 0, sizeof(log));
+	TCGS_SchedulerAdapter_Init(&adapter, 2);
+	TCGS_Scheduler_Init(&scheduler, queues, devices, adapters, 3, workers, 2);
+	TCGS_Scheduler_Submit(&scheduler, 0, &jobs[0], SCHEDULER_CLASS_ADMIN, ScheduledWaitFlag, &log);
+	TCGS_Scheduler_Submit(&scheduler, 2, &jobs[1], SCHEDULER_CLASS_ADMIN, ScheduledSetFlag, &log);
+	assert_int_equal(TCGS_Scheduler_Start(&scheduler), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Scheduler_Wait(&scheduler, &jobs[0]), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Scheduler_Wait(&scheduler, &jobs[1]), ERROR_SUCCESS);
+	assert_int_equal(workers[0].stolen + workers[1].stolen, 1);
+
+	//one job in flight on adapter with limit 1
+	TCGS_SchedulerAdapter_Init(&adapter, 1);
+	for (i = 0; i < 4; i++)
+	{
+		TCGS_Scheduler_Submit(&scheduler, i % 2, &jobs[i], SCHEDULER_CLASS_ADMIN, ScheduledRecord, &contexts[i]);
+	}
+	for (i = 0; i < 4; i++)
+	{
+		assert_int_equal(TCGS_Scheduler_Wait(&scheduler, &jobs[i]), ERROR_SUCCESS);
+	}
+	TCGS_Scheduler_Stop(&scheduler);
+	assert_int_equal(log.maxRunning, 1);
+	assert_int_equal(workers[0].jobs + workers[1].jobs, 6);
+
+	//worker 0 has only bulk jobs, locking job of worker 1 gets the freed slot first
+	memset(&log, 0, sizeof(log));
+	memset(&gate, 0, sizeof(gate));
+	TCGS_SchedulerAdapter_Init(&adapter, 1);
+	TCGS_Scheduler_Init(&scheduler, queues, devices, adapters, 3, workers, 2);
+	assert_int_equal(TCGS_Scheduler_Start(&scheduler), ERROR_SUCCESS);
+	TCGS_Scheduler_Submit(&scheduler, 2, &jobs[0], SCHEDULER_CLASS_ADMIN, ScheduledWaitFlag, &gate);
+	for (i = 0; i < 1000 && adapter.inFlight == 0; i++)
+	{
+		TCGS_Sleep(TCGS_NSEC_PER_MSEC);
+	}
+	assert_int_equal(adapter.inFlight, 1);
+	for (i = 1; i < 4; i++)
+	{
+		TCGS_Scheduler_Submit(&scheduler, (i < 3) ? 0 : 1, &jobs[i],
+				(i < 3) ? SCHEDULER_CLASS_BULK : SCHEDULER_CLASS_LOCKING, ScheduledRecord, &contexts[i]);
+	}
+	gate.flag = TRUE;
+	for (i = 0; i < 4; i++)
+	{
+		assert_int_equal(TCGS_Scheduler_Wait(&scheduler, &jobs[i]), ERROR_SUCCESS);
+	}
+	TCGS_Scheduler_Stop(&scheduler);
+	assert_int_equal(log.count, 3);
+	assert_int_equal(log.order[0], 3);
+}
+
+static TCGS_VTPer_t lockdownTPers[3];
+
+/**
+ * \brief Test for lockdown: armed drives are locked in parallel, drive that
+ * lost its session starts a new one, failed drive is reported
+ */
+void test_tcgs_lockdown(void **state)
+{
+	static TCGS_LockdownDrive_t drives[3];
+	TCGS_Lockdown_t lockdown;
+	TCGS_Device_t devices[3];
+	TCGS_UID_t ranges[2] = {TCGS_UID_Locking_GlobalRange, TCGS_UID_Locking_Range1};
+	TCGS_VTPer_Object_t *object;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	uint32 missed, i;
+
+	for (i = 0; i < 3; i++)
+	{
+		TCGS_VTPer_InitInstance(&lockdownTPers[i]);
+		TCGS_Device_Init(&devices[i], &TCGS_Interface_Virtual_Funcs, &lockdownTPers[i]);
+		assert_int_equal(TCGS_Device_Level0Discovery(&devices[i], buffer), ERROR_SUCCESS);
+		assert_int_equal(TCGS_LockdownDrive_Init(&drives[i], &devices[i], &TCGS_UID_Admin1, "", 0, ranges, 2),
+				ERROR_SUCCESS);
+	}
+	TCGS_Lockdown_Init(&lockdown, drives, 3);
+	assert_int_equal(TCGS_Lockdown_Arm(&lockdown), ERROR_SUCCESS);
+	for (i = 0; i < 3; i++)
+	{
+		assert_int_equal(drives[i].state, LOCKDOWN_DRIVE_ARMED);
+		assert_int_equal(lockdownTPers[i].startSessionCount, 1);
+	}
+	//the prepared session is lost
+	TCGS_VTPer_PowerCycle(&lockdownTPers[2]);
+	assert_int_equal(TCGS_Lockdown_Fire(&lockdown, TCGS_NSEC_PER_SEC, &missed), ERROR_SUCCESS);
+	assert_int_equal(missed, 0);
+	TCGS_Lockdown_Destroy(&lockdown);
+	for (i = 0; i < 3; i++)
+	{
+		assert_int_equal(drives[i].state, LOCKDOWN_DRIVE_CONFIRMED);
+		assert_true(drives[i].latency <= TCGS_NSEC_PER_SEC);
+		object = TCGS_VTPer_FindObject(&lockdownTPers[i], &TCGS_UID_Locking_Range1);
+		assert_int_equal(object->columns[TCGS_COLUMN_LOCKING_READ_LOCKED].value, 1);
+		assert_int_equal(object->columns[TCGS_COLUMN_LOCKING_WRITE_LOCKED].value, 1);
+		assert_false(drives[i].session.open);
+	}
+	assert_false(drives[0].rearmed);
+	assert_true(drives[2].rearmed);
+
+	//drive with wrong credential fails to arm and to lock
+	assert_int_equal(TCGS_LockdownDrive_Init(&drives[1], &devices[1], &TCGS_UID_Admin1, "wrong", 5, ranges, 2),
+			ERROR_SUCCESS);
+	TCGS_Lockdown_Init(&lockdown, drives, 3);
+	assert_int_equal(TCGS_Lockdown_Arm(&lockdown), ERROR_METHOD);
+	assert_int_equal(drives[1].state, LOCKDOWN_DRIVE_IDLE);
+	assert_int_equal(TCGS_Lockdown_Fire(&lockdown, TCGS_NSEC_PER_SEC, &missed), ERROR_METHOD);
+	assert_int_equal(missed, 0);
+	TCGS_Lockdown_Destroy(&lockdown);
+	assert_int_equal(drives[0].state, LOCKDOWN_DRIVE_CONFIRMED);
+	assert_int_equal(drives[1].state, LOCKDOWN_DRIVE_FAILED);
+	assert_int_equal(drives[1].error, ERROR_METHOD);
+	for (i = 0; i < 3; i++)
+	{
+		TCGS_Device_Destroy(&devices[i]);
+	}
+}
+
+/**
+ * \brief Test for resume unlock: locked drive is unlocked with credential
+ * from kernel keyring, unlocked drive is skipped
+ */
+void test_tcgs_resume(void **state)
+{
+	static TCGS_VTPer_t tpers[2];
+	static TCGS_ResumeDrive_t drives[2], found;
+	TCGS_Device_t devices[2];
+	TCGS_Session_t session;
+	TCGS_VTPer_Object_t *object;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	uint8 zero[TCGS_MAX_CREDENTIAL_LENGTH];
+	uint8 longKey[TCGS_MAX_CREDENTIAL_LENGTH + 8];
+	uint32 i;
+
+	for (i = 0; i < 2; i++)
+	{
+		TCGS_VTPer_InitInstance(&tpers[i]);
+		TCGS_Device_Init(&devices[i], &TCGS_Interface_Virtual_Funcs, &tpers[i]);
+		assert_int_equal(TCGS_Device_Level0Discovery(&devices[i], buffer), ERROR_SUCCESS);
+		assert_int_equal(TCGS_ResumeDrive_Init(&drives[i], &devices[i], &TCGS_UID_Admin1,
+				&TCGS_UID_Locking_Range1, 1), ERROR_SUCCESS);
+	}
+	//the first drive has Range1 locked and shadow MBR shown after power cycle
+	assert_int_equal(TCGS_StartSession(&session, &devices[0], &TCGS_UID_LockingSP, &TCGS_UID_Admin1,
+			"", 0, TRUE, NULL), ERROR_SUCCESS);
+	assert_int_equal(TCGS_SetUInt(&session, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_READ_LOCK_ENABLED, 1, NULL),
+			ERROR_SUCCESS);
+	assert_int_equal(TCGS_SetUInt(&session, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_WRITE_LOCK_ENABLED, 1, NULL),
+			ERROR_SUCCESS);
+	assert_int_equal(TCGS_SetUInt(&session, &TCGS_UID_MBRControl, TCGS_COLUMN_MBRCONTROL_ENABLE, 1, NULL),
+			ERROR_SUCCESS);
+	assert_int_equal(TCGS_SetBytes(&session, &TCGS_UID_C_PIN_Admin1, TCGS_COLUMN_C_PIN_PIN, "resume-pin", 10, NULL),
+			ERROR_SUCCESS);
+	assert_int_equal(TCGS_EndSession(&session), ERROR_SUCCESS);
+	TCGS_VTPer_PowerCycle(&tpers[0]);
+
+	assert_int_equal(TCGS_Resume_StoreCredential(&drives[0], KEY_SPEC_PROCESS_KEYRING, "tcgs:test-resume",
+			"resume-pin", 10), ERROR_SUCCESS);
+	assert_int_equal(TCGS_ResumeDrive_Init(&found, &devices[0], &TCGS_UID_Admin1, &TCGS_UID_Locking_Range1, 1),
+			ERROR_SUCCESS);
+	assert_int_equal(TCGS_Resume_FindCredential(&found, KEY_SPEC_PROCESS_KEYRING, "tcgs:test-resume"), ERROR_SUCCESS);
+	assert_int_equal(found.key, drives[0].key);
+
+	assert_int_equal(TCGS_Resume_Unlock(drives, 2), ERROR_SUCCESS);
+	assert_true(drives[0].unlocked);
+	assert_false(drives[1].unlocked);
+	assert_int_equal(tpers[1].startSessionCount, 0);
+	object = TCGS_VTPer_FindObject(&tpers[0], &TCGS_UID_Locking_Range1);
+	assert_int_equal(object->columns[TCGS_COLUMN_LOCKING_READ_LOCKED].value, 0);
+	assert_int_equal(object->columns[TCGS_COLUMN_LOCKING_WRITE_LOCKED].value, 0);
+	object = TCGS_VTPer_FindObject(&tpers[0], &TCGS_UID_MBRControl);
+	assert_int_equal(object->columns[TCGS_COLUMN_MBRCONTROL_DONE].value, 1);
+	memset(zero, 0, sizeof(zero));
+	assert_memory_equal(drives[0].credential, zero, sizeof(zero));
+
+	//revoked key is not read, the drive stays locked
+	TCGS_Resume_RevokeCredential(&drives[0]);
+	TCGS_VTPer_PowerCycle(&tpers[0]);
+	assert_int_equal(TCGS_Resume_Unlock(drives, 2), ERROR_PARAMETER);
+	assert_int_equal(drives[0].error, ERROR_PARAMETER);
+	assert_int_equal(drives[1].error, ERROR_SUCCESS);
+
+	//key longer than the credential buffer is rejected, the buffer is cleared
+	//whether or not the kernel copied a part of the key
+	memset(longKey, 'k', sizeof(longKey));
+	memset(drives[0].credential, 'k', sizeof(drives[0].credential));
+	drives[0].key = (int)syscall(__NR_add_key, "user", "tcgs:test-resume-long", longKey, sizeof(longKey),
+			KEY_SPEC_PROCESS_KEYRING);
+	assert_true(drives[0].key > 0);
+	assert_int_equal(TCGS_Resume_Unlock(drives, 2), ERROR_PARAMETER);
+	assert_int_equal(drives[0].error, ERROR_PARAMETER);
+	assert_memory_equal(drives[0].credential, zero, sizeof(zero));
+	TCGS_Resume_RevokeCredential(&drives[0]);
+	for (i = 0; i < 2; i++)
+	{
+		TCGS_Device_Destroy(&devices[i]);
+	}
+}
+
+/**
+ * \brief Test for session with virtual TPer: StartSession, Get, Set, End of Session
+ */
+void test_tcgs_session_virtual(void **state)
+{
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t session;
+	TCGS_Parser_t results;
+	TCGS_MethodStatus_t status;
+	TCGS_Token_t token;
+
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &TCGS_Interface_Virtual_Funcs, &tper);
+	device.comId = VTPER_BASE_COMID;
+
+	//wrong credential
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			"wrong", 5, TRUE, &status), ERROR_METHOD);
+	assert_int_equal(status, METHOD_STATUS_NOT_AUTHORIZED);
+
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			VTPER_MSID, strlen(VTPER_MSID), TRUE, &status), ERROR_SUCCESS);
+	assert_true(session.open);
+	assert_int_equal(TCGS_Get(&session, &TCGS_UID_C_PIN_MSID, TCGS_COLUMN_C_PIN_PIN,
+			TCGS_COLUMN_C_PIN_PIN, &results, &status), ERROR_SUCCESS);
+	assert_true(TCGS_Parser_FindNamedValue(&results, TCGS_COLUMN_C_PIN_PIN, &token));
+	assert_int_equal(token.length, strlen(VTPER_MSID));
+	assert_memory_equal(token.data, VTPER_MSID, token.length);
+
+	assert_int_equal(TCGS_SetBytes(&session, &TCGS_UID_C_PIN_SID, TCGS_COLUMN_C_PIN_PIN,
+			"secret", 6, &status), ERROR_SUCCESS);
+	assert_int_equal(TCGS_EndSession(&session), ERROR_SUCCESS);
+	assert_false(session.open);
+
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			"secret", 6, FALSE, &status), ERROR_SUCCESS);
+	assert_int_equal(TCGS_EndSession(&session), ERROR_SUCCESS);
+	TCGS_Device_Destroy(&device);
+}
+
+static TCGS_Error_t test_pool_get_range(TCGS_Session_t *session, void *context)
+{
+	TCGS_Parser_t results;
+
+	return TCGS_Get(session, &TCGS_UID_Locking_GlobalRange, TCGS_COLUMN_LOCKING_RANGE_START,
+			TCGS_COLUMN_LOCKING_WRITE_LOCKED, &results, NULL);
+}
+
+/**
+ * \brief Test for session pool: reuse of idle session and recovery of lost one
+ */
+void test_tcgs_session_pool(void **state)
+{
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_SessionPool_t pool;
+	TCGS_Session_t *session;
+	uint8 longPin[TCGS_MAX_CREDENTIAL_LENGTH + 1];
+	int i;
+
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &TCGS_Interface_Virtual_Funcs, &tper);
+	device.comId = VTPER_BASE_COMID;
+	TCGS_SessionPool_Init(&pool, &device, 0);
+
+	for (i = 0; i < 5; i++)
+	{
+		assert_int_equal(TCGS_SessionPool_Run(&pool, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+				VTPER_MSID, strlen(VTPER_MSID), FALSE, test_pool_get_range, NULL), ERROR_SUCCESS);
+	}
+	assert_int_equal(tper.startSessionCount, 1);
+
+	//session held by a caller is not handed out twice
+	assert_int_equal(TCGS_SessionPool_Acquire(&pool, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			VTPER_MSID, strlen(VTPER_MSID), FALSE, &session), ERROR_SUCCESS);
+	assert_int_equal(TCGS_SessionPool_Run(&pool, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			VTPER_MSID, strlen(VTPER_MSID), FALSE, test_pool_get_range, NULL), ERROR_SUCCESS);
+	assert_int_equal(tper.startSessionCount, 2);
+	TCGS_SessionPool_Release(&pool, session);
+
+	//sessions die silently, pool replaces them
+	TCGS_VTPer_PowerCycle(&tper);
+	assert_int_equal(TCGS_SessionPool_Run(&pool, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			VTPER_MSID, strlen(VTPER_MSID), FALSE, test_pool_get_range, NULL), ERROR_SUCCESS);
+	assert_int_equal(tper.startSessionCount, 3);
+
+	//credential that doesn't fit the slot is an error of the caller
+	memset(longPin, 'p', sizeof(longPin));
+	assert_int_equal(TCGS_SessionPool_Acquire(&pool, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			longPin, sizeof(longPin), FALSE, &session), ERROR_PARAMETER);
+
+	TCGS_SessionPool_Destroy(&pool);
+	TCGS_Device_Destroy(&device);
+}
+
+/**
+ * \brief Test for PBKDF2 with RFC 6070 vectors and batch derivation on every hash engine
+ */
+void test_tcgs_pbkdf2(void **state)
+{
+	static const uint8 sha1Expected[20] =
+	{
+		0x4B, 0x00, 0x79, 0x01, 0xB7, 0x65, 0x48, 0x9A, 0xBE, 0xAD,
+		0x49, 0xD9, 0x26, 0xF7, 0x21, 0xD0, 0x65, 0xA4, 0x29, 0xC1,
+	};
+	static const uint8 sha256Expected[32] =
+	{
+		0xC5, 0xE4, 0x78, 0xD5, 0x92, 0x88, 0xC8, 0x41, 0xAA, 0x53, 0x0D, 0xB6, 0x84, 0x5C, 0x4C, 0x8D,
+		0x96, 0x28, 0x93, 0xA0, 0x01, 0xCE, 0x4E, 0x11, 0xA4, 0x96, 0x38, 0x73, 0xAA, 0x98, 0x13, 0x4A,
+	};
+	static const uint32 engines[] =
+	{
+		0, HASH_ACCELERATION_SHA_NI, HASH_ACCELERATION_AVX2, ~0U,
+	};
+	TCGS_Pbkdf2_Request_t requests[11];
+	uint8 key[32], keys[11][40], expected[11][40];
+	char salts[11][8];
+	uint32 i, engine;
+
+	assert_int_equal(TCGS_Pbkdf2(HASH_SHA1, "password", 8, "salt", 4, 4096, key, 20), ERROR_SUCCESS);
+	assert_memory_equal(key, sha1Expected, 20);
+	assert_int_equal(TCGS_Pbkdf2(HASH_SHA256, "password", 8, "salt", 4, 0, key, 32), ERROR_PARAMETER);
+
+	for (engine = 0; engine < sizeof(engines) / sizeof(engines[0]); engine++)
+	{
+		TCGS_Hash_SetAcceleration(engines[engine]);
+		assert_int_equal(TCGS_Pbkdf2(HASH_SHA256, "password", 8, "salt", 4, 4096, key, 32), ERROR_SUCCESS);
+		assert_memory_equal(key, sha256Expected, 32);
+
+		//keys of several blocks and partial last block
+		for (i = 0; i < 11; i++)
+		{
+			sprintf(salts[i], "drive%u", i);
+			requests[i].password = "passphrase";
+			requests[i].passwordLength = 10;
+			requests[i].salt = salts[i];
+			requests[i].saltLength = strlen(salts[i]);
+			requests[i].key = keys[i];
+			requests[i].keyLength = sizeof(keys[i]);
+			if (engine == 0)
+			{
+				TCGS_Pbkdf2(HASH_SHA256, "passphrase", 10, salts[i], strlen(salts[i]), 50,
+						expected[i], sizeof(expected[i]));
+			}
+		}
+		assert_int_equal(TCGS_Pbkdf2_Batch(HASH_SHA256, 50, requests, 11), ERROR_SUCCESS);
+		assert_memory_equal(keys, expected, sizeof(keys));
+	}
+	TCGS_Hash_SetAcceleration(~0U);
+}
+
+/**
+ * \brief Test for cache of derived credentials
+ */
+void test_tcgs_credential_cache(void **state)
+{
+	TCGS_CredentialRequest_t requests[3];
+	uint8 credential[32], expected[32];
+
+	TCGS_ClearCredentials();
+	assert_int_equal(TCGS_DeriveCredential(HASH_SHA256, 1000, "passphrase", 10, "SN0001", 6,
+			credential, 32), ERROR_SUCCESS);
+	TCGS_Pbkdf2(HASH_SHA256, "passphrase", 10, "SN0001", 6, 1000, expected, 32);
+	assert_memory_equal(credential, expected, 32);
+	if (TCGS_GetCachedCredentialCount() == 0)
+	{
+		//memory can't be locked in this environment, nothing is cached
+		return;
+	}
+	assert_int_equal(TCGS_GetCachedCredentialCount(), 1);
+
+	requests[0].passphrase = "passphrase";
+	requests[0].passphraseLength = 10;
+	requests[0].salt = "SN0001";
+	requests[0].saltLength = 6;
+	requests[1] = requests[0];
+	requests[1].salt = "SN0002";
+	requests[2] = requests[0];
+	requests[2].passphrase = "other";
+	requests[2].passphraseLength = 5;
+	assert_int_equal(TCGS_DeriveCredentials(HASH_SHA256, 1000, requests, 3, 32), ERROR_SUCCESS);
+	assert_memory_equal(requests[0].credential, expected, 32);
+	assert_int_equal(TCGS_GetCachedCredentialCount(), 3);
+
+	TCGS_ClearCredentials();
+	assert_int_equal(TCGS_GetCachedCredentialCount(), 0);
+}
+
+/**
+ * \brief Test for transaction: batching into ComPackets, results of calls, rollback
+ */
+void test_tcgs_transaction(void **state)
+{
+	static const TCGS_UID_t unknown = {{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x99, 0x99}};
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t session;
+	TCGS_Transaction_t transaction;
+	TCGS_TransactionCall_t get, encoded, sets[40];
+	TCGS_Builder_t builder;
+	TCGS_Parser_t results;
+	TCGS_Token_t token;
+	uint8 buffer[64], tokens[64];
+	uint32 i, sendCount;
+
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &TCGS_Interface_Virtual_Funcs, &tper);
+	device.comId = VTPER_BASE_COMID;
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, &TCGS_UID_SID,
+			VTPER_MSID, strlen(VTPER_MSID), TRUE, NULL), ERROR_SUCCESS);
+
+	//40 methods take two ComPackets, End Transaction the third one
+	sendCount = tper.sendCount;
+	assert_int_equal(TCGS_StartTransaction(&transaction, &session), ERROR_SUCCESS);
+	for (i = 0; i < 40; i++)
+	{
+		assert_int_equal(TCGS_Transaction_SetUInt(&transaction, &sets[i], &TCGS_UID_Locking_Range1,
+				TCGS_COLUMN_LOCKING_RANGE_START, i), ERROR_SUCCESS);
+	}
+	get.results = buffer;
+	get.resultsSize = sizeof(buffer);
+	assert_int_equal(TCGS_Transaction_Get(&transaction, &get, &TCGS_UID_Locking_Range1,
+			TCGS_COLUMN_LOCKING_RANGE_START, TCGS_COLUMN_LOCKING_RANGE_START), ERROR_SUCCESS);
+	//invocation encoded in advance
+	TCGS_Builder_Init(&builder, tokens, sizeof(tokens));
+	TCGS_Builder_AddGet(&builder, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_RANGE_START,
+			TCGS_COLUMN_LOCKING_RANGE_START);
+	memset(&encoded, 0, sizeof(encoded));
+	assert_int_equal(TCGS_Transaction_AddEncoded(&transaction, &encoded, tokens, builder.length), ERROR_SUCCESS);
+	assert_int_equal(TCGS_EndTransaction(&transaction, TRUE), ERROR_SUCCESS);
+	assert_int_equal(tper.sendCount - sendCount, 3);
+	assert_true(sets[39].done);
+	assert_int_equal(sets[39].status, METHOD_STATUS_SUCCESS);
+	assert_true(get.done);
+	TCGS_TransactionCall_GetResults(&get, &results);
+	assert_true(TCGS_Parser_FindNamedValue(&results, TCGS_COLUMN_LOCKING_RANGE_START, &token));
+	assert_int_equal(token.value, 39);
+	assert_true(encoded.done);
+	assert_int_equal(encoded.status, METHOD_STATUS_SUCCESS);
+	assert_int_equal(encoded.resultsLength, get.resultsLength);
+
+	//failed method aborts all changes
+	assert_int_equal(TCGS_StartTransaction(&transaction, &session), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Transaction_SetUInt(&transaction, &sets[0], &TCGS_UID_Locking_Range1,
+			TCGS_COLUMN_LOCKING_RANGE_START, 1000), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Transaction_SetUInt(&transaction, &sets[1], &unknown, 1, 1), ERROR_SUCCESS);
+	assert_int_equal(TCGS_EndTransaction(&transaction, TRUE), ERROR_METHOD);
+	assert_int_equal(sets[0].status, METHOD_STATUS_SUCCESS);
+	assert_int_not_equal(sets[1].status, METHOD_STATUS_SUCCESS);
+	assert_int_equal(TCGS_VTPer_FindObject(&tper, &TCGS_UID_Locking_Range1)->
+			columns[TCGS_COLUMN_LOCKING_RANGE_START].value, 39);
+
+	//failed exchange consumes its ComPacket, End Transaction only aborts
+	sendCount = tper.sendCount;
+	assert_int_equal(TCGS_StartTransaction(&transaction, &session), ERROR_SUCCESS);
+	get.results = buffer;
+	get.resultsSize = 2;
+	assert_int_equal(TCGS_Transaction_Get(&transaction, &get, &TCGS_UID_Locking_Range1,
+			TCGS_COLUMN_LOCKING_RANGE_START, TCGS_COLUMN_LOCKING_RANGE_START), ERROR_SUCCESS);
+	for (i = 0; i < 40; i++)
+	{
+		TCGS_Transaction_SetUInt(&transaction, &sets[i], &TCGS_UID_Locking_Range1,
+				TCGS_COLUMN_LOCKING_RANGE_START, 2000 + i);
+	}
+	assert_int_equal(TCGS_EndTransaction(&transaction, TRUE), ERROR_PARAMETER);
+	assert_int_equal(tper.sendCount - sendCount, 2);
+	assert_int_equal(TCGS_VTPer_FindObject(&tper, &TCGS_UID_Locking_Range1)->
+			columns[TCGS_COLUMN_LOCKING_RANGE_START].value, 39);
+
+	assert_int_equal(TCGS_EndSession(&session), ERROR_SUCCESS);
+	TCGS_Device_Destroy(&device);
+}
+
+/**
+ * \brief Test for table cache: hits cost no round trip, cache is dropped
+ * when locking state or session changes
+ */
+void test_tcgs_table_cache(void **state)
+{
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t session;
+	TCGS_TableCache_t cache;
+	TCGS_CommandBlock_t commandBlock;
+	TCGS_InterfaceError_t interfaceError;
+	uint8 output[TCGS_BLOCK_SIZE];
+	uint64 value;
+	uint32 sendCount;
+
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &TCGS_Interface_Virtual_Funcs, &tper);
+	device.comId = VTPER_BASE_COMID;
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_LockingSP, &TCGS_UID_Admin1,
+			"", 0, TRUE, NULL), ERROR_SUCCESS);
+	TCGS_TableCache_Init(&cache, &session);
+
+	//one Get fills the row
+	sendCount = tper.sendCount;
+	assert_int_equal(TCGS_TableCache_Prefetch(&cache, &TCGS_UID_Locking_Range1,
+			TCGS_COLUMN_LOCKING_RANGE_START, TCGS_COLUMN_LOCKING_WRITE_LOCKED), ERROR_SUCCESS);
+	assert_int_equal(TCGS_TableCache_GetUInt(&cache, &TCGS_UID_Locking_Range1,
+			TCGS_COLUMN_LOCKING_RANGE_LENGTH, &value), ERROR_SUCCESS);
+	assert_int_equal(TCGS_TableCache_GetUInt(&cache, &TCGS_UID_Locking_Range1,
+			TCGS_COLUMN_LOCKING_READ_LOCKED, &value), ERROR_SUCCESS);
+	assert_int_equal(value, 0);
+	assert_int_equal(tper.sendCount - sendCount, 1);
+	assert_int_equal(cache.hits, 2);
+
+	//Set goes to TPer and updates the cache
+	assert_int_equal(TCGS_TableCache_SetUInt(&cache, &TCGS_UID_Locking_Range1,
+			TCGS_COLUMN_LOCKING_READ_LOCK_ENABLED, 1), ERROR_SUCCESS);
+	assert_int_equal(TCGS_TableCache_GetUInt(&cache, &TCGS_UID_Locking_Range1,
+			TCGS_COLUMN_LOCKING_READ_LOCK_ENABLED, &value), ERROR_SUCCESS);
+	assert_int_equal(value, 1);
+	assert_int_equal(tper.sendCount - sendCount, 2);
+
+	//locking range locked behind the cache is reported by Level 0 Discovery
+	TCGS_PrepareInterfaceCommand(LEVEL0_DISCOVERY, NULL, &commandBlock, NULL);
+	assert_int_equal(TCGS_Device_SendCommand(&device, &commandBlock, NULL, &interfaceError, output), ERROR_SUCCESS);
+	assert_false(TCGS_TableCache_CheckLevel0Discovery(&cache, TCGS_DecodeLevel0Discovery(output)));
+	TCGS_VTPer_FindObject(&tper, &TCGS_UID_Locking_Range1)->columns[TCGS_COLUMN_LOCKING_READ_LOCKED].value = 1;
+	assert_int_equal(TCGS_Device_SendCommand(&device, &commandBlock, NULL, &interfaceError, output), ERROR_SUCCESS);
+	assert_true(TCGS_TableCache_CheckLevel0Discovery(&cache, TCGS_DecodeLevel0Discovery(output)));
+	sendCount = tper.sendCount;
+	assert_int_equal(TCGS_TableCache_GetUInt(&cache, &TCGS_UID_Locking_Range1,
+			TCGS_COLUMN_LOCKING_READ_LOCKED, &value), ERROR_SUCCESS);
+	assert_int_equal(value, 1);
+	assert_int_equal(tper.sendCount - sendCount, 1);
+
+	//lost session drops the cache
+	TCGS_VTPer_PowerCycle(&tper);
+	assert_int_not_equal(TCGS_TableCache_GetUInt(&cache, &TCGS_UID_Locking_Range1,
+			TCGS_COLUMN_LOCKING_RANGE_START, &value), ERROR_SUCCESS);
+	assert_int_not_equal(TCGS_TableCache_GetUInt(&cache, &TCGS_UID_Locking_Range1,
+			TCGS_COLUMN_LOCKING_READ_LOCKED, &value), ERROR_SUCCESS);
+	assert_false(session.open);
+	assert_int_equal(cache.rowCount, 0);
+
+	TCGS_Device_Destroy(&device);
+}
+
+/**
+ * \brief Test for enumeration of table rows in batches
+ */
+void test_tcgs_table_iterator(void **state)
+{
+	static TCGS_TableIterator_t iterator;
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t session, other;
+	TCGS_UID_t uid = TCGS_UID_Locking_Range1;
+	const TCGS_UID_t *row;
+	TCGS_Parser_t results;
+	struct
+	{
+		uint8 buffer[TCGS_BLOCK_SIZE + 100];
+		uint8 guard[TCGS_MAX_COMPACKET_SIZE];
+	} small;
+	uint32 i, rows, sendCount;
+
+	TCGS_VTPer_InitInstance(&tper);
+	for (i = 0; i < 100; i++)
+	{
+		uid.bytes[7] = (uint8)(i + 2);
+		assert_true(TCGS_VTPer_AddObject(&tper, &uid) != NULL);
+	}
+	TCGS_Device_Init(&device, &TCGS_Interface_Virtual_Funcs, &tper);
+	device.comId = VTPER_BASE_COMID;
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_LockingSP, &TCGS_UID_Admin1,
+			"", 0, TRUE, NULL), ERROR_SUCCESS);
+
+	//102 rows fit one ComPacket
+	sendCount = tper.sendCount;
+	assert_int_equal(TCGS_TableIterator_Start(&iterator, &session, &TCGS_UID_Table_Locking, 0), ERROR_SUCCESS);
+	for (rows = 0; TCGS_TableIterator_Next(&iterator, &row); rows++)
+	{
+		//rows point into the received ComPacket
+		assert_true((const uint8*)row > iterator.buffers[0] &&
+				(const uint8*)row < iterator.buffers[0] + sizeof(iterator.buffers[0]));
+	}
+	assert_int_equal(TCGS_TableIterator_End(&iterator), ERROR_SUCCESS);
+	assert_int_equal(rows, 102);
+	assert_int_equal(iterator.batchCount, 1);
+	assert_int_equal(tper.sendCount - sendCount, 1);
+
+	//small batches, session is used while the next batch is prefetched
+	assert_int_equal(TCGS_TableIterator_Start(&iterator, &session, &TCGS_UID_Table_Locking, 25), ERROR_SUCCESS);
+	assert_true(TCGS_TableIterator_Next(&iterator, &row));
+	assert_true(memcmp(row, &TCGS_UID_Locking_GlobalRange, sizeof(*row)) == 0);
+	assert_int_equal(TCGS_Get(&session, row, TCGS_COLUMN_LOCKING_RANGE_START,
+			TCGS_COLUMN_LOCKING_RANGE_START, &results, NULL), ERROR_SUCCESS);
+	for (rows = 1; TCGS_TableIterator_Next(&iterator, &row); rows++)
+	{
+	}
+	assert_int_equal(TCGS_TableIterator_End(&iterator), ERROR_SUCCESS);
+	assert_int_equal(rows, 102);
+	assert_int_equal(iterator.batchCount, 5);
+	assert_true(memcmp(row->bytes, uid.bytes, sizeof(uid)) == 0);
+
+	//another session of the device reads the prefetched batch for the iterator
+	assert_int_equal(TCGS_StartSession(&other, &device, &TCGS_UID_LockingSP, NULL, NULL, 0, FALSE, NULL),
+			ERROR_SUCCESS);
+	assert_int_equal(TCGS_TableIterator_Start(&iterator, &session, &TCGS_UID_Table_Locking, 50), ERROR_SUCCESS);
+	assert_true(TCGS_TableIterator_Next(&iterator, &row));
+	assert_true(device.pendingSession == &session);
+	assert_int_equal(TCGS_Get(&other, &TCGS_UID_Locking_GlobalRange, TCGS_COLUMN_LOCKING_RANGE_START,
+			TCGS_COLUMN_LOCKING_RANGE_START, &results, NULL), ERROR_SUCCESS);
+	assert_true(device.pendingSession == NULL);
+	for (rows = 1; TCGS_TableIterator_Next(&iterator, &row); rows++)
+	{
+	}
+	assert_int_equal(TCGS_TableIterator_End(&iterator), ERROR_SUCCESS);
+	assert_int_equal(rows, 102);
+	assert_int_equal(TCGS_EndSession(&other), ERROR_SUCCESS);
+
+	//abandoned enumeration releases the device
+	assert_int_equal(TCGS_TableIterator_Start(&iterator, &session, &TCGS_UID_Table_Locking, 10), ERROR_SUCCESS);
+	assert_true(TCGS_TableIterator_Next(&iterator, &row));
+	assert_int_equal(TCGS_TableIterator_End(&iterator), ERROR_SUCCESS);
+
+	//response is read in whole blocks that fit the buffer of the caller
+	memset(&small, 0xA5, sizeof(small));
+	TCGS_Builder_AddGet(TCGS_Session_StartPacket(&session), &TCGS_UID_Locking_GlobalRange,
+			TCGS_COLUMN_LOCKING_RANGE_START, TCGS_COLUMN_LOCKING_RANGE_START);
+	assert_int_equal(TCGS_Session_Send(&session, small.buffer, sizeof(small.buffer)), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Session_Receive(&session, &results), ERROR_SUCCESS);
+	assert_true(results.length > 0);
+	for (i = 0; i < sizeof(small.guard); i++)
+	{
+		assert_int_equal(small.guard[i], 0xA5);
+	}
+	TCGS_Builder_AddGet(TCGS_Session_StartPacket(&session), &TCGS_UID_Locking_GlobalRange,
+			TCGS_COLUMN_LOCKING_RANGE_START, TCGS_COLUMN_LOCKING_RANGE_START);
+	assert_int_equal(TCGS_Session_Send(&session, small.buffer, TCGS_BLOCK_SIZE - 1), ERROR_PARAMETER);
+	assert_int_equal(TCGS_EndSession(&session), ERROR_SUCCESS);
+	TCGS_Device_Destroy(&device);
+}
+
+/**
+ * \brief Test for lookups of UID catalog
+ */
+void test_tcgs_uid_catalog(void **state)
+{
+	static const TCGS_UID_t unknown = {{0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x99, 0x99}};
+	const TCGS_UIDCatalogEntry_t *entry;
+	uint32 i;
+
+	for (i = 0; i < TCGS_UIDCatalog_Size; i++)
+	{
+		assert_true(TCGS_UIDCatalog_FindName(TCGS_UIDCatalog[i].name) == &TCGS_UIDCatalog[i]);
+		assert_true(TCGS_UIDCatalog_FindUID(&TCGS_UIDCatalog[i].uid) == &TCGS_UIDCatalog[i]);
+	}
+
+	entry = TCGS_UIDCatalog_FindName("Locking_Range1");
+	assert_true(entry != NULL);
+	assert_int_equal(entry->kind, UID_KIND_OBJECT);
+	assert_true(memcmp(&entry->uid, &TCGS_UID_Locking_Range1, sizeof(TCGS_UID_t)) == 0);
+	assert_string_equal(TCGS_UIDCatalog_FindUID(&TCGS_UID_Method_Get)->name, "Method_Get");
+	assert_string_equal(TCGS_UIDCatalog_FindUID(&TCGS_UID_C_PIN_MSID)->name, "C_PIN_MSID");
+	assert_string_equal(TCGS_UIDCatalog_FindUID(&TCGS_UID_Table_Locking)->name, "Table_Locking");
+
+	assert_true(TCGS_UIDCatalog_FindName("Locking_Range9") == NULL);
+	assert_true(TCGS_UIDCatalog_FindName("") == NULL);
+	assert_true(TCGS_UIDCatalog_FindUID(&unknown) == NULL);
+
+	for (i = 0; i < TCGS_FeatureCatalog_Size; i++)
+	{
+		assert_true(TCGS_FeatureCatalog_FindCode(TCGS_FeatureCatalog[i].code) == &TCGS_FeatureCatalog[i]);
+	}
+	assert_string_equal(TCGS_FeatureCatalog_FindCode(FEATURE_OPAL2)->name, "OPAL2");
+	assert_string_equal(TCGS_Format_FeatureName(FEATURE_ENTERPRISE), "ENTERPRISE");
+	assert_true(TCGS_FeatureCatalog_FindCode(0x0204) == NULL);
+}
+
+//grows buffer of formatter once to static buffer
+static bool FormatGrow(TCGS_Formatter_t *formatter, uint32 capacity, void *context)
+{
+	static char large[4096];
+
+	if (formatter->buffer == large || capacity > sizeof(large))
+	{
+		return FALSE;
+	}
+	memcpy(large, formatter->buffer, formatter->length);
+	formatter->buffer = large;
+	formatter->capacity = sizeof(large);
+	(*(uint32*)context)++;
+	return TRUE;
+}
+
+/**
+ * \brief Test for formatter: Level 0 Discovery and method results as JSON
+ * and text, truncation, grown buffer and writev of many formatters
+ */
+void test_tcgs_format(void **state)
+{
+	static TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Formatter_t formatters[2], small;
+	TCGS_Parser_t results;
+	TCGS_CommandBlock_t commandBlock = {IF_RECV, 0x01, 1, 0x07FE};
+	uint8 discovery[TCGS_BLOCK_SIZE];
+	uint8 tokens[32] = {0xF0, 0xF2, 0x03, 0x01, 0xF3, 0xF2, 0x04, 0xA8};
+	char buffers[2][2048], tiny[16], text[4096];
+	uint32 grown = 0, length = 0;
+	int fds[2];
+	ssize_t n;
+	const char expected[] = "{\"status\":0,\"values\":[[{\"3\":1},{\"4\":\"Locking_Range1\"}]]}\n";
+
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &TCGS_Interface_Virtual_Funcs, &tper);
+	assert_int_equal(TCGS_Device_Level0Discovery(&device, discovery), ERROR_SUCCESS);
+
+	//result of Get: list of named values, UID is formatted by name
+	memcpy(tokens + 8, TCGS_UID_Locking_Range1.bytes, sizeof(TCGS_UID_t));
+	tokens[16] = 0xF3;
+	tokens[17] = 0xF1;
+	TCGS_Parser_Init(&results, tokens, 18);
+	TCGS_Formatter_Init(&formatters[0], buffers[0], sizeof(buffers[0]), FORMAT_JSON);
+	TCGS_Format_Result(&formatters[0], NULL, &results, METHOD_STATUS_SUCCESS);
+	assert_int_equal(formatters[0].length, strlen(expected));
+	assert_memory_equal(formatters[0].buffer, expected, strlen(expected));
+
+	TCGS_Formatter_Init(&formatters[1], buffers[1], sizeof(buffers[1]), FORMAT_TEXT);
+	TCGS_Format_BeginObject(&formatters[1], NULL);
+	TCGS_Format_Command(&formatters[1], "command", &commandBlock);
+	TCGS_Format_Level0Discovery(&formatters[1], "discovery", (TCGS_Level0Discovery_Header_t*)discovery);
+	TCGS_Format_EndObject(&formatters[1]);
+	assert_false(formatters[1].truncated);
+
+	//both formatters are written by one writev and reset
+	assert_int_equal(pipe(fds), 0);
+	assert_int_equal(TCGS_Formatter_Writev(fds[1], formatters, 2), ERROR_SUCCESS);
+	assert_int_equal(formatters[0].length, 0);
+	assert_int_equal(formatters[1].length, 0);
+	close(fds[1]);
+	while ((n = read(fds[0], text + length, sizeof(text) - 1 - length)) > 0)
+	{
+		length += n;
+	}
+	close(fds[0]);
+	text[length] = '\0';
+	assert_true(strncmp(text, expected, strlen(expected)) == 0);
+	assert_true(strstr(text, "\ncommand:\n  command:              IF_RECV\n") != NULL);
+	assert_true(strstr(text, "\n      name:             LOCKING\n") != NULL);
+	assert_true(strstr(text, "\n      locked:           false\n") != NULL);
+
+	//output that doesn't fit is dropped, a grown buffer keeps it
+	TCGS_Formatter_Init(&small, tiny, sizeof(tiny), FORMAT_JSON);
+	TCGS_Format_Level0Discovery(&small, NULL, (TCGS_Level0Discovery_Header_t*)discovery);
+	assert_true(small.truncated);
+	assert_true(small.length <= sizeof(tiny));
+	TCGS_Formatter_Init(&small, tiny, sizeof(tiny), FORMAT_JSON);
+	TCGS_Formatter_SetGrow(&small, FormatGrow, &grown);
+	TCGS_Format_Level0Discovery(&small, NULL, (TCGS_Level0Discovery_Header_t*)discovery);
+	assert_false(small.truncated);
+	assert_int_equal(grown, 1);
+	assert_true(small.length > sizeof(tiny));
+	assert_int_equal(small.buffer[small.length - 1], '\n');
+	TCGS_Device_Destroy(&device);
+}
+
+static void *ArbiterEndLease(void *device)
+{
+	return (void*)(size_t)TCGS_Arbiter_EndLease(device);
+}
+
+//masks byte atoms other than UIDs, counts tokens it is called for
+static bool FormatSecret(const TCGS_Token_t *token, void *context)
+{
+	(*(uint32*)context)++;
+	return token->type == TOKEN_TYPE_BYTES && token->length != sizeof(TCGS_UID_t);
+}
+
+/**
+ * \brief Test for formatter of token streams: control tokens by names,
+ * credentials masked, lists left open by the stream closed
+ */
+void test_tcgs_format_tokens(void **state)
+{
+	TCGS_Formatter_t formatter;
+	TCGS_Parser_t parser;
+	uint8 tokens[32] = {0xF8, 0xA8};
+	const uint8 tail[] = {0xF0, 0xF2, 0x00, 0xA2, 'p', 'w', 0xF3, 0xF1, 0xF9, 0xF0, 0x05};
+	char buffer[256];
+	uint32 calls = 0;
+	const char expected[] = "[\"CALL\",\"Locking_Range1\",[{\"0\":\"<secret>\"}],\"EOD\",[5]]\n";
+
+	memcpy(tokens + 2, TCGS_UID_Locking_Range1.bytes, sizeof(TCGS_UID_t));
+	memcpy(tokens + 10, tail, sizeof(tail));
+	TCGS_Parser_Init(&parser, tokens, 10 + sizeof(tail));
+	TCGS_Formatter_Init(&formatter, buffer, sizeof(buffer), FORMAT_JSON);
+	TCGS_Format_Tokens(&formatter, NULL, &parser, FormatSecret, &calls);
+	assert_int_equal(calls, 11);
+	assert_int_equal(formatter.depth, 0);
+	assert_int_equal(formatter.length, strlen(expected));
+	assert_memory_equal(formatter.buffer, expected, strlen(expected));
+}
+
+/**
+ * \brief Test for ComID arbiter: the lock left by a dead process is taken
+ * over with Stack Reset, waiting for a lease of another process is limited
+ * by deadline of operation
+ */
+void test_tcgs_arbiter(void **state)
+{
+	static TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t session;
+	TCGS_MethodStatus_t status;
+	TCGS_Arbiter_t arbiter, other;
+	TCGS_ArbiterSlot_t *slot;
+	TCGS_Operation_t operation;
+	pthread_t thread;
+	void *result;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	char path[64];
+	int childStatus;
+	pid_t child;
+	uint32 i;
+
+	snprintf(path, sizeof(path), "/tmp/tcgs_arbiter_test.%d", (int)getpid());
+	unlink(path);
+	assert_int_equal(TCGS_Arbiter_Open(&arbiter, path), ERROR_SUCCESS);
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &TCGS_Interface_Virtual_Funcs, &tper);
+	TCGS_Arbiter_Attach(&arbiter, &device, 1);
+	assert_int_equal(TCGS_Device_Level0Discovery(&device, buffer), ERROR_SUCCESS);
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, NULL,
+			NULL, 0, FALSE, &status), ERROR_SUCCESS);
+	assert_true(device.arbiterSlot != NULL);
+	assert_true(device.arbiterSlot->acquisitions > 0);
+	assert_int_equal(device.arbiterSlot->contended, 0);
+
+	//another mapping of the file finds the same slot
+	assert_int_equal(TCGS_Arbiter_Open(&other, path), ERROR_SUCCESS);
+	assert_true((char*)TCGS_Arbiter_FindSlot(&other, 1, device.comId) - (char*)other.table ==
+			(char*)device.arbiterSlot - (char*)arbiter.table);
+	TCGS_Arbiter_Close(&other);
+
+	//process dies holding the lock within exchange
+	child = fork();
+	if (child == 0)
+	{
+		_exit(TCGS_Arbiter_Acquire(device.arbiterSlot, NULL) == ERROR_SUCCESS ? 0 : 1);
+	}
+	assert_int_equal(waitpid(child, &childStatus, 0), child);
+	assert_int_equal(WEXITSTATUS(childStatus), 0);
+	assert_int_equal(TCGS_Device_Lock(&device), ERROR_SUCCESS);
+	TCGS_Device_Unlock(&device);
+	assert_int_equal(device.arbiterSlot->recoveries, 1);
+	for (i = 0; i < VTPER_MAX_SESSIONS; i++)
+	{
+		assert_false(tper.sessions[i].open);
+	}
+	session.open = FALSE;
+
+	//exchanges of another process wait for the lease until deadline
+	assert_int_equal(TCGS_Arbiter_Lease(&device), ERROR_SUCCESS);
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_AdminSP, NULL,
+			NULL, 0, FALSE, &status), ERROR_SUCCESS);
+	child = fork();
+	if (child == 0)
+	{
+		TCGS_Operation_Init(&operation, 50 * TCGS_NSEC_PER_MSEC);
+		TCGS_Operation_Begin(&operation);
+		_exit(TCGS_Device_Lock(&device) == ERROR_TIMEOUT ? 0 : 1);
+	}
+	assert_int_equal(waitpid(child, &childStatus, 0), child);
+	assert_int_equal(WEXITSTATUS(childStatus), 0);
+	assert_int_equal(device.arbiterSlot->contended, 1);
+	assert_int_equal(TCGS_EndSession(&session), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Arbiter_EndLease(&device), ERROR_SUCCESS);
+	assert_int_equal(device.arbiterSlot->recoveries, 1);
+
+	//lease is ended by its thread, the leased slot is released after ComID changes
+	assert_int_equal(TCGS_Arbiter_Lease(&device), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Arbiter_Lease(&device), ERROR_PARAMETER);
+	assert_int_equal(pthread_create(&thread, NULL, ArbiterEndLease, &device), 0);
+	assert_int_equal(pthread_join(thread, &result), 0);
+	assert_int_equal((TCGS_Error_t)(size_t)result, ERROR_PARAMETER);
+	slot = device.arbiterSlot;
+	device.comId++;
+	assert_int_equal(TCGS_Device_Lock(&device), ERROR_SUCCESS);
+	TCGS_Device_Unlock(&device);
+	assert_true(device.arbiterSlot != slot);
+	assert_int_equal(TCGS_Arbiter_EndLease(&device), ERROR_SUCCESS);
+	device.comId--;
+	child = fork();
+	if (child == 0)
+	{
+		TCGS_Operation_Init(&operation, 50 * TCGS_NSEC_PER_MSEC);
+		TCGS_Operation_Begin(&operation);
+		_exit(TCGS_Arbiter_Acquire(slot, NULL) == ERROR_SUCCESS ? 0 : 1);
+	}
+	assert_int_equal(waitpid(child, &childStatus, 0), child);
+	assert_int_equal(WEXITSTATUS(childStatus), 0);
+
+	TCGS_Device_Destroy(&device);
+	TCGS_Arbiter_Close(&arbiter);
+	unlink(path);
+}
+
+/**
+ * \brief Test for inventory snapshot: devices added by Level 0 Discovery are
+ * found in mapped file, flag columns are counted and scanned
+ */
+void test_tcgs_inventory(void **state)
+{
+	static TCGS_VTPer_t tpers[2];
+	static uint64 snapshot[1024];
+	TCGS_Device_t devices[2];
+	TCGS_Inventory_t inventory, mapped;
+	const TCGS_InventoryRecord_t *record;
+	const uint8 *level0;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+	char path[64];
+	uint32 length;
+	uint32 i;
+
+	assert_int_equal(sizeof(TCGS_InventoryHeader_t), 64);
+	assert_int_equal(sizeof(TCGS_InventoryRecord_t), 64);
+	assert_int_equal(sizeof(TCGS_InventoryIndexEntry_t), 16);
+	assert_true(TCGS_Inventory_Size(4, 2 * TCGS_BLOCK_SIZE) <= sizeof(snapshot));
+	assert_int_equal(TCGS_Inventory_Init(&inventory, (uint8*)snapshot + 1, sizeof(snapshot) - 8,
+			4, 2 * TCGS_BLOCK_SIZE), ERROR_PARAMETER);
+	assert_int_equal(TCGS_Inventory_Init(&inventory, snapshot, sizeof(snapshot),
+			4, 2 * TCGS_BLOCK_SIZE), ERROR_SUCCESS);
+
+	for (i = 0; i < 2; i++)
+	{
+		TCGS_VTPer_InitInstance(&tpers[i]);
+		TCGS_Device_Init(&devices[i], &TCGS_Interface_Virtual_Funcs, &tpers[i]);
+	}
+	TCGS_VTPer_FindObject(&tpers[1], &TCGS_UID_Locking_Range1)->columns[TCGS_COLUMN_LOCKING_READ_LOCKED].value = 1;
+	assert_int_equal(TCGS_Inventory_Discover(&inventory, &devices[0], 30), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Inventory_Discover(&inventory, &devices[1], 10), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Inventory_Add(&inventory, 20, NULL, 0), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Inventory_Add(&inventory, 10, NULL, 0), ERROR_PARAMETER);
+
+	snprintf(path, sizeof(path), "/tmp/tcgs_inventory_test.%d", (int)getpid());
+	assert_int_equal(TCGS_Inventory_Save(&inventory, path), ERROR_SUCCESS);
+	assert_int_equal(TCGS_Inventory_Map(&mapped, path), ERROR_SUCCESS);
+	assert_int_equal(mapped.header->count, 3);
+
+	//decoded state matches Level 0 Discovery of the library
+	assert_int_equal(TCGS_Device_Level0Discovery(&devices[0], buffer), ERROR_SUCCESS);
+	record = TCGS_Inventory_Find(&mapped, 30);
+	assert_true(record != NULL);
+	assert_int_equal(record->baseComId, devices[0].comId);
+	assert_true(record->numberOfComIds > 0);
+	assert_true(record->flags & (1 << INVENTORY_FLAG_LOCKING_SUPPORTED));
+	assert_false(record->flags & (1 << INVENTORY_FLAG_LOCKED));
+	level0 = TCGS_Inventory_GetLevel0(&mapped, record, &length);
+	assert_true(level0 != NULL);
+	assert_int_equal(length, ((TCGS_Level0Discovery_Header_t*)buffer)->length + sizeof(uint32));
+
+	record = TCGS_Inventory_Find(&mapped, 10);
+	assert_true(record != NULL);
+	assert_true(record->flags & (1 << INVENTORY_FLAG_LOCKED));
+	assert_true(memcmp(record, TCGS_Inventory_GetRecord(&inventory, 1), sizeof(*record)) == 0);
+	record = TCGS_Inventory_Find(&mapped, 20);
+	assert_true(record != NULL);
+	assert_int_equal(record->flags, 0);
+	assert_true(TCGS_Inventory_GetLevel0(&mapped, record, &length) == NULL);
+	assert_true(TCGS_Inventory_Find(&mapped, 15) == NULL);
+
+	assert_int_equal(TCGS_Inventory_CountFlag(&mapped, INVENTORY_FLAG_RESPONDING), 2);
+	assert_int_equal(TCGS_Inventory_CountFlag(&mapped, INVENTORY_FLAG_LOCKED), 1);
+	assert_int_equal(TCGS_Inventory_NextWithFlag(&mapped, INVENTORY_FLAG_LOCKED, 0), 1);
+	assert_int_equal(TCGS_Inventory_NextWithFlag(&mapped, INVENTORY_FLAG_LOCKED, 2), 3);
+	assert_true(TCGS_Inventory_GetFlag(&mapped, 0, INVENTORY_FLAG_RESPONDING));
+	assert_false(TCGS_Inventory_GetFlag(&mapped, 2, INVENTORY_FLAG_RESPONDING));
+	TCGS_Inventory_Unmap(&mapped);
+
+	//truncated file is rejected
+	assert_int_equal(truncate(path, 100), 0);
+	assert_int_equal(TCGS_Inventory_Map(&mapped, path), ERROR_PARSER);
+	unlink(path);
+
+	for (i = 0; i < 2; i++)
+	{
+		TCGS_Device_Destroy(&devices[i]);
+	}
+}
+
+/**
+ * \brief Test for LBA index: lookup of LBAs and extents, refresh of changed range, alignment
+ */
+void test_tcgs_lba_index(void **state)
+{
+	static TCGS_LBAIndex_t index;
+	TCGS_VTPer_t tper;
+	TCGS_Device_t device;
+	TCGS_Session_t session;
+	TCGS_UID_t range2 = TCGS_UID_Locking_Range1;
+	uint8 buffer[TCGS_BLOCK_SIZE];
+
+	TCGS_VTPer_InitInstance(&tper);
+	TCGS_Device_Init(&device, &TCGS_Interface_Virtual_Funcs, &tper);
+	assert_int_equal(TCGS_Device_Level0Discovery(&device, buffer), ERROR_SUCCESS);
+	assert_int_equal(TCGS_StartSession(&session, &device, &TCGS_UID_LockingSP, &TCGS_UID_Admin1,
+			"", 0, TRUE, NULL), ERROR_SUCCESS);
+	assert_int_equal(TCGS_SetUInt(&session, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_RANGE_START,
+			1000, NULL), ERROR_SUCCESS);
+	assert_int_equal(TCGS_SetUInt(&session, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_RANGE_LENGTH,
+			1000, NULL), ERROR_SUCCESS);
+	assert_int_equal(TCGS_SetUInt(&session, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_READ_LOCK_ENABLED,
+			1, NULL), ERROR_SUCCESS);
+	assert_int_equal(TCGS_SetUInt(&session, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_READ_LOCKED,
+			1, NULL), ERROR_SUCCESS);
+
+	TCGS_LBAIndex_Init(&index);
+	assert_true(TCGS_LBAIndex_SetGeometry(&index, (TCGS_Level0Discovery_Header_t*)buffer));
+	assert_int_equal(index.logicalBlockSize, 512);
+	assert_true(TCGS_LBAIndex_IsAligned(&index, 1000));
+	assert_false(TCGS_LBAIndex_IsAligned(&index, 1001));
+
+	assert_int_equal(TCGS_LBAIndex_Load(&index, &session), ERROR_SUCCESS);
+	assert_int_equal(index.rangeCount, 2);
+	assert_int_equal(index.segmentCount, 3);
+	assert_int_equal(TCGS_LBAIndex_Lookup(&index, 0), 0);
+	assert_int_equal(TCGS_LBAIndex_Lookup(&index, 999), 0);
+	assert_int_equal(TCGS_LBAIndex_Lookup(&index, 1000), TCGS_LBA_READ_LOCKED);
+	assert_int_equal(TCGS_LBAIndex_Lookup(&index, 1999), TCGS_LBA_READ_LOCKED);
+	assert_int_equal(TCGS_LBAIndex_Lookup(&index, 2000), 0);
+	assert_int_equal(TCGS_LBAIndex_Lookup(&index, ~0ULL), 0);
+	assert_int_equal(TCGS_LBAIndex_LookupExtent(&index, 990, 10), 0);
+	assert_int_equal(TCGS_LBAIndex_LookupExtent(&index, 990, 11), TCGS_LBA_READ_LOCKED);
+	assert_int_equal(TCGS_LBAIndex_LookupExtent(&index, 0, ~0ULL), TCGS_LBA_READ_LOCKED);
+	assert_int_equal(TCGS_LBAIndex_LookupExtent(&index, 2000, 100), 0);
+
+	//unlock changes lock state of the segment only
+	assert_int_equal(TCGS_SetUInt(&session, &TCGS_UID_Locking_Range1, TCGS_COLUMN_LOCKING_READ_LOCKED,
+			0, NULL), ERROR_SUCCESS);
+	assert_int_equal(TCGS_LBAIndex_Refresh(&index, &session, &TCGS_UID_Locking_Range1), ERROR_SUCCESS);
+	assert_int_equal(TCGS_LBAIndex_Lookup(&index, 1500), 0);
+	assert_int_equal(TCGS_EndSession(&session), ERROR_SUCCESS);
+
+	//ranges are kept sorted, overlapping range is refused
+	range2.bytes[7] = 2;
+	assert_int_equal(TCGS_LBAIndex_SetRange(&index, &range2, 0, 500, TCGS_LBA_WRITE_LOCKED), ERROR_SUCCESS);
+	assert_int_equal(index.segmentCount, 4);
+	assert_int_equal(TCGS_LBAIndex_Lookup(&index, 499), TCGS_LBA_WRITE_LOCKED);
+	assert_int_equal(TCGS_LBAIndex_Lookup(&index, 500), 0);
+	assert_int_equal(TCGS_LBAIndex_SetRange(&index, &range2, 1500, 1000, 0), ERROR_PARAMETER);
+	assert_int_equal(TCGS_LBAIndex_SetRange(&index, &TCGS_UID_Locking_GlobalRange, 0, 0,
+			TCGS_LBA_READ_LOCKED | TCGS_LBA_WRITE_LOCKED), ERROR_SUCCESS);
+	assert_int_equal(TCGS_LBAIndex_Lookup(&index, 700), TCGS_LBA_READ_LOCKED | TCGS_LBA_WRITE_LOCKED);
+	assert_int_equal(TCGS_LBAIndex_Lookup(&index, 1000), 0);
+	TCGS_Device_Destroy(&device);
+}
+
+static uint32 monitorEvents[2];
+static TCGS_MonitorEntry_t monitorLastEntry;
+
+static void test_monitor_callback(TCGS_Monitor_t *monitor, TCGS_MonitorEntry_t *entry,
+		TCGS_MonitorEvent_t event, TCGS_Level0Discovery_Header_t *header)
+{
+	assert_true((event == MONITOR_EVENT_ERROR) == (header == NULL));
+	monitorEvents[event]++;
+	monitorLastEntry = *entry;
+}
+
+static TCGS_Error_t test_monitor_fail(TCGS_CommandBlock_t *inputCommandBlock,
+		void *inputPayload, TCGS_InterfaceError_t *interfaceError, void *outputPayload)
+{
+	*interfaceError = INTERFACE_ERROR_OTHER_INVALID_COMMAND_PARAMETER;
+	return ERROR_INTERFACE;
+}
+
+/**
+ * \brief Test for monitor: only changes of Level 0 Discovery are reported
+ */
+void test_tcgs_monitor(void **state)
+{
+	static TCGS_VTPer_t tpers[3];
+	TCGS_InterfaceFunctions_t failFuncs = {test_monitor_fail, NULL};
+	TCGS_Device_t devices[3];
+	TCGS_MonitorEntry_t entries[3];
+	TCGS_Monitor_t monitor;
+	uint64 interval = 1000 * TCGS_NSEC_PER_MSEC, now;
+	uint32 i;
+
+	for (i = 0; i < 3; i++)
+	{
+		TCGS_VTPer_InitInstance(&tpers[i]);
+		TCGS_Device_Init(&devices[i], &TCGS_Interface_Virtual_Funcs, &tpers[i]);
+	}
+	TCGS_Monitor_Init(&monitor, entries, devices, 3, interval, interval / 10, test_monitor_callback, NULL);
+	now = TCGS_GetTime();
+
+	//first responses are reported, all devices are polled in one wakeup
+	now += 2 * interval;
+	assert_true(TCGS_Monitor_Poll(&monitor, now) > now);
+	assert_int_equal(monitor.polls, 3);
+	assert_int_equal(monitorEvents[MONITOR_EVENT_CHANGED], 3);
+
+	//steady state
+	now += 2 * interval;
+	TCGS_Monitor_Poll(&monitor, now);
+	assert_int_equal(monitor.polls, 6);
+	assert_int_equal(monitorEvents[MONITOR_EVENT_CHANGED], 3);
+	assert_int_equal(monitor.wakeups, 2);
+
+	//range of the second device is locked
+	TCGS_VTPer_FindObject(&tpers[1], &TCGS_UID_Locking_Range1)->columns[TCGS_COLUMN_LOCKING_READ_LOCKED].value = 1;
+	now += 2 * interval;
+	TCGS_Monitor_Poll(&monitor, now);
+	assert_int_equal(monitorEvents[MONITOR_EVENT_CHANGED], 4);
+	assert_true(monitorLastEntry.device == &devices[1]);
+	assert_true(monitorLastEntry.locking & TCGS_MONITOR_LOCKED);
+	assert_false(monitorLastEntry.previousLocking & TCGS_MONITOR_LOCKED);
+
+	//failure is reported once, the response after it is reported again
+	devices[2].funcs = &failFuncs;
+	now += 2 * interval;
+	TCGS_Monitor_Poll(&monitor, now);
+	now += 2 * interval;
+	TCGS_Monitor_Poll(&monitor, now);
+	assert_int_equal(monitorEvents[MONITOR_EVENT_ERROR], 1);
+	devices[2].funcs = &TCGS_Interface_Virtual_Funcs;
+	now += 2 * interval;
+	TCGS_Monitor_Poll(&monitor, now);
+	assert_int_equal(monitorEvents[MONITOR_EVENT_CHANGED], 5);
+	assert_true(monitorLastEntry.device == &devices[2]);
+	assert_int_equal(monitor.polls, 18);
+
+	//jitter longer than 2^32 nanoseconds spreads polls over all of it
+	now = TCGS_GetTime();
+	TCGS_Monitor_Init(&monitor, entries, devices, 3, interval, 1000 * interval, test_monitor_callback, NULL);
+	for (i = 0; i < 3 && entries[i].nextPoll - now < (1ULL << 32) + interval; i++)
+	{
+	}
+	assert_true(i < 3);
+
+	for (i = 0; i < 3; i++)
+	{
+		TCGS_Device_Destroy(&devices[i]);
+	}
+}
+
 int main(int argc, char* argv[]) {
     const UnitTest tests[] = {
         unit_test(test_tcgs_basetypes_size),
         unit_test(test_tcgs_host_level0discovery),
         unit_test(test_tcgs_host_level0discovery_virtual),
+        unit_test(test_tcgs_device_level0discovery),
+        unit_test(test_tcgs_comid_reclaim),
+        unit_test(test_tcgs_provision),
+        unit_test(test_tcgs_capture_record_replay),
+        unit_test(test_tcgs_capture_concurrent),
+        unit_test(test_tcgs_interface_chain),
+        unit_test(test_tcgs_single_flight),
+        unit_test(test_tcgs_operation_deadline),
+        unit_test(test_tcgs_retry_policy),
+        unit_test(test_tcgs_scheduler),
+        unit_test(test_tcgs_lockdown),
+        unit_test(test_tcgs_resume),
+        unit_test(test_tcgs_session_virtual),
+        unit_test(test_tcgs_session_pool),
+        unit_test(test_tcgs_transaction),
+        unit_test(test_tcgs_table_cache),
+        unit_test(test_tcgs_table_iterator),
+        unit_test(test_tcgs_uid_catalog),
+        unit_test(test_tcgs_format),
+        unit_test(test_tcgs_format_tokens),
+        unit_test(test_tcgs_arbiter),
+        unit_test(test_tcgs_inventory),
+        unit_test(test_tcgs_lba_index),
+        unit_test(test_tcgs_monitor),
+        unit_test(test_tcgs_pbkdf2),
+        unit_test(test_tcgs_credential_cache),
     };
 	int result;
 
@@ -0,0 +1,132 @@
+#!/usr/bin/env python
+#
+# gen_uid_catalog.py
+#
+# Generates static UID catalog of libtcgstorage: entries sorted by UID for
+# binary search and minimal perfect hash of names (hash and displace), and
+# names of Level 0 Discovery features sorted by feature code.
+#
+# usage: python tools/gen_uid_catalog.py tools/uid_catalog.txt > src/tcgs_uid_catalog.c
+#
+# (c) Artem Zankovich, 2012
+
+import sys
+
+KINDS = ('SP', 'TABLE', 'OBJECT', 'METHOD', 'AUTHORITY')
+MAX_SEED = 0xFFFF
+
+
+def name_hash(name, seed):
+    # FNV-1a, the same as TCGS_UIDCatalog_Hash
+    h = (0x811C9DC5 ^ seed) & 0xFFFFFFFF
+    for c in name.encode('ascii'):
+        h ^= c
+        h = (h * 0x01000193) & 0xFFFFFFFF
+    return h
+
+
+def read_catalog(path):
+    entries = []
+    features = []
+    for line in open(path):
+        line = line.split('#', 1)[0].split()
+        if not line:
+            continue
+        kind, name, uid = line[0], line[1], bytes(int(b, 16) for b in line[2:])
+        if kind == 'FEATURE' and len(uid) == 2:
+            features.append(((uid[0] << 8) | uid[1], name))
+            continue
+        if kind not in KINDS or len(uid) != 8:
+            sys.exit('invalid entry: %s' % ' '.join(line))
+        entries.append((uid, name, kind))
+    entries.sort()
+    features.sort()
+    for a, b in zip(features, features[1:]):
+        if a[0] == b[0]:
+            sys.exit('duplicate code of features %s and %s' % (a[1], b[1]))
+    for a, b in zip(entries, entries[1:]):
+        if a[0] == b[0]:
+            sys.exit('duplicate UID of %s and %s' % (a[1], b[1]))
+    names = [e[1] for e in entries]
+    if len(set(names)) != len(names):
+        sys.exit('duplicate names')
+    return entries, features
+
+
+def build_hash(names):
+    size = len(names)
+    for bucket_count in range((size + 1) // 2, size + 1):
+        buckets = [[] for i in range(bucket_count)]
+        for index, name in enumerate(names):
+            buckets[name_hash(name, 0) % bucket_count].append(index)
+        slots = [None] * size
+        seeds = [0] * bucket_count
+        # the largest buckets are placed first
+        order = sorted(range(bucket_count), key=lambda b: -len(buckets[b]))
+        for b in order:
+            if not buckets[b]:
+                continue
+            for seed in range(1, MAX_SEED + 1):
+                taken = [name_hash(names[i], seed) % size for i in buckets[b]]
+                if len(set(taken)) == len(taken) and all(slots[t] is None for t in taken):
+                    break
+            else:
+                break
+            seeds[b] = seed
+            for i, t in zip(buckets[b], taken):
+                slots[t] = i
+        else:
+            return seeds, slots
+    sys.exit('no perfect hash found')
+
+
+def main():
+    entries, features = read_catalog(sys.argv[1])
+    names = [e[1] for e in entries]
+    seeds, slots = build_hash(names)
+    length = max(len(n) for n in names) + 1
+    feature_length = max(len(f[1]) for f in features) + 1
+
+    out = sys.stdout.write
+    out('/////////////////////////////////////////////////////////////////////////////\n')
+    out('/// tcgs_uid_catalog.c\n')
+    out('///\n')
+    out('/// Catalog of UIDs, generated by tools/gen_uid_catalog.py, do not edit\n')
+    out('///\n')
+    out('/// (c) Artem Zankovich, 2012\n')
+    out('/////////////////////////////////////////////////////////////////////////////\n\n')
+    out('#include "tcgs_uid_catalog.h"\n\n')
+    out('#if TCGS_UID_CATALOG_NAME_LENGTH < %d\n' % length)
+    out('#error TCGS_UID_CATALOG_NAME_LENGTH is too small for the catalog\n')
+    out('#endif\n\n')
+    out('#if TCGS_FEATURE_CATALOG_NAME_LENGTH < %d\n' % feature_length)
+    out('#error TCGS_FEATURE_CATALOG_NAME_LENGTH is too small for the catalog\n')
+    out('#endif\n\n')
+    out('const uint32 TCGS_UIDCatalog_Size = %d;\n\n' % len(entries))
+    out('//sorted by UID\n')
+    out('const TCGS_UIDCatalogEntry_t TCGS_UIDCatalog[%d] =\n{\n' % len(entries))
+    for uid, name, kind in entries:
+        out('\t{{{%s}}, UID_KIND_%s, "%s"},\n' %
+            (', '.join('0x%02X' % b for b in uid), kind, name))
+    out('};\n\n')
+    out('const uint32 TCGS_UIDCatalog_BucketCount = %d;\n\n' % len(seeds))
+    out('//seed of name hash for each bucket\n')
+    out('const uint16 TCGS_UIDCatalog_Seeds[%d] =\n{' % len(seeds))
+    for i, seed in enumerate(seeds):
+        out(('\n\t' if i % 12 == 0 else ' ') + '%d,' % seed)
+    out('\n};\n\n')
+    out('//index of entry for each hash value\n')
+    out('const uint16 TCGS_UIDCatalog_Slots[%d] =\n{' % len(slots))
+    for i, slot in enumerate(slots):
+        out(('\n\t' if i % 12 == 0 else ' ') + '%d,' % slot)
+    out('\n};\n\n')
+    out('const uint32 TCGS_FeatureCatalog_Size = %d;\n\n' % len(features))
+    out('//sorted by feature code\n')
+    out('const TCGS_FeatureCatalogEntry_t TCGS_FeatureCatalog[%d] =\n{\n' % len(features))
+    for code, name in features:
+        out('\t{0x%04X, "%s"},\n' % (code, name))
+    out('};\n')
+
+
+if __name__ == '__main__':
+    main()
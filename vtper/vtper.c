@@ -5,39 +5,956 @@
 ///
 /// (c) Artem Zankovich, 2012
 //////////////////////////////////////////////////////////////////////////////
-#ifndef _TCGS_VTPER_H
-#define _TCGS_VTPER_H
 
 #include <string.h>
 
 #include "tcgs_types.h"
 #include "tcgs_interface.h"
+#include "tcgs_builder.h"
+#include "tcgs_parser.h"
+#include "tcgs_interface_encode.h"
+#include "tcgs_uid.h"
+#include "vtper.h"
+
+static TCGS_VTPer_t defaultTPer;
+
+typedef struct
+{
+	const TCGS_UID_t *authority;
+	const TCGS_UID_t *credential;
+} TCGS_VTPer_AuthorityMap_t;
+
+static const TCGS_VTPer_AuthorityMap_t authorityMap[] =
+{
+	{&TCGS_UID_SID,    &TCGS_UID_C_PIN_SID},
+	{&TCGS_UID_Admin1, &TCGS_UID_C_PIN_Admin1},
+	{&TCGS_UID_User1,  &TCGS_UID_C_PIN_User1},
+};
+
+#define _uidEqual(a, b) (memcmp((a), (b), sizeof(TCGS_UID_t)) == 0)
+
+TCGS_VTPer_Object_t *TCGS_VTPer_FindObject(TCGS_VTPer_t *tper, const TCGS_UID_t *uid)
+{
+	uint32 i;
+
+	for (i = 0; i < tper->objectCount; i++)
+	{
+		if (_uidEqual(&tper->objects[i].uid, uid))
+		{
+			return &tper->objects[i];
+		}
+	}
+	return NULL;
+}
+
+TCGS_VTPer_Object_t *TCGS_VTPer_AddObject(TCGS_VTPer_t *tper, const TCGS_UID_t *uid)
+{
+	TCGS_VTPer_Object_t *object;
+
+	if (tper->objectCount == VTPER_MAX_OBJECTS)
+	{
+		return NULL;
+	}
+	object = &tper->objects[tper->objectCount++];
+	memset(object, 0, sizeof(*object));
+	object->uid = *uid;
+	return object;
+}
+
+static void TCGS_VTPer_SetUInt(TCGS_VTPer_Object_t *object, uint32 column, uint64 value)
+{
+	object->columns[column].type = VTPER_VALUE_UINT;
+	object->columns[column].value = value;
+	object->columns[column].length = 0;
+}
+
+static void TCGS_VTPer_SetBytes(TCGS_VTPer_Object_t *object, uint32 column, const void *data, uint32 length)
+{
+	object->columns[column].type = VTPER_VALUE_BYTES;
+	object->columns[column].length = (uint8)length;
+	memcpy(object->columns[column].bytes, data, length);
+}
+
+static void TCGS_VTPer_AddLockingRange(TCGS_VTPer_t *tper, const TCGS_UID_t *uid)
+{
+	TCGS_VTPer_Object_t *range = TCGS_VTPer_AddObject(tper, uid);
+	uint32 column;
+
+	for (column = TCGS_COLUMN_LOCKING_RANGE_START; column <= TCGS_COLUMN_LOCKING_WRITE_LOCKED; column++)
+	{
+		TCGS_VTPer_SetUInt(range, column, 0);
+	}
+}
+
+/*
+ * Adds rows of factory tables, MBR is not touched
+ */
+static void TCGS_VTPer_AddFactoryObjects(TCGS_VTPer_t *tper)
+{
+	TCGS_VTPer_Object_t *object;
+
+	tper->objectCount = 0;
+	tper->lockingActive = FALSE;
+
+	object = TCGS_VTPer_AddObject(tper, &TCGS_UID_C_PIN_MSID);
+	TCGS_VTPer_SetBytes(object, TCGS_COLUMN_C_PIN_PIN, VTPER_MSID, sizeof(VTPER_MSID) - 1);
+	object = TCGS_VTPer_AddObject(tper, &TCGS_UID_C_PIN_SID);
+	TCGS_VTPer_SetBytes(object, TCGS_COLUMN_C_PIN_PIN, VTPER_MSID, sizeof(VTPER_MSID) - 1);
+	object = TCGS_VTPer_AddObject(tper, &TCGS_UID_C_PIN_Admin1);
+	TCGS_VTPer_SetBytes(object, TCGS_COLUMN_C_PIN_PIN, "", 0);
+	object = TCGS_VTPer_AddObject(tper, &TCGS_UID_C_PIN_User1);
+	TCGS_VTPer_SetBytes(object, TCGS_COLUMN_C_PIN_PIN, "", 0);
+	object = TCGS_VTPer_AddObject(tper, &TCGS_UID_User1);
+	TCGS_VTPer_SetUInt(object, TCGS_COLUMN_AUTHORITY_ENABLED, 0);
+
+	TCGS_VTPer_AddLockingRange(tper, &TCGS_UID_Locking_GlobalRange);
+	TCGS_VTPer_AddLockingRange(tper, &TCGS_UID_Locking_Range1);
+
+	object = TCGS_VTPer_AddObject(tper, &TCGS_UID_MBRControl);
+	TCGS_VTPer_SetUInt(object, TCGS_COLUMN_MBRCONTROL_ENABLE, 0);
+	TCGS_VTPer_SetUInt(object, TCGS_COLUMN_MBRCONTROL_DONE, 0);
+}
+
+/*
+ * Fills tables with factory values
+ */
+static void TCGS_VTPer_InitTables(TCGS_VTPer_t *tper)
+{
+	memset(tper->mbr, 0, sizeof(tper->mbr));
+	TCGS_VTPer_AddFactoryObjects(tper);
+}
+
+void TCGS_VTPer_InitInstance(TCGS_VTPer_t *tper)
+{
+	memset(tper, 0, sizeof(*tper));
+	tper->comId = VTPER_BASE_COMID;
+	tper->lastSessionNumber = 0x1000;
+	TCGS_VTPer_InitTables(tper);
+}
+
+void TCGS_VTPer_InitZeroedInstance(TCGS_VTPer_t *tper)
+{
+	tper->comId = VTPER_BASE_COMID;
+	tper->lastSessionNumber = 0x1000;
+	TCGS_VTPer_AddFactoryObjects(tper);
+}
 
 void TCGS_VTPer_Init(void)
 {
-	return;
+	TCGS_VTPer_InitInstance(&defaultTPer);
+}
+
+TCGS_VTPer_t *TCGS_VTPer_GetDefault(void)
+{
+	return &defaultTPer;
+}
+
+/*
+ * Only one transaction may be open: tables are copied at its start
+ */
+static bool TCGS_VTPer_StartTransaction(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session)
+{
+	uint32 i;
+
+	for (i = 0; i < VTPER_MAX_SESSIONS; i++)
+	{
+		if (tper->sessions[i].open && tper->sessions[i].transaction)
+		{
+			return FALSE;
+		}
+	}
+	memcpy(tper->transactionBackup, tper->objects, sizeof(tper->objects));
+	tper->transactionBackupCount = tper->objectCount;
+	session->transaction = TRUE;
+	return TRUE;
+}
+
+static void TCGS_VTPer_EndTransaction(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session, bool commit)
+{
+	if (!session->transaction)
+	{
+		return;
+	}
+	if (!commit)
+	{
+		memcpy(tper->objects, tper->transactionBackup, sizeof(tper->objects));
+		tper->objectCount = tper->transactionBackupCount;
+	}
+	session->transaction = FALSE;
+}
+
+static void TCGS_VTPer_CloseSession(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session)
+{
+	//open transaction is aborted with the session
+	TCGS_VTPer_EndTransaction(tper, session, FALSE);
+	session->open = FALSE;
+}
+
+void TCGS_VTPer_PowerCycle(TCGS_VTPer_t *tper)
+{
+	TCGS_VTPer_Object_t *object;
+	uint32 i;
+
+	for (i = 0; i < VTPER_MAX_SESSIONS; i++)
+	{
+		TCGS_VTPer_EndTransaction(tper, &tper->sessions[i], FALSE);
+	}
+	memset(tper->sessions, 0, sizeof(tper->sessions));
+	tper->responseReady = FALSE;
+
+	//ranges with enabled locks are locked and MBR shadowing is resumed on reset
+	for (i = 0; i < tper->objectCount; i++)
+	{
+		object = &tper->objects[i];
+		if (_uidEqual(&object->uid, &TCGS_UID_MBRControl))
+		{
+			object->columns[TCGS_COLUMN_MBRCONTROL_DONE].value = 0;
+			continue;
+		}
+		if (object->columns[TCGS_COLUMN_LOCKING_READ_LOCK_ENABLED].value != 0)
+		{
+			object->columns[TCGS_COLUMN_LOCKING_READ_LOCKED].value = 1;
+		}
+		if (object->columns[TCGS_COLUMN_LOCKING_WRITE_LOCK_ENABLED].value != 0)
+		{
+			object->columns[TCGS_COLUMN_LOCKING_WRITE_LOCKED].value = 1;
+		}
+	}
+}
+
+static TCGS_VTPer_t *TCGS_VTPer_GetCurrent(void)
+{
+	TCGS_Device_t *device = TCGS_GetCurrentDevice();
+
+	if (device != NULL && device->context != NULL)
+	{
+		return (TCGS_VTPer_t*)device->context;
+	}
+	if (defaultTPer.comId == 0)
+	{
+		TCGS_VTPer_InitInstance(&defaultTPer);
+	}
+	return &defaultTPer;
+}
+
+static bool TCGS_VTPer_CheckCredential(TCGS_VTPer_t *tper, const TCGS_UID_t *authority,
+		const uint8 *challenge, uint32 challengeLength)
+{
+	TCGS_VTPer_Object_t *credential;
+	uint32 i;
+
+	if (_uidEqual(authority, &TCGS_UID_Anybody))
+	{
+		return TRUE;
+	}
+	for (i = 0; i < sizeof(authorityMap) / sizeof(authorityMap[0]); i++)
+	{
+		if (_uidEqual(authority, authorityMap[i].authority))
+		{
+			credential = TCGS_VTPer_FindObject(tper, authorityMap[i].credential);
+			return credential != NULL &&
+				credential->columns[TCGS_COLUMN_C_PIN_PIN].length == challengeLength &&
+				memcmp(credential->columns[TCGS_COLUMN_C_PIN_PIN].bytes, challenge, challengeLength) == 0;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Extracts content of method parameter list and skips End of Data and status list
+ */
+static bool TCGS_VTPer_GetArguments(TCGS_Parser_t *request, TCGS_Parser_t *arguments)
+{
+	TCGS_Token_t token;
+	uint32 start;
+
+	if (!TCGS_Parser_Peek(request, &token) || token.type != TOKEN_TYPE_CONTROL ||
+		token.control != TOKEN_START_LIST)
+	{
+		return FALSE;
+	}
+	start = request->position;
+	if (!TCGS_Parser_SkipValue(request))
+	{
+		return FALSE;
+	}
+	TCGS_Parser_Init(arguments, request->data + start + 1, request->position - start - 2);
+	return TCGS_Parser_Expect(request, TOKEN_END_OF_DATA) && TCGS_Parser_SkipValue(request);
+}
+
+static void TCGS_VTPer_StartSession(TCGS_VTPer_t *tper, TCGS_Parser_t *arguments,
+		TCGS_Builder_t *response)
+{
+	TCGS_VTPer_Session_t *session = NULL;
+	TCGS_MethodStatus_t status = METHOD_STATUS_SUCCESS;
+	TCGS_UID_t sp, authority = TCGS_UID_Anybody;
+	const uint8 *challenge = NULL;
+	uint32 challengeLength = 0;
+	uint64 hostSessionNumber, write, name;
+	uint32 i;
+
+	tper->startSessionCount++;
+	if (!TCGS_Parser_GetUInt(arguments, &hostSessionNumber) ||
+		!TCGS_Parser_GetUID(arguments, &sp) ||
+		!TCGS_Parser_GetUInt(arguments, &write))
+	{
+		status = METHOD_STATUS_INVALID_PARAMETER;
+	}
+	while (status == METHOD_STATUS_SUCCESS && TCGS_Parser_Expect(arguments, TOKEN_START_NAME))
+	{
+		TCGS_Parser_GetUInt(arguments, &name);
+		if (name == START_SESSION_HOST_CHALLENGE)
+		{
+			TCGS_Parser_GetBytes(arguments, &challenge, &challengeLength);
+		}
+		else if (name == START_SESSION_HOST_SIGNING_AUTHORITY)
+		{
+			TCGS_Parser_GetUID(arguments, &authority);
+		}
+		else
+		{
+			TCGS_Parser_SkipValue(arguments);
+		}
+		if (!TCGS_Parser_Expect(arguments, TOKEN_END_NAME))
+		{
+			status = METHOD_STATUS_INVALID_PARAMETER;
+		}
+	}
+
+	if (status == METHOD_STATUS_SUCCESS &&
+		!_uidEqual(&sp, &TCGS_UID_AdminSP) && !_uidEqual(&sp, &TCGS_UID_LockingSP))
+	{
+		status = METHOD_STATUS_INVALID_PARAMETER;
+	}
+	if (status == METHOD_STATUS_SUCCESS &&
+		!TCGS_VTPer_CheckCredential(tper, &authority, challenge, challengeLength))
+	{
+		status = METHOD_STATUS_NOT_AUTHORIZED;
+	}
+	for (i = 0; status == METHOD_STATUS_SUCCESS && i < VTPER_MAX_SESSIONS && session == NULL; i++)
+	{
+		if (!tper->sessions[i].open)
+		{
+			session = &tper->sessions[i];
+		}
+	}
+	if (status == METHOD_STATUS_SUCCESS && session == NULL)
+	{
+		status = METHOD_STATUS_NO_SESSIONS_AVAILABLE;
+	}
+
+	TCGS_Builder_StartComPacket(response, tper->comId, 0, 0);
+	TCGS_Builder_StartCall(response, &TCGS_UID_SMUID, &TCGS_UID_Method_SyncSession);
+	if (status == METHOD_STATUS_SUCCESS)
+	{
+		session->open = TRUE;
+		session->hostSessionNumber = (uint32)hostSessionNumber;
+		session->tperSessionNumber = ++tper->lastSessionNumber;
+		session->sp = sp;
+		session->authority = authority;
+		session->write = (write != 0);
+		TCGS_Builder_AddUInt(response, session->hostSessionNumber);
+		TCGS_Builder_AddUInt(response, session->tperSessionNumber);
+	}
+	TCGS_Builder_AddToken(response, TOKEN_END_LIST);
+	TCGS_Builder_AddStatus(response, status);
+}
+
+static void TCGS_VTPer_AddValue(TCGS_Builder_t *response, TCGS_VTPer_Value_t *value)
+{
+	if (value->type == VTPER_VALUE_UINT)
+	{
+		TCGS_Builder_AddUInt(response, value->value);
+	}
+	else
+	{
+		TCGS_Builder_AddBytes(response, value->bytes, value->length);
+	}
+}
+
+static TCGS_MethodStatus_t TCGS_VTPer_Get(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session,
+		TCGS_VTPer_Object_t *object, TCGS_Parser_t *arguments, TCGS_Builder_t *response)
+{
+	uint64 name, value, startColumn = 0, endColumn = VTPER_MAX_COLUMNS - 1;
+	uint64 column;
+
+	if (!TCGS_Parser_Expect(arguments, TOKEN_START_LIST))
+	{
+		return METHOD_STATUS_INVALID_PARAMETER;
+	}
+	while (TCGS_Parser_Expect(arguments, TOKEN_START_NAME))
+	{
+		if (!TCGS_Parser_GetUInt(arguments, &name) || !TCGS_Parser_GetUInt(arguments, &value) ||
+			!TCGS_Parser_Expect(arguments, TOKEN_END_NAME))
+		{
+			return METHOD_STATUS_INVALID_PARAMETER;
+		}
+		if (name == CELLBLOCK_START_COLUMN)
+		{
+			startColumn = value;
+		}
+		else if (name == CELLBLOCK_END_COLUMN)
+		{
+			endColumn = value;
+		}
+	}
+	if (!TCGS_Parser_Expect(arguments, TOKEN_END_LIST) ||
+		startColumn > endColumn || endColumn >= VTPER_MAX_COLUMNS)
+	{
+		return METHOD_STATUS_INVALID_PARAMETER;
+	}
+	//PINs other than MSID are not readable
+	if (object->uid.bytes[3] == TCGS_UID_C_PIN_MSID.bytes[3] &&
+		!_uidEqual(&object->uid, &TCGS_UID_C_PIN_MSID) &&
+		startColumn <= TCGS_COLUMN_C_PIN_PIN && endColumn >= TCGS_COLUMN_C_PIN_PIN)
+	{
+		return METHOD_STATUS_NOT_AUTHORIZED;
+	}
+
+	TCGS_Builder_AddToken(response, TOKEN_START_LIST);
+	for (column = startColumn; column <= endColumn; column++)
+	{
+		if (object->columns[column].type != VTPER_VALUE_NONE)
+		{
+			TCGS_Builder_AddToken(response, TOKEN_START_NAME);
+			TCGS_Builder_AddUInt(response, column);
+			TCGS_VTPer_AddValue(response, &object->columns[column]);
+			TCGS_Builder_AddToken(response, TOKEN_END_NAME);
+		}
+	}
+	TCGS_Builder_AddToken(response, TOKEN_END_LIST);
+	return METHOD_STATUS_SUCCESS;
+}
+
+/*
+ * Parses Values of Set method. When object is NULL values are only validated.
+ */
+static bool TCGS_VTPer_ApplyValues(TCGS_Parser_t values, TCGS_VTPer_Object_t *object)
+{
+	TCGS_Token_t token;
+	uint64 column;
+
+	if (!TCGS_Parser_Expect(&values, TOKEN_START_LIST))
+	{
+		return FALSE;
+	}
+	while (TCGS_Parser_Expect(&values, TOKEN_START_NAME))
+	{
+		if (!TCGS_Parser_GetUInt(&values, &column) || column >= VTPER_MAX_COLUMNS ||
+			!TCGS_Parser_Next(&values, &token) || token.type == TOKEN_TYPE_CONTROL ||
+			!TCGS_Parser_Expect(&values, TOKEN_END_NAME))
+		{
+			return FALSE;
+		}
+		if (token.type == TOKEN_TYPE_BYTES && token.length > VTPER_MAX_VALUE_LENGTH)
+		{
+			return FALSE;
+		}
+		if (object == NULL)
+		{
+			continue;
+		}
+		if (token.type == TOKEN_TYPE_BYTES)
+		{
+			TCGS_VTPer_SetBytes(object, (uint32)column, token.data, token.length);
+		}
+		else
+		{
+			TCGS_VTPer_SetUInt(object, (uint32)column, token.value);
+		}
+	}
+	return TCGS_Parser_Expect(&values, TOKEN_END_LIST);
+}
+
+static TCGS_MethodStatus_t TCGS_VTPer_Set(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session,
+		TCGS_VTPer_Object_t *object, TCGS_Parser_t *arguments, TCGS_Builder_t *response)
+{
+	TCGS_Parser_t values;
+	uint64 name;
+
+	if (!session->write || _uidEqual(&session->authority, &TCGS_UID_Anybody))
+	{
+		return METHOD_STATUS_NOT_AUTHORIZED;
+	}
+	while (TCGS_Parser_Expect(arguments, TOKEN_START_NAME))
+	{
+		if (!TCGS_Parser_GetUInt(arguments, &name))
+		{
+			return METHOD_STATUS_INVALID_PARAMETER;
+		}
+		values = *arguments;
+		if (!TCGS_Parser_SkipValue(arguments) || !TCGS_Parser_Expect(arguments, TOKEN_END_NAME))
+		{
+			return METHOD_STATUS_INVALID_PARAMETER;
+		}
+		if (name != SET_VALUES)
+		{
+			continue;
+		}
+		//all values are validated before any of them is changed
+		if (!TCGS_VTPer_ApplyValues(values, NULL))
+		{
+			return METHOD_STATUS_INVALID_PARAMETER;
+		}
+		TCGS_VTPer_ApplyValues(values, object);
+	}
+	TCGS_Builder_AddToken(response, TOKEN_START_LIST);
+	TCGS_Builder_AddToken(response, TOKEN_END_LIST);
+	return METHOD_STATUS_SUCCESS;
+}
+
+/*
+ * Writes data to MBR table at offset given by Where
+ */
+static TCGS_MethodStatus_t TCGS_VTPer_SetMBR(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session,
+		TCGS_Parser_t *arguments, TCGS_Builder_t *response)
+{
+	const uint8 *data = NULL;
+	uint64 name, where = 0;
+	uint32 length = 0;
+
+	if (!session->write || _uidEqual(&session->authority, &TCGS_UID_Anybody))
+	{
+		return METHOD_STATUS_NOT_AUTHORIZED;
+	}
+	while (TCGS_Parser_Expect(arguments, TOKEN_START_NAME))
+	{
+		if (!TCGS_Parser_GetUInt(arguments, &name) ||
+			(name == SET_WHERE && !TCGS_Parser_GetUInt(arguments, &where)) ||
+			(name == SET_VALUES && !TCGS_Parser_GetBytes(arguments, &data, &length)) ||
+			name > SET_VALUES || !TCGS_Parser_Expect(arguments, TOKEN_END_NAME))
+		{
+			return METHOD_STATUS_INVALID_PARAMETER;
+		}
+	}
+	if (data == NULL || where > sizeof(tper->mbr) || length > sizeof(tper->mbr) - where)
+	{
+		return METHOD_STATUS_INVALID_PARAMETER;
+	}
+	memcpy(tper->mbr + where, data, length);
+	TCGS_Builder_AddToken(response, TOKEN_START_LIST);
+	TCGS_Builder_AddToken(response, TOKEN_END_LIST);
+	return METHOD_STATUS_SUCCESS;
+}
+
+/*
+ * Revert of Admin SP returns TPer to factory state when the response is sent
+ */
+static TCGS_MethodStatus_t TCGS_VTPer_Revert(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session,
+		TCGS_Builder_t *response)
+{
+	if (!session->write || !_uidEqual(&session->authority, &TCGS_UID_SID))
+	{
+		return METHOD_STATUS_NOT_AUTHORIZED;
+	}
+	tper->revertPending = TRUE;
+	TCGS_Builder_AddToken(response, TOKEN_START_LIST);
+	TCGS_Builder_AddToken(response, TOKEN_END_LIST);
+	return METHOD_STATUS_SUCCESS;
+}
+
+/*
+ * Activate of Locking SP copies SID PIN to Admin1, activation of active SP
+ * has no effect
+ */
+static TCGS_MethodStatus_t TCGS_VTPer_Activate(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session,
+		TCGS_Builder_t *response)
+{
+	TCGS_VTPer_Object_t *sid, *admin;
+
+	if (!session->write || !_uidEqual(&session->authority, &TCGS_UID_SID))
+	{
+		return METHOD_STATUS_NOT_AUTHORIZED;
+	}
+	if (!tper->lockingActive)
+	{
+		sid = TCGS_VTPer_FindObject(tper, &TCGS_UID_C_PIN_SID);
+		admin = TCGS_VTPer_FindObject(tper, &TCGS_UID_C_PIN_Admin1);
+		admin->columns[TCGS_COLUMN_C_PIN_PIN] = sid->columns[TCGS_COLUMN_C_PIN_PIN];
+		tper->lockingActive = TRUE;
+	}
+	TCGS_Builder_AddToken(response, TOKEN_START_LIST);
+	TCGS_Builder_AddToken(response, TOKEN_END_LIST);
+	return METHOD_STATUS_SUCCESS;
+}
+
+/*
+ * Returns rows of table following Where, rows are ordered as they were added
+ */
+static TCGS_MethodStatus_t TCGS_VTPer_Next(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session,
+		const TCGS_UID_t *table, TCGS_Parser_t *arguments, TCGS_Builder_t *response)
+{
+	TCGS_UID_t where;
+	bool found = TRUE;
+	uint64 name, count = VTPER_MAX_OBJECTS;
+	uint32 i, returned = 0;
+
+	while (TCGS_Parser_Expect(arguments, TOKEN_START_NAME))
+	{
+		if (!TCGS_Parser_GetUInt(arguments, &name))
+		{
+			return METHOD_STATUS_INVALID_PARAMETER;
+		}
+		if (name == NEXT_WHERE)
+		{
+			if (!TCGS_Parser_GetUID(arguments, &where))
+			{
+				return METHOD_STATUS_INVALID_PARAMETER;
+			}
+			found = FALSE;
+		}
+		else if (name != NEXT_COUNT || !TCGS_Parser_GetUInt(arguments, &count))
+		{
+			return METHOD_STATUS_INVALID_PARAMETER;
+		}
+		if (!TCGS_Parser_Expect(arguments, TOKEN_END_NAME))
+		{
+			return METHOD_STATUS_INVALID_PARAMETER;
+		}
+	}
+
+	TCGS_Builder_AddToken(response, TOKEN_START_LIST);
+	TCGS_Builder_AddToken(response, TOKEN_START_LIST);
+	for (i = 0; i < tper->objectCount && returned < count; i++)
+	{
+		//rows of table share upper half of UID with the table
+		if (memcmp(tper->objects[i].uid.bytes, table->bytes, 4) != 0)
+		{
+			continue;
+		}
+		if (found)
+		{
+			TCGS_Builder_AddUID(response, &tper->objects[i].uid);
+			returned++;
+		}
+		else
+		{
+			found = _uidEqual(&tper->objects[i].uid, &where);
+		}
+	}
+	TCGS_Builder_AddToken(response, TOKEN_END_LIST);
+	TCGS_Builder_AddToken(response, TOKEN_END_LIST);
+	return response->overflow ? METHOD_STATUS_RESPONSE_OVERFLOW : METHOD_STATUS_SUCCESS;
+}
+
+static TCGS_MethodStatus_t TCGS_VTPer_Authenticate(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session,
+		TCGS_Parser_t *arguments, TCGS_Builder_t *response)
+{
+	TCGS_UID_t authority;
+	const uint8 *challenge = NULL;
+	uint32 challengeLength = 0;
+	uint64 name;
+	bool authenticated;
+
+	if (!TCGS_Parser_GetUID(arguments, &authority))
+	{
+		return METHOD_STATUS_INVALID_PARAMETER;
+	}
+	if (TCGS_Parser_Expect(arguments, TOKEN_START_NAME))
+	{
+		if (!TCGS_Parser_GetUInt(arguments, &name) ||
+			!TCGS_Parser_GetBytes(arguments, &challenge, &challengeLength) ||
+			!TCGS_Parser_Expect(arguments, TOKEN_END_NAME))
+		{
+			return METHOD_STATUS_INVALID_PARAMETER;
+		}
+	}
+	authenticated = TCGS_VTPer_CheckCredential(tper, &authority, challenge, challengeLength);
+	if (authenticated)
+	{
+		session->authority = authority;
+	}
+	TCGS_Builder_AddToken(response, TOKEN_START_LIST);
+	TCGS_Builder_AddUInt(response, authenticated ? 1 : 0);
+	TCGS_Builder_AddToken(response, TOKEN_END_LIST);
+	return METHOD_STATUS_SUCCESS;
+}
+
+static void TCGS_VTPer_InvokeMethod(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session,
+		const TCGS_UID_t *invokingId, const TCGS_UID_t *methodId,
+		TCGS_Parser_t *arguments, TCGS_Builder_t *response)
+{
+	TCGS_MethodStatus_t status = METHOD_STATUS_FAIL;
+	TCGS_VTPer_Object_t *object = TCGS_VTPer_FindObject(tper, invokingId);
+	uint32 mark = response->length;
+
+	if (_uidEqual(methodId, &TCGS_UID_Method_Authenticate) && _uidEqual(invokingId, &TCGS_UID_ThisSP))
+	{
+		status = TCGS_VTPer_Authenticate(tper, session, arguments, response);
+	}
+	else if (_uidEqual(methodId, &TCGS_UID_Method_Set) && _uidEqual(invokingId, &TCGS_UID_MBR))
+	{
+		status = TCGS_VTPer_SetMBR(tper, session, arguments, response);
+	}
+	else if (_uidEqual(methodId, &TCGS_UID_Method_Revert) && _uidEqual(invokingId, &TCGS_UID_AdminSP))
+	{
+		status = TCGS_VTPer_Revert(tper, session, response);
+	}
+	else if (_uidEqual(methodId, &TCGS_UID_Method_Activate) && _uidEqual(invokingId, &TCGS_UID_LockingSP))
+	{
+		status = TCGS_VTPer_Activate(tper, session, response);
+	}
+	else if (_uidEqual(methodId, &TCGS_UID_Method_Next))
+	{
+		status = TCGS_VTPer_Next(tper, session, invokingId, arguments, response);
+	}
+	else if (object == NULL)
+	{
+		status = METHOD_STATUS_INVALID_PARAMETER;
+	}
+	else if (_uidEqual(methodId, &TCGS_UID_Method_Get))
+	{
+		status = TCGS_VTPer_Get(tper, session, object, arguments, response);
+	}
+	else if (_uidEqual(methodId, &TCGS_UID_Method_Set))
+	{
+		status = TCGS_VTPer_Set(tper, session, object, arguments, response);
+	}
+
+	if (status != METHOD_STATUS_SUCCESS)
+	{
+		//failed method returns empty list
+		response->length = mark;
+		response->overflow = FALSE;
+		TCGS_Builder_AddToken(response, TOKEN_START_LIST);
+		TCGS_Builder_AddToken(response, TOKEN_END_LIST);
+	}
+	TCGS_Builder_AddStatus(response, status);
+}
+
+static TCGS_VTPer_Session_t *TCGS_VTPer_FindSession(TCGS_VTPer_t *tper, TCGS_ComPacketInfo_t *info)
+{
+	uint32 i;
+
+	for (i = 0; i < VTPER_MAX_SESSIONS; i++)
+	{
+		if (tper->sessions[i].open &&
+			tper->sessions[i].tperSessionNumber == info->tperSessionNumber &&
+			tper->sessions[i].hostSessionNumber == info->hostSessionNumber)
+		{
+			return &tper->sessions[i];
+		}
+	}
+	return NULL;
+}
+
+static void TCGS_VTPer_ProcessSession(TCGS_VTPer_t *tper, TCGS_VTPer_Session_t *session,
+		TCGS_Parser_t *request, TCGS_Builder_t *response)
+{
+	TCGS_Parser_t arguments;
+	TCGS_UID_t invokingId, methodId;
+	uint64 status;
+	bool done;
+
+	TCGS_Builder_StartComPacket(response, tper->comId,
+			session->tperSessionNumber, session->hostSessionNumber);
+	while (!TCGS_Parser_AtEnd(request))
+	{
+		if (TCGS_Parser_Expect(request, TOKEN_END_OF_SESSION))
+		{
+			TCGS_VTPer_CloseSession(tper, session);
+			TCGS_Builder_AddToken(response, TOKEN_END_OF_SESSION);
+			break;
+		}
+		if (TCGS_Parser_Expect(request, TOKEN_START_TRANSACTION))
+		{
+			TCGS_Parser_GetUInt(request, &status);
+			done = !session->transaction && TCGS_VTPer_StartTransaction(tper, session);
+			TCGS_Builder_AddToken(response, TOKEN_START_TRANSACTION);
+			TCGS_Builder_AddUInt(response, done ? 0 : 1);
+			continue;
+		}
+		if (TCGS_Parser_Expect(request, TOKEN_END_TRANSACTION))
+		{
+			//status 0 commits the transaction, any other aborts it
+			TCGS_Parser_GetUInt(request, &status);
+			done = session->transaction && status == 0;
+			TCGS_VTPer_EndTransaction(tper, session, done);
+			TCGS_Builder_AddToken(response, TOKEN_END_TRANSACTION);
+			TCGS_Builder_AddUInt(response, done ? 0 : 1);
+			continue;
+		}
+		if (!TCGS_Parser_Expect(request, TOKEN_CALL) ||
+			!TCGS_Parser_GetUID(request, &invokingId) ||
+			!TCGS_Parser_GetUID(request, &methodId) ||
+			!TCGS_VTPer_GetArguments(request, &arguments))
+		{
+			//malformed method aborts the session
+			TCGS_VTPer_CloseSession(tper, session);
+			TCGS_Builder_AddToken(response, TOKEN_END_OF_SESSION);
+			break;
+		}
+		TCGS_VTPer_InvokeMethod(tper, session, &invokingId, &methodId, &arguments, response);
+	}
 }
 
-// see section 3.2.1.1.1 (Response) of Application Note for description of the package
+static void TCGS_VTPer_ProcessComPacket(TCGS_VTPer_t *tper, const void *data, uint32 size)
+{
+	TCGS_ComPacketInfo_t info;
+	TCGS_Parser_t request, arguments;
+	TCGS_Builder_t response;
+	TCGS_VTPer_Session_t *session;
+	TCGS_UID_t invokingId, methodId;
+
+	tper->responseReady = FALSE;
+	if (TCGS_ParseComPacket(data, size, &info, &request) != ERROR_SUCCESS || request.length == 0)
+	{
+		return;
+	}
+	TCGS_Builder_Init(&response, tper->response, sizeof(tper->response));
+
+	if (info.tperSessionNumber == 0)
+	{
+		//Session Manager
+		if (!TCGS_Parser_Expect(&request, TOKEN_CALL) ||
+			!TCGS_Parser_GetUID(&request, &invokingId) ||
+			!TCGS_Parser_GetUID(&request, &methodId) ||
+			!TCGS_VTPer_GetArguments(&request, &arguments) ||
+			!_uidEqual(&invokingId, &TCGS_UID_SMUID) ||
+			!_uidEqual(&methodId, &TCGS_UID_Method_StartSession))
+		{
+			return;
+		}
+		TCGS_VTPer_StartSession(tper, &arguments, &response);
+	}
+	else
+	{
+		session = TCGS_VTPer_FindSession(tper, &info);
+		if (session == NULL)
+		{
+			//packets of unknown sessions are discarded
+			return;
+		}
+		TCGS_VTPer_ProcessSession(tper, session, &request, &response);
+	}
+	tper->responseReady = (TCGS_Builder_EndComPacket(&response) == ERROR_SUCCESS);
+
+	if (tper->revertPending)
+	{
+		//all sessions are closed by Revert
+		tper->revertPending = FALSE;
+		memset(tper->sessions, 0, sizeof(tper->sessions));
+		TCGS_VTPer_InitTables(tper);
+	}
+}
+
+//offset of flags byte of Locking feature in Level 0 Discovery response
+#define VTPER_LOCKING_FLAGS_OFFSET 68
+
+//offset of code of SSC feature in Level 0 Discovery response
+#define VTPER_SSC_FEATURE_OFFSET 112
+
+/*
+ * Locking feature flags reflect state of locking ranges and MBRControl
+ */
+static uint8 TCGS_VTPer_GetLockingFlags(TCGS_VTPer_t *tper)
+{
+	const TCGS_UID_t *ranges[] = {&TCGS_UID_Locking_GlobalRange, &TCGS_UID_Locking_Range1};
+	TCGS_VTPer_Object_t *object;
+	uint8 flags = 0x09;     //locking supported, media encryption
+	uint32 i;
+
+	if (tper->lockingActive)
+	{
+		flags |= 0x02;
+	}
+
+	for (i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++)
+	{
+		object = TCGS_VTPer_FindObject(tper, ranges[i]);
+		if (object->columns[TCGS_COLUMN_LOCKING_READ_LOCKED].value != 0 ||
+			object->columns[TCGS_COLUMN_LOCKING_WRITE_LOCKED].value != 0)
+		{
+			flags |= 0x04;
+		}
+	}
+	object = TCGS_VTPer_FindObject(tper, &TCGS_UID_MBRControl);
+	if (object->columns[TCGS_COLUMN_MBRCONTROL_ENABLE].value != 0)
+	{
+		flags |= 0x10;
+	}
+	if (object->columns[TCGS_COLUMN_MBRCONTROL_DONE].value != 0)
+	{
+		flags |= 0x20;
+	}
+	return flags;
+}
+
+// see section 3.2.1.1.1 (Response) of Application Note for description of the package,
+// Geometry feature is added
 uint8 appnote_response_level0discovery[] =
 {
-	0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x01, 0x10, 0x0C, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x10, 0x0C, 0x51, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x02, 0x10, 0x0C, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	//Geometry: 512 bytes blocks, 8 blocks alignment granularity
+	0x00, 0x03, 0x10, 0x1C, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x02, 0x00, 0x10, 0x10, 0x07, 0xFE, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 };
 
-TCGS_InterfaceError_t TCGS_VTPER_SendCommand(
+/*
+ * Processes ComID management request of protocol 0x02. Stack Reset aborts
+ * all sessions and discards the pending response.
+ */
+static void TCGS_VTPer_ProcessComIDRequest(TCGS_VTPer_t *tper, TCGS_ComIDRequest_t *request)
+{
+	TCGS_ComIDResponse_t *response = &tper->comIdResponse;
+	uint32 state = COMID_STATE_ISSUED;
+	uint32 i;
+
+	memset(response, 0, sizeof(*response));
+	memcpy(response, request, sizeof(*request));
+	switch (_getBE32(request->requestCode))
+	{
+	case COMID_REQUEST_VERIFY_COMID_VALID:
+		for (i = 0; i < VTPER_MAX_SESSIONS; i++)
+		{
+			if (tper->sessions[i].open)
+			{
+				state = COMID_STATE_ASSOCIATED;
+			}
+		}
+		_putBE32(response->data, state);
+		break;
+	case COMID_REQUEST_STACK_RESET:
+		for (i = 0; i < VTPER_MAX_SESSIONS; i++)
+		{
+			TCGS_VTPer_EndTransaction(tper, &tper->sessions[i], FALSE);
+		}
+		memset(tper->sessions, 0, sizeof(tper->sessions));
+		tper->responseReady = FALSE;
+		_putBE32(response->data, 0);
+		break;
+	default:
+		return;
+	}
+	_putBE16(response->availableDataLength, sizeof(response->data));
+	tper->comIdResponseReady = TRUE;
+}
+
+TCGS_Error_t TCGS_VTPER_SendCommand(
     TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
     TCGS_InterfaceError_t *tperError, void *outputPayload)
 {
+	TCGS_VTPer_t *tper = TCGS_VTPer_GetCurrent();
+	uint32 transferLength = TCGS_GetTransferLength(inputCommandBlock);
+	TCGS_ComPacketHeader_t *comPacket;
+
 	if (inputCommandBlock->command == IF_SEND)
 	{
-
+		if (inputCommandBlock->protocolId == 0x01 && inputCommandBlock->comId == tper->comId)
+		{
+			tper->sendCount++;
+			TCGS_VTPer_ProcessComPacket(tper, inputPayload, transferLength);
+		}
+		else if (inputCommandBlock->protocolId == 0x02 && inputCommandBlock->comId == tper->comId)
+		{
+			TCGS_VTPer_ProcessComIDRequest(tper, (TCGS_ComIDRequest_t*)inputPayload);
+		}
 	}
 	else
 	{
@@ -47,9 +964,37 @@ TCGS_InterfaceError_t TCGS_VTPER_SendCommand(
 				if (inputCommandBlock->comId == 0x01)
 				{
 					//Level 0 Discovery
-					//TODO: replace 100 with actual buffer length
-					memset(outputPayload, 0, 100);
 					memcpy(outputPayload, appnote_response_level0discovery, sizeof(appnote_response_level0discovery));
+					((uint8*)outputPayload)[VTPER_LOCKING_FLAGS_OFFSET] = TCGS_VTPer_GetLockingFlags(tper);
+					if (tper->enterprise)
+					{
+						_putBE16((uint8*)outputPayload + VTPER_SSC_FEATURE_OFFSET, FEATURE_ENTERPRISE);
+					}
+				}
+				else if (inputCommandBlock->comId == tper->comId)
+				{
+					memset(outputPayload, 0, transferLength);
+					if (tper->responseReady)
+					{
+						memcpy(outputPayload, tper->response,
+								transferLength < sizeof(tper->response) ? transferLength : sizeof(tper->response));
+						tper->responseReady = FALSE;
+					}
+					else
+					{
+						//empty ComPacket: no response is available
+						comPacket = (TCGS_ComPacketHeader_t*)outputPayload;
+						comPacket->comId[0] = (uint8)(tper->comId >> 8);
+						comPacket->comId[1] = (uint8)tper->comId;
+					}
+				}
+				break;
+			case 0x02:
+				memset(outputPayload, 0, transferLength);
+				if (inputCommandBlock->comId == tper->comId && tper->comIdResponseReady)
+				{
+					memcpy(outputPayload, &tper->comIdResponse, sizeof(tper->comIdResponse));
+					tper->comIdResponseReady = FALSE;
 				}
 				break;
 			}
@@ -58,5 +1003,3 @@ TCGS_InterfaceError_t TCGS_VTPER_SendCommand(
 	*tperError = INTERFACE_ERROR_GOOD;
 	return ERROR_SUCCESS;
 }
-
-#endif //_TCGS_VTPER_H
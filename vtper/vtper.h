@@ -8,13 +8,125 @@
 #ifndef _TCGS_VTPER_H
 #define _TCGS_VTPER_H
 
+#include <stdbool.h>
+
+#include "tcgs_config.h"
 #include "tcgs_types.h"
+#include "tcgs_stream.h"
 #include "tcgs_interface.h"
 
+#define VTPER_BASE_COMID        0x07FE
+#define VTPER_MAX_SESSIONS      8
+#define VTPER_MAX_OBJECTS       128
+#define VTPER_MAX_COLUMNS       12
+#define VTPER_MAX_VALUE_LENGTH  32
+#define VTPER_MBR_SIZE          0x20000
+
+//MSID of every virtual TPer
+#define VTPER_MSID "VTPER-MSID"
+
+typedef enum
+{
+	VTPER_VALUE_NONE,
+	VTPER_VALUE_UINT,
+	VTPER_VALUE_BYTES,
+} TCGS_VTPer_ValueType_t;
+
+typedef struct
+{
+	uint8   type;
+	uint8   length;
+	uint64  value;
+	uint8   bytes[VTPER_MAX_VALUE_LENGTH];
+} TCGS_VTPer_Value_t;
+
+typedef struct
+{
+	TCGS_UID_t          uid;
+	TCGS_VTPer_Value_t  columns[VTPER_MAX_COLUMNS];
+} TCGS_VTPer_Object_t;
+
+typedef struct
+{
+	bool        open;
+	uint32      tperSessionNumber;
+	uint32      hostSessionNumber;
+	TCGS_UID_t  sp;
+	TCGS_UID_t  authority;
+	bool        write;
+	bool        transaction;        //transaction of the session is open
+} TCGS_VTPer_Session_t;
+
+/*****************************************************************************
+ * \brief State of virtual TPer
+ *
+ * An instance is bound to TCGS_Device_t through context of the device.
+ * Commands sent without device go to the default instance.
+ *****************************************************************************/
+typedef struct
+{
+	uint16                comId;
+	uint32                lastSessionNumber;
+	TCGS_VTPer_Session_t  sessions[VTPER_MAX_SESSIONS];
+	TCGS_VTPer_Object_t   objects[VTPER_MAX_OBJECTS];
+	uint32                objectCount;
+	uint8                 response[TCGS_MAX_COMPACKET_SIZE];
+	bool                  responseReady;
+	bool                  revertPending;      //tables are reset after the response
+	bool                  lockingActive;      //Locking SP is activated
+	bool                  enterprise;         //Level 0 Discovery reports Enterprise SSC instead of Opal 1.0
+	TCGS_ComIDResponse_t  comIdResponse;      //response to ComID management request
+	bool                  comIdResponseReady;
+	uint8                 mbr[VTPER_MBR_SIZE];
+
+	//tables at start of the open transaction, restored when it is aborted
+	TCGS_VTPer_Object_t   transactionBackup[VTPER_MAX_OBJECTS];
+	uint32                transactionBackupCount;
 
+	//statistics
+	uint32                startSessionCount;
+	uint32                sendCount;
+} TCGS_VTPer_t;
+
+/*****************************************************************************
+ * \brief Resets default instance of virtual TPer to factory state
+ *****************************************************************************/
 void TCGS_VTPer_Init(void);
 
-TCGS_InterfaceError_t TCGS_VTPER_SendCommand(
+/*****************************************************************************
+ * \brief Resets instance of virtual TPer to factory state
+ *
+ * \par SID PIN equals to MSID, Admin1 and User1 PINs are empty.
+ *****************************************************************************/
+void TCGS_VTPer_InitInstance(TCGS_VTPer_t *tper);
+
+/*****************************************************************************
+ * \brief Brings instance of virtual TPer in zeroed memory to factory state
+ *
+ * \par Only the rows of factory tables are written, so instances allocated
+ * with calloc take memory for MBR and transaction backup when they are used.
+ *****************************************************************************/
+void TCGS_VTPer_InitZeroedInstance(TCGS_VTPer_t *tper);
+
+TCGS_VTPer_t *TCGS_VTPer_GetDefault(void);
+
+/*****************************************************************************
+ * \brief Simulates power cycle: all sessions are closed, tables are kept
+ *
+ * \par Open transaction is aborted.
+ *****************************************************************************/
+void TCGS_VTPer_PowerCycle(TCGS_VTPer_t *tper);
+
+TCGS_VTPer_Object_t *TCGS_VTPer_FindObject(TCGS_VTPer_t *tper, const TCGS_UID_t *uid);
+
+/*****************************************************************************
+ * \brief Adds table row with empty columns
+ *
+ * \return TCGS_VTPer_Object_t* added row, NULL if there is no room
+ *****************************************************************************/
+TCGS_VTPer_Object_t *TCGS_VTPer_AddObject(TCGS_VTPer_t *tper, const TCGS_UID_t *uid);
+
+TCGS_Error_t TCGS_VTPER_SendCommand(
     TCGS_CommandBlock_t *inputCommandBlock,  void *inputPayload,
     TCGS_InterfaceError_t *tperError, void *outputPayload);
 